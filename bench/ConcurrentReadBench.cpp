@@ -0,0 +1,148 @@
+// Measures message ingest latency while other threads run history queries.
+//
+// Usage: ConcurrentReadBench [seedMessages] [readerThreads] [writes]
+
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+#include <algorithm>
+
+#include "storage/DatabaseManager.h"
+
+using namespace MeshCore;
+
+namespace {
+
+Message makeMessage(int i) {
+  Message msg;
+  msg.type = Message::CHANNEL_MESSAGE;
+  msg.channelIdx = static_cast<uint8_t>(i % 8);
+  msg.senderName = QString("node%1").arg(i % 64);
+  msg.text = QString("bench message %1 with some typical payload text").arg(i);
+  msg.timestamp = 1700000000u + static_cast<uint32_t>(i);
+  msg.pathLen = msg.pathLength = static_cast<uint8_t>(i % 4);
+  msg.snr = 5.0f;
+  msg.receivedAt = QDateTime::currentDateTime();
+  return msg;
+}
+
+struct LatencySummary {
+  double p50Us = 0;
+  double p99Us = 0;
+  double maxUs = 0;
+};
+
+LatencySummary summarize(QVector<qint64> samplesNs) {
+  LatencySummary summary;
+  if (samplesNs.isEmpty()) {
+    return summary;
+  }
+  std::sort(samplesNs.begin(), samplesNs.end());
+  auto at = [&](double q) {
+    qsizetype idx = std::min(static_cast<qsizetype>(q * samplesNs.size()),
+                              samplesNs.size() - 1);
+    return samplesNs[idx] / 1000.0;
+  };
+  summary.p50Us = at(0.50);
+  summary.p99Us = at(0.99);
+  summary.maxUs = samplesNs.last() / 1000.0;
+  return summary;
+}
+
+QVector<qint64> timeWrites(DatabaseManager &db, int firstId, int count) {
+  QVector<qint64> samples;
+  samples.reserve(count);
+  QElapsedTimer timer;
+  for (int i = 0; i < count; ++i) {
+    timer.start();
+    db.saveMessage(makeMessage(firstId + i));
+    samples.append(timer.nsecsElapsed());
+  }
+  return samples;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  QTextStream out(stdout);
+
+  QStringList args = app.arguments();
+  int seedCount = args.size() > 1 ? args[1].toInt() : 20000;
+  int readerCount = args.size() > 2 ? args[2].toInt() : 4;
+  int writeCount = args.size() > 3 ? args[3].toInt() : 2000;
+
+  QTemporaryDir dir;
+  if (!dir.isValid()) {
+    out << "Failed to create temporary directory\n";
+    return 1;
+  }
+
+  DatabaseManager db;
+  db.setDatabaseDirectory(dir.path());
+  if (!db.openDatabase(QByteArray(32, '\x42'))) {
+    out << "Failed to open database: " << db.getLastError() << "\n";
+    return 1;
+  }
+
+  out << "Seeding " << seedCount << " messages...\n";
+  out.flush();
+  for (int i = 0; i < seedCount; ++i) {
+    db.saveMessage(makeMessage(i));
+  }
+
+  LatencySummary idle = summarize(timeWrites(db, seedCount, writeCount));
+
+  QAtomicInt stop(0);
+  QAtomicInt queries(0);
+  QVector<QThread *> readers;
+  for (int r = 0; r < readerCount; ++r) {
+    QThread *thread = QThread::create([&db, &stop, &queries, r]() {
+      int n = 0;
+      while (!stop.loadAcquire()) {
+        if (n++ % 2 == 0) {
+          db.loadMessages(100, (n * 37) % 1000);
+        } else {
+          db.loadChannelMessages(static_cast<uint8_t>(r % 8), 100);
+        }
+        queries.fetchAndAddRelaxed(1);
+      }
+      db.releaseReadConnection();
+    });
+    readers.append(thread);
+    thread->start();
+  }
+
+  QElapsedTimer wall;
+  wall.start();
+  LatencySummary loaded =
+      summarize(timeWrites(db, seedCount + writeCount, writeCount));
+  qint64 loadedMs = wall.elapsed();
+
+  stop.storeRelease(1);
+  for (QThread *thread : readers) {
+    thread->wait();
+    delete thread;
+  }
+
+  out << QString("writes without readers: p50 %1 us  p99 %2 us  max %3 us\n")
+             .arg(idle.p50Us, 0, 'f', 1)
+             .arg(idle.p99Us, 0, 'f', 1)
+             .arg(idle.maxUs, 0, 'f', 1);
+  out << QString("writes with %1 readers: p50 %2 us  p99 %3 us  max %4 us\n")
+             .arg(readerCount)
+             .arg(loaded.p50Us, 0, 'f', 1)
+             .arg(loaded.p99Us, 0, 'f', 1)
+             .arg(loaded.maxUs, 0, 'f', 1);
+  out << QString("reader queries completed: %1 (%2/s)\n")
+             .arg(queries.loadRelaxed())
+             .arg(loadedMs > 0 ? queries.loadRelaxed() * 1000.0 / loadedMs : 0.0, 0,
+                  'f', 0);
+
+  db.closeDatabase();
+  return 0;
+}
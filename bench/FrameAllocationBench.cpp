@@ -0,0 +1,216 @@
+// Counts heap allocations per inbound message frame on the receive path:
+// parsing, dispatch through MeshClient, and parsing plus saving to each
+// message store. Stores are run with the per-frame arena active, as
+// MeshClient does, and without one, where scratch falls back to the heap.
+// Every malloc is counted, so Qt's string and list buffers are included as
+// well as operator new; allocations from other threads (SQLite's, Qt's) are
+// too, but the receive path runs on one.
+//
+// Counting interposes malloc and needs glibc; elsewhere only times are shown.
+//
+// Usage: FrameAllocationBench [frames]
+
+#include <cstdlib>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+#include <atomic>
+
+#include "connection/IConnection.h"
+#include "core/FrameArena.h"
+#include "core/MeshClient.h"
+#include "protocol/ProtocolConstants.h"
+#include "protocol/ResponseParser.h"
+#include "storage/DatabaseManager.h"
+#include "storage/MessageLogStore.h"
+
+using namespace MeshCore;
+
+namespace {
+
+std::atomic<quint64> allocationCount{0};
+
+} // namespace
+
+#if defined(__GLIBC__)
+#define COUNTING_ALLOCATIONS
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+
+void *malloc(size_t size) noexcept {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) noexcept {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) noexcept {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  return __libc_realloc(pointer, size);
+}
+}
+#endif
+
+namespace {
+
+class FakeConnection : public IConnection {
+public:
+  using IConnection::IConnection;
+
+  bool open(const QString &) override { return true; }
+  void close() override {}
+  bool isOpen() const override { return true; }
+  bool sendFrame(const QByteArray &) override { return true; }
+  ConnectionState state() const override { return ConnectionState::Connected; }
+  QString connectionType() const override { return "Fake"; }
+
+  void deliver(const QByteArray &frame) { emit frameReceived(frame); }
+};
+
+void appendTimestamp(QByteArray &frame, uint32_t timestamp) {
+  for (int b = 0; b < 4; ++b) {
+    frame.append(static_cast<char>((timestamp >> (8 * b)) & 0xFF));
+  }
+}
+
+// Three channel messages to one direct message. Timestamps start at base so
+// that each run saves messages the store has not seen.
+QVector<QByteArray> makeFrames(int count, uint32_t base) {
+  QVector<QByteArray> frames;
+  frames.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    QByteArray frame;
+    const QByteArray text = QString("message %1 about the weather").arg(i).toUtf8();
+    if (i % 4 != 0) {
+      frame.append(static_cast<char>(ResponseCode::CHANNEL_MSG_RECV_V3));
+      frame.append(static_cast<char>(20 + i % 16)); // SNR * 4
+      frame.append(2, '\0');
+      frame.append(static_cast<char>(i % 8)); // Channel
+      frame.append(static_cast<char>(i % 4)); // Path length
+      frame.append('\0');                     // Text type
+      appendTimestamp(frame, base + static_cast<uint32_t>(i));
+      frame.append(QString("node-%1: ").arg(i % 50).toUtf8() + text);
+    } else {
+      frame.append(static_cast<char>(ResponseCode::CONTACT_MSG_RECV_V3));
+      frame.append(static_cast<char>(20 + i % 16));
+      frame.append(2, '\0');
+      frame.append(QByteArray(6, static_cast<char>(i % 50))); // Sender key prefix
+      frame.append(static_cast<char>(0xFF));                  // Direct
+      frame.append('\0');
+      appendTimestamp(frame, base + static_cast<uint32_t>(i));
+      frame.append(text);
+    }
+    frame.append('\0');
+    frames.append(frame);
+  }
+  return frames;
+}
+
+Message parse(const QByteArray &frame) {
+  return ResponseParser::getResponseCode(frame) == ResponseCode::CHANNEL_MSG_RECV_V3
+             ? ResponseParser::parseChannelMsgRecvV3(frame)
+             : ResponseParser::parseContactMsgRecvV3(frame);
+}
+
+struct Result {
+  qint64 nsPerFrame;
+  double allocationsPerFrame;
+};
+
+template <typename Handler>
+Result measure(const QVector<QByteArray> &frames, Handler &&handle) {
+  const quint64 startCount = allocationCount.load(std::memory_order_relaxed);
+  QElapsedTimer timer;
+  timer.start();
+  for (const QByteArray &frame : frames) {
+    handle(frame);
+  }
+  const qint64 ns = timer.nsecsElapsed();
+  const quint64 count = allocationCount.load(std::memory_order_relaxed) - startCount;
+  return {ns / frames.size(), double(count) / frames.size()};
+}
+
+void print(QTextStream &out, const QString &name, const Result &result) {
+  out << QString("%1 %2 ns/frame").arg(name, -28).arg(result.nsPerFrame, 7);
+#ifdef COUNTING_ALLOCATIONS
+  out << QString("  %1 allocations/frame").arg(result.allocationsPerFrame, 6, 'f', 2);
+#endif
+  out << "\n";
+}
+
+void runStore(QTextStream &out, const QString &name, IMessageStore &store, int count) {
+  if (!store.openDatabase(QByteArray(32, '\x24'))) {
+    out << name << ": failed to open: " << store.getLastError() << "\n";
+    return;
+  }
+
+  // Warms the sender cache and creates the partition
+  for (const QByteArray &frame : makeFrames(1000, 1600000000u)) {
+    store.saveMessage(parse(frame));
+  }
+
+  FrameArena arena;
+  const Result withArena =
+      measure(makeFrames(count, 1700000000u), [&](const QByteArray &frame) {
+        FrameArena::Scope scope(arena);
+        store.saveMessage(parse(frame));
+      });
+  const Result withHeap =
+      measure(makeFrames(count, 1800000000u),
+              [&](const QByteArray &frame) { store.saveMessage(parse(frame)); });
+
+  print(out, name + " save, frame arena", withArena);
+  print(out, name + " save, heap scratch", withHeap);
+  out << QString("%1 frame arena heap spills: %2\n").arg(name).arg(arena.overflows());
+  store.closeDatabase();
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  QTextStream out(stdout);
+
+  const int count = qMax(1, argc > 1 ? QString(argv[1]).toInt() : 100000);
+
+#ifndef COUNTING_ALLOCATIONS
+  out << "malloc is not interposed on this platform; allocations are not counted\n";
+#endif
+
+  print(out, "parse", measure(makeFrames(count, 1700000000u),
+                              [](const QByteArray &frame) { parse(frame); }));
+
+  {
+    FakeConnection connection;
+    MeshClient client(&connection);
+    client.enablePersistence(false);
+    print(out, "dispatch, no persistence",
+          measure(makeFrames(count, 1700000000u),
+                  [&](const QByteArray &frame) { connection.deliver(frame); }));
+  }
+
+  QTemporaryDir dir;
+  if (!dir.isValid()) {
+    out << "Failed to create a temporary directory\n";
+    return 1;
+  }
+
+  DatabaseManager db;
+  db.setDatabaseDirectory(dir.path());
+  runStore(out, "sqlite", db, count);
+
+  MessageLogStore log;
+  log.setDirectory(dir.path());
+  runStore(out, "log", log, count);
+
+  return 0;
+}
@@ -0,0 +1,122 @@
+// Measures what logging costs on the receive path: channel messages and raw
+// RX pushes are fed through MeshClient from a fake connection, once with the
+// default logging rules and once with every meshcore category at debug
+// level (what each frame paid when all output went through qDebug()).
+// Log output is formatted but discarded.
+//
+// Usage: IngestLoggingBench [frames]
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QLoggingCategory>
+#include <QTextStream>
+
+#include "connection/IConnection.h"
+#include "core/MeshClient.h"
+#include "protocol/ProtocolConstants.h"
+
+using namespace MeshCore;
+
+namespace {
+
+const int ROUNDS = 3;
+
+class FakeConnection : public IConnection {
+public:
+  using IConnection::IConnection;
+
+  bool open(const QString &) override { return true; }
+  void close() override {}
+  bool isOpen() const override { return true; }
+  bool sendFrame(const QByteArray &) override { return true; }
+  ConnectionState state() const override { return ConnectionState::Connected; }
+  QString connectionType() const override { return "Fake"; }
+
+  void deliver(const QByteArray &frame) { emit frameReceived(frame); }
+};
+
+void discardMessage(QtMsgType, const QMessageLogContext &, const QString &) {}
+
+QVector<QByteArray> makeFrames(int count) {
+  QVector<QByteArray> frames;
+  frames.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    QByteArray frame;
+    if (i % 2 == 0) {
+      // CHANNEL_MSG_RECV_V3
+      frame.append(static_cast<char>(ResponseCode::CHANNEL_MSG_RECV_V3));
+      frame.append(static_cast<char>(20 + i % 16)); // SNR * 4
+      frame.append(2, '\0');
+      frame.append(static_cast<char>(i % 8));       // Channel
+      frame.append(static_cast<char>(i % 4));       // Path length
+      frame.append('\0');                           // Text type
+      const uint32_t timestamp = 1700000000u + static_cast<uint32_t>(i);
+      for (int b = 0; b < 4; ++b) {
+        frame.append(static_cast<char>((timestamp >> (8 * b)) & 0xFF));
+      }
+      frame.append(QString("node-%1: message %2 about the weather on the hill")
+                       .arg(i % 50)
+                       .arg(i)
+                       .toUtf8());
+      frame.append('\0');
+    } else {
+      // LOG_RX_DATA: SNR, RSSI, raw packet
+      frame.append(static_cast<char>(PushCode::LOG_RX_DATA));
+      frame.append(static_cast<char>(20 + i % 16));
+      frame.append(static_cast<char>(-90 + i % 30));
+      frame.append(QByteArray(64, static_cast<char>(i)));
+    }
+    frames.append(frame);
+  }
+  return frames;
+}
+
+qint64 runFrames(FakeConnection &connection, const QVector<QByteArray> &frames) {
+  qint64 best = 0;
+  for (int round = 0; round < ROUNDS; ++round) {
+    QElapsedTimer timer;
+    timer.start();
+    for (const QByteArray &frame : frames) {
+      connection.deliver(frame);
+    }
+    qint64 ns = timer.nsecsElapsed();
+    best = round == 0 ? ns : qMin(best, ns);
+  }
+  return qMax<qint64>(1, best);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  QTextStream out(stdout);
+
+  const int count = argc > 1 ? QString(argv[1]).toInt() : 200000;
+  const QVector<QByteArray> frames = makeFrames(count);
+
+  FakeConnection connection;
+  MeshClient client(&connection);
+  client.enablePersistence(false);
+  qInstallMessageHandler(discardMessage);
+
+#ifdef MESHCORE_TRACE_LOGGING
+  out << "trace statements: compiled in\n";
+#else
+  out << "trace statements: compiled out\n";
+#endif
+
+  QLoggingCategory::setFilterRules("meshcore.*.debug=true");
+  const qint64 verboseNs = runFrames(connection, frames);
+
+  QLoggingCategory::setFilterRules(QString());
+  const qint64 defaultNs = runFrames(connection, frames);
+
+  out << QString("all debug output: %1 ns/frame (%2 frames/s)\n")
+             .arg(verboseNs / count)
+             .arg(qint64(count) * 1000000000 / verboseNs);
+  out << QString("default rules:    %1 ns/frame (%2 frames/s)\n")
+             .arg(defaultNs / count)
+             .arg(qint64(count) * 1000000000 / defaultNs);
+  out << QString("speedup: %1x\n").arg(double(verboseNs) / defaultNs, 0, 'f', 2);
+  return 0;
+}
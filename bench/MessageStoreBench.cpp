@@ -0,0 +1,118 @@
+// Runs the same ingest and read workload against the SQLite store and the
+// append-only message log: ingest rate, latency of a recent history page,
+// and the time to reopen (which for the log includes recovery scanning).
+//
+// Usage: MessageStoreBench [messages]
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+#include "storage/DatabaseManager.h"
+#include "storage/MessageLogStore.h"
+
+using namespace MeshCore;
+
+namespace {
+
+const int CHANNELS = 8;
+const int PEERS = 50;
+const int PAGE_READS = 200;
+
+QVector<Message> makeMessages(int count) {
+  QVector<Message> messages;
+  messages.reserve(count);
+  QDateTime start = QDateTime::currentDateTime().addDays(-7);
+  for (int i = 0; i < count; ++i) {
+    Message msg;
+    // One in five is a direct message
+    msg.type = i % 5 == 0 ? Message::CONTACT_MESSAGE : Message::CHANNEL_MESSAGE;
+    msg.channelIdx = static_cast<uint8_t>(i % CHANNELS);
+    msg.senderPubKeyPrefix = QByteArray(6, static_cast<char>(i % PEERS));
+    msg.senderName = QString("node-%1").arg(i % PEERS);
+    msg.text = QString("message %1 with some ordinary chat text about the weather").arg(i);
+    msg.timestamp = 1700000000u + static_cast<uint32_t>(i);
+    msg.pathLen = msg.pathLength = static_cast<uint8_t>(i % 4);
+    msg.txtType = 0;
+    msg.snr = 5.0f + (i % 20) * 0.25f;
+    msg.receivedAt = start.addSecs(i);
+    messages.append(msg);
+  }
+  return messages;
+}
+
+void runStore(QTextStream &out, const QString &name, IMessageStore &store,
+              const QVector<Message> &messages) {
+  const QByteArray key(32, '\x24');
+  if (!store.openDatabase(key)) {
+    out << name << ": failed to open: " << store.getLastError() << "\n";
+    return;
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+  for (const Message &msg : messages) {
+    store.saveMessage(msg);
+  }
+  qint64 ingestMs = qMax<qint64>(1, timer.elapsed());
+  out << QString("%1: ingest %2 messages: %3 ms (%4 msgs/s)\n")
+             .arg(name)
+             .arg(messages.size())
+             .arg(ingestMs)
+             .arg(messages.size() * 1000 / ingestMs);
+
+  timer.restart();
+  for (int i = 0; i < PAGE_READS; ++i) {
+    store.loadChannelMessages(static_cast<uint8_t>(i % CHANNELS), 50);
+  }
+  out << QString("%1: channel page of 50: %2 us\n")
+             .arg(name)
+             .arg(timer.nsecsElapsed() / 1000 / PAGE_READS);
+
+  timer.restart();
+  for (int i = 0; i < PAGE_READS; ++i) {
+    store.loadDirectMessages(QByteArray(6, static_cast<char>(i % PEERS)), 50);
+  }
+  out << QString("%1: direct page of 50: %2 us\n")
+             .arg(name)
+             .arg(timer.nsecsElapsed() / 1000 / PAGE_READS);
+
+  store.closeDatabase();
+  timer.restart();
+  bool reopened = store.openDatabase(key);
+  qint64 reopenMs = timer.elapsed();
+  out << QString("%1: reopen: %2 ms, %3 messages\n")
+             .arg(name)
+             .arg(reopenMs)
+             .arg(reopened ? store.getMessageCount() : -1);
+  store.closeDatabase();
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  QTextStream out(stdout);
+
+  QStringList args = app.arguments();
+  int count = args.size() > 1 ? args[1].toInt() : 100000;
+
+  QTemporaryDir dir;
+  if (!dir.isValid()) {
+    out << "Failed to create a temporary directory\n";
+    return 1;
+  }
+
+  QVector<Message> messages = makeMessages(count);
+
+  DatabaseManager db;
+  db.setDatabaseDirectory(dir.path());
+  runStore(out, "sqlite", db, messages);
+
+  MessageLogStore log;
+  log.setDirectory(dir.path());
+  runStore(out, "log", log, messages);
+
+  return 0;
+}
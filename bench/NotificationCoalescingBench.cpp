@@ -0,0 +1,141 @@
+// Feeds a contact list through MeshClient, a few frames per event-loop turn
+// as a serial read delivers them, to a consumer that re-renders the whole
+// list whenever it is notified: once connected to contactsUpdated (one
+// signal per contact), then to the coalesced contactsChanged at a few
+// update intervals. Reports renders and the time spent rendering.
+//
+// Usage: NotificationCoalescingBench [contacts] [frames per read]
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QStringList>
+#include <QTextStream>
+#include <QTimer>
+
+#include "connection/IConnection.h"
+#include "core/MeshClient.h"
+#include "protocol/ProtocolConstants.h"
+
+using namespace MeshCore;
+
+namespace {
+
+class FakeConnection : public IConnection {
+public:
+  using IConnection::IConnection;
+
+  bool open(const QString &) override { return true; }
+  void close() override {}
+  bool isOpen() const override { return true; }
+  bool sendFrame(const QByteArray &) override { return true; }
+  ConnectionState state() const override { return ConnectionState::Connected; }
+  QString connectionType() const override { return "Fake"; }
+
+  void deliver(const QByteArray &frame) { emit frameReceived(frame); }
+};
+
+QVector<QByteArray> makeContactFrames(int count) {
+  QVector<QByteArray> frames;
+  frames.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    QByteArray frame(148, '\0');
+    frame[0] = static_cast<char>(ResponseCode::CONTACT);
+    for (int b = 0; b < 32; ++b) {
+      frame[1 + b] = static_cast<char>((i >> (8 * (b % 4))) + b); // Public key
+    }
+    frame[33] = 1;                        // Type
+    frame[35] = static_cast<char>(i % 4); // Path length
+    const QByteArray name = QString("node-%1").arg(i).toUtf8();
+    frame.replace(100, name.size(), name);
+    frames.append(frame);
+  }
+  return frames;
+}
+
+// Redraws every contact, as a list view refreshed from getContacts() would
+struct Renderer {
+  const MeshClient *client;
+  int renders = 0;
+  qint64 renderNs = 0;
+  QStringList lines;
+
+  void render() {
+    QElapsedTimer timer;
+    timer.start();
+    lines.clear();
+    for (const Contact &contact : client->getContacts()) {
+      lines.append(QString("%1  %2  %3 hops")
+                       .arg(contact.name(), -32)
+                       .arg(QString(contact.publicKey().left(6).toHex()))
+                       .arg(contact.pathLength()));
+    }
+    renders++;
+    renderNs += timer.nsecsElapsed();
+  }
+};
+
+void waitMs(int ms) {
+  QEventLoop loop;
+  QTimer::singleShot(ms, &loop, &QEventLoop::quit);
+  loop.exec();
+}
+
+// interval < 0 connects the renderer to the per-contact contactsUpdated
+void run(QTextStream &out, const QVector<QByteArray> &frames, int framesPerRead,
+         int interval) {
+  FakeConnection connection;
+  MeshClient client(&connection);
+  client.enablePersistence(false);
+  Renderer renderer{&client};
+
+  if (interval < 0) {
+    QObject::connect(&client, &MeshClient::contactsUpdated, [&]() { renderer.render(); });
+  } else {
+    client.setUpdateInterval(interval);
+    QObject::connect(&client, &MeshClient::contactsChanged,
+                     [&](const QVector<QByteArray> &, const QVector<QByteArray> &) {
+                       renderer.render();
+                     });
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+  for (int i = 0; i < frames.size(); ++i) {
+    connection.deliver(frames[i]);
+    if ((i + 1) % framesPerRead == 0) {
+      QCoreApplication::processEvents(); // Next read
+    }
+  }
+  const qint64 ingestMs = timer.elapsed();
+  waitMs(qMax(0, interval) + 20); // The last batch
+
+  const QString name = interval < 0 ? QString("contactsUpdated")
+                                    : QString("contactsChanged, %1 ms").arg(interval);
+  out << QString("%1 %2 renders, %3 ms rendering, %4 ms ingest\n")
+             .arg(name, -24)
+             .arg(renderer.renders, 6)
+             .arg(renderer.renderNs / 1000000, 6)
+             .arg(ingestMs, 6);
+  if (renderer.lines.size() != frames.size()) {
+    out << "  last render showed " << renderer.lines.size() << " contacts\n";
+  }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  QTextStream out(stdout);
+
+  const int count = qMax(1, argc > 1 ? QString(argv[1]).toInt() : 2000);
+  const int framesPerRead = qMax(1, argc > 2 ? QString(argv[2]).toInt() : 4);
+  const QVector<QByteArray> frames = makeContactFrames(count);
+
+  out << count << " contacts, " << framesPerRead << " frames per read\n";
+  for (int interval : {-1, 0, 16, 50}) {
+    run(out, frames, framesPerRead, interval);
+    out.flush();
+  }
+  return 0;
+}
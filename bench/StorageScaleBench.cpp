@@ -0,0 +1,277 @@
+// Storage behaviour at scale: generates synthetic history (many channels,
+// direct-message peers, Zipf-distributed senders) and measures ingest
+// throughput, duplicate detection, history page latency by depth, file
+// size and open time.
+//
+// Results are printed one JSON object per line, e.g.
+//   {"metric":"ingest_rate","value":41234,"unit":"msgs/s","messages":1000000}
+// so runs can be collected and compared by scripts.
+//
+// Usage: StorageScaleBench [messages] [channels] [senders] [days]
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QVector>
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "storage/DatabaseManager.h"
+
+using namespace MeshCore;
+
+namespace {
+
+const double ZIPF_EXPONENT = 1.1;
+const int DIRECT_PERCENT = 10;
+const int PAGE_SIZE = 50;
+const int PAGE_REPEATS = 20;
+const int LATENCY_SAMPLE_EVERY = 100;
+const int DEDUP_SAMPLES = 10000;
+
+const char *const WORDS[] = {"ok",      "the",   "relay",  "is",      "up",    "on",
+                             "channel", "heard", "you",    "loud",    "clear", "moving",
+                             "north",   "packet", "lost",  "battery", "low",   "solar",
+                             "antenna", "node",  "repeater", "weather", "rain", "meet",
+                             "at",      "noon",  "thanks", "check",   "path",  "hops"};
+const int WORD_COUNT = sizeof(WORDS) / sizeof(WORDS[0]);
+
+// Sender rank drawn with probability proportional to 1 / rank^s
+class ZipfSampler {
+public:
+  ZipfSampler(int count, double exponent) : m_cdf(count) {
+    double sum = 0;
+    for (int i = 0; i < count; ++i) {
+      sum += 1.0 / std::pow(i + 1, exponent);
+      m_cdf[i] = sum;
+    }
+    for (double &value : m_cdf) {
+      value /= sum;
+    }
+  }
+
+  int sample(std::mt19937_64 &rng) {
+    double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+    return int(std::lower_bound(m_cdf.begin(), m_cdf.end(), u) - m_cdf.begin());
+  }
+
+private:
+  std::vector<double> m_cdf;
+};
+
+QByteArray senderPrefix(int sender) {
+  QByteArray prefix(6, '\0');
+  for (int i = 0; i < 4; ++i) {
+    prefix[i] = static_cast<char>((sender >> (8 * i)) & 0xFF);
+  }
+  prefix[4] = '\x5a';
+  prefix[5] = '\xa5';
+  return prefix;
+}
+
+class HistoryGenerator {
+public:
+  HistoryGenerator(int messages, int channels, int senders, int days)
+      : m_messages(messages), m_channels(channels), m_senders(senders, ZIPF_EXPONENT),
+        m_rng(20240601), m_start(QDateTime::currentSecsSinceEpoch() - qint64(days) * 86400),
+        m_step(qMax<double>(1.0, double(days) * 86400 / qMax(1, messages))) {}
+
+  Message make(int i) {
+    int sender = m_senders.sample(m_rng);
+    int words = 2 + int(m_rng() % 18);
+    QStringList text;
+    for (int w = 0; w < words; ++w) {
+      text.append(WORDS[m_rng() % WORD_COUNT]);
+    }
+
+    Message msg;
+    msg.type = int(m_rng() % 100) < DIRECT_PERCENT ? Message::CONTACT_MESSAGE
+                                                   : Message::CHANNEL_MESSAGE;
+    // Lower channel indexes are busier, like a public channel
+    quint64 a = m_rng() % m_channels;
+    quint64 b = m_rng() % m_channels;
+    msg.channelIdx = static_cast<uint8_t>(a * b / m_channels);
+    msg.senderPubKeyPrefix = senderPrefix(sender);
+    msg.senderName = QString("node-%1").arg(sender);
+    msg.text = text.join(' ');
+    qint64 receivedAt = m_start + qint64(i * m_step);
+    msg.timestamp = static_cast<uint32_t>(receivedAt - int(m_rng() % 5));
+    msg.pathLen = msg.pathLength = static_cast<uint8_t>(m_rng() % 8);
+    msg.txtType = 0;
+    msg.snr = float(int(m_rng() % 80) - 40) / 4.0f;
+    msg.receivedAt = QDateTime::fromSecsSinceEpoch(receivedAt);
+    return msg;
+  }
+
+  int messages() const { return m_messages; }
+
+private:
+  int m_messages;
+  int m_channels;
+  ZipfSampler m_senders;
+  std::mt19937_64 m_rng;
+  qint64 m_start;
+  double m_step;
+};
+
+class Reporter {
+public:
+  explicit Reporter(QTextStream &out) : m_out(out) {}
+
+  void metric(const QString &name, double value, const QString &unit,
+              const QJsonObject &extra = QJsonObject()) {
+    QJsonObject row = extra;
+    row["metric"] = name;
+    row["value"] = value;
+    row["unit"] = unit;
+    m_out << QJsonDocument(row).toJson(QJsonDocument::Compact) << "\n";
+    m_out.flush();
+  }
+
+private:
+  QTextStream &m_out;
+};
+
+double percentileUs(QVector<qint64> samplesNs, double q) {
+  if (samplesNs.isEmpty()) {
+    return 0;
+  }
+  std::sort(samplesNs.begin(), samplesNs.end());
+  qsizetype idx = std::min(static_cast<qsizetype>(q * samplesNs.size()), samplesNs.size() - 1);
+  return samplesNs[idx] / 1000.0;
+}
+
+template <typename Load> double medianPageUs(Load load) {
+  QVector<qint64> samples;
+  for (int i = 0; i < PAGE_REPEATS; ++i) {
+    QElapsedTimer timer;
+    timer.start();
+    load();
+    samples.append(timer.nsecsElapsed());
+  }
+  return percentileUs(samples, 0.5);
+}
+
+qint64 fileBytes(const QString &path) {
+  return QFileInfo(path).size() + QFileInfo(path + "-wal").size();
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  QTextStream out(stdout);
+  Reporter report(out);
+
+  QStringList args = app.arguments();
+  int count = args.size() > 1 ? args[1].toInt() : 1000000;
+  int channels = qBound(1, args.size() > 2 ? args[2].toInt() : 16, 256);
+  int senders = qMax(1, args.size() > 3 ? args[3].toInt() : 5000);
+  int days = args.size() > 4 ? args[4].toInt() : 365;
+
+  QTemporaryDir dir;
+  DatabaseManager db;
+  db.setDatabaseDirectory(dir.path());
+  const QByteArray key(32, '\x24');
+  if (!dir.isValid() || !db.openDatabase(key)) {
+    out << "Failed to open database: " << db.getLastError() << "\n";
+    return 1;
+  }
+  // Measure storage, not pruning or compression; keep every dedup hash
+  RetentionPolicy policy;
+  policy.hashRetentionDays = 0;
+  db.setRetentionPolicy(policy);
+
+  const QString dbPath = db.getDatabasePath(key);
+  const QJsonObject scale{{"messages", count},
+                          {"channels", channels},
+                          {"senders", senders},
+                          {"days", days}};
+
+  // Ingest
+  HistoryGenerator generator(count, channels, senders, days);
+  QVector<Message> dedupSample;
+  QVector<qint64> saveNs;
+  QElapsedTimer total;
+  QElapsedTimer timer;
+  total.start();
+  const int dedupStride = qMax(1, count / DEDUP_SAMPLES);
+  for (int i = 0; i < count; ++i) {
+    Message msg = generator.make(i);
+    if (i % dedupStride == 0) {
+      dedupSample.append(msg); // Spread over the whole history
+    }
+    if (i % LATENCY_SAMPLE_EVERY == 0) {
+      timer.start();
+      db.saveMessage(msg);
+      saveNs.append(timer.nsecsElapsed());
+    } else {
+      db.saveMessage(msg);
+    }
+  }
+  qint64 ingestMs = qMax<qint64>(1, total.elapsed());
+  report.metric("ingest_rate", count * 1000.0 / ingestMs, "msgs/s", scale);
+  report.metric("save_p50", percentileUs(saveNs, 0.50), "us", scale);
+  report.metric("save_p99", percentileUs(saveNs, 0.99), "us", scale);
+  report.metric("save_max", percentileUs(saveNs, 1.0), "us", scale);
+
+  // Duplicates: saves that are detected and skipped, and the explicit check
+  timer.start();
+  for (const Message &msg : std::as_const(dedupSample)) {
+    db.saveMessage(msg);
+  }
+  report.metric("duplicate_save", timer.nsecsElapsed() / 1000.0 / qMax(1, dedupSample.size()),
+                "us", scale);
+  timer.start();
+  for (const Message &msg : std::as_const(dedupSample)) {
+    db.isMessageDuplicate(msg);
+  }
+  report.metric("duplicate_check",
+                timer.nsecsElapsed() / 1000.0 / qMax(1, dedupSample.size()), "us", scale);
+
+  // History pages by depth; sender 0 is the busiest under the Zipf draw
+  const QByteArray busiestPeer = senderPrefix(0);
+  for (int depth : {0, 1000, 10000, 100000, 1000000}) {
+    if (depth >= count) {
+      break;
+    }
+    QJsonObject extra = scale;
+    extra["offset"] = depth;
+    extra["limit"] = PAGE_SIZE;
+    report.metric("load_messages",
+                  medianPageUs([&]() { db.loadMessages(PAGE_SIZE, depth); }), "us", extra);
+    report.metric("load_channel_messages",
+                  medianPageUs([&]() { db.loadChannelMessages(0, PAGE_SIZE, depth); }), "us",
+                  extra);
+    report.metric(
+        "load_direct_messages",
+        medianPageUs([&]() { db.loadDirectMessages(busiestPeer, PAGE_SIZE, depth); }), "us",
+        extra);
+  }
+
+  // Size on disk, with and without the WAL folded back in
+  report.metric("file_bytes", fileBytes(dbPath), "bytes", scale);
+  db.checkpointNow(WalCheckpointer::Truncate);
+  report.metric("file_bytes_checkpointed", fileBytes(dbPath), "bytes", scale);
+  report.metric("bytes_per_message", double(db.getDatabaseSize()) / qMax(1, count), "bytes",
+                scale);
+
+  // Reopen, including partition and dictionary loading
+  db.closeDatabase();
+  timer.start();
+  bool reopened = db.openDatabase(key);
+  report.metric("open_time", timer.nsecsElapsed() / 1e6, "ms", scale);
+  if (!reopened) {
+    out << "Failed to reopen database: " << db.getLastError() << "\n";
+    return 1;
+  }
+
+  db.closeDatabase();
+  return 0;
+}
@@ -1,4 +1,5 @@
 #include <QCoreApplication>
+#include "src/core/FlightRecorder.h"
 #include "src/core/MeshClient.h"
 #include "src/ui/CLI/CommandLineInterface.h"
 
@@ -10,6 +11,9 @@ int main(int argc, char *argv[]) {
     QCoreApplication::setApplicationVersion("1.0.0");
     QCoreApplication::setOrganizationName("MeshCore");
 
+    // Keep the last frames on disk if the process dies on a fatal error
+    MeshCore::FlightRecorder::installMessageHandler();
+
     // Create MeshCore client
     MeshCore::MeshClient client;
 
@@ -1,4 +1,9 @@
 #include "BLEConnection.h"
+#include "../core/FlightRecorder.h"
+#include "../core/LatencyMetrics.h"
+#include "../core/Logging.h"
+#include "../core/MemoryAccounting.h"
+#include "../core/TelemetryCounters.h"
 #include <QDebug>
 
 namespace MeshCore {
@@ -14,7 +19,7 @@ const QBluetoothUuid BLEConnection::TX_CHARACTERISTIC_UUID =
 BLEConnection::BLEConnection(QObject *parent)
     : IConnection(parent), m_discoveryAgent(nullptr), m_controller(nullptr),
       m_service(nullptr), m_state(ConnectionState::Disconnected),
-      m_filterMeshCoreOnly(false) {
+      m_filterMeshCoreOnly(false), m_footprintId(0) {
 
   m_discoveryAgent = new QBluetoothDeviceDiscoveryAgent(this);
   m_discoveryAgent->setLowEnergyDiscoveryTimeout(5000);
@@ -25,19 +30,34 @@ BLEConnection::BLEConnection(QObject *parent)
           &BLEConnection::onDiscoveryFinished);
   connect(m_discoveryAgent, &QBluetoothDeviceDiscoveryAgent::errorOccurred,
           this, &BLEConnection::onDiscoveryError);
+
+  // Qt's private device data is not included
+  m_footprintId = MemoryAccounting::instance().addFootprint(
+      MemoryAccounting::Transport, "ble discovery", [this]() {
+        qint64 bytes = m_discoveredDevices.capacity() * qint64(sizeof(QBluetoothDeviceInfo)) +
+                       m_discoveredBLEDevices.capacity() * qint64(sizeof(BLEDeviceInfo));
+        for (const BLEDeviceInfo &info : std::as_const(m_discoveredBLEDevices)) {
+          bytes += MemoryAccounting::heapBytes(info.name) +
+                   MemoryAccounting::heapBytes(info.address);
+        }
+        return bytes;
+      });
 }
 
-BLEConnection::~BLEConnection() { close(); }
+BLEConnection::~BLEConnection() {
+  MemoryAccounting::instance().removeFootprint(m_footprintId);
+  close();
+}
 
 bool BLEConnection::open(const QString &target) {
   if (m_controller && m_controller->state() !=
                           QLowEnergyController::UnconnectedState) {
-    qWarning() << "BLE already connected or connecting";
+    qCWarning(lcTransport) << "BLE already connected or connecting";
     return false;
   }
 
   m_targetDeviceName = target;
-  qDebug() << "Starting BLE discovery for device:" << target;
+  qCDebug(lcTransport) << "Starting BLE discovery for device:" << target;
 
   setState(ConnectionState::Connecting);
   startDiscovery();
@@ -62,7 +82,7 @@ void BLEConnection::close() {
   }
 
   setState(ConnectionState::Disconnected);
-  qDebug() << "BLE connection closed";
+  qCDebug(lcTransport) << "BLE connection closed";
 }
 
 bool BLEConnection::isOpen() const {
@@ -75,18 +95,18 @@ bool BLEConnection::isOpen() const {
 
 bool BLEConnection::sendFrame(const QByteArray &data) {
   if (!isOpen()) {
-    qWarning() << "Cannot send frame: BLE not connected";
+    qCWarning(lcTransport) << "Cannot send frame: BLE not connected";
     return false;
   }
 
   if (data.size() > MAX_FRAME_SIZE) {
-    qWarning() << "Frame too large:" << data.size() << "bytes (max"
-               << MAX_FRAME_SIZE << ")";
+    qCWarning(lcTransport) << "Frame too large:" << data.size() << "bytes (max"
+                           << MAX_FRAME_SIZE << ")";
     return false;
   }
 
   if (!m_rxCharacteristic.isValid()) {
-    qWarning() << "RX characteristic not valid";
+    qCWarning(lcTransport) << "RX characteristic not valid";
     return false;
   }
 
@@ -95,6 +115,8 @@ bool BLEConnection::sendFrame(const QByteArray &data) {
   m_service->writeCharacteristic(m_rxCharacteristic, data,
                                   QLowEnergyService::WriteWithoutResponse);
 
+  TelemetryCounters::instance().countFrameOut(data);
+  FlightRecorder::instance().record(FlightRecorder::Outbound, data);
   return true;
 }
 
@@ -104,8 +126,8 @@ void BLEConnection::startDiscovery(bool filterMeshCoreOnly) {
   m_discoveredBLEDevices.clear();
   m_discoveryAgent->start(QBluetoothDeviceDiscoveryAgent::LowEnergyMethod);
 
-  qDebug() << "BLE discovery started"
-           << (filterMeshCoreOnly ? "(filtering MeshCore devices only)"
+  qCDebug(lcTransport) << "BLE discovery started"
+                       << (filterMeshCoreOnly ? "(filtering MeshCore devices only)"
                                   : "(all devices)");
 }
 
@@ -116,6 +138,7 @@ void BLEConnection::stopDiscovery() {
 }
 
 void BLEConnection::onDeviceDiscovered(const QBluetoothDeviceInfo &device) {
+  MemoryScope memory(MemoryAccounting::Transport);
   // Check if it's a BLE device
   if (!(device.coreConfigurations() &
         QBluetoothDeviceInfo::LowEnergyCoreConfiguration)) {
@@ -132,13 +155,12 @@ void BLEConnection::onDeviceDiscovered(const QBluetoothDeviceInfo &device) {
 
   // Apply filtering if requested
   if (m_filterMeshCoreOnly && !info.hasMeshCoreService) {
-    qDebug() << "Skipping non-MeshCore device:" << info.displayName();
+    qCTrace(lcTransport) << "Skipping non-MeshCore device:" << info.displayName();
     return;
   }
 
-  qDebug() << "BLE device discovered:" << info.displayName() << info.address
-           << info.rssiString()
-           << (info.hasMeshCoreService ? "[MeshCore]" : "");
+  qCTrace(lcTransport) << "BLE device discovered:" << info.displayName() << info.address
+                       << info.rssiString() << (info.hasMeshCoreService ? "[MeshCore]" : "");
 
   // Store in both lists
   m_discoveredDevices.append(device);
@@ -152,7 +174,7 @@ void BLEConnection::onDeviceDiscovered(const QBluetoothDeviceInfo &device) {
   if (!m_targetDeviceName.isEmpty() &&
       (device.name() == m_targetDeviceName ||
        device.address().toString() == m_targetDeviceName)) {
-    qDebug() << "Found target device:" << device.name();
+    qCDebug(lcTransport) << "Found target device:" << device.name();
     m_targetDevice = device;
     stopDiscovery();
 
@@ -179,13 +201,13 @@ void BLEConnection::onDeviceDiscovered(const QBluetoothDeviceInfo &device) {
 }
 
 void BLEConnection::onDiscoveryFinished() {
-  qDebug() << "BLE discovery finished. Found" << m_discoveredDevices.size()
-           << "devices";
+  qCDebug(lcTransport) << "BLE discovery finished. Found" << m_discoveredDevices.size()
+                       << "devices";
   emit discoveryFinished();
 
   if (!m_controller) {
     QString error = QString("Device not found: %1").arg(m_targetDeviceName);
-    qWarning() << error;
+    qCWarning(lcTransport) << error;
     setState(ConnectionState::Error);
     emit errorOccurred(error);
   }
@@ -195,18 +217,18 @@ void BLEConnection::onDiscoveryError(
     QBluetoothDeviceDiscoveryAgent::Error error) {
   QString errorStr =
       QString("BLE discovery error: %1").arg(m_discoveryAgent->errorString());
-  qWarning() << errorStr;
+  qCWarning(lcTransport) << errorStr;
   setState(ConnectionState::Error);
   emit errorOccurred(errorStr);
 }
 
 void BLEConnection::onControllerConnected() {
-  qDebug() << "BLE controller connected, discovering services...";
+  qCDebug(lcTransport) << "BLE controller connected, discovering services...";
   m_controller->discoverServices();
 }
 
 void BLEConnection::onControllerDisconnected() {
-  qDebug() << "BLE controller disconnected";
+  qCDebug(lcTransport) << "BLE controller disconnected";
   setState(ConnectionState::Disconnected);
 
   if (m_service) {
@@ -219,28 +241,28 @@ void BLEConnection::onControllerError(QLowEnergyController::Error error) {
   QString errorStr = QString("BLE controller error: %1 (%2)")
                          .arg(m_controller->errorString())
                          .arg(static_cast<int>(error));
-  qWarning() << errorStr;
+  qCWarning(lcTransport) << errorStr;
   setState(ConnectionState::Error);
   emit errorOccurred(errorStr);
 }
 
 void BLEConnection::onServiceDiscovered(const QBluetoothUuid &uuid) {
-  qDebug() << "Service discovered:" << uuid.toString();
+  qCDebug(lcTransport) << "Service discovered:" << uuid.toString();
 
   if (uuid == SERVICE_UUID) {
-    qDebug() << "Found MeshCore UART service";
+    qCDebug(lcTransport) << "Found MeshCore UART service";
     connectToService();
   }
 }
 
 void BLEConnection::onServiceDiscoveryFinished() {
-  qDebug() << "Service discovery finished";
+  qCDebug(lcTransport) << "Service discovery finished";
 
   if (!m_service) {
     QString error =
         QString("MeshCore UART service not found on device: %1")
             .arg(m_targetDeviceName);
-    qWarning() << error;
+    qCWarning(lcTransport) << error;
     setState(ConnectionState::Error);
     emit errorOccurred(error);
   }
@@ -255,7 +277,7 @@ void BLEConnection::connectToService() {
 
   if (!m_service) {
     QString error = "Failed to create service object";
-    qWarning() << error;
+    qCWarning(lcTransport) << error;
     setState(ConnectionState::Error);
     emit errorOccurred(error);
     return;
@@ -274,7 +296,7 @@ void BLEConnection::connectToService() {
 }
 
 void BLEConnection::onServiceStateChanged(QLowEnergyService::ServiceState state) {
-  qDebug() << "Service state changed:" << static_cast<int>(state);
+  qCDebug(lcTransport) << "Service state changed:" << static_cast<int>(state);
 
   if (state == QLowEnergyService::RemoteServiceDiscovered) {
     // Service details discovered, find RX and TX characteristics
@@ -283,7 +305,7 @@ void BLEConnection::onServiceStateChanged(QLowEnergyService::ServiceState state)
 
     if (!m_rxCharacteristic.isValid()) {
       QString error = "RX characteristic not found";
-      qWarning() << error;
+      qCWarning(lcTransport) << error;
       setState(ConnectionState::Error);
       emit errorOccurred(error);
       return;
@@ -291,13 +313,13 @@ void BLEConnection::onServiceStateChanged(QLowEnergyService::ServiceState state)
 
     if (!m_txCharacteristic.isValid()) {
       QString error = "TX characteristic not found";
-      qWarning() << error;
+      qCWarning(lcTransport) << error;
       setState(ConnectionState::Error);
       emit errorOccurred(error);
       return;
     }
 
-    qDebug() << "RX and TX characteristics found";
+    qCDebug(lcTransport) << "RX and TX characteristics found";
 
     // Enable notifications on TX characteristic (device -> app)
     QLowEnergyDescriptor notification =
@@ -306,20 +328,20 @@ void BLEConnection::onServiceStateChanged(QLowEnergyService::ServiceState state)
     if (notification.isValid()) {
       m_service->writeDescriptor(notification,
                                   QByteArray::fromHex("0100")); // Enable notify
-      qDebug() << "Enabled notifications on TX characteristic";
+      qCDebug(lcTransport) << "Enabled notifications on TX characteristic";
     } else {
-      qWarning() << "TX notification descriptor not found";
+      qCWarning(lcTransport) << "TX notification descriptor not found";
     }
 
     setState(ConnectionState::Connected);
-    qDebug() << "BLE connection established successfully";
+    qCDebug(lcTransport) << "BLE connection established successfully";
   }
 }
 
 void BLEConnection::onServiceError(QLowEnergyService::ServiceError error) {
   QString errorStr = QString("BLE service error: %1")
                          .arg(static_cast<int>(error));
-  qWarning() << errorStr;
+  qCWarning(lcTransport) << errorStr;
   setState(ConnectionState::Error);
   emit errorOccurred(errorStr);
 }
@@ -328,8 +350,12 @@ void BLEConnection::onCharacteristicChanged(
     const QLowEnergyCharacteristic &characteristic,
     const QByteArray &newValue) {
   if (characteristic.uuid() == TX_CHARACTERISTIC_UUID) {
+    MemoryScope memory(MemoryAccounting::Transport);
     // Received data from device - emit as frame
     // For BLE, the frame is the raw data without serial framing
+    m_frameTiming.readNs = m_frameTiming.deframedNs = LatencyMetrics::now();
+    TelemetryCounters::instance().countFrameIn(newValue);
+    FlightRecorder::instance().record(FlightRecorder::Inbound, newValue);
     emit frameReceived(newValue);
   }
 }
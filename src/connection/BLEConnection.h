@@ -106,6 +106,7 @@ private:
   QList<QBluetoothDeviceInfo> m_discoveredDevices;
   QList<BLEDeviceInfo> m_discoveredBLEDevices;
   bool m_filterMeshCoreOnly;
+  int m_footprintId; // MemoryAccounting registration for the lists above
 
   QLowEnergyController *m_controller;
   QLowEnergyService *m_service;
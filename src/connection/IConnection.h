@@ -8,6 +8,12 @@
 
 namespace MeshCore {
 
+// Monotonic timestamps (LatencyMetrics::now()) of the frame being delivered
+struct FrameTiming {
+  qint64 readNs = 0;     // Transport read that returned the frame's first byte
+  qint64 deframedNs = 0; // Frame complete, about to be emitted
+};
+
 class IConnection : public QObject {
   Q_OBJECT
 
@@ -29,6 +35,9 @@ public:
   // Connection type identification
   virtual QString connectionType() const = 0;
 
+  // Valid for the frame currently passed to frameReceived()
+  FrameTiming lastFrameTiming() const { return m_frameTiming; }
+
 signals:
   // Frame received from the device
   void frameReceived(const QByteArray &frame);
@@ -38,6 +47,9 @@ signals:
 
   // Error occurred
   void errorOccurred(const QString &error);
+
+protected:
+  FrameTiming m_frameTiming;
 };
 
 } // namespace MeshCore
@@ -1,11 +1,18 @@
 #include <QDebug>
 
 #include "SerialConnection.h"
+#include "../core/FlightRecorder.h"
+#include "../core/LatencyMetrics.h"
+#include "../core/Logging.h"
+#include "../core/MemoryAccounting.h"
+#include "../core/TelemetryCounters.h"
 
 namespace MeshCore {
 SerialConnection::SerialConnection(QObject *parent)
     : IConnection(parent), m_serial(new QSerialPort(this)),
-      m_state(ConnectionState::Disconnected), m_recvState(IDLE), m_frameLen(0) {
+      m_state(ConnectionState::Disconnected), m_recvState(IDLE), m_frameLen(0),
+      m_rxCount(0), m_chunkReadNs(0) {
+  m_rxBuffer.reserve(MAX_FRAME_SIZE);
   connect(m_serial, &QSerialPort::readyRead, this,
           &SerialConnection::onReadyRead);
   connect(m_serial, &QSerialPort::errorOccurred, this,
@@ -20,7 +27,7 @@ bool SerialConnection::open(const QString &target) {
 
 bool SerialConnection::open(const QString &portName, int baudRate) {
   if (m_serial->isOpen()) {
-    qWarning() << "Serial port already open";
+    qCWarning(lcTransport) << "Serial port already open";
     return false;
   }
 
@@ -36,7 +43,7 @@ bool SerialConnection::open(const QString &portName, int baudRate) {
   if (!m_serial->open(QIODevice::ReadWrite)) {
     QString error =
         QString("Failed to open %1: %2").arg(portName, m_serial->errorString());
-    qWarning() << error;
+    qCWarning(lcTransport) << error;
     setState(ConnectionState::Error);
     emit errorOccurred(error);
     return false;
@@ -51,7 +58,7 @@ bool SerialConnection::open(const QString &portName, int baudRate) {
   m_rxBuffer.clear();
 
   setState(ConnectionState::Connected);
-  qDebug() << "Connected to" << portName << "at" << baudRate << "baud";
+  qCDebug(lcTransport) << "Connected to" << portName << "at" << baudRate << "baud";
   return true;
 }
 
@@ -59,7 +66,7 @@ void SerialConnection::close() {
   if (m_serial->isOpen()) {
     m_serial->close();
     setState(ConnectionState::Disconnected);
-    qDebug() << "Serial port closed";
+    qCDebug(lcTransport) << "Serial port closed";
   }
 }
 
@@ -67,13 +74,13 @@ bool SerialConnection::isOpen() const { return m_serial->isOpen(); }
 
 bool SerialConnection::sendFrame(const QByteArray &data) {
   if (!m_serial->isOpen()) {
-    qWarning() << "Cannot send frame: serial port not open";
+    qCWarning(lcTransport) << "Cannot send frame: serial port not open";
     return false;
   }
 
   if (data.size() > MAX_FRAME_SIZE) {
-    qWarning() << "Frame too large:" << data.size() << "bytes (max"
-               << MAX_FRAME_SIZE << ")";
+    qCWarning(lcTransport) << "Frame too large:" << data.size() << "bytes (max"
+                           << MAX_FRAME_SIZE << ")";
     return false;
   }
 
@@ -88,16 +95,20 @@ bool SerialConnection::sendFrame(const QByteArray &data) {
 
   qint64 written = m_serial->write(frame);
   if (written != frame.size()) {
-    qWarning() << "Failed to write complete frame:" << written << "of"
-               << frame.size() << "bytes";
+    qCWarning(lcTransport) << "Failed to write complete frame:" << written << "of"
+                           << frame.size() << "bytes";
     return false;
   }
 
   m_serial->flush();
+  TelemetryCounters::instance().countFrameOut(data);
+  FlightRecorder::instance().record(FlightRecorder::Outbound, data);
   return true;
 }
 
 void SerialConnection::onReadyRead() {
+  MemoryScope memory(MemoryAccounting::Transport);
+  m_chunkReadNs = LatencyMetrics::now();
   while (m_serial->bytesAvailable() > 0) {
     char byte;
     if (m_serial->read(&byte, 1) == 1) {
@@ -112,6 +123,7 @@ void SerialConnection::processByte(uint8_t byte) {
     if (byte == FRAME_OUTBOUND) {
       // '>' (0x3e) - outbound frame from radio
       m_recvState = HDR_FOUND;
+      m_frameTiming.readNs = m_chunkReadNs;
     }
     break;
 
@@ -122,7 +134,10 @@ void SerialConnection::processByte(uint8_t byte) {
 
   case LEN1_FOUND:
     m_frameLen |= (static_cast<uint16_t>(byte) << 8); // MSB
-    m_rxBuffer.clear();
+    // Keeps the reserved capacity, unless a receiver still shares the last
+    // frame, so deframing does not allocate
+    m_rxBuffer.resize(0);
+    m_rxCount = 0;
     m_recvState = (m_frameLen > 0) ? LEN2_FOUND : IDLE;
     break;
 
@@ -130,15 +145,21 @@ void SerialConnection::processByte(uint8_t byte) {
     if (m_rxBuffer.size() < MAX_FRAME_SIZE) {
       m_rxBuffer.append(static_cast<char>(byte));
     }
+    m_rxCount++;
 
-    if (m_rxBuffer.size() >= m_frameLen) {
+    // Counted separately from the buffer, which stops at MAX_FRAME_SIZE
+    if (m_rxCount >= m_frameLen) {
       // Frame complete
+      FlightRecorder::instance().record(FlightRecorder::Inbound, m_rxBuffer);
       if (m_frameLen > MAX_FRAME_SIZE) {
-        qWarning() << "Frame truncated from" << m_frameLen << "to"
-                   << MAX_FRAME_SIZE << "bytes";
-        m_rxBuffer.resize(MAX_FRAME_SIZE);
+        qCWarning(lcTransport) << "Frame truncated from" << m_frameLen << "to"
+                               << MAX_FRAME_SIZE << "bytes";
+        FlightRecorder::instance().dumpOnError(
+            QString("Frame truncated from %1 bytes").arg(m_frameLen));
       }
 
+      m_frameTiming.deframedNs = LatencyMetrics::now();
+      TelemetryCounters::instance().countFrameIn(m_rxBuffer);
       emit frameReceived(m_rxBuffer);
       m_recvState = IDLE;
     }
@@ -153,7 +174,7 @@ void SerialConnection::onErrorOccurred(QSerialPort::SerialPortError error) {
 
   QString errorStr =
       QString("Serial port error: %1").arg(m_serial->errorString());
-  qWarning() << errorStr;
+  qCWarning(lcTransport) << errorStr;
 
   setState(ConnectionState::Error);
   emit errorOccurred(errorStr);
@@ -186,7 +207,7 @@ QList<SerialPortInfo> SerialConnection::enumeratePorts() {
     result.append(info);
   }
 
-  qDebug() << "Enumerated" << result.size() << "serial port(s)";
+  qCDebug(lcTransport) << "Enumerated" << result.size() << "serial port(s)";
   return result;
 }
 
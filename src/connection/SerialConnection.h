@@ -81,6 +81,8 @@ private:
   // Frame parsing state
   RecvState m_recvState;
   uint16_t m_frameLen;
+  uint16_t m_rxCount; // Payload bytes read so far, including any dropped
   QByteArray m_rxBuffer;
+  qint64 m_chunkReadNs; // When the bytes being processed were read
 };
 } // namespace MeshCore
@@ -1,6 +1,7 @@
 #include <QDebug>
 
 #include "ChannelManager.h"
+#include "Logging.h"
 
 namespace MeshCore {
 
@@ -11,7 +12,7 @@ void ChannelManager::initialize() {
   // Add the default public channel
   Channel publicChannel = Channel::createPublicChannel();
   addOrUpdateChannel(publicChannel);
-  qDebug() << "ChannelManager initialized with public channel";
+  qCDebug(lcProtocol) << "ChannelManager initialized with public channel";
 }
 
 QVector<Channel> ChannelManager::getChannels() const {
@@ -22,6 +23,14 @@ QVector<Channel> ChannelManager::getChannels() const {
   return channels;
 }
 
+qint64 ChannelManager::memoryUsage() const {
+  qint64 bytes = 0;
+  for (const Channel &ch : m_channels) {
+    bytes += ch.memoryUsage();
+  }
+  return bytes;
+}
+
 Channel ChannelManager::getChannel(uint8_t index) const {
   return m_channels.value(index, Channel());
 }
@@ -36,24 +45,24 @@ void ChannelManager::addOrUpdateChannel(const Channel &channel) {
   m_channels[channel.index] = channel;
 
   if (isNew) {
-    qDebug() << "Channel added:" << channel.index << channel.name;
+    qCDebug(lcProtocol) << "Channel added:" << channel.index << channel.name;
     emit channelAdded(channel);
   } else {
-    qDebug() << "Channel updated:" << channel.index << channel.name;
+    qCDebug(lcProtocol) << "Channel updated:" << channel.index << channel.name;
     emit channelUpdated(channel);
   }
 }
 
 void ChannelManager::removeChannel(uint8_t index) {
   if (m_channels.remove(index)) {
-    qDebug() << "Channel removed:" << index;
+    qCDebug(lcProtocol) << "Channel removed:" << index;
     emit channelRemoved(index);
   }
 }
 
 void ChannelManager::clear() {
   m_channels.clear();
-  qDebug() << "All channels cleared";
+  qCDebug(lcProtocol) << "All channels cleared";
 }
 
 uint8_t ChannelManager::getNextAvailableIndex() const {
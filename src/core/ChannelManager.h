@@ -25,6 +25,7 @@ public:
   void removeChannel(uint8_t index);
   void clear();
   uint8_t getNextAvailableIndex() const;
+  qint64 memoryUsage() const;
 
   // Discovery state
   bool isDiscovering() const { return m_isDiscovering; }
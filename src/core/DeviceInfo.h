@@ -23,4 +23,13 @@ struct SelfInfo {
   SelfInfo() : contactType(0), flags(0) {}
 };
 
+struct BatteryStatus {
+  uint16_t milliVolts;     // Battery voltage
+  uint32_t storageUsedKb;  // Device flash in use
+  uint32_t storageTotalKb; // 0 if the firmware does not report it
+  bool isValid;
+
+  BatteryStatus() : milliVolts(0), storageUsedKb(0), storageTotalKb(0), isValid(false) {}
+};
+
 } // namespace MeshCore
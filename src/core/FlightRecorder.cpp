@@ -0,0 +1,159 @@
+#include "FlightRecorder.h"
+#include "LatencyMetrics.h"
+#include "Logging.h"
+#include "MemoryAccounting.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QStringList>
+#include <cstring>
+
+namespace MeshCore {
+
+namespace {
+
+QtMessageHandler previousMessageHandler = nullptr;
+
+void fatalMessageHandler(QtMsgType type, const QMessageLogContext &context,
+                         const QString &message) {
+  if (type == QtFatalMsg) {
+    FlightRecorder::instance().dumpOnError(QString("Fatal: %1").arg(message));
+  }
+  if (previousMessageHandler) {
+    previousMessageHandler(type, context, message);
+  }
+}
+
+} // namespace
+
+FlightRecorder &FlightRecorder::instance() {
+  static FlightRecorder recorder;
+  return recorder;
+}
+
+FlightRecorder::FlightRecorder() : m_recorded(0), m_lastAutoDumpMs(0) {
+  MemoryAccounting::instance().addFootprint(MemoryAccounting::Diagnostics, "flight recorder",
+                                            []() { return qint64(sizeof(FlightRecorder)); });
+}
+
+void FlightRecorder::record(Direction direction, const QByteArray &frame) {
+  Slot &slot = m_slots[m_recorded % CAPACITY];
+  const int length = qMin<int>(frame.size(), 0xFFFF);
+  slot.timestampNs = LatencyMetrics::now();
+  slot.length = static_cast<quint16>(length);
+  slot.direction = direction;
+  std::memcpy(slot.bytes.data(), frame.constData(), qMin<int>(length, MAX_FRAME_SIZE));
+  m_recorded++;
+}
+
+int FlightRecorder::frameCount() const {
+  return static_cast<int>(qMin<quint64>(m_recorded, CAPACITY));
+}
+
+QStringList FlightRecorder::describe(int maxFrames) const {
+  const quint64 count = qMin<quint64>(frameCount(), qMax(0, maxFrames));
+
+  // Slots hold monotonic time; shown as wall-clock time relative to now
+  const qint64 nowNs = LatencyMetrics::now();
+  const QDateTime now = QDateTime::currentDateTime();
+
+  QStringList lines;
+  lines.reserve(static_cast<int>(count));
+  for (quint64 i = m_recorded - count; i < m_recorded; ++i) {
+    const Slot &slot = m_slots[i % CAPACITY];
+    const int stored = qMin<int>(slot.length, MAX_FRAME_SIZE);
+    const QByteArray bytes = QByteArray::fromRawData(slot.bytes.data(), stored);
+    lines.append(QString("%1 %2 %3 bytes code=%4 %5%6")
+                     .arg(now.addMSecs(-(nowNs - slot.timestampNs) / 1000000)
+                              .toString("yyyy-MM-dd HH:mm:ss.zzz"))
+                     .arg(slot.direction == Inbound ? "<<" : ">>")
+                     .arg(slot.length, 3)
+                     .arg(stored > 0 ? static_cast<quint8>(bytes[0]) : 0, 3)
+                     .arg(QString::fromLatin1(bytes.toHex(' ')))
+                     .arg(stored < slot.length ? " ..." : ""));
+  }
+  return lines;
+}
+
+bool FlightRecorder::dump(const QString &path, const QString &reason) {
+  QSaveFile file(path);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+    m_lastError = QString("Failed to open %1: %2").arg(path, file.errorString());
+    return false;
+  }
+
+  QByteArray text;
+  text += "# MeshCoreQt flight recorder, " +
+          QDateTime::currentDateTime().toString(Qt::ISODateWithMs).toUtf8() + "\n";
+  text += "# Reason: " + reason.toUtf8() + "\n";
+  text += "# Last " + QByteArray::number(frameCount()) + " of " +
+          QByteArray::number(m_recorded) + " frames (<< from device, >> to device)\n";
+  for (const QString &line : describe()) {
+    text += line.toUtf8() + '\n';
+  }
+
+  if (file.write(text) != text.size() || !file.commit()) {
+    m_lastError = QString("Failed to write %1: %2").arg(path, file.errorString());
+    return false;
+  }
+  return true;
+}
+
+QString FlightRecorder::dumpOnError(const QString &reason) {
+  const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+  if (m_lastAutoDumpMs > 0 && nowMs - m_lastAutoDumpMs < MIN_DUMP_INTERVAL_MS) {
+    return QString(); // The previous dump already holds these frames
+  }
+  m_lastAutoDumpMs = nowMs;
+
+  QDir dir(dumpDirectory());
+  if (!dir.mkpath(".")) {
+    m_lastError = QString("Failed to create %1").arg(dir.path());
+    qCWarning(lcProtocol) << "FlightRecorder:" << m_lastError;
+    return QString();
+  }
+
+  QString path = dir.filePath(QString("frames-%1.txt")
+                                  .arg(QDateTime::fromMSecsSinceEpoch(nowMs).toString(
+                                      "yyyyMMdd-HHmmss-zzz")));
+  if (!dump(path, reason)) {
+    qCWarning(lcProtocol) << "FlightRecorder:" << m_lastError;
+    return QString();
+  }
+
+  qCWarning(lcProtocol) << "Recent frames written to" << path << "after:" << reason;
+  pruneDumps();
+  return path;
+}
+
+QString FlightRecorder::dumpDirectory() const {
+  QString appDataPath = m_dumpDirectory.isEmpty()
+                            ? QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+                            : m_dumpDirectory;
+  return QString("%1/flight-recorder").arg(appDataPath);
+}
+
+void FlightRecorder::setDumpDirectory(const QString &directory) {
+  m_dumpDirectory = directory;
+}
+
+void FlightRecorder::pruneDumps() {
+  QDir dir(dumpDirectory());
+  // Names sort by time
+  QStringList dumps = dir.entryList({"frames-*.txt"}, QDir::Files, QDir::Name);
+  while (dumps.size() > MAX_DUMP_FILES) {
+    dir.remove(dumps.takeFirst());
+  }
+}
+
+void FlightRecorder::installMessageHandler() {
+  static bool installed = false;
+  if (!installed) {
+    previousMessageHandler = qInstallMessageHandler(fatalMessageHandler);
+    installed = true;
+  }
+}
+
+} // namespace MeshCore
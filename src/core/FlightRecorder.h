@@ -0,0 +1,73 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+#include <array>
+
+#include "../protocol/ProtocolConstants.h"
+
+namespace MeshCore {
+
+// Always-on record of the last CAPACITY frames to and from the device, kept
+// in fixed storage: recording a frame is one memcpy into the next slot and
+// never allocates. The ring is written to a file automatically when
+// something goes wrong (transport errors, malformed frames, command
+// timeouts, fatal messages) and on demand from the CLI.
+//
+// Frames are recorded by the transports on the main thread. Automatic dumps
+// are rate limited and the oldest dump files are removed.
+class FlightRecorder {
+public:
+  enum Direction : quint8 { Inbound, Outbound };
+
+  static FlightRecorder &instance();
+
+  void record(Direction direction, const QByteArray &frame);
+
+  int capacity() const { return CAPACITY; }
+  int frameCount() const;
+  // One line per frame, oldest first; at most the newest maxFrames
+  QStringList describe(int maxFrames = CAPACITY) const;
+
+  // Writes the ring to path with the reason as a header
+  bool dump(const QString &path, const QString &reason);
+  // Writes the ring to a new file in dumpDirectory(), unless an automatic
+  // dump was written in the last few seconds. Returns the file written.
+  QString dumpOnError(const QString &reason);
+  QString dumpDirectory() const;
+  void setDumpDirectory(const QString &directory); // Empty = app data dir
+
+  // Dumps the ring before a fatal message (failed Q_ASSERT, qFatal) is
+  // passed on to the previous handler
+  static void installMessageHandler();
+
+  QString getLastError() const { return m_lastError; }
+
+private:
+  FlightRecorder();
+  FlightRecorder(const FlightRecorder &) = delete;
+  FlightRecorder &operator=(const FlightRecorder &) = delete;
+
+  struct Slot {
+    qint64 timestampNs;
+    quint16 length; // Length of the frame; bytes holds at most MAX_FRAME_SIZE
+    Direction direction;
+    std::array<char, MAX_FRAME_SIZE> bytes;
+  };
+
+  void pruneDumps();
+
+  static const int CAPACITY = 256;
+  static const int MAX_DUMP_FILES = 20;
+  static const qint64 MIN_DUMP_INTERVAL_MS = 10000;
+
+  std::array<Slot, CAPACITY> m_slots;
+  quint64 m_recorded; // Total frames; the next slot is m_recorded % CAPACITY
+  qint64 m_lastAutoDumpMs;
+  QString m_dumpDirectory;
+  QString m_lastError;
+};
+
+} // namespace MeshCore
@@ -0,0 +1,63 @@
+#include "FrameArena.h"
+#include <QStringEncoder>
+
+namespace MeshCore {
+
+namespace {
+
+thread_local FrameArena *currentArena = nullptr;
+
+} // namespace
+
+FrameArena::FrameArena()
+    : m_resource(m_buffer.data(), m_buffer.size(), &m_upstream), m_frames(0) {}
+
+void FrameArena::reset() {
+  // Back to the start of m_buffer; overflow blocks go back to the heap
+  m_resource.release();
+  m_frames++;
+}
+
+std::pmr::memory_resource *FrameArena::current() {
+  return currentArena ? currentArena->resource() : std::pmr::get_default_resource();
+}
+
+FrameArena::Scope::Scope(FrameArena &arena) : m_arena(currentArena ? nullptr : &arena) {
+  if (m_arena) {
+    currentArena = m_arena;
+  }
+}
+
+FrameArena::Scope::~Scope() {
+  if (m_arena) {
+    currentArena = nullptr;
+    m_arena->reset();
+  }
+}
+
+void *FrameArena::OverflowResource::do_allocate(std::size_t bytes, std::size_t alignment) {
+  allocations++;
+  return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+}
+
+void FrameArena::OverflowResource::do_deallocate(void *pointer, std::size_t bytes,
+                                                 std::size_t alignment) {
+  std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+}
+
+ScratchBytes::ScratchBytes() : m_bytes(FrameArena::current()) {}
+
+ScratchBytes::ScratchBytes(QStringView text) : m_bytes(FrameArena::current()) {
+  append(text);
+}
+
+void ScratchBytes::append(QStringView text) {
+  // Sized for the worst case, then cut back to what was written
+  QStringEncoder encoder(QStringEncoder::Utf8);
+  const std::size_t start = m_bytes.size();
+  m_bytes.resize(start + encoder.requiredSpace(text.size()));
+  char *end = encoder.appendToBuffer(m_bytes.data() + start, text);
+  m_bytes.resize(end - m_bytes.data());
+}
+
+} // namespace MeshCore
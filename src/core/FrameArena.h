@@ -0,0 +1,99 @@
+#pragma once
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QStringView>
+
+#include <array>
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+namespace MeshCore {
+
+// Scratch memory for the temporaries made while one inbound frame is
+// handled: UTF-8 encodings for hashing and storing a message, cache lookup
+// keys. Allocating bumps a pointer through a fixed buffer and freeing does
+// nothing; everything is released at once when the frame has been
+// dispatched. A frame that needs more than CAPACITY bytes spills to the heap,
+// which overflows() counts.
+//
+// Nothing allocated here may outlive the frame. What is kept (messages,
+// contacts, cache entries) is built from ordinary Qt types.
+class FrameArena {
+public:
+  static const int CAPACITY = 8192;
+
+  FrameArena();
+
+  std::pmr::memory_resource *resource() { return &m_resource; }
+  void reset();
+
+  quint64 frames() const { return m_frames; }
+  quint64 overflows() const { return m_upstream.allocations; }
+
+  // The arena of the frame being handled on the calling thread; the heap
+  // outside of one
+  static std::pmr::memory_resource *current();
+
+  // Makes an arena current for the calling thread and resets it on exit. A
+  // scope opened while another one is active keeps the outer arena.
+  class Scope {
+  public:
+    explicit Scope(FrameArena &arena);
+    ~Scope();
+
+  private:
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+    FrameArena *m_arena; // Null when nested
+  };
+
+private:
+  FrameArena(const FrameArena &) = delete;
+  FrameArena &operator=(const FrameArena &) = delete;
+
+  // Heap allocations made once the buffer is used up
+  class OverflowResource : public std::pmr::memory_resource {
+  public:
+    quint64 allocations = 0;
+
+  private:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void *pointer, std::size_t bytes, std::size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+      return this == &other;
+    }
+  };
+
+  alignas(std::max_align_t) std::array<std::byte, CAPACITY> m_buffer;
+  OverflowResource m_upstream;
+  std::pmr::monotonic_buffer_resource m_resource;
+  quint64 m_frames;
+};
+
+// Bytes in the current frame arena. Strings are appended as UTF-8.
+class ScratchBytes {
+public:
+  ScratchBytes();
+  explicit ScratchBytes(QStringView text);
+
+  void append(char byte) { m_bytes.push_back(byte); }
+  void append(QByteArrayView bytes) {
+    m_bytes.insert(m_bytes.end(), bytes.begin(), bytes.end());
+  }
+  void append(QStringView text);
+
+  QByteArrayView view() const { return {m_bytes.data(), qsizetype(m_bytes.size())}; }
+  // A QByteArray over the scratch bytes, valid while this object is; for
+  // lookups in containers keyed by QByteArray
+  QByteArray rawBytes() const {
+    return QByteArray::fromRawData(m_bytes.data(), qsizetype(m_bytes.size()));
+  }
+
+private:
+  std::pmr::vector<char> m_bytes;
+};
+
+} // namespace MeshCore
@@ -0,0 +1,99 @@
+#include "LatencyMetrics.h"
+
+#include <QtAlgorithms>
+
+#include <chrono>
+#include <cmath>
+
+namespace MeshCore {
+
+int LatencyHistogram::bucketFor(qint64 ns) {
+  if (ns < SUB_BUCKETS) {
+    return ns > 0 ? static_cast<int>(ns) : 0;
+  }
+  if (ns >= (qint64(1) << MAX_BITS)) {
+    return BUCKETS - 1;
+  }
+  // Leading one at bit msb; the next SUB_BITS bits pick the sub-bucket
+  const int msb = 63 - qCountLeadingZeroBits(static_cast<quint64>(ns));
+  const int shift = msb - SUB_BITS;
+  const int sub = static_cast<int>((ns >> shift) - SUB_BUCKETS);
+  return SUB_BUCKETS + shift * SUB_BUCKETS + sub;
+}
+
+qint64 LatencyHistogram::bucketUpperBound(int index) {
+  if (index < SUB_BUCKETS) {
+    return index;
+  }
+  const int shift = (index - SUB_BUCKETS) / SUB_BUCKETS;
+  const int sub = (index - SUB_BUCKETS) % SUB_BUCKETS;
+  const qint64 lower = qint64(SUB_BUCKETS + sub) << shift;
+  return lower + (qint64(1) << shift) - 1;
+}
+
+void LatencyHistogram::record(qint64 ns) {
+  if (ns < 0) {
+    ns = 0;
+  }
+  ++m_buckets[bucketFor(ns)];
+  if (m_count == 0 || ns < m_min) {
+    m_min = ns;
+  }
+  if (ns > m_max) {
+    m_max = ns;
+  }
+  ++m_count;
+  m_sum += ns;
+}
+
+void LatencyHistogram::reset() { *this = LatencyHistogram(); }
+
+qint64 LatencyHistogram::valueAt(double quantile) const {
+  if (m_count == 0) {
+    return 0;
+  }
+  const quint64 target =
+      qMax<quint64>(1, static_cast<quint64>(std::ceil(qBound(0.0, quantile, 1.0) * m_count)));
+  quint64 seen = 0;
+  for (int i = 0; i < BUCKETS; ++i) {
+    seen += m_buckets[i];
+    if (seen >= target) {
+      // The bucket bound can overshoot what was actually recorded
+      return qMin(bucketUpperBound(i), m_max);
+    }
+  }
+  return m_max;
+}
+
+qint64 LatencyMetrics::now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+const char *LatencyMetrics::stageName(Stage stage) {
+  switch (stage) {
+  case Deframe:
+    return "deframe";
+  case Dispatch:
+    return "dispatch";
+  case Parse:
+    return "parse";
+  case Commit:
+    return "commit";
+  case Emit:
+    return "emit";
+  case Total:
+    return "total";
+  default:
+    return "unknown";
+  }
+}
+
+void LatencyMetrics::reset() {
+  for (LatencyHistogram &histogram : m_stages) {
+    histogram.reset();
+  }
+}
+
+} // namespace MeshCore
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <array>
+
+namespace MeshCore {
+
+// Log-linear latency histogram in the style of HdrHistogram: exact below 32
+// ns, then 32 buckets per power of two (about 3% relative error) up to
+// about 18 minutes. Recording is a few integer operations and never
+// allocates. Not thread-safe; the receive pipeline runs on the main thread.
+class LatencyHistogram {
+public:
+  void record(qint64 ns);
+  void reset();
+
+  quint64 count() const { return m_count; }
+  qint64 min() const { return m_count ? m_min : 0; }
+  qint64 max() const { return m_max; }
+  double mean() const { return m_count ? double(m_sum) / m_count : 0.0; }
+  // Highest value equivalent to the bucket holding the given quantile
+  // (0.5 for the median, 0.999 for p99.9)
+  qint64 valueAt(double quantile) const;
+
+private:
+  static const int SUB_BITS = 5;
+  static const int SUB_BUCKETS = 1 << SUB_BITS;
+  static const int MAX_BITS = 40; // 2^40 ns; larger values are clamped
+  static const int BUCKETS = SUB_BUCKETS + (MAX_BITS - SUB_BITS) * SUB_BUCKETS;
+
+  static int bucketFor(qint64 ns);
+  static qint64 bucketUpperBound(int index);
+
+  std::array<quint64, BUCKETS> m_buckets{};
+  quint64 m_count = 0;
+  qint64 m_sum = 0;
+  qint64 m_min = 0;
+  qint64 m_max = 0;
+};
+
+// Per-stage latencies of the receive pipeline, from bytes read off the
+// transport to the message signal having been delivered
+class LatencyMetrics {
+public:
+  enum Stage {
+    Deframe,  // Read of the first byte -> complete frame
+    Dispatch, // Complete frame -> MeshClient handler entered
+    Parse,    // Handler entered -> message decoded
+    Commit,   // Decoded -> saved to the store (or journal)
+    Emit,     // Saved -> signal handlers returned
+    Total,    // Read -> signal handlers returned
+    StageCount
+  };
+
+  // Monotonic nanoseconds, comparable across all stages
+  static qint64 now();
+  static const char *stageName(Stage stage);
+
+  void record(Stage stage, qint64 startNs, qint64 endNs) {
+    if (startNs > 0 && endNs >= startNs) {
+      m_stages[stage].record(endNs - startNs);
+    }
+  }
+  const LatencyHistogram &stage(Stage stage) const { return m_stages[stage]; }
+  void reset();
+
+private:
+  std::array<LatencyHistogram, StageCount> m_stages;
+};
+
+} // namespace MeshCore
@@ -0,0 +1,14 @@
+#include "Logging.h"
+
+namespace MeshCore {
+
+// Info and up by default: debug output was on everywhere before the
+// categories existed and cost a formatted string per frame. Turn it back
+// on with QT_LOGGING_RULES="meshcore.*.debug=true" or the CLI's 'log on'.
+Q_LOGGING_CATEGORY(lcTransport, "meshcore.transport", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcProtocol, "meshcore.protocol", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcStorage, "meshcore.storage", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcCli, "meshcore.cli", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcMetrics, "meshcore.metrics", QtInfoMsg)
+
+} // namespace MeshCore
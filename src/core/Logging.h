@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QLoggingCategory>
+
+namespace MeshCore {
+
+// One category per subsystem. Debug output is off by default and enabled
+// at run time with QT_LOGGING_RULES, e.g. "meshcore.protocol.debug=true".
+// Arguments of a disabled statement are not evaluated.
+Q_DECLARE_LOGGING_CATEGORY(lcTransport) // meshcore.transport
+Q_DECLARE_LOGGING_CATEGORY(lcProtocol)  // meshcore.protocol
+Q_DECLARE_LOGGING_CATEGORY(lcStorage)   // meshcore.storage
+Q_DECLARE_LOGGING_CATEGORY(lcCli)       // meshcore.cli
+Q_DECLARE_LOGGING_CATEGORY(lcMetrics)   // meshcore.metrics
+
+} // namespace MeshCore
+
+// Per-frame and per-message tracing on the receive path. Compiled in only
+// with MESHCORE_TRACE_LOGGING (Debug builds, or MESHCOREQT_TRACE_LOGGING=ON);
+// otherwise the statement and its arguments compile to nothing.
+#ifdef MESHCORE_TRACE_LOGGING
+#define qCTrace(category) qCDebug(category)
+#else
+#define qCTrace(category)                                                                      \
+  while (false)                                                                                \
+  QMessageLogger().noDebug()
+#endif
@@ -0,0 +1,215 @@
+#include "MemoryAccounting.h"
+#include <QFile>
+#include <QMutexLocker>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+namespace MeshCore {
+
+namespace {
+
+struct HeapCounters {
+  std::atomic<quint64> allocations;
+  std::atomic<quint64> frees;
+  std::atomic<quint64> bytesAllocated;
+  std::atomic<quint64> bytesFreed;
+};
+
+// Zero-initialized before any allocation can happen, so operator new may
+// run during static initialization
+std::array<HeapCounters, MemoryAccounting::SubsystemCount> heapCounters;
+thread_local MemoryAccounting::Subsystem currentSubsystem = MemoryAccounting::Unattributed;
+
+} // namespace
+
+MemoryAccounting &MemoryAccounting::instance() {
+  static MemoryAccounting accounting;
+  return accounting;
+}
+
+MemoryAccounting::MemoryAccounting() : m_nextId(1) {}
+
+const char *MemoryAccounting::subsystemName(Subsystem subsystem) {
+  switch (subsystem) {
+  case Unattributed:
+    return "unattributed";
+  case Transport:
+    return "transport";
+  case Protocol:
+    return "protocol";
+  case Models:
+    return "models";
+  case Caches:
+    return "caches";
+  case Storage:
+    return "storage";
+  case Diagnostics:
+    return "diagnostics";
+  case Ui:
+    return "ui";
+  case SubsystemCount:
+    break;
+  }
+  return "unknown";
+}
+
+bool MemoryAccounting::heapCountingEnabled() {
+#ifdef MESHCORE_MEMORY_ACCOUNTING
+  return true;
+#else
+  return false;
+#endif
+}
+
+MemoryAccounting::HeapStats MemoryAccounting::heapStats(Subsystem subsystem) {
+  const HeapCounters &counters = heapCounters[subsystem];
+  HeapStats stats;
+  stats.allocations = counters.allocations.load(std::memory_order_relaxed);
+  stats.frees = counters.frees.load(std::memory_order_relaxed);
+  stats.bytesAllocated = counters.bytesAllocated.load(std::memory_order_relaxed);
+  stats.bytesFreed = counters.bytesFreed.load(std::memory_order_relaxed);
+  return stats;
+}
+
+MemoryAccounting::Subsystem MemoryAccounting::setCurrentSubsystem(Subsystem subsystem) {
+  const Subsystem previous = currentSubsystem;
+  currentSubsystem = subsystem;
+  return previous;
+}
+
+int MemoryAccounting::addFootprint(Subsystem subsystem, const char *name,
+                                   const Estimator &estimator) {
+  QMutexLocker locker(&m_mutex);
+  const int id = m_nextId++;
+  m_entries.append({id, subsystem, name, estimator});
+  return id;
+}
+
+void MemoryAccounting::removeFootprint(int id) {
+  QMutexLocker locker(&m_mutex);
+  for (int i = 0; i < m_entries.size(); ++i) {
+    if (m_entries[i].id == id) {
+      m_entries.removeAt(i);
+      return;
+    }
+  }
+}
+
+QVector<MemoryAccounting::Footprint> MemoryAccounting::footprints() const {
+  // Estimators take their owners' locks, so they run outside this one
+  QVector<Entry> entries;
+  {
+    QMutexLocker locker(&m_mutex);
+    entries = m_entries;
+  }
+
+  QVector<Footprint> footprints;
+  footprints.reserve(entries.size());
+  for (const Entry &entry : std::as_const(entries)) {
+    footprints.append({entry.subsystem, entry.name, entry.estimator()});
+  }
+  return footprints;
+}
+
+qint64 MemoryAccounting::residentBytes() {
+#ifdef Q_OS_UNIX
+  // "size resident shared text lib data dt", in pages
+  QFile statm("/proc/self/statm");
+  if (statm.open(QIODevice::ReadOnly)) {
+    const QList<QByteArray> fields = statm.readAll().split(' ');
+    if (fields.size() > 1) {
+      return fields[1].toLongLong() * sysconf(_SC_PAGESIZE);
+    }
+  }
+#endif
+  return 0;
+}
+
+} // namespace MeshCore
+
+#ifdef MESHCORE_MEMORY_ACCOUNTING
+
+// Replaceable global allocation functions. Each block carries its size and
+// the subsystem that allocated it, so frees are charged back to it. The
+// aligned (align_val_t) forms keep the library implementation.
+namespace {
+
+struct alignas(alignof(std::max_align_t)) BlockHeader {
+  std::size_t size;
+  MeshCore::MemoryAccounting::Subsystem subsystem;
+};
+
+void *countedAlloc(std::size_t size) {
+  void *block;
+  while (!(block = std::malloc(sizeof(BlockHeader) + size))) {
+    std::new_handler handler = std::get_new_handler();
+    if (!handler) {
+      return nullptr;
+    }
+    handler(); // Frees memory or throws
+  }
+
+  auto *header = static_cast<BlockHeader *>(block);
+  header->size = size;
+  header->subsystem = MeshCore::currentSubsystem;
+  auto &counters = MeshCore::heapCounters[header->subsystem];
+  counters.allocations.fetch_add(1, std::memory_order_relaxed);
+  counters.bytesAllocated.fetch_add(size, std::memory_order_relaxed);
+  return header + 1;
+}
+
+void countedFree(void *pointer) noexcept {
+  if (!pointer) {
+    return;
+  }
+
+  auto *header = static_cast<BlockHeader *>(pointer) - 1;
+  auto &counters = MeshCore::heapCounters[header->subsystem];
+  counters.frees.fetch_add(1, std::memory_order_relaxed);
+  counters.bytesFreed.fetch_add(header->size, std::memory_order_relaxed);
+  std::free(header);
+}
+
+} // namespace
+
+void *operator new(std::size_t size) {
+  if (void *pointer = countedAlloc(size)) {
+    return pointer;
+  }
+  throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  try {
+    return countedAlloc(size);
+  } catch (...) {
+    return nullptr; // Thrown by the new handler
+  }
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &tag) noexcept {
+  return operator new(size, tag);
+}
+
+void operator delete(void *pointer) noexcept { countedFree(pointer); }
+void operator delete[](void *pointer) noexcept { countedFree(pointer); }
+void operator delete(void *pointer, std::size_t) noexcept { countedFree(pointer); }
+void operator delete[](void *pointer, std::size_t) noexcept { countedFree(pointer); }
+void operator delete(void *pointer, const std::nothrow_t &) noexcept {
+  countedFree(pointer);
+}
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept {
+  countedFree(pointer);
+}
+
+#endif // MESHCORE_MEMORY_ACCOUNTING
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <QByteArray>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+#include <functional>
+
+namespace MeshCore {
+
+// Where the process's memory goes, by subsystem, from two sources:
+//
+// Footprints are estimates of what the long-lived containers hold (contact
+// list, BLE device list, caches, diagnostic rings), reported by their owners
+// when asked. They include QString/QByteArray/QVector buffers.
+//
+// Heap counters attribute every operator new/delete to the subsystem the
+// allocating thread is in (see MemoryScope), which gives live bytes and
+// allocation rates. They are compiled in with MESHCOREQT_MEMORY_ACCOUNTING
+// only, since they add a 16-byte header to each allocation. Qt allocates
+// string and list buffers with malloc, so those are not counted here; Qt
+// objects, QHash/QMap nodes and std containers are.
+class MemoryAccounting {
+public:
+  enum Subsystem : quint8 {
+    Unattributed, // Outside any MemoryScope (Qt internals, startup)
+    Transport,
+    Protocol,
+    Models,
+    Caches,
+    Storage,
+    Diagnostics,
+    Ui,
+    SubsystemCount
+  };
+
+  struct HeapStats {
+    quint64 allocations = 0;
+    quint64 frees = 0;
+    quint64 bytesAllocated = 0;
+    quint64 bytesFreed = 0; // Attributed to the subsystem that allocated
+
+    qint64 liveBytes() const { return qint64(bytesAllocated - bytesFreed); }
+  };
+
+  struct Footprint {
+    Subsystem subsystem;
+    const char *name;
+    qint64 bytes;
+  };
+
+  using Estimator = std::function<qint64()>;
+
+  static MemoryAccounting &instance();
+  static const char *subsystemName(Subsystem subsystem);
+
+  static bool heapCountingEnabled();
+  static HeapStats heapStats(Subsystem subsystem);
+
+  // The calling thread's subsystem; returns the previous one
+  static Subsystem setCurrentSubsystem(Subsystem subsystem);
+
+  // name must be a literal. The estimator runs on the thread that calls
+  // footprints(), the main thread for the CLI and metrics endpoint.
+  int addFootprint(Subsystem subsystem, const char *name, const Estimator &estimator);
+  void removeFootprint(int id);
+  QVector<Footprint> footprints() const;
+
+  // Resident set size from /proc/self/statm; 0 where that is unavailable
+  static qint64 residentBytes();
+
+  // Heap bytes behind a value; shared (implicitly copied) data is counted by
+  // every holder
+  static qint64 heapBytes(const QByteArray &bytes) { return bytes.capacity(); }
+  static qint64 heapBytes(const QString &text) {
+    return text.capacity() * qint64(sizeof(QChar));
+  }
+
+private:
+  MemoryAccounting();
+  MemoryAccounting(const MemoryAccounting &) = delete;
+  MemoryAccounting &operator=(const MemoryAccounting &) = delete;
+
+  struct Entry {
+    int id;
+    Subsystem subsystem;
+    const char *name;
+    Estimator estimator;
+  };
+
+  mutable QMutex m_mutex;
+  QVector<Entry> m_entries;
+  int m_nextId;
+};
+
+// Attributes the calling thread's allocations to a subsystem until the end
+// of the scope. Scopes nest; the innermost one wins.
+class MemoryScope {
+public:
+  explicit MemoryScope(MemoryAccounting::Subsystem subsystem)
+      : m_previous(MemoryAccounting::setCurrentSubsystem(subsystem)) {}
+  ~MemoryScope() { MemoryAccounting::setCurrentSubsystem(m_previous); }
+
+private:
+  MemoryScope(const MemoryScope &) = delete;
+  MemoryScope &operator=(const MemoryScope &) = delete;
+
+  MemoryAccounting::Subsystem m_previous;
+};
+
+} // namespace MeshCore
@@ -1,13 +1,20 @@
 #include <QDateTime>
 #include <QDebug>
+#include <QFileInfo>
+#include <QTimer>
 
 #include "../connection/BLEConnection.h"
 #include "../connection/SerialConnection.h"
 #include "../protocol/CommandBuilder.h"
 #include "../protocol/ResponseParser.h"
 #include "../storage/DatabaseManager.h"
+#include "../storage/MessageLogStore.h"
 #include "../storage/SettingsManager.h"
+#include "FlightRecorder.h"
+#include "Logging.h"
+#include "MemoryAccounting.h"
 #include "MeshClient.h"
+#include "Tracer.h"
 
 namespace MeshCore {
 
@@ -16,17 +23,36 @@ MeshClient::MeshClient(QObject *parent)
       m_channelManager(new ChannelManager(this)), m_initialized(false),
       m_initState(NOT_STARTED), m_isDiscoveringChannels(false),
       m_nextChannelIdx(0), m_databaseManager(new DatabaseManager(this)),
-      m_persistenceEnabled(true) {
+      m_messageLog(new MessageLogStore(this)), m_messageStore(m_databaseManager),
+      m_storesReady(false), m_persistenceEnabled(true), m_dispatchNs(0),
+      m_initStartNs(0), m_discoveryStartNs(0), m_syncStartNs(0), m_syncedMessages(0),
+      m_commandTimer(new QTimer(this)), m_updates(new NotificationCoalescer(this)) {
   // Initialize channel manager with public channel
   m_channelManager->initialize();
 
   // Connect channel manager signals for persistence
-  connect(m_channelManager, &ChannelManager::channelAdded, this,
-          [this](const Channel &channel) {
-            if (m_persistenceEnabled && m_databaseManager && m_databaseManager->isOpen()) {
-              m_databaseManager->saveChannel(channel);
+  connect(m_channelManager, &ChannelManager::channelAdded, this, &MeshClient::persistChannel);
+  connect(m_channelManager, &ChannelManager::channelUpdated, this,
+          &MeshClient::persistChannel);
+
+  // Retention may delete rows the rings still hold; they re-warm on demand
+  connect(m_databaseManager, &DatabaseManager::retentionStepCompleted, this,
+          [this](int removedRows) {
+            if (removedRows > 0 &&
+                m_databaseManager->retentionPolicy().hasMessageLimits()) {
+              m_recentMessages.clear();
             }
           });
+  connect(m_databaseManager, &DatabaseManager::databaseClosed, this, [this]() {
+    m_storesReady = false;
+    m_recentMessages.clear();
+  });
+
+  m_commandTimer->setSingleShot(true);
+  connect(m_commandTimer, &QTimer::timeout, this, &MeshClient::onCommandTimeout);
+
+  registerMemoryFootprints();
+  connectUpdateNotifications();
 }
 
 MeshClient::MeshClient(IConnection *connection, QObject *parent)
@@ -34,7 +60,10 @@ MeshClient::MeshClient(IConnection *connection, QObject *parent)
       m_channelManager(new ChannelManager(this)), m_initialized(false),
       m_initState(NOT_STARTED), m_isDiscoveringChannels(false),
       m_nextChannelIdx(0), m_databaseManager(new DatabaseManager(this)),
-      m_persistenceEnabled(true) {
+      m_messageLog(new MessageLogStore(this)), m_messageStore(m_databaseManager),
+      m_storesReady(false), m_persistenceEnabled(true), m_dispatchNs(0),
+      m_initStartNs(0), m_discoveryStartNs(0), m_syncStartNs(0), m_syncedMessages(0),
+      m_commandTimer(new QTimer(this)), m_updates(new NotificationCoalescer(this)) {
   // Connect connection signals
   connect(m_connection, &IConnection::frameReceived, this,
           &MeshClient::onFrameReceived);
@@ -47,7 +76,7 @@ MeshClient::MeshClient(IConnection *connection, QObject *parent)
   connect(m_connection, &IConnection::stateChanged, this,
           [this](ConnectionState state) {
             if (state == ConnectionState::Connected && !m_initialized) {
-              qDebug() << "Connection established, starting auto-init...";
+              qCDebug(lcProtocol) << "Connection established, starting auto-init...";
               startInitSequence();
             }
           });
@@ -56,24 +85,106 @@ MeshClient::MeshClient(IConnection *connection, QObject *parent)
   m_channelManager->initialize();
 
   // Connect channel manager signals for persistence
-  connect(m_channelManager, &ChannelManager::channelAdded, this,
-          [this](const Channel &channel) {
-            if (m_persistenceEnabled && m_databaseManager && m_databaseManager->isOpen()) {
-              m_databaseManager->saveChannel(channel);
+  connect(m_channelManager, &ChannelManager::channelAdded, this, &MeshClient::persistChannel);
+  connect(m_channelManager, &ChannelManager::channelUpdated, this,
+          &MeshClient::persistChannel);
+
+  // Retention may delete rows the rings still hold; they re-warm on demand
+  connect(m_databaseManager, &DatabaseManager::retentionStepCompleted, this,
+          [this](int removedRows) {
+            if (removedRows > 0 &&
+                m_databaseManager->retentionPolicy().hasMessageLimits()) {
+              m_recentMessages.clear();
             }
           });
+  connect(m_databaseManager, &DatabaseManager::databaseClosed, this, [this]() {
+    m_storesReady = false;
+    m_recentMessages.clear();
+  });
+
+  m_commandTimer->setSingleShot(true);
+  connect(m_commandTimer, &QTimer::timeout, this, &MeshClient::onCommandTimeout);
+
+  registerMemoryFootprints();
+  connectUpdateNotifications();
 }
 
 MeshClient::~MeshClient() {
+  for (int id : std::as_const(m_footprintIds)) {
+    MemoryAccounting::instance().removeFootprint(id);
+  }
   disconnect();
   if (m_ownsConnection && m_connection) {
     delete m_connection;
   }
 }
 
+void MeshClient::registerMemoryFootprints() {
+  auto add = [this](MemoryAccounting::Subsystem subsystem, const char *name,
+                    const MemoryAccounting::Estimator &estimator) {
+    m_footprintIds << MemoryAccounting::instance().addFootprint(subsystem, name, estimator);
+  };
+
+  add(MemoryAccounting::Models, "contacts", [this]() {
+    qint64 bytes = (m_contacts.capacity() - m_contacts.size()) * qint64(sizeof(Contact));
+    for (const Contact &contact : std::as_const(m_contacts)) {
+      bytes += contact.memoryUsage();
+    }
+    return bytes;
+  });
+  add(MemoryAccounting::Models, "channels",
+      [this]() { return m_channelManager->memoryUsage(); });
+  add(MemoryAccounting::Transport, "device lists", [this]() {
+    qint64 bytes = m_bleDevices.capacity() * qint64(sizeof(BLEDeviceInfo)) +
+                   m_serialPorts.capacity() * qint64(sizeof(SerialPortInfo));
+    for (const BLEDeviceInfo &device : std::as_const(m_bleDevices)) {
+      bytes += MemoryAccounting::heapBytes(device.name) +
+               MemoryAccounting::heapBytes(device.address);
+    }
+    for (const SerialPortInfo &port : std::as_const(m_serialPorts)) {
+      bytes += MemoryAccounting::heapBytes(port.portName) +
+               MemoryAccounting::heapBytes(port.description) +
+               MemoryAccounting::heapBytes(port.manufacturer) +
+               MemoryAccounting::heapBytes(port.serialNumber);
+    }
+    return bytes;
+  });
+  add(MemoryAccounting::Caches, "recent messages",
+      [this]() { return m_recentMessages.memoryUsage(); });
+  add(MemoryAccounting::Storage, "database",
+      [this]() { return m_databaseManager->memoryUsage(); });
+  add(MemoryAccounting::Storage, "message log",
+      [this]() { return m_messageLog->memoryUsage(); });
+  add(MemoryAccounting::Protocol, "frame arena",
+      []() { return qint64(FrameArena::CAPACITY); });
+  add(MemoryAccounting::Diagnostics, "latency histograms",
+      []() { return qint64(sizeof(LatencyMetrics)); });
+}
+
+void MeshClient::connectUpdateNotifications() {
+  m_updates->setInterval(UPDATE_INTERVAL_MS);
+  connect(m_channelManager, &ChannelManager::channelAdded, m_updates,
+          [this](const Channel &channel) { m_updates->channelChanged(channel.index); });
+  connect(m_channelManager, &ChannelManager::channelUpdated, m_updates,
+          [this](const Channel &channel) { m_updates->channelChanged(channel.index); });
+  connect(m_channelManager, &ChannelManager::channelRemoved, m_updates,
+          &NotificationCoalescer::channelRemoved);
+  connect(m_updates, &NotificationCoalescer::contactsChanged, this,
+          &MeshClient::contactsChanged);
+  connect(m_updates, &NotificationCoalescer::channelsChanged, this,
+          &MeshClient::channelsChanged);
+}
+
+void MeshClient::reportContactsMissingFromSync() {
+  for (const QByteArray &publicKey : std::as_const(m_contactsBeforeSync)) {
+    m_updates->contactRemoved(publicKey);
+  }
+  m_contactsBeforeSync.clear();
+}
+
 bool MeshClient::connectToDevice(const QString &target) {
   if (m_connection && m_connection->isOpen()) {
-    qWarning() << "Already connected";
+    qCWarning(lcProtocol) << "Already connected";
     return false;
   }
 
@@ -94,19 +205,19 @@ bool MeshClient::connectToDevice(const QString &target) {
     connect(m_connection, &IConnection::stateChanged, this,
             [this](ConnectionState state) {
               if (state == ConnectionState::Connected && !m_initialized) {
-                qDebug() << "Connection established, starting auto-init...";
+                qCDebug(lcProtocol) << "Connection established, starting auto-init...";
                 startInitSequence();
               }
             });
   }
 
-  qDebug() << "Connecting to" << target << "...";
+  qCDebug(lcProtocol) << "Connecting to" << target << "...";
   return m_connection->open(target);
 }
 
 bool MeshClient::connectToSerialDevice(const QString &portName, int baudRate) {
   if (m_connection && m_connection->isOpen()) {
-    qWarning() << "Already connected";
+    qCWarning(lcProtocol) << "Already connected";
     return false;
   }
 
@@ -128,13 +239,13 @@ bool MeshClient::connectToSerialDevice(const QString &portName, int baudRate) {
   connect(m_connection, &IConnection::stateChanged, this,
           [this](ConnectionState state) {
             if (state == ConnectionState::Connected && !m_initialized) {
-              qDebug() << "Connection established, starting auto-init...";
+              qCDebug(lcProtocol) << "Connection established, starting auto-init...";
               startInitSequence();
             }
           });
 
-  qDebug() << "Connecting to serial port" << portName << "at" << baudRate
-           << "baud...";
+  qCDebug(lcProtocol) << "Connecting to serial port" << portName << "at" << baudRate
+                      << "baud...";
 
   SerialConnection *serialConn = qobject_cast<SerialConnection *>(m_connection);
   if (serialConn) {
@@ -146,7 +257,7 @@ bool MeshClient::connectToSerialDevice(const QString &portName, int baudRate) {
 
 bool MeshClient::connectToBLEDevice(const QString &deviceName) {
   if (m_connection && m_connection->isOpen()) {
-    qWarning() << "Already connected";
+    qCWarning(lcProtocol) << "Already connected";
     return false;
   }
 
@@ -168,28 +279,26 @@ bool MeshClient::connectToBLEDevice(const QString &deviceName) {
   connect(m_connection, &IConnection::stateChanged, this,
           [this](ConnectionState state) {
             if (state == ConnectionState::Connected && !m_initialized) {
-              qDebug() << "Connection established, starting auto-init...";
+              qCDebug(lcProtocol) << "Connection established, starting auto-init...";
               startInitSequence();
             }
           });
 
-  qDebug() << "Connecting to BLE device:" << deviceName;
+  qCDebug(lcProtocol) << "Connecting to BLE device:" << deviceName;
   return m_connection->open(deviceName);
 }
 
 void MeshClient::disconnect() {
   if (m_connection && m_connection->isOpen()) {
-    // Update last connected time and close database
-    if (m_persistenceEnabled && m_databaseManager && m_databaseManager->isOpen()) {
-      m_databaseManager->updateLastConnectedTime();
-      m_databaseManager->closeDatabase();
-      qDebug() << "Database closed";
-    }
-
+    closeStores();
     m_connection->close();
     m_initialized = false;
     m_initState = NOT_STARTED;
-    qDebug() << "Disconnected from device";
+    m_batteryStatus = BatteryStatus();
+    m_pendingCommands.clear();
+    m_commandTimer->stop();
+    m_syncStartNs = 0;
+    qCDebug(lcProtocol) << "Disconnected from device";
     emit disconnected();
   }
 }
@@ -198,6 +307,97 @@ bool MeshClient::isConnected() const {
   return m_connection && m_connection->isOpen();
 }
 
+namespace {
+
+// Span names for the commands this client sends
+const char *commandName(uint8_t code) {
+  switch (static_cast<CommandCode>(code)) {
+  case CommandCode::APP_START:
+    return "APP_START";
+  case CommandCode::SEND_TXT_MSG:
+    return "SEND_TXT_MSG";
+  case CommandCode::SEND_CHANNEL_TXT_MSG:
+    return "SEND_CHANNEL_TXT_MSG";
+  case CommandCode::GET_CONTACTS:
+    return "GET_CONTACTS";
+  case CommandCode::SEND_SELF_ADVERT:
+    return "SEND_SELF_ADVERT";
+  case CommandCode::SET_ADVERT_NAME:
+    return "SET_ADVERT_NAME";
+  case CommandCode::ADD_UPDATE_CONTACT:
+    return "ADD_UPDATE_CONTACT";
+  case CommandCode::SYNC_NEXT_MESSAGE:
+    return "SYNC_NEXT_MESSAGE";
+  case CommandCode::SET_RADIO_PARAMS:
+    return "SET_RADIO_PARAMS";
+  case CommandCode::SET_ADVERT_LATLON:
+    return "SET_ADVERT_LATLON";
+  case CommandCode::REMOVE_CONTACT:
+    return "REMOVE_CONTACT";
+  case CommandCode::GET_BATT_AND_STORAGE:
+    return "GET_BATT_AND_STORAGE";
+  case CommandCode::DEVICE_QUERY:
+    return "DEVICE_QUERY";
+  case CommandCode::GET_CONTACT_BY_KEY:
+    return "GET_CONTACT_BY_KEY";
+  case CommandCode::GET_CHANNEL:
+    return "GET_CHANNEL";
+  case CommandCode::SET_CHANNEL:
+    return "SET_CHANNEL";
+  default:
+    return "command";
+  }
+}
+
+} // namespace
+
+void MeshClient::sendCommand(const QByteArray &cmd) {
+  m_connection->sendFrame(cmd);
+
+  // A device that stops answering must not grow the queue
+  if (m_pendingCommands.size() >= MAX_PENDING_COMMANDS) {
+    m_pendingCommands.dequeue();
+  }
+  m_pendingCommands.enqueue({static_cast<uint8_t>(cmd.at(0)), LatencyMetrics::now()});
+  if (!m_commandTimer->isActive()) {
+    m_commandTimer->start(COMMAND_TIMEOUT_MS);
+  }
+}
+
+void MeshClient::completePendingCommand() {
+  if (m_pendingCommands.isEmpty()) {
+    return;
+  }
+  const PendingCommand command = m_pendingCommands.dequeue();
+  Tracer::instance().record("command", commandName(command.code), command.sentNs,
+                            LatencyMetrics::now(), "code", command.code);
+
+  // The next command's clock starts now at the latest
+  if (m_pendingCommands.isEmpty()) {
+    m_commandTimer->stop();
+  } else {
+    m_commandTimer->start(COMMAND_TIMEOUT_MS);
+  }
+}
+
+void MeshClient::onCommandTimeout() {
+  if (m_pendingCommands.isEmpty()) {
+    return;
+  }
+
+  // Given up on, so a late answer is not matched to it
+  const PendingCommand command = m_pendingCommands.dequeue();
+  QString reason = QString("No response to %1 within %2 ms")
+                       .arg(commandName(command.code))
+                       .arg(COMMAND_TIMEOUT_MS);
+  qCWarning(lcProtocol) << reason;
+  FlightRecorder::instance().dumpOnError(reason);
+
+  if (!m_pendingCommands.isEmpty()) {
+    m_commandTimer->start(COMMAND_TIMEOUT_MS);
+  }
+}
+
 void MeshClient::startInitSequence() {
   if (!m_connection || !m_connection->isOpen()) {
     emit errorOccurred("Cannot initialize: not connected");
@@ -205,13 +405,14 @@ void MeshClient::startInitSequence() {
   }
 
   if (m_initialized) {
-    qDebug() << "Already initialized";
+    qCDebug(lcProtocol) << "Already initialized";
     emit initializationComplete();
     return;
   }
 
-  qDebug() << "Starting initialization sequence...";
+  qCDebug(lcProtocol) << "Starting initialization sequence...";
   m_initState = NOT_STARTED;
+  m_initStartNs = LatencyMetrics::now();
   sendNextInitCommand();
 }
 
@@ -221,25 +422,25 @@ void MeshClient::sendNextInitCommand() {
   switch (m_initState) {
   case NOT_STARTED:
     // Step 1: Send DEVICE_QUERY
-    qDebug() << "Sending CMD_DEVICE_QUERY...";
+    qCDebug(lcProtocol) << "Sending CMD_DEVICE_QUERY...";
     cmd = CommandBuilder::buildDeviceQuery(PROTOCOL_VERSION);
-    m_connection->sendFrame(cmd);
+    sendCommand(cmd);
     m_initState = SENT_DEVICE_QUERY;
     break;
 
   case SENT_DEVICE_QUERY:
     // Step 2: Send APP_START
-    qDebug() << "Sending CMD_APP_START...";
+    qCDebug(lcProtocol) << "Sending CMD_APP_START...";
     cmd = CommandBuilder::buildAppStart(1, "MeshCoreQt");
-    m_connection->sendFrame(cmd);
+    sendCommand(cmd);
     m_initState = SENT_APP_START;
     break;
 
   case SENT_APP_START:
     // Step 3: Send GET_CONTACTS
-    qDebug() << "Sending CMD_GET_CONTACTS...";
+    qCDebug(lcProtocol) << "Sending CMD_GET_CONTACTS...";
     cmd = CommandBuilder::buildGetContacts(0);
-    m_connection->sendFrame(cmd);
+    sendCommand(cmd);
     m_initState = SENT_GET_CONTACTS;
     break;
 
@@ -265,8 +466,9 @@ void MeshClient::discoverChannels() {
     return;
   }
 
-  qDebug() << "Starting channel discovery...";
+  qCDebug(lcProtocol) << "Starting channel discovery...";
   m_isDiscoveringChannels = true;
+  m_discoveryStartNs = LatencyMetrics::now();
   m_nextChannelIdx = 0;
   m_channelManager->setDiscovering(true);
   requestNextChannel();
@@ -295,11 +497,11 @@ void MeshClient::joinChannel(const QString &name, const QString &pskHex) {
   // Get next available channel index
   uint8_t channelIdx = m_channelManager->getNextAvailableIndex();
 
-  qDebug() << "Joining channel" << name << "at index" << channelIdx;
+  qCDebug(lcProtocol) << "Joining channel" << name << "at index" << channelIdx;
 
   // Build and send SET_CHANNEL command
   QByteArray cmd = CommandBuilder::buildSetChannel(channelIdx, name, pskBytes);
-  m_connection->sendFrame(cmd);
+  sendCommand(cmd);
 
   // Add to local channel manager
   Channel channel;
@@ -314,9 +516,9 @@ void MeshClient::requestNextChannel() {
   if (!m_isDiscoveringChannels)
     return;
 
-  qDebug() << "Requesting channel" << m_nextChannelIdx << "...";
+  qCDebug(lcProtocol) << "Requesting channel" << m_nextChannelIdx << "...";
   QByteArray cmd = CommandBuilder::buildGetChannel(m_nextChannelIdx);
-  m_connection->sendFrame(cmd);
+  sendCommand(cmd);
 }
 
 QVector<Channel> MeshClient::getChannels() const {
@@ -343,8 +545,8 @@ void MeshClient::addOrUpdateContact(const Contact &contact) {
       contact.pathLength(), contact.path(), contact.latitude(),
       contact.longitude(), contact.lastAdvertTimestamp());
 
-  qDebug() << "Adding/updating contact:" << contact.name();
-  m_connection->sendFrame(cmd);
+  qCDebug(lcProtocol) << "Adding/updating contact:" << contact.name();
+  sendCommand(cmd);
 
   // Update local storage
   bool found = false;
@@ -360,6 +562,7 @@ void MeshClient::addOrUpdateContact(const Contact &contact) {
     m_contacts.append(contact);
   }
 
+  m_updates->contactChanged(contact.publicKey());
   emit contactReceived(contact);
   emit contactsUpdated();
 }
@@ -377,8 +580,8 @@ void MeshClient::removeContact(const QByteArray &publicKey) {
 
   // Send command to device
   QByteArray cmd = CommandBuilder::buildRemoveContact(publicKey);
-  qDebug() << "Removing contact:" << publicKey.toHex();
-  m_connection->sendFrame(cmd);
+  qCDebug(lcProtocol) << "Removing contact:" << publicKey.toHex();
+  sendCommand(cmd);
 
   // Remove from local storage
   for (int i = 0; i < m_contacts.size(); ++i) {
@@ -388,6 +591,7 @@ void MeshClient::removeContact(const QByteArray &publicKey) {
     }
   }
 
+  m_updates->contactRemoved(publicKey);
   emit contactRemoved(publicKey);
   emit contactsUpdated();
 }
@@ -404,8 +608,8 @@ void MeshClient::requestContactByKey(const QByteArray &publicKey) {
   }
 
   QByteArray cmd = CommandBuilder::buildGetContactByKey(publicKey);
-  qDebug() << "Requesting contact:" << publicKey.toHex();
-  m_connection->sendFrame(cmd);
+  qCDebug(lcProtocol) << "Requesting contact:" << publicKey.toHex();
+  sendCommand(cmd);
 }
 
 void MeshClient::sendSelfAdvert(bool floodMode) {
@@ -414,9 +618,9 @@ void MeshClient::sendSelfAdvert(bool floodMode) {
     return;
   }
 
-  qDebug() << "Sending self advertisement" << (floodMode ? "(flood mode)" : "(direct)");
+  qCDebug(lcProtocol) << "Sending self advertisement" << (floodMode ? "(flood mode)" : "(direct)");
   QByteArray cmd = CommandBuilder::buildSendSelfAdvert(floodMode ? 1 : 0);
-  m_connection->sendFrame(cmd);
+  sendCommand(cmd);
 }
 
 void MeshClient::setAdvertName(const QString &name) {
@@ -425,9 +629,9 @@ void MeshClient::setAdvertName(const QString &name) {
     return;
   }
 
-  qDebug() << "Setting advert name:" << name;
+  qCDebug(lcProtocol) << "Setting advert name:" << name;
   QByteArray cmd = CommandBuilder::buildSetAdvertName(name);
-  m_connection->sendFrame(cmd);
+  sendCommand(cmd);
 }
 
 void MeshClient::setAdvertLocation(double latitude, double longitude) {
@@ -440,9 +644,9 @@ void MeshClient::setAdvertLocation(double latitude, double longitude) {
   int32_t lat = static_cast<int32_t>(latitude * 1000000.0);
   int32_t lon = static_cast<int32_t>(longitude * 1000000.0);
 
-  qDebug() << "Setting advert location:" << latitude << "," << longitude;
+  qCDebug(lcProtocol) << "Setting advert location:" << latitude << "," << longitude;
   QByteArray cmd = CommandBuilder::buildSetAdvertLatLon(lat, lon);
-  m_connection->sendFrame(cmd);
+  sendCommand(cmd);
 }
 
 void MeshClient::sendChannelMessage(uint8_t channelIdx, const QString &text) {
@@ -460,8 +664,8 @@ void MeshClient::sendChannelMessage(uint8_t channelIdx, const QString &text) {
   QByteArray cmd = CommandBuilder::buildSendChannelTxtMsg(
       static_cast<uint8_t>(TextType::PLAIN), channelIdx, timestamp, text);
 
-  qDebug() << "Sending message to channel" << channelIdx << ":" << text;
-  m_connection->sendFrame(cmd);
+  qCDebug(lcProtocol) << "Sending message to channel" << channelIdx << ":" << text;
+  sendCommand(cmd);
 }
 
 void MeshClient::sendDirectMessage(const QByteArray &recipientPubKey,
@@ -481,9 +685,9 @@ void MeshClient::sendDirectMessage(const QByteArray &recipientPubKey,
   QByteArray cmd = CommandBuilder::buildSendTxtMsg(
       TXT_TYPE_PLAIN, attempt, timestamp, recipientPubKey, text);
 
-  qDebug() << "Sending direct message to"
-           << recipientPubKey.left(6).toHex() << ":" << text;
-  m_connection->sendFrame(cmd);
+  qCDebug(lcProtocol) << "Sending direct message to"
+                      << recipientPubKey.left(6).toHex() << ":" << text;
+  sendCommand(cmd);
 }
 
 void MeshClient::sendDirectMessage(const Contact &recipient,
@@ -497,8 +701,13 @@ void MeshClient::syncNextMessage() {
     return;
   }
 
+  if (m_syncStartNs == 0) {
+    m_syncStartNs = LatencyMetrics::now();
+    m_syncedMessages = 0;
+  }
+
   QByteArray cmd = CommandBuilder::buildSyncNextMessage();
-  m_connection->sendFrame(cmd);
+  sendCommand(cmd);
 }
 
 void MeshClient::setRadioConfig(const RadioConfig &config) {
@@ -512,13 +721,13 @@ void MeshClient::setRadioConfig(const RadioConfig &config) {
     return;
   }
 
-  qDebug() << "Setting radio config:" << config.toString();
+  qCDebug(lcProtocol) << "Setting radio config:" << config.toString();
 
   QByteArray cmd = CommandBuilder::buildSetRadioParams(
       config.frequencyKhz, config.bandwidthHz, config.spreadingFactor,
       config.codingRate);
 
-  m_connection->sendFrame(cmd);
+  sendCommand(cmd);
   // Will receive RESP_CODE_OK or RESP_CODE_ERR as confirmation
 }
 
@@ -534,10 +743,27 @@ void MeshClient::setRadioPreset(const QString &presetName) {
   setRadioConfig(config);
 }
 
+void MeshClient::requestBatteryStatus() {
+  if (!m_initialized) {
+    emit errorOccurred("Cannot request battery status: not initialized");
+    return;
+  }
+
+  QByteArray cmd = CommandBuilder::buildGetBattAndStorage();
+  sendCommand(cmd);
+}
+
 void MeshClient::onFrameReceived(const QByteArray &frame) {
   if (frame.isEmpty())
     return;
 
+  MemoryScope memory(MemoryAccounting::Protocol);
+  FrameArena::Scope arena(m_frameArena);
+  m_dispatchNs = LatencyMetrics::now();
+  m_frameTiming = m_connection ? m_connection->lastFrameTiming() : FrameTiming();
+  m_metrics.record(LatencyMetrics::Deframe, m_frameTiming.readNs, m_frameTiming.deframedNs);
+  m_metrics.record(LatencyMetrics::Dispatch, m_frameTiming.deframedNs, m_dispatchNs);
+
   if (ResponseParser::isPushNotification(frame)) {
     handlePushNotification(frame);
   } else {
@@ -548,14 +774,21 @@ void MeshClient::onFrameReceived(const QByteArray &frame) {
 void MeshClient::handleResponse(const QByteArray &frame) {
   ResponseCode code = ResponseParser::getResponseCode(frame);
 
+  // Responses arrive in command order. A contact list is one round trip
+  // that ends with END_OF_CONTACTS.
+  if (code != ResponseCode::CONTACTS_START &&
+      !(code == ResponseCode::CONTACT && m_initState == SENT_GET_CONTACTS)) {
+    completePendingCommand();
+  }
+
   // Handle initialization responses
   if (m_initState != COMPLETE) {
     switch (m_initState) {
     case SENT_DEVICE_QUERY:
       if (code == ResponseCode::DEVICE_INFO) {
         m_deviceInfo = ResponseParser::parseDeviceInfo(frame);
-        qDebug() << "Device info:" << m_deviceInfo.firmwareName << "v"
-                 << m_deviceInfo.firmwareVersion;
+        qCDebug(lcProtocol) << "Device info:" << m_deviceInfo.firmwareName << "v"
+                            << m_deviceInfo.firmwareVersion;
         sendNextInitCommand();
         return;
       }
@@ -564,13 +797,23 @@ void MeshClient::handleResponse(const QByteArray &frame) {
     case SENT_APP_START:
       if (code == ResponseCode::SELF_INFO) {
         m_selfInfo = ResponseParser::parseSelfInfo(frame);
-        qDebug() << "Self info received, public key:"
-                 << m_selfInfo.publicKey.toHex();
+        qCDebug(lcProtocol) << "Self info received, public key:"
+                            << m_selfInfo.publicKey.toHex();
+
+        // Anything journaled from here on belongs to this device
+        m_journal.setDeviceKey(m_selfInfo.publicKey);
 
         // Open database for persistence
         if (m_persistenceEnabled && m_databaseManager) {
+          TraceScope span("init", "open_stores");
+          m_databaseManager->setStorageProfile(
+              SettingsManager::instance().getStorageProfile());
+          m_databaseManager->queryProfiler().setSlowThresholdMs(
+              SettingsManager::instance().getSlowQueryMs());
           if (m_databaseManager->openDatabase(m_selfInfo.publicKey)) {
-            qDebug() << "Database opened:" << m_databaseManager->getDatabasePath(m_selfInfo.publicKey);
+            qCDebug(lcProtocol) << "Database opened:" << m_databaseManager->getDatabasePath(m_selfInfo.publicKey);
+            m_databaseManager->setRetentionPolicy(
+                SettingsManager::instance().getRetentionPolicy());
             // Save device info
             m_databaseManager->saveDeviceInfo(m_deviceInfo, m_selfInfo);
 
@@ -578,21 +821,40 @@ void MeshClient::handleResponse(const QByteArray &frame) {
             QVector<Channel> currentChannels = m_channelManager->getChannels();
             for (const Channel &ch : currentChannels) {
               m_databaseManager->saveChannel(ch);
-              qDebug() << "Saved existing channel to DB:" << ch.index << ch.name;
+              qCDebug(lcProtocol) << "Saved existing channel to DB:" << ch.index << ch.name;
             }
 
             // Load cached contacts and channels
             QVector<Contact> cachedContacts = m_databaseManager->loadAllContacts();
             QVector<Channel> cachedChannels = m_databaseManager->loadAllChannels();
-            qDebug() << "Loaded" << cachedContacts.size() << "cached contacts,"
-                     << cachedChannels.size() << "cached channels";
+            qCDebug(lcProtocol) << "Loaded" << cachedContacts.size() << "cached contacts,"
+                                << cachedChannels.size() << "cached channels";
 
             // Pre-populate contacts from database cache
             // These will be updated/merged when device sends fresh contacts
             m_contacts = cachedContacts;
-            qDebug() << "Initialized m_contacts with" << m_contacts.size() << "cached contacts";
+            qCDebug(lcProtocol) << "Initialized m_contacts with" << m_contacts.size() << "cached contacts";
+
+            openMessageStore();
+
+            // Frames received before this point were journaled
+            JournalReplayResult replayed;
+            if (m_journal.replay(m_selfInfo.publicKey, m_databaseManager, m_messageStore,
+                                 &replayed)) {
+              m_storesReady = true;
+              if (replayed.messages + replayed.contacts + replayed.channels > 0) {
+                qCDebug(lcProtocol) << "Replayed" << replayed.messages << "messages,"
+                                    << replayed.contacts << "contacts and" << replayed.channels
+                                    << "channels from the ingest journal";
+              }
+            } else {
+              qCWarning(lcProtocol) << "Journal replay failed, still journaling:"
+                                    << m_journal.getLastError();
+            }
+
+            warmRecentMessages();
           } else {
-            qWarning() << "Failed to open database:" << m_databaseManager->getLastError();
+            qCWarning(lcProtocol) << "Failed to open database:" << m_databaseManager->getLastError();
           }
         }
 
@@ -603,39 +865,55 @@ void MeshClient::handleResponse(const QByteArray &frame) {
 
     case SENT_GET_CONTACTS:
       if (code == ResponseCode::CONTACTS_START) {
-        qDebug() << "Contacts sync started";
+        qCDebug(lcProtocol) << "Contacts sync started";
+        m_contactsBeforeSync.clear();
+        for (const Contact &contact : std::as_const(m_contacts)) {
+          m_contactsBeforeSync.insert(contact.publicKey());
+        }
         m_contacts.clear();
         return;
       } else if (code == ResponseCode::CONTACT) {
         Contact contact = ResponseParser::parseContact(frame);
         if (contact.isValid()) {
           m_contacts.append(contact);
-          qDebug() << "Contact received:" << contact.name();
-
-          // Save to database during init
-          if (m_persistenceEnabled && m_databaseManager && m_databaseManager->isOpen()) {
-            if (!m_databaseManager->saveContact(contact)) {
-              qWarning() << "Failed to save contact during init:" << m_databaseManager->getLastError();
-            }
-          }
+          qCTrace(lcProtocol) << "Contact received:" << contact.name();
 
+          // Persisted in one sync once the full list has arrived
+          m_contactsBeforeSync.remove(contact.publicKey());
+          m_updates->contactChanged(contact.publicKey());
           emit contactReceived(contact);
         }
         return;
       } else if (code == ResponseCode::END_OF_CONTACTS) {
-        qDebug() << "Contacts sync complete - received" << m_contacts.size()
-                 << "contacts";
+        qCDebug(lcProtocol) << "Contacts sync complete - received" << m_contacts.size()
+                            << "contacts";
+
+        // The list is complete, so contacts missing from it were deleted on the
+        // device. Not done on ERR, where the list may be partial.
+        // Without the database the list is journaled and later upserted;
+        // the deletions wait for the next complete sync.
+        if (m_persistenceEnabled && m_storesReady &&
+            !m_databaseManager->syncContacts(m_contacts)) {
+          qCWarning(lcProtocol) << "Failed to sync contacts:" << m_databaseManager->getLastError();
+          persistContacts(m_contacts);
+        } else if (!m_storesReady) {
+          persistContacts(m_contacts);
+        }
+
+        reportContactsMissingFromSync();
         emit contactsUpdated();
 
         // Start automatic channel discovery
         m_initState = DISCOVERING_CHANNELS;
-        qDebug() << "Starting automatic channel discovery...";
+        qCDebug(lcProtocol) << "Starting automatic channel discovery...";
         m_isDiscoveringChannels = true;
+        m_discoveryStartNs = LatencyMetrics::now();
         m_nextChannelIdx = 0;
         requestNextChannel();
         return;
       } else if (code == ResponseCode::ERR) {
-        qDebug() << "Got error during contact sync, completing init anyway";
+        qCDebug(lcProtocol) << "Got error during contact sync, completing init anyway";
+        reportContactsMissingFromSync(); // Gone from the list until the next sync
         sendNextInitCommand();
         return;
       }
@@ -649,7 +927,7 @@ void MeshClient::handleResponse(const QByteArray &frame) {
   // Handle other responses
   switch (code) {
   case ResponseCode::OK:
-    qDebug() << "Received OK response";
+    qCTrace(lcProtocol) << "Received OK response";
     // Radio configuration confirmed, message sent, etc.
     break;
 
@@ -657,7 +935,10 @@ void MeshClient::handleResponse(const QByteArray &frame) {
     ErrorCode errCode = ResponseParser::getErrorCode(frame);
     if (m_isDiscoveringChannels && errCode == ErrorCode::NOT_FOUND) {
       // No more channels to discover
-      qDebug() << "Channel discovery complete - no more channels";
+      qCDebug(lcProtocol) << "Channel discovery complete - no more channels";
+      Tracer::instance().record("init", "channel_discovery", m_discoveryStartNs,
+                                LatencyMetrics::now(), "channels",
+                                m_channelManager->getChannels().size());
       m_isDiscoveringChannels = false;
       m_channelManager->setDiscovering(false);
       emit channelListUpdated();
@@ -666,11 +947,12 @@ void MeshClient::handleResponse(const QByteArray &frame) {
       if (m_initState == DISCOVERING_CHANNELS) {
         m_initState = COMPLETE;
         m_initialized = true;
-        qDebug() << "Initialization complete (with channel discovery)";
+        qCDebug(lcProtocol) << "Initialization complete (with channel discovery)";
+        Tracer::instance().record("init", "init_sequence", m_initStartNs, LatencyMetrics::now());
         emit initializationComplete();
       }
     } else {
-      qWarning() << "Error response:" << static_cast<int>(errCode);
+      qCWarning(lcProtocol) << "Error response:" << static_cast<int>(errCode);
       emit errorOccurred(
           QString("Device error: %1").arg(static_cast<int>(errCode)));
     }
@@ -682,16 +964,10 @@ void MeshClient::handleResponse(const QByteArray &frame) {
 
     // Filter out empty channels
     if (channel.isEmpty()) {
-      qDebug() << "Skipping empty channel at index" << channel.index;
+      qCDebug(lcProtocol) << "Skipping empty channel at index" << channel.index;
     } else {
-      qDebug() << "Channel discovered:" << channel.index << channel.name;
-      m_channelManager->addOrUpdateChannel(channel);
-
-      // Save to database
-      if (m_persistenceEnabled && m_databaseManager && m_databaseManager->isOpen()) {
-        m_databaseManager->saveChannel(channel);
-      }
-
+      qCDebug(lcProtocol) << "Channel discovered:" << channel.index << channel.name;
+      m_channelManager->addOrUpdateChannel(channel); // Persisted by its signals
       emit channelDiscovered(channel);
     }
 
@@ -706,7 +982,7 @@ void MeshClient::handleResponse(const QByteArray &frame) {
   case ResponseCode::CONTACT: {
     Contact contact = ResponseParser::parseContact(frame);
     if (contact.isValid()) {
-      qDebug() << "Contact received:" << contact.name();
+      qCTrace(lcProtocol) << "Contact received:" << contact.name();
 
       // Update local storage
       bool found = false;
@@ -722,11 +998,9 @@ void MeshClient::handleResponse(const QByteArray &frame) {
         m_contacts.append(contact);
       }
 
-      // Save to database
-      if (m_persistenceEnabled && m_databaseManager && m_databaseManager->isOpen()) {
-        m_databaseManager->saveContact(contact);
-      }
+      persistContacts({contact});
 
+      m_updates->contactChanged(contact.publicKey());
       emit contactReceived(contact);
       emit contactsUpdated();
     }
@@ -735,58 +1009,75 @@ void MeshClient::handleResponse(const QByteArray &frame) {
 
   case ResponseCode::CHANNEL_MSG_RECV_V3: {
     Message msg = ResponseParser::parseChannelMsgRecvV3(frame);
-    qDebug() << "Channel message received from" << msg.senderName
-             << "on channel" << msg.channelIdx;
+    const qint64 parsedNs = LatencyMetrics::now();
+    qCTrace(lcProtocol) << "Channel message received from" << msg.senderName
+                        << "on channel" << msg.channelIdx;
 
-    // Save to database
-    if (m_persistenceEnabled && m_databaseManager && m_databaseManager->isOpen()) {
-      if (!m_databaseManager->saveMessage(msg, false)) {
-        qWarning() << "Failed to save message:" << m_databaseManager->getLastError();
-      }
-    }
+    persistMessage(msg);
+    const qint64 committedNs = LatencyMetrics::now();
 
+    m_recentMessages.insert(msg);
     emit channelMessageReceived(msg);
+    recordMessageLatency(parsedNs, committedNs);
+    break;
+  }
+
+  case ResponseCode::BATT_AND_STORAGE: {
+    BatteryStatus status = ResponseParser::parseBattAndStorage(frame);
+    if (status.isValid) {
+      m_batteryStatus = status;
+      qCDebug(lcProtocol) << "Battery:" << status.milliVolts << "mV, storage"
+                          << status.storageUsedKb << "of" << status.storageTotalKb << "KB";
+      emit batteryStatusReceived(status);
+    }
     break;
   }
 
   case ResponseCode::NO_MORE_MESSAGES:
-    qDebug() << "No more messages in queue";
+    qCTrace(lcProtocol) << "No more messages in queue";
+    if (m_syncStartNs > 0) {
+      Tracer::instance().record("sync", "sync_drain", m_syncStartNs, LatencyMetrics::now(),
+                                "messages", m_syncedMessages);
+      m_syncStartNs = 0;
+    }
     emit noMoreMessages();
     break;
 
   case ResponseCode::SENT:
-    qDebug() << "Message sent confirmation";
+    qCTrace(lcProtocol) << "Message sent confirmation";
     break;
 
   case ResponseCode::CONTACT_MSG_RECV_V3: {
     Message msg = ResponseParser::parseContactMsgRecvV3(frame);
-
-    // Try to resolve sender name from contacts
-    QString senderInfo = msg.senderPubKeyPrefix.toHex();
-    for (const Contact &contact : m_contacts) {
-      if (contact.publicKey().startsWith(msg.senderPubKeyPrefix)) {
-        if (!contact.name().isEmpty()) {
-          senderInfo = QString("%1 (%2)").arg(contact.name(), msg.senderPubKeyPrefix.toHex());
+    const qint64 parsedNs = LatencyMetrics::now();
+
+    // Resolves the sender name from contacts; only called when tracing
+    auto senderInfo = [this, &msg]() {
+      QString info = msg.senderPubKeyPrefix.toHex();
+      for (const Contact &contact : m_contacts) {
+        if (contact.publicKey().startsWith(msg.senderPubKeyPrefix)) {
+          if (!contact.name().isEmpty()) {
+            info = QString("%1 (%2)").arg(contact.name(), msg.senderPubKeyPrefix.toHex());
+          }
+          break;
         }
-        break;
       }
-    }
+      return info;
+    };
 
-    qDebug() << "Direct message received from" << senderInfo << ":" << msg.text;
+    qCTrace(lcProtocol) << "Direct message received from" << senderInfo() << ":" << msg.text;
 
-    // Save to database
-    if (m_persistenceEnabled && m_databaseManager && m_databaseManager->isOpen()) {
-      if (!m_databaseManager->saveMessage(msg, false)) {
-        qWarning() << "Failed to save direct message:" << m_databaseManager->getLastError();
-      }
-    }
+    persistMessage(msg);
+    const qint64 committedNs = LatencyMetrics::now();
 
+    m_recentMessages.insert(msg);
     emit contactMessageReceived(msg);
+    recordMessageLatency(parsedNs, committedNs);
     break;
   }
 
   default:
-    qDebug() << "Unhandled response code:" << static_cast<int>(code);
+    qCTrace(lcProtocol) << "Unhandled response code:" << static_cast<int>(code);
     break;
   }
 }
@@ -796,58 +1087,61 @@ void MeshClient::handlePushNotification(const QByteArray &frame) {
 
   switch (code) {
   case PushCode::MSG_WAITING:
-    qDebug() << "New message waiting - use syncNextMessage() to retrieve";
+    qCTrace(lcProtocol) << "New message waiting - use syncNextMessage() to retrieve";
     emit newMessageWaiting();
     break;
 
   case PushCode::SEND_CONFIRMED:
-    qDebug() << "Message send confirmed";
+    qCTrace(lcProtocol) << "Message send confirmed";
     break;
 
   case PushCode::PATH_UPDATED:
-    qDebug() << "Path updated notification";
+    qCTrace(lcProtocol) << "Path updated notification";
     break;
 
   case PushCode::LOG_RX_DATA: {
-    // Raw RX data logging - useful for debugging
+    // Raw RX data logging - useful for debugging, and the most frequent push
     if (frame.size() >= 3) {
-      int8_t snrRaw = static_cast<int8_t>(frame[1]);
-      float snr = snrRaw / 4.0f;
-      int8_t rssi = static_cast<int8_t>(frame[2]);
-      QByteArray rawData = frame.mid(3);
-
-      qDebug() << "Raw RX data logged: SNR=" << snr
-               << "dB, RSSI=" << rssi
-               << "dBm, payload=" << rawData.toHex();
+      qCTrace(lcProtocol) << "Raw RX data logged: SNR=" << static_cast<int8_t>(frame[1]) / 4.0f
+                          << "dB, RSSI=" << static_cast<int8_t>(frame[2])
+                          << "dBm, payload=" << frame.mid(3).toHex();
     }
     break;
   }
 
   default:
-    qDebug() << "Unhandled push notification:" << static_cast<int>(code);
+    qCTrace(lcProtocol) << "Unhandled push notification:" << static_cast<int>(code);
     break;
   }
 }
 
 void MeshClient::onConnectionStateChanged(ConnectionState state) {
-  qDebug() << "Connection state changed:" << static_cast<int>(state);
+  qCDebug(lcProtocol) << "Connection state changed:" << static_cast<int>(state);
 
   if (state == ConnectionState::Connected) {
     emit connected();
   } else if (state == ConnectionState::Disconnected) {
+    // The link dropped on its own (cable, BLE range); the stores belong to
+    // the device that went away
+    closeStores();
     m_initialized = false;
     m_initState = NOT_STARTED;
+    m_batteryStatus = BatteryStatus();
+    m_pendingCommands.clear();
+    m_commandTimer->stop();
+    m_syncStartNs = 0;
     emit disconnected();
   }
 }
 
 void MeshClient::onSerialError(const QString &error) {
-  qWarning() << "Serial error:" << error;
+  qCWarning(lcProtocol) << "Serial error:" << error;
+  FlightRecorder::instance().dumpOnError(QString("Transport error: %1").arg(error));
   emit errorOccurred(error);
 }
 
 void MeshClient::scanBLEDevices(bool filterMeshCoreOnly) {
-  qDebug() << "Starting BLE device scan (filter:" << filterMeshCoreOnly << ")";
+  qCDebug(lcProtocol) << "Starting BLE device scan (filter:" << filterMeshCoreOnly << ")";
 
   // Note: With Info.plist properly configured, macOS will automatically
   // prompt for Bluetooth permission when we attempt to use Bluetooth.
@@ -867,8 +1161,8 @@ void MeshClient::scanBLEDevices(bool filterMeshCoreOnly) {
   // Clean up and signal completion
   connect(bleConn, &BLEConnection::discoveryFinished, this,
           [this, bleConn]() {
-            qDebug() << "BLE discovery finished. Found" << m_bleDevices.size()
-                     << "device(s)";
+            qCDebug(lcProtocol) << "BLE discovery finished. Found" << m_bleDevices.size()
+                                << "device(s)";
             emit bleDiscoveryFinished();
             bleConn->deleteLater(); // Qt will delete after event loop
           });
@@ -876,7 +1170,7 @@ void MeshClient::scanBLEDevices(bool filterMeshCoreOnly) {
   // Handle discovery errors
   connect(bleConn, &BLEConnection::errorOccurred, this,
           [this, bleConn](const QString &error) {
-            qWarning() << "BLE discovery error:" << error;
+            qCWarning(lcProtocol) << "BLE discovery error:" << error;
             emit errorOccurred(error);
             bleConn->deleteLater();
           });
@@ -886,9 +1180,9 @@ void MeshClient::scanBLEDevices(bool filterMeshCoreOnly) {
 }
 
 void MeshClient::scanSerialPorts() {
-  qDebug() << "Scanning serial ports...";
+  qCDebug(lcProtocol) << "Scanning serial ports...";
   m_serialPorts = SerialConnection::enumeratePorts();
-  qDebug() << "Found" << m_serialPorts.size() << "serial port(s)";
+  qCDebug(lcProtocol) << "Found" << m_serialPorts.size() << "serial port(s)";
 }
 
 QList<BLEDeviceInfo> MeshClient::getDiscoveredBLEDevices() const {
@@ -903,25 +1197,176 @@ QList<SerialPortInfo> MeshClient::getAvailableSerialPorts() const {
 
 void MeshClient::enablePersistence(bool enable) {
   m_persistenceEnabled = enable;
-  qDebug() << "Persistence" << (enable ? "enabled" : "disabled");
+  qCDebug(lcProtocol) << "Persistence" << (enable ? "enabled" : "disabled");
 }
 
 QVector<Message> MeshClient::getMessageHistory(int limit, int offset) {
-  if (!m_persistenceEnabled || !m_databaseManager || !m_databaseManager->isOpen()) {
-    qWarning() << "Cannot get message history: persistence not enabled or database not open";
+  if (!m_persistenceEnabled || !m_messageStore->isOpen()) {
+    qCWarning(lcProtocol) << "Cannot get message history: persistence not enabled or database not open";
     return QVector<Message>();
   }
 
-  return m_databaseManager->loadMessages(limit, offset);
+  return m_messageStore->loadMessages(limit, offset);
 }
 
-QVector<Message> MeshClient::getChannelMessageHistory(uint8_t channelIdx, int limit) {
-  if (!m_persistenceEnabled || !m_databaseManager || !m_databaseManager->isOpen()) {
-    qWarning() << "Cannot get channel message history: persistence not enabled or database not open";
+QVector<Message> MeshClient::getChannelMessageHistory(uint8_t channelIdx, int limit,
+                                                     int offset) {
+  if (!m_persistenceEnabled || !m_messageStore->isOpen()) {
+    qCWarning(lcProtocol) << "Cannot get channel message history: persistence not enabled or database not open";
     return QVector<Message>();
   }
 
-  return m_databaseManager->loadChannelMessages(channelIdx, limit);
+  QVector<Message> messages;
+  if (m_recentMessages.channelPage(channelIdx, limit, offset, messages)) {
+    return messages;
+  }
+
+  // Channels joined after open are warmed on first use
+  if (!m_recentMessages.isChannelWarm(channelIdx)) {
+    m_recentMessages.warmChannel(
+        channelIdx,
+        m_messageStore->loadChannelMessages(channelIdx, m_recentMessages.capacity()));
+    if (m_recentMessages.channelPage(channelIdx, limit, offset, messages)) {
+      return messages;
+    }
+  }
+
+  return m_messageStore->loadChannelMessages(channelIdx, limit, offset);
+}
+
+QVector<Message> MeshClient::getDirectMessageHistory(const QByteArray &pubKeyPrefix,
+                                                    int limit, int offset) {
+  if (!m_persistenceEnabled || !m_messageStore->isOpen()) {
+    qCWarning(lcProtocol) << "Cannot get direct message history: persistence not enabled or database not open";
+    return QVector<Message>();
+  }
+
+  QVector<Message> messages;
+  if (m_recentMessages.directPage(pubKeyPrefix, limit, offset, messages)) {
+    return messages;
+  }
+
+  // Direct conversations are warmed lazily; there can be many peers
+  if (!m_recentMessages.isDirectWarm(pubKeyPrefix)) {
+    m_recentMessages.warmDirect(
+        pubKeyPrefix,
+        m_messageStore->loadDirectMessages(pubKeyPrefix, m_recentMessages.capacity()));
+    if (m_recentMessages.directPage(pubKeyPrefix, limit, offset, messages)) {
+      return messages;
+    }
+  }
+
+  return m_messageStore->loadDirectMessages(pubKeyPrefix, limit, offset);
+}
+
+void MeshClient::recordMessageLatency(qint64 parsedNs, qint64 committedNs) {
+  const qint64 doneNs = LatencyMetrics::now();
+  if (m_syncStartNs > 0) {
+    m_syncedMessages++;
+  }
+  m_metrics.record(LatencyMetrics::Parse, m_dispatchNs, parsedNs);
+  m_metrics.record(LatencyMetrics::Commit, parsedNs, committedNs);
+  m_metrics.record(LatencyMetrics::Emit, committedNs, doneNs);
+  m_metrics.record(LatencyMetrics::Total, m_frameTiming.readNs, doneNs);
+}
+
+void MeshClient::persistMessage(const Message &msg) {
+  if (!m_persistenceEnabled) {
+    return;
+  }
+
+  if (m_storesReady) {
+    if (m_messageStore->saveMessage(msg, false)) {
+      return;
+    }
+    qCWarning(lcProtocol) << "Failed to save message, journaling it:" << m_messageStore->getLastError();
+  }
+
+  if (!m_journal.appendMessage(msg)) {
+    qCWarning(lcProtocol) << "Message lost:" << m_journal.getLastError();
+  }
+}
+
+void MeshClient::persistContacts(const QVector<Contact> &contacts) {
+  if (!m_persistenceEnabled) {
+    return;
+  }
+
+  if (m_storesReady) {
+    if (m_databaseManager->saveContacts(contacts)) {
+      return;
+    }
+    qCWarning(lcProtocol) << "Failed to save contacts, journaling them:"
+                          << m_databaseManager->getLastError();
+  }
+
+  for (const Contact &contact : contacts) {
+    if (!m_journal.appendContact(contact)) {
+      qCWarning(lcProtocol) << "Contact lost:" << m_journal.getLastError();
+      return;
+    }
+  }
+}
+
+void MeshClient::persistChannel(const Channel &channel) {
+  if (!m_persistenceEnabled) {
+    return;
+  }
+
+  if (m_storesReady) {
+    if (m_databaseManager->saveChannel(channel)) {
+      return;
+    }
+    qCWarning(lcProtocol) << "Failed to save channel, journaling it:"
+                          << m_databaseManager->getLastError();
+  }
+
+  if (!m_journal.appendChannel(channel)) {
+    qCWarning(lcProtocol) << "Channel lost:" << m_journal.getLastError();
+  }
+}
+
+void MeshClient::closeStores() {
+  // Closing is a no-op for a store that is not open
+  if (m_storesReady) {
+    m_databaseManager->updateLastConnectedTime();
+  }
+  m_messageLog->closeDatabase();
+  m_databaseManager->closeDatabase();
+  m_storesReady = false;
+  m_journal.setDeviceKey(QByteArray()); // The next device is not known yet
+}
+
+void MeshClient::openMessageStore() {
+  m_messageStore = m_databaseManager;
+  if (SettingsManager::instance().getMessageStore() != "log") {
+    return;
+  }
+
+  // The log lives next to the database and opens with the same device key;
+  // contacts, channels and device info stay in the database either way
+  QString dbPath = m_databaseManager->getDatabasePath(m_selfInfo.publicKey);
+  m_messageLog->setDirectory(QFileInfo(dbPath).absolutePath());
+  if (m_messageLog->openDatabase(m_selfInfo.publicKey)) {
+    m_messageStore = m_messageLog;
+    qCDebug(lcProtocol) << "Message log opened:" << m_messageLog->getLogPath(m_selfInfo.publicKey);
+  } else {
+    qCWarning(lcProtocol) << "Failed to open message log, keeping messages in the database:"
+                          << m_messageLog->getLastError();
+  }
+}
+
+void MeshClient::warmRecentMessages() {
+  m_recentMessages.clear();
+
+  QVector<Channel> channels = m_channelManager->getChannels();
+  for (const Channel &channel : channels) {
+    m_recentMessages.warmChannel(
+        channel.index,
+        m_messageStore->loadChannelMessages(channel.index, m_recentMessages.capacity()));
+  }
+
+  qCDebug(lcProtocol) << "Warmed recent message cache for" << channels.size() << "channels";
 }
 
 } // namespace MeshCore
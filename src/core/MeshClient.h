@@ -2,8 +2,14 @@
 
 #include "ChannelManager.h"
 #include "DeviceInfo.h"
+#include "FrameArena.h"
+#include "LatencyMetrics.h"
+#include "NotificationCoalescer.h"
 #include "RadioPresets.h"
+#include "RecentMessageCache.h"
 #include <QObject>
+#include <QQueue>
+#include <QSet>
 #include <QString>
 #include <QVector>
 
@@ -14,10 +20,15 @@
 #include "../models/Channel.h"
 #include "../models/Contact.h"
 #include "../models/Message.h"
+#include "../storage/IngestJournal.h"
+
+class QTimer;
 
 namespace MeshCore {
 
 class DatabaseManager; // Forward declaration
+class IMessageStore;
+class MessageLogStore;
 
 class MeshClient : public QObject {
   Q_OBJECT
@@ -49,6 +60,11 @@ public:
   void removeContact(const QByteArray &publicKey);
   void requestContactByKey(const QByteArray &publicKey);
 
+  // How long contactsChanged/channelsChanged collect changes, 16 ms by
+  // default; 0 delivers once per turn of the event loop
+  void setUpdateInterval(int ms) { m_updates->setInterval(ms); }
+  int updateInterval() const { return m_updates->interval(); }
+
   // Advertising operations
   void sendSelfAdvert(bool floodMode = false);
   void setAdvertName(const QString &name);
@@ -64,6 +80,9 @@ public:
   void setRadioConfig(const RadioConfig &config);
   void setRadioPreset(const QString &presetName);
 
+  // Device status; the answer arrives through batteryStatusReceived()
+  void requestBatteryStatus();
+
   // Device discovery
   void scanBLEDevices(bool filterMeshCoreOnly = true);
   void scanSerialPorts();
@@ -74,15 +93,34 @@ public:
   bool isInitialized() const { return m_initialized; }
   DeviceInfo getDeviceInfo() const { return m_deviceInfo; }
   SelfInfo getSelfInfo() const { return m_selfInfo; }
+  BatteryStatus getBatteryStatus() const { return m_batteryStatus; } // Last reported
 
   // Persistence
   void enablePersistence(bool enable);
   bool isPersistenceEnabled() const { return m_persistenceEnabled; }
   DatabaseManager *databaseManager() const { return m_databaseManager; }
+  // Message history backend, chosen from settings when the device connects:
+  // the database itself, or the append-only log next to it
+  IMessageStore *messageStore() const { return m_messageStore; }
+  // Messages and contacts received while the database was unavailable
+  int pendingJournalRecords() const { return m_journal.pendingCount(); }
 
   // Message history (requires persistence)
   QVector<Message> getMessageHistory(int limit = 100, int offset = 0);
-  QVector<Message> getChannelMessageHistory(uint8_t channelIdx, int limit = 100);
+  // Newest first. Recent pages come from memory; older ones from the database.
+  QVector<Message> getChannelMessageHistory(uint8_t channelIdx, int limit = 100,
+                                            int offset = 0);
+  QVector<Message> getDirectMessageHistory(const QByteArray &pubKeyPrefix,
+                                           int limit = 100, int offset = 0);
+  RecentMessageCache::Stats recentMessageCacheStats() const {
+    return m_recentMessages.stats();
+  }
+
+  // Receive pipeline latencies, per stage, since startup or the last reset
+  const LatencyMetrics &metrics() const { return m_metrics; }
+  void resetMetrics() { m_metrics.reset(); }
+  // Scratch memory for handling one inbound frame
+  const FrameArena &frameArena() const { return m_frameArena; }
 
 signals:
   void connected();
@@ -103,6 +141,12 @@ signals:
   void contactRemoved(const QByteArray &publicKey);
   void contactsUpdated();
 
+  // Coalesced change signals for consumers that redraw: at most one per
+  // update interval, with the keys that changed since the previous one.
+  // The per-change signals above are still emitted for every change.
+  void contactsChanged(const QVector<QByteArray> &changed, const QVector<QByteArray> &removed);
+  void channelsChanged(const QVector<uint8_t> &changed, const QVector<uint8_t> &removed);
+
   // Advertisement signals
   void advertReceived(const QByteArray &publicKey);
   void newContactAdvertReceived(const Contact &contact);
@@ -117,10 +161,14 @@ signals:
   // Radio configuration signals
   void radioConfigured(const RadioConfig &config);
 
+  // Device status signals
+  void batteryStatusReceived(const BatteryStatus &status);
+
 private slots:
   void onFrameReceived(const QByteArray &frame);
   void onConnectionStateChanged(ConnectionState state);
   void onSerialError(const QString &error);
+  void onCommandTimeout();
 
 private:
   enum InitState {
@@ -132,6 +180,9 @@ private:
     COMPLETE
   };
 
+  // Sends a command and remembers it, so its round trip can be traced
+  void sendCommand(const QByteArray &cmd);
+  void completePendingCommand();
   void handleResponse(const QByteArray &frame);
   void handlePushNotification(const QByteArray &frame);
   void processInitSequence();
@@ -140,6 +191,26 @@ private:
   // Channel discovery
   void requestNextChannel();
 
+  void openMessageStore();
+  // Stamps the connection time and closes both stores; safe when closed
+  void closeStores();
+  void warmRecentMessages();
+
+  // Save to the stores when they are open, else to the ingest journal
+  void persistMessage(const Message &msg);
+  void persistContacts(const QVector<Contact> &contacts);
+  void persistChannel(const Channel &channel);
+
+  // Records the parse, commit and emit stages of the message just delivered,
+  // and counts it toward a sync drain in progress
+  void recordMessageLatency(qint64 parsedNs, qint64 committedNs);
+
+  // Reports what the containers below hold to MemoryAccounting
+  void registerMemoryFootprints();
+  void connectUpdateNotifications();
+  // Reports contacts that the device did not send again in a contact sync
+  void reportContactsMissingFromSync();
+
   IConnection *m_connection;
   bool m_ownsConnection;
   ChannelManager *m_channelManager;
@@ -148,6 +219,7 @@ private:
   InitState m_initState;
   DeviceInfo m_deviceInfo;
   SelfInfo m_selfInfo;
+  BatteryStatus m_batteryStatus;
 
   // Channel discovery state
   bool m_isDiscoveringChannels;
@@ -155,6 +227,7 @@ private:
 
   // Contact storage
   QVector<Contact> m_contacts;
+  QSet<QByteArray> m_contactsBeforeSync; // Not yet seen again in this sync
 
   // Device discovery results
   QList<SerialPortInfo> m_serialPorts;
@@ -162,7 +235,37 @@ private:
 
   // Persistence
   DatabaseManager *m_databaseManager;
+  MessageLogStore *m_messageLog;
+  IMessageStore *m_messageStore; // One of the two above
+  IngestJournal m_journal;
+  bool m_storesReady; // Stores open and the journal replayed into them
   bool m_persistenceEnabled;
+  RecentMessageCache m_recentMessages;
+
+  LatencyMetrics m_metrics;
+  FrameTiming m_frameTiming; // Of the frame being handled
+  qint64 m_dispatchNs;
+  FrameArena m_frameArena;
+
+  // Tracing: commands awaiting their response, oldest first, and the start
+  // of the init sequence, channel discovery and message sync in progress
+  struct PendingCommand {
+    uint8_t code;
+    qint64 sentNs;
+  };
+  QQueue<PendingCommand> m_pendingCommands;
+  qint64 m_initStartNs;
+  qint64 m_discoveryStartNs;
+  qint64 m_syncStartNs;
+  int m_syncedMessages;
+  QTimer *m_commandTimer; // Oldest pending command's response deadline
+  NotificationCoalescer *m_updates;
+
+  QVector<int> m_footprintIds; // MemoryAccounting registrations
+
+  static const int MAX_PENDING_COMMANDS = 32;
+  static const int COMMAND_TIMEOUT_MS = 10000;
+  static const int UPDATE_INTERVAL_MS = 16; // One display frame
 };
 
 } // namespace MeshCore
@@ -0,0 +1,301 @@
+#include "MetricsServer.h"
+#include "Logging.h"
+#include "MemoryAccounting.h"
+#include "MeshClient.h"
+#include "TelemetryCounters.h"
+#include "../storage/DatabaseManager.h"
+#include <QHostAddress>
+#include <QMutexLocker>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <memory>
+
+namespace MeshCore {
+
+namespace {
+
+void appendHeader(QByteArray &out, const char *name, const char *type, const char *help) {
+  out += "# HELP ";
+  out += name;
+  out += ' ';
+  out += help;
+  out += "\n# TYPE ";
+  out += name;
+  out += ' ';
+  out += type;
+  out += '\n';
+}
+
+void appendSample(QByteArray &out, const QByteArray &name, const QByteArray &labels,
+                  double value) {
+  out += name;
+  if (!labels.isEmpty()) {
+    out += '{' + labels + '}';
+  }
+  out += ' ';
+  out += QByteArray::number(value, 'g', 12);
+  out += '\n';
+}
+
+void appendMetric(QByteArray &out, const char *name, const char *type, const char *help,
+                  double value) {
+  appendHeader(out, name, type, help);
+  appendSample(out, name, QByteArray(), value);
+}
+
+// One sample per code seen; codes never seen are left out
+void appendPerCode(QByteArray &out, const char *name, const char *help,
+                   const std::array<TelemetryCounters::Counter, 256> &counters) {
+  appendHeader(out, name, "counter", help);
+  for (int code = 0; code < 256; ++code) {
+    const quint64 value = TelemetryCounters::read(counters[code]);
+    if (value > 0) {
+      appendSample(out, name, "code=\"" + QByteArray::number(code) + '"', double(value));
+    }
+  }
+}
+
+void appendSummary(QByteArray &out, const char *name, const char *help,
+                   const LatencyHistogram &histogram) {
+  appendHeader(out, name, "summary", help);
+  for (double quantile : {0.5, 0.9, 0.99, 0.999}) {
+    appendSample(out, name, "quantile=\"" + QByteArray::number(quantile) + '"',
+                 histogram.valueAt(quantile) / 1e9);
+  }
+  const QByteArray base(name);
+  appendSample(out, base + "_sum", QByteArray(), histogram.mean() * histogram.count() / 1e9);
+  appendSample(out, base + "_count", QByteArray(), double(histogram.count()));
+}
+
+QByteArray subsystemLabel(MemoryAccounting::Subsystem subsystem) {
+  return QByteArray("subsystem=\"") + MemoryAccounting::subsystemName(subsystem) + '"';
+}
+
+} // namespace
+
+MetricsServer::MetricsServer(MeshClient *client, QObject *parent)
+    : QObject(parent), m_client(client), m_server(new QTcpServer(this)),
+      m_batteryTimer(new QTimer(this)) {
+  connect(m_server, &QTcpServer::newConnection, this, &MetricsServer::onNewConnection);
+
+  m_batteryTimer->setInterval(BATTERY_POLL_MS);
+  connect(m_batteryTimer, &QTimer::timeout, this, &MetricsServer::onBatteryPollTimer);
+  connect(m_client, &MeshClient::initializationComplete, this, [this]() {
+    if (m_server->isListening()) {
+      onBatteryPollTimer();
+    }
+  });
+}
+
+MetricsServer::~MetricsServer() { stop(); }
+
+bool MetricsServer::start(quint16 port) {
+  stop();
+
+  if (!m_server->listen(QHostAddress::LocalHost, port)) {
+    setLastError(QString("Failed to listen on 127.0.0.1:%1: %2")
+                     .arg(port)
+                     .arg(m_server->errorString()));
+    return false;
+  }
+
+  qCDebug(lcMetrics) << "Serving metrics on http://127.0.0.1:" << m_server->serverPort()
+                     << "/metrics";
+  m_batteryTimer->start();
+  onBatteryPollTimer();
+  return true;
+}
+
+void MetricsServer::stop() {
+  m_batteryTimer->stop();
+  if (m_server->isListening()) {
+    m_server->close();
+    qCDebug(lcMetrics) << "Metrics server stopped";
+  }
+}
+
+bool MetricsServer::isListening() const { return m_server->isListening(); }
+
+quint16 MetricsServer::port() const { return m_server->serverPort(); }
+
+void MetricsServer::onNewConnection() {
+  while (QTcpSocket *socket = m_server->nextPendingConnection()) {
+    connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+
+    // Answered once the headers are complete; the body of a GET is ignored
+    auto request = std::make_shared<QByteArray>();
+    connect(socket, &QTcpSocket::readyRead, this, [this, socket, request]() {
+      request->append(socket->readAll());
+      if (request->contains("\r\n\r\n") || request->contains("\n\n")) {
+        handleRequest(socket, *request);
+        request->clear();
+      } else if (request->size() > MAX_REQUEST_BYTES) {
+        socket->abort();
+      }
+    });
+  }
+}
+
+void MetricsServer::handleRequest(QTcpSocket *socket, const QByteArray &request) {
+  MemoryScope memory(MemoryAccounting::Diagnostics);
+  const QList<QByteArray> requestLine =
+      request.left(request.indexOf('\n')).trimmed().split(' ');
+  const QByteArray method = requestLine.value(0);
+  const QByteArray path = requestLine.value(1);
+
+  QByteArray status = "200 OK";
+  QByteArray contentType = "text/plain; version=0.0.4; charset=utf-8";
+  QByteArray body;
+  if (method != "GET" && method != "HEAD") {
+    status = "405 Method Not Allowed";
+    contentType = "text/plain; charset=utf-8";
+    body = "Only GET is supported\n";
+  } else if (path == "/metrics" || path.startsWith("/metrics?")) {
+    body = renderMetrics();
+  } else {
+    status = "404 Not Found";
+    contentType = "text/plain; charset=utf-8";
+    body = "Metrics are served at /metrics\n";
+  }
+
+  QByteArray response = "HTTP/1.1 " + status + "\r\nContent-Type: " + contentType +
+                        "\r\nContent-Length: " + QByteArray::number(body.size()) +
+                        "\r\nConnection: close\r\n\r\n";
+  if (method != "HEAD") {
+    response += body;
+  }
+  socket->write(response);
+  socket->disconnectFromHost(); // After the write has been flushed
+}
+
+QByteArray MetricsServer::renderMetrics() const {
+  const TelemetryCounters &counters = TelemetryCounters::instance();
+  QByteArray out;
+  out.reserve(8192);
+
+  appendMetric(out, "meshcore_connected", "gauge", "1 while a device is connected",
+               m_client->isConnected() ? 1 : 0);
+
+  // Transport
+  appendPerCode(out, "meshcore_frames_received_total", "Frames from the device by code",
+                counters.framesIn);
+  appendPerCode(out, "meshcore_frames_sent_total", "Frames to the device by command code",
+                counters.framesOut);
+  appendMetric(out, "meshcore_received_bytes_total", "counter", "Frame bytes from the device",
+               double(TelemetryCounters::read(counters.bytesIn)));
+  appendMetric(out, "meshcore_sent_bytes_total", "counter", "Frame bytes to the device",
+               double(TelemetryCounters::read(counters.bytesOut)));
+  appendMetric(out, "meshcore_parse_errors_total", "counter",
+               "Frames too short for their response code",
+               double(TelemetryCounters::read(counters.parseErrors)));
+
+  // Storage
+  const quint64 stored = TelemetryCounters::read(counters.messagesStored);
+  const quint64 duplicates = TelemetryCounters::read(counters.duplicatesSkipped);
+  appendMetric(out, "meshcore_messages_stored_total", "counter",
+               "Messages written to the message store", double(stored));
+  appendMetric(out, "meshcore_duplicates_skipped_total", "counter",
+               "Messages not written because they were already stored", double(duplicates));
+  appendMetric(out, "meshcore_dedup_hit_ratio", "gauge",
+               "Share of message saves that were duplicates",
+               stored + duplicates > 0 ? double(duplicates) / (stored + duplicates) : 0.0);
+  appendSummary(out, "meshcore_message_commit_seconds",
+                "Time to save a received message to the store or journal",
+                m_client->metrics().stage(LatencyMetrics::Commit));
+  appendSummary(out, "meshcore_message_receive_seconds",
+                "Time from the transport read to the message signal being handled",
+                m_client->metrics().stage(LatencyMetrics::Total));
+
+  // Queue depths
+  appendMetric(out, "meshcore_journal_pending_records", "gauge",
+               "Messages and contacts waiting in the ingest journal",
+               m_client->pendingJournalRecords());
+  DatabaseManager *db = m_client->databaseManager();
+  if (db && db->isOpen()) {
+    appendMetric(out, "meshcore_wal_bytes", "gauge",
+                 "Size of the write-ahead log not yet checkpointed",
+                 double(db->walStats().walBytes));
+  }
+
+  // Device
+  appendMetric(out, "meshcore_contacts", "gauge", "Contacts known to the client",
+               m_client->getContacts().size());
+  appendMetric(out, "meshcore_channels", "gauge", "Channels known to the client",
+               m_client->getChannels().size());
+  const BatteryStatus battery = m_client->getBatteryStatus();
+  if (battery.isValid) {
+    appendMetric(out, "meshcore_battery_volts", "gauge", "Device battery voltage",
+                 battery.milliVolts / 1000.0);
+    appendMetric(out, "meshcore_device_storage_used_bytes", "gauge",
+                 "Device flash storage in use", battery.storageUsedKb * 1024.0);
+    if (battery.storageTotalKb > 0) {
+      appendMetric(out, "meshcore_device_storage_total_bytes", "gauge",
+                   "Device flash storage size", battery.storageTotalKb * 1024.0);
+    }
+  }
+
+  // Memory
+  const qint64 resident = MemoryAccounting::residentBytes();
+  if (resident > 0) {
+    appendMetric(out, "meshcore_process_resident_bytes", "gauge", "Resident set size",
+                 double(resident));
+  }
+  appendHeader(out, "meshcore_memory_footprint_bytes", "gauge",
+               "Estimated bytes held by long-lived containers");
+  const QVector<MemoryAccounting::Footprint> footprints =
+      MemoryAccounting::instance().footprints();
+  for (const MemoryAccounting::Footprint &footprint : footprints) {
+    appendSample(out, "meshcore_memory_footprint_bytes",
+                 subsystemLabel(footprint.subsystem) + ",name=\"" + footprint.name + '"',
+                 double(footprint.bytes));
+  }
+  if (MemoryAccounting::heapCountingEnabled()) {
+    QVector<MemoryAccounting::HeapStats> heap;
+    for (int i = 0; i < MemoryAccounting::SubsystemCount; ++i) {
+      heap.append(MemoryAccounting::heapStats(static_cast<MemoryAccounting::Subsystem>(i)));
+    }
+    auto label = [](int i) {
+      return subsystemLabel(static_cast<MemoryAccounting::Subsystem>(i));
+    };
+    appendHeader(out, "meshcore_heap_live_bytes", "gauge",
+                 "Heap bytes allocated with operator new and not yet freed");
+    for (int i = 0; i < heap.size(); ++i) {
+      appendSample(out, "meshcore_heap_live_bytes", label(i), double(heap[i].liveBytes()));
+    }
+    appendHeader(out, "meshcore_heap_allocations_total", "counter",
+                 "Allocations made with operator new");
+    for (int i = 0; i < heap.size(); ++i) {
+      appendSample(out, "meshcore_heap_allocations_total", label(i),
+                   double(heap[i].allocations));
+    }
+    appendHeader(out, "meshcore_heap_allocated_bytes_total", "counter",
+                 "Bytes allocated with operator new");
+    for (int i = 0; i < heap.size(); ++i) {
+      appendSample(out, "meshcore_heap_allocated_bytes_total", label(i),
+                   double(heap[i].bytesAllocated));
+    }
+  }
+
+  return out;
+}
+
+void MetricsServer::onBatteryPollTimer() {
+  // No error when there is no device to ask; the gauges are just absent
+  if (m_client->isConnected() && m_client->isInitialized()) {
+    m_client->requestBatteryStatus();
+  }
+}
+
+QString MetricsServer::getLastError() const {
+  QMutexLocker locker(&m_errorMutex);
+  return m_lastError;
+}
+
+void MetricsServer::setLastError(const QString &error) {
+  QMutexLocker locker(&m_errorMutex);
+  m_lastError = error;
+  qCWarning(lcMetrics) << "MetricsServer:" << error;
+}
+
+} // namespace MeshCore
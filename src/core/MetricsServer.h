@@ -0,0 +1,58 @@
+#pragma once
+
+#include <QByteArray>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+
+class QTcpServer;
+class QTcpSocket;
+class QTimer;
+
+namespace MeshCore {
+
+class MeshClient;
+
+// Serves a metrics page in the Prometheus text format over HTTP on the
+// loopback interface, for headless gateways. The page is rendered on demand
+// from the telemetry counters, the client's latency histograms and a few
+// live gauges, so nothing is collected unless it is scraped. While running
+// it also polls the device's battery and storage once a minute.
+class MetricsServer : public QObject {
+  Q_OBJECT
+
+public:
+  explicit MetricsServer(MeshClient *client, QObject *parent = nullptr);
+  ~MetricsServer();
+
+  // Binds 127.0.0.1 only; port 0 picks a free one
+  bool start(quint16 port);
+  void stop();
+  bool isListening() const;
+  quint16 port() const;
+
+  // Body of GET /metrics
+  QByteArray renderMetrics() const;
+
+  QString getLastError() const;
+
+private slots:
+  void onNewConnection();
+  void onBatteryPollTimer();
+
+private:
+  void handleRequest(QTcpSocket *socket, const QByteArray &request);
+  void setLastError(const QString &error);
+
+  MeshClient *m_client;
+  QTcpServer *m_server;
+  QTimer *m_batteryTimer;
+
+  mutable QMutex m_errorMutex;
+  QString m_lastError;
+
+  static const int MAX_REQUEST_BYTES = 8192;
+  static const int BATTERY_POLL_MS = 60000;
+};
+
+} // namespace MeshCore
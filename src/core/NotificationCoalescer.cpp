@@ -0,0 +1,72 @@
+#include "NotificationCoalescer.h"
+#include <QTimer>
+
+namespace MeshCore {
+
+NotificationCoalescer::NotificationCoalescer(QObject *parent)
+    : QObject(parent), m_timer(new QTimer(this)), m_changesReceived(0),
+      m_batchesDelivered(0) {
+  m_timer->setSingleShot(true);
+  m_timer->setInterval(0);
+  connect(m_timer, &QTimer::timeout, this, &NotificationCoalescer::flush);
+}
+
+void NotificationCoalescer::setInterval(int ms) { m_timer->setInterval(qMax(0, ms)); }
+
+int NotificationCoalescer::interval() const { return m_timer->interval(); }
+
+void NotificationCoalescer::contactChanged(const QByteArray &publicKey) {
+  m_removedContacts.remove(publicKey);
+  m_changedContacts.insert(publicKey);
+  schedule();
+}
+
+void NotificationCoalescer::contactRemoved(const QByteArray &publicKey) {
+  m_changedContacts.remove(publicKey);
+  m_removedContacts.insert(publicKey);
+  schedule();
+}
+
+void NotificationCoalescer::channelChanged(uint8_t index) {
+  m_removedChannels.remove(index);
+  m_changedChannels.insert(index);
+  schedule();
+}
+
+void NotificationCoalescer::channelRemoved(uint8_t index) {
+  m_changedChannels.remove(index);
+  m_removedChannels.insert(index);
+  schedule();
+}
+
+void NotificationCoalescer::schedule() {
+  m_changesReceived++;
+  // Started by the first change of a batch; later ones do not push it back
+  if (!m_timer->isActive()) {
+    m_timer->start();
+  }
+}
+
+void NotificationCoalescer::flush() {
+  m_timer->stop();
+
+  // Taken before emitting, so changes made by receivers start a new batch
+  const bool contacts = !m_changedContacts.isEmpty() || !m_removedContacts.isEmpty();
+  const bool channels = !m_changedChannels.isEmpty() || !m_removedChannels.isEmpty();
+  const QVector<QByteArray> changedContacts = m_changedContacts.take();
+  const QVector<QByteArray> removedContacts = m_removedContacts.take();
+  const QVector<uint8_t> changedChannels = m_changedChannels.take();
+  const QVector<uint8_t> removedChannels = m_removedChannels.take();
+
+  if (contacts || channels) {
+    m_batchesDelivered++;
+  }
+  if (contacts) {
+    emit contactsChanged(changedContacts, removedContacts);
+  }
+  if (channels) {
+    emit channelsChanged(changedChannels, removedChannels);
+  }
+}
+
+} // namespace MeshCore
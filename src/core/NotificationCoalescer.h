@@ -0,0 +1,86 @@
+#pragma once
+
+#include <QByteArray>
+#include <QObject>
+#include <QSet>
+#include <QVector>
+
+#include <utility>
+
+class QTimer;
+
+namespace MeshCore {
+
+// Batches contact and channel change notifications for consumers that
+// redraw on them. Changes are collected and delivered as one signal per
+// interval carrying the keys that changed, instead of one signal per
+// change: a contact sync of n contacts costs such a consumer one redraw per
+// batch rather than n redraws of a growing list.
+//
+// With an interval of 0 a batch is delivered on the next turn of the event
+// loop, so everything handled in one turn (all the frames from one serial
+// read) is one batch. A longer interval caps the rate, e.g. 16 ms for one
+// update per display frame. A key is reported once per batch; a contact
+// changed and then removed within a batch is reported as removed only.
+class NotificationCoalescer : public QObject {
+  Q_OBJECT
+
+public:
+  explicit NotificationCoalescer(QObject *parent = nullptr);
+
+  void setInterval(int ms);
+  int interval() const;
+
+  void contactChanged(const QByteArray &publicKey);
+  void contactRemoved(const QByteArray &publicKey);
+  void channelChanged(uint8_t index);
+  void channelRemoved(uint8_t index);
+
+  // Delivers what is pending now instead of when the interval ends
+  void flush();
+
+  quint64 changesReceived() const { return m_changesReceived; }
+  quint64 batchesDelivered() const { return m_batchesDelivered; }
+
+signals:
+  void contactsChanged(const QVector<QByteArray> &changed, const QVector<QByteArray> &removed);
+  void channelsChanged(const QVector<uint8_t> &changed, const QVector<uint8_t> &removed);
+
+private:
+  // Keys in the order they first changed, each once
+  template <typename Key> class KeySet {
+  public:
+    void insert(const Key &key) {
+      if (!m_seen.contains(key)) {
+        m_seen.insert(key);
+        m_keys.append(key);
+      }
+    }
+    void remove(const Key &key) {
+      if (m_seen.remove(key)) {
+        m_keys.removeOne(key);
+      }
+    }
+    bool isEmpty() const { return m_keys.isEmpty(); }
+    QVector<Key> take() {
+      m_seen.clear();
+      return std::exchange(m_keys, QVector<Key>());
+    }
+
+  private:
+    QVector<Key> m_keys;
+    QSet<Key> m_seen;
+  };
+
+  void schedule();
+
+  QTimer *m_timer;
+  KeySet<QByteArray> m_changedContacts;
+  KeySet<QByteArray> m_removedContacts;
+  KeySet<uint8_t> m_changedChannels;
+  KeySet<uint8_t> m_removedChannels;
+  quint64 m_changesReceived;
+  quint64 m_batchesDelivered;
+};
+
+} // namespace MeshCore
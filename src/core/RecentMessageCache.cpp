@@ -0,0 +1,157 @@
+#include "RecentMessageCache.h"
+#include "MemoryAccounting.h"
+
+#include <utility>
+
+namespace MeshCore {
+
+namespace {
+
+bool sameMessage(const Message &a, const Message &b) {
+  return a.timestamp == b.timestamp && a.senderName == b.senderName &&
+         a.senderPubKeyPrefix == b.senderPubKeyPrefix && a.text == b.text;
+}
+
+} // namespace
+
+RecentMessageCache::RecentMessageCache(int capacity)
+    : m_capacity(capacity > 0 ? capacity : 1) {}
+
+void RecentMessageCache::insert(const Message &message) {
+  MemoryScope memory(MemoryAccounting::Caches);
+  Ring *ring = nullptr;
+  if (message.type == Message::CHANNEL_MESSAGE) {
+    auto it = m_channels.find(message.channelIdx);
+    ring = it != m_channels.end() ? &it.value() : nullptr;
+  } else {
+    auto it = m_direct.find(message.senderPubKeyPrefix);
+    ring = it != m_direct.end() ? &it.value() : nullptr;
+  }
+
+  if (ring) {
+    insertInto(*ring, message);
+  }
+}
+
+void RecentMessageCache::warmChannel(uint8_t channelIdx,
+                                     const QVector<Message> &newestFirst) {
+  MemoryScope memory(MemoryAccounting::Caches);
+  m_channels.insert(channelIdx, makeRing(newestFirst));
+}
+
+void RecentMessageCache::warmDirect(const QByteArray &pubKeyPrefix,
+                                    const QVector<Message> &newestFirst) {
+  MemoryScope memory(MemoryAccounting::Caches);
+  m_direct.insert(pubKeyPrefix, makeRing(newestFirst));
+}
+
+bool RecentMessageCache::isChannelWarm(uint8_t channelIdx) const {
+  return m_channels.contains(channelIdx);
+}
+
+bool RecentMessageCache::isDirectWarm(const QByteArray &pubKeyPrefix) const {
+  return m_direct.contains(pubKeyPrefix);
+}
+
+bool RecentMessageCache::channelPage(uint8_t channelIdx, int limit, int offset,
+                                     QVector<Message> &out) {
+  auto it = m_channels.constFind(channelIdx);
+  return page(it != m_channels.constEnd() ? &it.value() : nullptr, limit, offset, out);
+}
+
+bool RecentMessageCache::directPage(const QByteArray &pubKeyPrefix, int limit, int offset,
+                                    QVector<Message> &out) {
+  auto it = m_direct.constFind(pubKeyPrefix);
+  return page(it != m_direct.constEnd() ? &it.value() : nullptr, limit, offset, out);
+}
+
+void RecentMessageCache::clear() {
+  m_channels.clear();
+  m_direct.clear();
+}
+
+qint64 RecentMessageCache::memoryUsage() const {
+  auto ringBytes = [](const Ring &ring) {
+    qint64 bytes =
+        sizeof(Ring) + (ring.slots.capacity() - ring.count) * qint64(sizeof(Message));
+    for (int i = 0; i < ring.count; ++i) {
+      bytes += ring.at(i).memoryUsage();
+    }
+    return bytes;
+  };
+
+  qint64 bytes = sizeof(RecentMessageCache);
+  for (const Ring &ring : m_channels) {
+    bytes += ringBytes(ring);
+  }
+  for (auto it = m_direct.cbegin(); it != m_direct.cend(); ++it) {
+    bytes += it.key().capacity() + ringBytes(it.value());
+  }
+  return bytes;
+}
+
+RecentMessageCache::Ring RecentMessageCache::makeRing(
+    const QVector<Message> &newestFirst) const {
+  Ring ring;
+  ring.slots.resize(m_capacity);
+
+  int count = qMin(static_cast<int>(newestFirst.size()), m_capacity);
+  for (int i = 0; i < count; ++i) {
+    ring.slots[i] = newestFirst[count - 1 - i];
+  }
+  ring.count = count;
+  // Callers load a full window; a short result means there is no more history
+  ring.complete = newestFirst.size() < m_capacity;
+  return ring;
+}
+
+void RecentMessageCache::insertInto(Ring &ring, const Message &message) {
+  // Messages mostly arrive in timestamp order, so the scan is usually one step
+  int pos = ring.count;
+  while (pos > 0 && ring.at(pos - 1).timestamp > message.timestamp) {
+    --pos;
+  }
+  for (int i = pos - 1; i >= 0 && ring.at(i).timestamp == message.timestamp; --i) {
+    if (sameMessage(ring.at(i), message)) {
+      return; // Re-delivered duplicate
+    }
+  }
+
+  if (ring.count == m_capacity) {
+    if (pos == 0) {
+      return; // Older than the whole window
+    }
+    // Drop the oldest to make room
+    ring.head = (ring.head + 1) % m_capacity;
+    ring.count--;
+    ring.complete = false;
+    pos--;
+  }
+
+  // Shift newer messages up one slot and place the new one
+  for (int i = ring.count; i > pos; --i) {
+    ring.at(i) = std::move(ring.at(i - 1));
+  }
+  ring.at(pos) = message;
+  ring.count++;
+}
+
+bool RecentMessageCache::page(const Ring *ring, int limit, int offset,
+                              QVector<Message> &out) {
+  if (!ring || (offset + limit > ring->count && !ring->complete)) {
+    m_stats.misses++;
+    return false;
+  }
+
+  out.clear();
+  int end = qMin(offset + limit, ring->count);
+  out.reserve(qMax(end - offset, 0));
+  for (int i = offset; i < end; ++i) {
+    out.append(ring->at(ring->count - 1 - i));
+  }
+
+  m_stats.hits++;
+  return true;
+}
+
+} // namespace MeshCore
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QVector>
+
+#include "../models/Message.h"
+
+namespace MeshCore {
+
+// Fixed-size rings of the newest messages per channel and per direct-message
+// peer, ordered by message timestamp. Recent-history reads are answered from
+// here; only pages beyond a ring's window go to the database.
+class RecentMessageCache {
+public:
+  struct Stats {
+    quint64 hits = 0;
+    quint64 misses = 0;
+
+    double hitRate() const {
+      quint64 total = hits + misses;
+      return total ? static_cast<double>(hits) / total : 0.0;
+    }
+  };
+
+  explicit RecentMessageCache(int capacity = 256);
+
+  int capacity() const { return m_capacity; }
+
+  // Adds a message from the receive path. Ignored for conversations that
+  // have not been warmed, since the ring would not hold the newest window.
+  void insert(const Message &message);
+
+  // Seeds a conversation from the newest rows in the database, newest
+  // first as returned by the history queries.
+  void warmChannel(uint8_t channelIdx, const QVector<Message> &newestFirst);
+  void warmDirect(const QByteArray &pubKeyPrefix, const QVector<Message> &newestFirst);
+
+  bool isChannelWarm(uint8_t channelIdx) const;
+  bool isDirectWarm(const QByteArray &pubKeyPrefix) const;
+
+  // Newest-first page. Returns false (a miss) when the page reaches past
+  // what the ring holds and older rows may exist in the database.
+  bool channelPage(uint8_t channelIdx, int limit, int offset, QVector<Message> &out);
+  bool directPage(const QByteArray &pubKeyPrefix, int limit, int offset,
+                  QVector<Message> &out);
+
+  void clear();
+  Stats stats() const { return m_stats; }
+  qint64 memoryUsage() const; // Rings, their messages and the hash tables
+
+private:
+  struct Ring {
+    QVector<Message> slots;
+    int head = 0;          // Index of the oldest message
+    int count = 0;
+    bool complete = false; // Holds every message of the conversation
+
+    Message &at(int logical) { return slots[(head + logical) % slots.size()]; }
+    const Message &at(int logical) const {
+      return slots[(head + logical) % slots.size()];
+    }
+  };
+
+  Ring makeRing(const QVector<Message> &newestFirst) const;
+  void insertInto(Ring &ring, const Message &message);
+  bool page(const Ring *ring, int limit, int offset, QVector<Message> &out);
+
+  int m_capacity;
+  QHash<uint8_t, Ring> m_channels;
+  QHash<QByteArray, Ring> m_direct; // Keyed by sender public key prefix
+  Stats m_stats;
+};
+
+} // namespace MeshCore
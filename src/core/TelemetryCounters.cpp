@@ -0,0 +1,10 @@
+#include "TelemetryCounters.h"
+
+namespace MeshCore {
+
+TelemetryCounters &TelemetryCounters::instance() {
+  static TelemetryCounters counters;
+  return counters;
+}
+
+} // namespace MeshCore
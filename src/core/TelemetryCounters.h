@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QByteArray>
+
+#include <array>
+#include <atomic>
+
+namespace MeshCore {
+
+// Process-wide counters bumped on the transport, protocol and storage paths
+// and read by MetricsServer. Relaxed atomics: an increment never takes a
+// lock or waits for a reader, whichever thread it runs on.
+struct TelemetryCounters {
+  using Counter = std::atomic<quint64>;
+
+  std::array<Counter, 256> framesIn{};  // By response or push code
+  std::array<Counter, 256> framesOut{}; // By command code
+  Counter bytesIn{0};
+  Counter bytesOut{0};
+  Counter parseErrors{0};       // Frames too short for their code
+  Counter messagesStored{0};    // New rows in either message store
+  Counter duplicatesSkipped{0}; // Saves dropped as already stored
+
+  static TelemetryCounters &instance();
+
+  static void add(Counter &counter, quint64 n = 1) {
+    counter.fetch_add(n, std::memory_order_relaxed);
+  }
+  static quint64 read(const Counter &counter) {
+    return counter.load(std::memory_order_relaxed);
+  }
+
+  // The first byte of a frame is its code
+  void countFrameIn(const QByteArray &frame) {
+    add(framesIn[frame.isEmpty() ? 0 : static_cast<quint8>(frame[0])]);
+    add(bytesIn, static_cast<quint64>(frame.size()));
+  }
+  void countFrameOut(const QByteArray &frame) {
+    add(framesOut[frame.isEmpty() ? 0 : static_cast<quint8>(frame[0])]);
+    add(bytesOut, static_cast<quint64>(frame.size()));
+  }
+};
+
+} // namespace MeshCore
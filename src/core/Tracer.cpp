@@ -0,0 +1,181 @@
+#include "Tracer.h"
+#include "MemoryAccounting.h"
+
+#include <QCoreApplication>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QThread>
+
+namespace MeshCore {
+
+namespace {
+
+// Category and name literals are ours, but thread names are not
+QByteArray jsonString(const QString &text) {
+  QByteArray out = "\"";
+  for (QChar c : text) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += char(c.unicode());
+    } else if (c.unicode() < 0x20) {
+      out += "\\u" + QByteArray::number(c.unicode(), 16).rightJustified(4, '0');
+    } else {
+      out += QString(c).toUtf8();
+    }
+  }
+  return out + '"';
+}
+
+} // namespace
+
+Tracer &Tracer::instance() {
+  static Tracer tracer;
+  return tracer;
+}
+
+Tracer::Tracer() : m_enabled(true), m_events(CAPACITY), m_written(0) {
+  MemoryAccounting::instance().addFootprint(MemoryAccounting::Diagnostics, "trace ring",
+                                            [this]() { return memoryUsage(); });
+}
+
+int Tracer::currentThreadId() {
+  const Qt::HANDLE handle = QThread::currentThreadId();
+  auto it = m_threadIds.constFind(handle);
+  if (it != m_threadIds.constEnd()) {
+    return it.value();
+  }
+
+  const int id = m_threadIds.size() + 1;
+  m_threadIds.insert(handle, id);
+
+  QThread *thread = QThread::currentThread();
+  QString name = thread ? thread->objectName() : QString();
+  if (QCoreApplication::instance() && thread == QCoreApplication::instance()->thread()) {
+    name = QStringLiteral("main");
+  } else if (name.isEmpty()) {
+    name = QString("thread %1").arg(id);
+  }
+  m_threadNames.insert(id, name);
+  return id;
+}
+
+void Tracer::record(const char *category, const char *name, qint64 startNs, qint64 endNs,
+                    const char *argName, qint64 arg) {
+  if (!isEnabled() || startNs <= 0) {
+    return;
+  }
+
+  QMutexLocker locker(&m_mutex);
+  Event &event = m_events[m_written % m_events.size()];
+  event.category = category;
+  event.name = name;
+  event.argName = argName;
+  event.startNs = startNs;
+  event.durationNs = qMax<qint64>(0, endNs - startNs);
+  event.arg = arg;
+  event.threadId = currentThreadId();
+  m_written++;
+}
+
+int Tracer::eventCount() const {
+  QMutexLocker locker(&m_mutex);
+  return static_cast<int>(qMin<quint64>(m_written, m_events.size()));
+}
+
+void Tracer::clear() {
+  QMutexLocker locker(&m_mutex);
+  m_written = 0;
+}
+
+qint64 Tracer::memoryUsage() const {
+  QMutexLocker locker(&m_mutex);
+  qint64 bytes = qint64(m_events.capacity()) * sizeof(Event);
+  for (const QString &name : m_threadNames) {
+    bytes += name.capacity() * qint64(sizeof(QChar));
+  }
+  return bytes;
+}
+
+QByteArray Tracer::toChromeJson() const {
+  // Copied out so recording is not held up while the JSON is built
+  std::vector<Event> events;
+  QHash<int, QString> threadNames;
+  {
+    QMutexLocker locker(&m_mutex);
+    const quint64 count = qMin<quint64>(m_written, m_events.size());
+    events.reserve(count);
+    for (quint64 i = m_written - count; i < m_written; ++i) {
+      events.push_back(m_events[i % m_events.size()]);
+    }
+    threadNames = m_threadNames;
+  }
+
+  QByteArray out;
+  out.reserve(static_cast<int>(events.size()) * 128 + 256);
+  out += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+  bool first = true;
+  for (auto it = threadNames.cbegin(); it != threadNames.cend(); ++it) {
+    out += first ? "" : ",\n";
+    out += "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" +
+           QByteArray::number(it.key()) + ",\"args\":{\"name\":" + jsonString(it.value()) +
+           "}}";
+    first = false;
+  }
+
+  // Microseconds relative to the earliest start keep the numbers short.
+  // Spans are stored as they end, so the first one need not start first.
+  qint64 originNs = events.empty() ? 0 : events.front().startNs;
+  for (const Event &event : events) {
+    originNs = qMin(originNs, event.startNs);
+  }
+  for (const Event &event : events) {
+    out += first ? "" : ",\n";
+    out += "{\"ph\":\"X\",\"pid\":1,\"tid\":";
+    out += QByteArray::number(event.threadId);
+    out += ",\"cat\":\"";
+    out += event.category;
+    out += "\",\"name\":\"";
+    out += event.name;
+    out += "\",\"ts\":";
+    out += QByteArray::number((event.startNs - originNs) / 1000.0, 'f', 3);
+    out += ",\"dur\":";
+    out += QByteArray::number(event.durationNs / 1000.0, 'f', 3);
+    if (event.argName) {
+      out += ",\"args\":{\"";
+      out += event.argName;
+      out += "\":";
+      out += QByteArray::number(event.arg);
+      out += '}';
+    }
+    out += '}';
+    first = false;
+  }
+
+  out += "\n]}\n";
+  return out;
+}
+
+bool Tracer::writeChromeJson(const QString &path) {
+  QSaveFile file(path);
+  if (!file.open(QIODevice::WriteOnly)) {
+    QMutexLocker locker(&m_mutex);
+    m_lastError = QString("Failed to open %1: %2").arg(path, file.errorString());
+    return false;
+  }
+
+  const QByteArray json = toChromeJson();
+  if (file.write(json) != json.size() || !file.commit()) {
+    QMutexLocker locker(&m_mutex);
+    m_lastError = QString("Failed to write %1: %2").arg(path, file.errorString());
+    return false;
+  }
+  return true;
+}
+
+QString Tracer::getLastError() const {
+  QMutexLocker locker(&m_mutex);
+  return m_lastError;
+}
+
+} // namespace MeshCore
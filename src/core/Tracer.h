@@ -0,0 +1,103 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+#include <atomic>
+#include <vector>
+
+#include "LatencyMetrics.h"
+
+namespace MeshCore {
+
+// Ring buffer of timed spans (command round trips, init steps, sync drains,
+// database transactions, CLI rendering) that can be written out as a Chrome
+// trace-event file and opened in Perfetto or chrome://tracing. Holds the
+// newest capacity() spans; older ones are overwritten.
+//
+// Recording a span is two clock reads and a short critical section, so it
+// stays on by default; when disabled, a span costs one atomic load.
+// Category and name strings must be literals (they are stored as pointers).
+// Safe to use from any thread.
+class Tracer {
+public:
+  static Tracer &instance();
+
+  void setEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+  bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+  // Times in LatencyMetrics::now() nanoseconds. argName may be null.
+  void record(const char *category, const char *name, qint64 startNs, qint64 endNs,
+              const char *argName = nullptr, qint64 arg = 0);
+
+  int capacity() const { return static_cast<int>(m_events.size()); }
+  int eventCount() const;
+  void clear();
+  qint64 memoryUsage() const;
+
+  // {"traceEvents": [...]}, in the order the spans ended
+  QByteArray toChromeJson() const;
+  bool writeChromeJson(const QString &path);
+
+  QString getLastError() const;
+
+private:
+  Tracer();
+  Tracer(const Tracer &) = delete;
+  Tracer &operator=(const Tracer &) = delete;
+
+  struct Event {
+    const char *category = nullptr;
+    const char *name = nullptr;
+    const char *argName = nullptr;
+    qint64 startNs = 0;
+    qint64 durationNs = 0;
+    qint64 arg = 0;
+    int threadId = 0;
+  };
+
+  int currentThreadId(); // Caller holds m_mutex
+
+  std::atomic<bool> m_enabled;
+  mutable QMutex m_mutex;
+  std::vector<Event> m_events;
+  quint64 m_written; // Total recorded; the next slot is m_written % capacity
+  QHash<Qt::HANDLE, int> m_threadIds;
+  QHash<int, QString> m_threadNames;
+  QString m_lastError;
+
+  static const int CAPACITY = 32768;
+};
+
+// Records the span from construction to destruction
+class TraceScope {
+public:
+  TraceScope(const char *category, const char *name)
+      : m_category(category), m_name(name), m_argName(nullptr), m_arg(0),
+        m_startNs(Tracer::instance().isEnabled() ? LatencyMetrics::now() : 0) {}
+  ~TraceScope() {
+    if (m_startNs > 0) {
+      Tracer::instance().record(m_category, m_name, m_startNs, LatencyMetrics::now(),
+                                m_argName, m_arg);
+    }
+  }
+
+  void setArg(const char *name, qint64 value) {
+    m_argName = name;
+    m_arg = value;
+  }
+
+private:
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+
+  const char *m_category;
+  const char *m_name;
+  const char *m_argName;
+  qint64 m_arg;
+  qint64 m_startNs;
+};
+
+} // namespace MeshCore
@@ -37,6 +37,10 @@ bool Channel::isEmpty() const {
 
 bool Channel::isValidChannel() const { return !isEmpty(); }
 
+qint64 Channel::memoryUsage() const {
+  return sizeof(Channel) + name.capacity() * qint64(sizeof(QChar)) + secret.capacity();
+}
+
 bool Channel::operator==(const Channel &other) const {
   return index == other.index && name == other.name && secret == other.secret &&
          isValid == other.isValid;
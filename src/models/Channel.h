@@ -23,6 +23,7 @@ public:
   // Validation
   bool isEmpty() const;
   bool isValidChannel() const;
+  qint64 memoryUsage() const; // Including the string and byte buffers
 
   bool operator==(const Channel &other) const;
 };
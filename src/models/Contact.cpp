@@ -45,6 +45,11 @@ QString Contact::publicKeyHex() const {
   return QString::fromLatin1(m_publicKey.toHex());
 }
 
+qint64 Contact::memoryUsage() const {
+  return sizeof(Contact) + m_publicKey.capacity() + m_name.capacity() * qint64(sizeof(QChar)) +
+         m_path.capacity();
+}
+
 bool Contact::operator==(const Contact &other) const {
   return m_publicKey == other.m_publicKey;
 }
@@ -35,6 +35,7 @@ public:
   // Utility methods
   bool isValid() const;
   QString publicKeyHex() const;
+  qint64 memoryUsage() const; // Including the string and byte buffers
 
   // Equality comparison (by public key)
   bool operator==(const Contact &other) const;
@@ -1,4 +1,5 @@
 #include "Message.h"
+#include <algorithm>
 
 namespace MeshCore {
 
@@ -6,6 +7,11 @@ Message::Message()
     : type(CHANNEL_MESSAGE), channelIdx(0), timestamp(0), pathLen(0xFF),
       pathLength(0xFF), txtType(0), snr(0.0f) {}
 
+qint64 Message::memoryUsage() const {
+  return sizeof(Message) + senderPubKeyPrefix.capacity() +
+         (senderName.capacity() + text.capacity()) * qint64(sizeof(QChar));
+}
+
 Message Message::fromChannelRecv(uint8_t channelIdx, const QString &fullText,
                                  uint32_t timestamp, uint8_t pathLen,
                                  float snr) {
@@ -23,6 +29,21 @@ Message Message::fromChannelRecv(uint8_t channelIdx, const QString &fullText,
   return msg;
 }
 
+Message Message::fromChannelRecvUtf8(uint8_t channelIdx, QByteArrayView fullText,
+                                     uint32_t timestamp, uint8_t pathLen, float snr) {
+  Message msg;
+  msg.type = CHANNEL_MESSAGE;
+  msg.channelIdx = channelIdx;
+  msg.timestamp = timestamp;
+  msg.pathLen = pathLen;
+  msg.snr = snr;
+  msg.receivedAt = QDateTime::currentDateTime();
+
+  parseSenderAndText(fullText, msg.senderName, msg.text);
+
+  return msg;
+}
+
 void Message::parseSenderAndText(const QString &fullText, QString &outSender,
                                  QString &outText) {
   // Channel messages format: "SenderName: message text"
@@ -38,4 +59,20 @@ void Message::parseSenderAndText(const QString &fullText, QString &outSender,
   }
 }
 
+void Message::parseSenderAndText(QByteArrayView fullText, QString &outSender,
+                                 QString &outText) {
+  // ':' is ASCII, so its byte offset splits the text exactly where the
+  // decoded string would
+  const qsizetype colonPos =
+      std::find(fullText.begin(), fullText.end(), ':') - fullText.begin();
+
+  if (colonPos > 0 && colonPos < fullText.size() - 1) {
+    outSender = QString::fromUtf8(fullText.first(colonPos)).trimmed();
+    outText = QString::fromUtf8(fullText.sliced(colonPos + 1)).trimmed();
+  } else {
+    outSender = QStringLiteral("Unknown");
+    outText = QString::fromUtf8(fullText);
+  }
+}
+
 } // namespace MeshCore
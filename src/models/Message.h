@@ -1,5 +1,6 @@
 #pragma once
 
+#include <QByteArrayView>
 #include <QDateTime>
 #include <QString>
 #include <cstdint>
@@ -27,14 +28,21 @@ public:
 
   Message();
 
+  qint64 memoryUsage() const; // Including the string and byte buffers
+
   static Message fromChannelRecv(uint8_t channelIdx, const QString &fullText,
                                  uint32_t timestamp, uint8_t pathLen,
                                  float snr = 0.0f);
+  // Same, from the UTF-8 text in the frame; decodes sender and text once each
+  static Message fromChannelRecvUtf8(uint8_t channelIdx, QByteArrayView fullText,
+                                     uint32_t timestamp, uint8_t pathLen, float snr = 0.0f);
 
 private:
   // Parse "SenderName: message text" format
   static void parseSenderAndText(const QString &fullText, QString &outSender,
                                  QString &outText);
+  static void parseSenderAndText(QByteArrayView fullText, QString &outSender,
+                                 QString &outText);
 };
 
 } // namespace MeshCore
@@ -136,6 +136,12 @@ QByteArray CommandBuilder::buildSetDeviceTime(uint32_t epochSecs) {
   return frame;
 }
 
+QByteArray CommandBuilder::buildGetBattAndStorage() {
+  QByteArray frame;
+  writeUint8(frame, static_cast<uint8_t>(CommandCode::GET_BATT_AND_STORAGE));
+  return frame;
+}
+
 // Node configuration
 QByteArray CommandBuilder::buildSetAdvertName(const QString &name) {
   QByteArray frame;
@@ -35,6 +35,9 @@ public:
   static QByteArray buildGetDeviceTime();
   static QByteArray buildSetDeviceTime(uint32_t epochSecs);
 
+  // Device status
+  static QByteArray buildGetBattAndStorage();
+
   // Node configuration
   static QByteArray buildSetAdvertName(const QString &name);
   static QByteArray buildSendSelfAdvert(uint8_t floodMode = 0);
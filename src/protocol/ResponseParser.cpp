@@ -1,8 +1,23 @@
 #include "ResponseParser.h"
+#include "../core/FlightRecorder.h"
+#include "../core/Logging.h"
+#include "../core/TelemetryCounters.h"
 #include <QDebug>
 
 namespace MeshCore {
 
+namespace {
+
+// A frame shorter than its code requires; the frames before it are kept
+void reportShortFrame(const char *what, const QByteArray &frame) {
+  qCWarning(lcProtocol) << what << "frame too short:" << frame.size();
+  TelemetryCounters::add(TelemetryCounters::instance().parseErrors);
+  FlightRecorder::instance().dumpOnError(
+      QString("%1 frame too short: %2 bytes").arg(what).arg(frame.size()));
+}
+
+} // namespace
+
 // Helper functions
 uint32_t ResponseParser::readUint32LE(const QByteArray &buf, int offset) {
   if (offset + 4 > buf.size())
@@ -32,8 +47,13 @@ uint8_t ResponseParser::readUint8(const QByteArray &buf, int offset) {
 
 QString ResponseParser::readString(const QByteArray &buf, int offset,
                                    int maxLen) {
+  return QString::fromUtf8(readStringBytes(buf, offset, maxLen));
+}
+
+QByteArrayView ResponseParser::readStringBytes(const QByteArray &buf, int offset,
+                                               int maxLen) {
   if (offset >= buf.size())
-    return QString();
+    return QByteArrayView();
 
   int len = 0;
   int limit = maxLen > 0 ? qMin(offset + maxLen, buf.size()) : buf.size();
@@ -43,7 +63,7 @@ QString ResponseParser::readString(const QByteArray &buf, int offset,
     len++;
   }
 
-  return QString::fromUtf8(buf.mid(offset, len));
+  return QByteArrayView(buf.constData() + offset, len);
 }
 
 // Response code helpers
@@ -77,7 +97,7 @@ DeviceInfo ResponseParser::parseDeviceInfo(const QByteArray &frame) {
   DeviceInfo info;
 
   if (frame.size() < 80) {
-    qWarning() << "DeviceInfo frame too short:" << frame.size();
+    reportShortFrame("DeviceInfo", frame);
     return info;
   }
 
@@ -108,7 +128,7 @@ SelfInfo ResponseParser::parseSelfInfo(const QByteArray &frame) {
   SelfInfo info;
 
   if (frame.size() < 46) {
-    qWarning() << "SelfInfo frame too short:" << frame.size();
+    reportShortFrame("SelfInfo", frame);
     return info;
   }
 
@@ -135,7 +155,7 @@ SelfInfo ResponseParser::parseSelfInfo(const QByteArray &frame) {
 // Parse RESP_CODE_CHANNEL_INFO
 Channel ResponseParser::parseChannelInfo(const QByteArray &frame) {
   if (frame.size() < 50) {
-    qWarning() << "ChannelInfo frame too short:" << frame.size();
+    reportShortFrame("ChannelInfo", frame);
     return Channel();
   }
 
@@ -155,7 +175,7 @@ Channel ResponseParser::parseChannelInfo(const QByteArray &frame) {
 // Parse RESP_CODE_CHANNEL_MSG_RECV_V3
 Message ResponseParser::parseChannelMsgRecvV3(const QByteArray &frame) {
   if (frame.size() < 12) {
-    qWarning() << "ChannelMsgRecvV3 frame too short:" << frame.size();
+    reportShortFrame("ChannelMsgRecvV3", frame);
     return Message();
   }
 
@@ -175,10 +195,9 @@ Message ResponseParser::parseChannelMsgRecvV3(const QByteArray &frame) {
   uint8_t channelIdx = readUint8(frame, 4);
   uint8_t pathLen = readUint8(frame, 5);
   uint32_t timestamp = readUint32LE(frame, 7);
-  QString fullText = readString(frame, 11);
+  QByteArrayView fullText = readStringBytes(frame, 11);
 
-  return Message::fromChannelRecv(channelIdx, fullText, timestamp, pathLen,
-                                  snr);
+  return Message::fromChannelRecvUtf8(channelIdx, fullText, timestamp, pathLen, snr);
 }
 
 // Parse RESP_CODE_CONTACT_MSG_RECV_V3
@@ -187,7 +206,7 @@ Message ResponseParser::parseContactMsgRecvV3(const QByteArray &frame) {
   msg.type = Message::CONTACT_MESSAGE;
 
   if (frame.size() < 16) {
-    qWarning() << "ContactMsgRecvV3 frame too short:" << frame.size();
+    reportShortFrame("ContactMsgRecvV3", frame);
     return msg;
   }
 
@@ -224,7 +243,7 @@ Contact ResponseParser::parseContact(const QByteArray &frame) {
   Contact contact;
 
   if (frame.size() < 148) {
-    qWarning() << "Contact frame too short:" << frame.size();
+    reportShortFrame("Contact", frame);
     return contact;
   }
 
@@ -262,4 +281,27 @@ Contact ResponseParser::parseContact(const QByteArray &frame) {
   return contact;
 }
 
+// Parse RESP_CODE_BATT_AND_STORAGE
+BatteryStatus ResponseParser::parseBattAndStorage(const QByteArray &frame) {
+  BatteryStatus status;
+
+  if (frame.size() < 3) {
+    reportShortFrame("BattAndStorage", frame);
+    return status;
+  }
+
+  // Frame format:
+  // Byte 0: RESP_CODE_BATT_AND_STORAGE (12)
+  // Bytes 1-2: battery millivolts (uint16 LE)
+  // Bytes 3-6: storage used in KB (uint32 LE, newer firmware)
+  // Bytes 7-10: storage total in KB (uint32 LE, newer firmware)
+
+  status.milliVolts = readUint16LE(frame, 1);
+  status.storageUsedKb = readUint32LE(frame, 3);
+  status.storageTotalKb = readUint32LE(frame, 7);
+  status.isValid = true;
+
+  return status;
+}
+
 } // namespace MeshCore
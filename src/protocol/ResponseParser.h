@@ -1,6 +1,7 @@
 #pragma once
 
 #include <QByteArray>
+#include <QByteArrayView>
 #include <QString>
 
 #include "../core/DeviceInfo.h"
@@ -20,6 +21,7 @@ public:
   static Message parseChannelMsgRecvV3(const QByteArray &frame);
   static Message parseContactMsgRecvV3(const QByteArray &frame);
   static Contact parseContact(const QByteArray &frame);
+  static BatteryStatus parseBattAndStorage(const QByteArray &frame);
 
   // Get response code from frame
   static ResponseCode getResponseCode(const QByteArray &frame);
@@ -40,6 +42,8 @@ private:
 
   // Read null-terminated string
   static QString readString(const QByteArray &buf, int offset, int maxLen = -1);
+  // The same string's bytes, undecoded; points into buf
+  static QByteArrayView readStringBytes(const QByteArray &buf, int offset, int maxLen = -1);
 };
 
 } // namespace MeshCore
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QtGlobal>
+
+#include "../models/Message.h"
+
+namespace MeshCore {
+
+// One inbox entry: a channel or a direct-message peer, with its newest
+// message and how many received messages are unread.
+struct Conversation {
+  Message::Type kind = Message::CHANNEL_MESSAGE;
+  uint8_t channelIdx = 0;    // For channel conversations
+  QByteArray pubKeyPrefix;   // For direct conversations
+  qint64 lastMessageId = 0;
+  qint64 lastTimestamp = 0;
+  QString lastSenderName;
+  QString lastText;
+  int unreadCount = 0;
+  qint64 lastReadMessageId = 0;
+};
+
+} // namespace MeshCore
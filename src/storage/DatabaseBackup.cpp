@@ -0,0 +1,165 @@
+#include "DatabaseBackup.h"
+#include "../core/Logging.h"
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QTimer>
+
+namespace MeshCore {
+
+namespace {
+
+const int PROGRESS_INTERVAL_MS = 250;
+const char *const PARTIAL_SUFFIX = ".partial";
+
+} // namespace
+
+DatabaseBackup::DatabaseBackup(QObject *parent)
+    : QObject(parent), m_worker(new QObject), m_progressTimer(new QTimer(this)),
+      m_running(false), m_expectedBytes(0) {
+  m_thread.setObjectName("DatabaseBackup");
+  m_worker->moveToThread(&m_thread);
+  connect(&m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+  m_thread.start(QThread::LowPriority);
+
+  // The copy grows as VACUUM INTO writes it, which is the only progress
+  // SQLite exposes for it
+  connect(m_progressTimer, &QTimer::timeout, this, [this]() {
+    emit progress(QFileInfo(m_partialPath).size(), m_expectedBytes);
+  });
+}
+
+DatabaseBackup::~DatabaseBackup() {
+  m_thread.quit();
+  m_thread.wait();
+}
+
+bool DatabaseBackup::start(const QString &databasePath, const QString &connectionName,
+                           const QString &targetPath, qint64 expectedBytes, bool verify) {
+  if (m_running.exchange(true)) {
+    return false;
+  }
+
+  m_partialPath = targetPath + PARTIAL_SUFFIX;
+  m_expectedBytes = expectedBytes;
+  QFile::remove(m_partialPath); // Left over from an interrupted run
+  m_progressTimer->start(PROGRESS_INTERVAL_MS);
+
+  QMetaObject::invokeMethod(
+      m_worker, [this, databasePath, connectionName, targetPath, verify]() {
+        BackupResult result = run(databasePath, connectionName, targetPath, verify);
+
+        QMetaObject::invokeMethod(
+            this,
+            [this, result]() {
+              m_progressTimer->stop();
+              m_running = false;
+              if (result.ok) {
+                emit progress(result.bytes, result.bytes);
+              }
+              emit finished(result);
+            },
+            Qt::QueuedConnection);
+      });
+
+  return true;
+}
+
+void DatabaseBackup::wait() {
+  if (!m_running) {
+    return;
+  }
+
+  // Work posted to the backup thread runs in order, so this returns once
+  // the backup has
+  QMetaObject::invokeMethod(m_worker, []() {}, Qt::BlockingQueuedConnection);
+}
+
+BackupResult DatabaseBackup::run(const QString &databasePath, const QString &connectionName,
+                                 const QString &targetPath, bool verify) {
+  BackupResult result;
+  result.path = targetPath;
+
+  QElapsedTimer timer;
+  timer.start();
+
+  {
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+    db.setDatabaseName(databasePath);
+    db.setConnectOptions("QSQLITE_OPEN_READONLY;QSQLITE_BUSY_TIMEOUT=5000");
+
+    if (!db.open()) {
+      result.error =
+          QString("Failed to open backup connection: %1").arg(db.lastError().text());
+    } else {
+      QSqlQuery query(db);
+      query.prepare("VACUUM INTO ?");
+      query.addBindValue(m_partialPath);
+      if (!query.exec()) {
+        result.error = QString("Backup failed: %1").arg(query.lastError().text());
+      }
+      query.finish();
+      db.close();
+    }
+  }
+  QSqlDatabase::removeDatabase(connectionName);
+
+  if (result.error.isEmpty() && verify) {
+    result.error = verifyCopy(m_partialPath, connectionName + "_verify");
+    result.verified = result.error.isEmpty();
+  }
+
+  if (result.error.isEmpty()) {
+    if (QFile::exists(targetPath) && !QFile::remove(targetPath)) {
+      result.error = QString("Failed to replace %1").arg(targetPath);
+    } else if (!QFile::rename(m_partialPath, targetPath)) {
+      result.error = QString("Failed to move backup to %1").arg(targetPath);
+    }
+  }
+
+  if (!result.error.isEmpty()) {
+    QFile::remove(m_partialPath);
+    qCWarning(lcStorage) << result.error;
+  } else {
+    result.ok = true;
+    result.bytes = QFileInfo(targetPath).size();
+  }
+
+  result.elapsedMs = timer.elapsed();
+  return result;
+}
+
+QString DatabaseBackup::verifyCopy(const QString &path, const QString &connectionName) {
+  QString error;
+
+  {
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+    db.setDatabaseName(path);
+    db.setConnectOptions("QSQLITE_OPEN_READONLY");
+
+    if (!db.open()) {
+      error = QString("Failed to open backup for verification: %1").arg(db.lastError().text());
+    } else {
+      QSqlQuery query(db);
+      if (!query.exec("PRAGMA integrity_check") || !query.next() ||
+          query.value(0).toString() != "ok") {
+        error = QString("Backup failed verification: %1")
+                    .arg(query.lastError().isValid() ? query.lastError().text()
+                                                     : query.value(0).toString());
+      } else if (!query.exec("SELECT MAX(version) FROM schema_version") || !query.next() ||
+                 query.value(0).toInt() <= 0) {
+        error = "Backup failed verification: no schema version";
+      }
+      query.finish();
+      db.close();
+    }
+  }
+  QSqlDatabase::removeDatabase(connectionName);
+
+  return error;
+}
+
+} // namespace MeshCore
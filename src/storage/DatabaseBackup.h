@@ -0,0 +1,63 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include <atomic>
+
+class QTimer;
+
+namespace MeshCore {
+
+struct BackupResult {
+  bool ok = false;
+  bool verified = false; // integrity_check passed on the copy
+  QString path;
+  QString error;
+  qint64 bytes = 0;
+  qint64 elapsedMs = 0;
+};
+
+// Writes a consistent snapshot of a live database to another file on its
+// own thread and connection. The copy is made with VACUUM INTO inside one
+// read transaction, which in WAL mode never blocks the writer, so ingest
+// carries on; the snapshot is whatever was committed when it started. The
+// copy is written under a temporary name, optionally verified, and only
+// then moved over the target.
+class DatabaseBackup : public QObject {
+  Q_OBJECT
+
+public:
+  explicit DatabaseBackup(QObject *parent = nullptr);
+  ~DatabaseBackup();
+
+  // expectedBytes (in-use pages of the source) scales progress reports.
+  // Returns false if a backup is already running.
+  bool start(const QString &databasePath, const QString &connectionName,
+             const QString &targetPath, qint64 expectedBytes, bool verify);
+  bool isRunning() const { return m_running; }
+
+  // Blocks until a running backup has finished on its thread; finished()
+  // is still delivered through the event loop
+  void wait();
+
+signals:
+  void progress(qint64 bytesWritten, qint64 bytesExpected);
+  void finished(const BackupResult &result);
+
+private:
+  // Backup thread only
+  BackupResult run(const QString &databasePath, const QString &connectionName,
+                   const QString &targetPath, bool verify);
+  static QString verifyCopy(const QString &path, const QString &connectionName);
+
+  QThread m_thread;
+  QObject *m_worker; // Lives on m_thread
+  QTimer *m_progressTimer;
+  std::atomic<bool> m_running;
+  QString m_partialPath;
+  qint64 m_expectedBytes;
+};
+
+} // namespace MeshCore
@@ -1,24 +1,446 @@
 #include "DatabaseManager.h"
+#include "../core/FrameArena.h"
+#include "../core/Logging.h"
+#include "../core/MemoryAccounting.h"
+#include "../core/TelemetryCounters.h"
+#include "../core/Tracer.h"
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QStandardPaths>
 #include <QDir>
+#include <QFileInfo>
 #include <QMutexLocker>
 #include <QDebug>
 #include <QDateTime>
 #include <QCryptographicHash>
 #include <QVariant>
+#include <QElapsedTimer>
+#include <QTimeZone>
+#include <algorithm>
+#include <climits>
+#include <limits>
+#include <tuple>
 
 namespace MeshCore {
 
+namespace {
+
+// Table definitions shared by createTables() and the migrations that rebuild
+// them under a staging name
+
+QString sendersTableSql() {
+  // Channel senders are identified by name, direct senders by key prefix;
+  // the unused half is stored empty so the UNIQUE constraint holds
+  return "CREATE TABLE IF NOT EXISTS senders ("
+         "id INTEGER PRIMARY KEY, "
+         "pubkey_prefix BLOB NOT NULL DEFAULT x'', "
+         "name TEXT NOT NULL DEFAULT '', "
+         "UNIQUE (pubkey_prefix, name))";
+}
+
+QString contactsTableSql(const QString &name) {
+  // Keyed lookups only, so the public key is the clustering key
+  return QString("CREATE TABLE IF NOT EXISTS %1 ("
+                 "public_key BLOB PRIMARY KEY, "
+                 "name TEXT NOT NULL, "
+                 "type INTEGER NOT NULL, "
+                 "flags INTEGER NOT NULL, "
+                 "path_length INTEGER, "
+                 "path BLOB, "
+                 "last_advert_timestamp INTEGER, "
+                 "last_modified INTEGER, "
+                 "latitude INTEGER, "
+                 "longitude INTEGER, "
+                 "created_at INTEGER NOT NULL, "
+                 "updated_at INTEGER NOT NULL) WITHOUT ROWID")
+      .arg(name);
+}
+
+// Existing rows keep created_at and are only rewritten when a field changed,
+// so re-syncing an unchanged contact list touches no pages
+const char *const CONTACT_UPSERT_SQL =
+    "INSERT INTO contacts "
+    "(public_key, name, type, flags, path_length, path, last_advert_timestamp, "
+    "last_modified, latitude, longitude, created_at, updated_at) "
+    "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?) "
+    "ON CONFLICT(public_key) DO UPDATE SET "
+    "name = excluded.name, type = excluded.type, flags = excluded.flags, "
+    "path_length = excluded.path_length, path = excluded.path, "
+    "last_advert_timestamp = excluded.last_advert_timestamp, "
+    "last_modified = excluded.last_modified, latitude = excluded.latitude, "
+    "longitude = excluded.longitude, updated_at = excluded.updated_at "
+    "WHERE name IS NOT excluded.name OR type IS NOT excluded.type "
+    "OR flags IS NOT excluded.flags OR path_length IS NOT excluded.path_length "
+    "OR path IS NOT excluded.path "
+    "OR last_advert_timestamp IS NOT excluded.last_advert_timestamp "
+    "OR last_modified IS NOT excluded.last_modified "
+    "OR latitude IS NOT excluded.latitude OR longitude IS NOT excluded.longitude";
+
+void bindContact(QSqlQuery &query, const Contact &contact, qint64 now) {
+  query.bindValue(0, contact.publicKey());
+  query.bindValue(1, contact.name());
+  query.bindValue(2, contact.type());
+  query.bindValue(3, contact.flags());
+  query.bindValue(4, contact.pathLength());
+  query.bindValue(5, contact.path());
+  query.bindValue(6, contact.lastAdvertTimestamp());
+  query.bindValue(7, contact.lastModified());
+  query.bindValue(8, contact.latitude());
+  query.bindValue(9, contact.longitude());
+  query.bindValue(10, now); // created_at, ignored on update
+  query.bindValue(11, now); // updated_at
+}
+
+// Partitions take ids allocated by DatabaseManager, so only the legacy
+// table uses AUTOINCREMENT. Rows of compressed partitions keep their text in
+// text_z (text is then empty); dict_id names the dictionary, 0 for zlib.
+QString messagesTableSql(const QString &name, bool autoIncrement = true) {
+  return QString("CREATE TABLE IF NOT EXISTS %1 ("
+                 "id INTEGER PRIMARY KEY%2, "
+                 "message_type INTEGER NOT NULL, "
+                 "channel_idx INTEGER, "
+                 "sender_id INTEGER NOT NULL REFERENCES senders(id), "
+                 "text TEXT NOT NULL, "
+                 "timestamp INTEGER NOT NULL, "
+                 "received_at INTEGER NOT NULL, "
+                 "path_length INTEGER, "
+                 "txt_type INTEGER, "
+                 "snr REAL, "
+                 "is_sent_by_me INTEGER DEFAULT 0, "
+                 "text_z BLOB, "
+                 "dict_id INTEGER, "
+                 "FOREIGN KEY (channel_idx) REFERENCES channels(idx) ON DELETE SET NULL)")
+      .arg(name, autoIncrement ? " AUTOINCREMENT" : "");
+}
+
+QString messageHashesTableSql(const QString &name) {
+  // Raw SHA-256 digests; the hash is the only lookup key. message_id may
+  // live in any partition, so it is not a foreign key; hashes expire on
+  // their own, shorter schedule.
+  return QString("CREATE TABLE IF NOT EXISTS %1 ("
+                 "hash BLOB PRIMARY KEY, "
+                 "message_id INTEGER NOT NULL, "
+                 "created_at INTEGER NOT NULL) "
+                 "WITHOUT ROWID")
+      .arg(name);
+}
+
+const char *const MIGRATION_PROGRESS_TABLE_SQL =
+    "CREATE TABLE IF NOT EXISTS migration_progress ("
+    "version INTEGER NOT NULL, "
+    "step TEXT NOT NULL, "
+    "cursor INTEGER NOT NULL, "
+    "PRIMARY KEY (version, step)) WITHOUT ROWID";
+
+// Aggregates read by the statistics API. stats_channel_totals tracks the rows
+// currently stored (direct messages under key -1); the hourly, sender and
+// histogram tables count traffic as received and are not reduced by pruning.
+const char *const STATS_TABLE_STATEMENTS[] = {
+    "CREATE TABLE IF NOT EXISTS stats_channel_totals ("
+    "channel_key INTEGER PRIMARY KEY, "
+    "message_count INTEGER NOT NULL)",
+    "CREATE TABLE IF NOT EXISTS stats_hourly ("
+    "hour INTEGER NOT NULL, "
+    "channel_key INTEGER NOT NULL, "
+    "message_count INTEGER NOT NULL, "
+    "PRIMARY KEY (hour, channel_key)) WITHOUT ROWID",
+    "CREATE TABLE IF NOT EXISTS stats_senders ("
+    "sender_id INTEGER PRIMARY KEY, "
+    "message_count INTEGER NOT NULL, "
+    "last_received_at INTEGER NOT NULL)",
+    "CREATE INDEX IF NOT EXISTS idx_stats_senders_count "
+    "ON stats_senders(message_count DESC)",
+    "CREATE TABLE IF NOT EXISTS stats_snr_histogram ("
+    "bucket INTEGER PRIMARY KEY, "
+    "message_count INTEGER NOT NULL)",
+    "CREATE TABLE IF NOT EXISTS stats_path_histogram ("
+    "path_length INTEGER PRIMARY KEY, "
+    "message_count INTEGER NOT NULL)",
+};
+
+// Triggers that keep the stats tables current for a table shaped like
+// messages. Moving a message between channels only happens when its
+// channel is deleted (ON DELETE SET NULL).
+QStringList statsTriggerSql(const QString &table) {
+  return {
+      QString("CREATE TRIGGER IF NOT EXISTS trg_%1_stats_insert AFTER INSERT ON %1 "
+              "BEGIN "
+              "INSERT INTO stats_channel_totals (channel_key, message_count) "
+              "VALUES (COALESCE(NEW.channel_idx, -1), 1) "
+              "ON CONFLICT(channel_key) DO UPDATE SET message_count = message_count + 1; "
+              "INSERT INTO stats_hourly (hour, channel_key, message_count) "
+              "VALUES (NEW.received_at / 3600, COALESCE(NEW.channel_idx, -1), 1) "
+              "ON CONFLICT(hour, channel_key) DO UPDATE "
+              "SET message_count = message_count + 1; "
+              "INSERT INTO stats_senders (sender_id, message_count, last_received_at) "
+              "VALUES (NEW.sender_id, 1, NEW.received_at) "
+              "ON CONFLICT(sender_id) DO UPDATE SET message_count = message_count + 1, "
+              "last_received_at = MAX(last_received_at, excluded.last_received_at); "
+              "INSERT INTO stats_snr_histogram (bucket, message_count) "
+              "SELECT CAST(ROUND(NEW.snr) AS INTEGER), 1 WHERE NEW.snr IS NOT NULL "
+              "ON CONFLICT(bucket) DO UPDATE SET message_count = message_count + 1; "
+              "INSERT INTO stats_path_histogram (path_length, message_count) "
+              "SELECT NEW.path_length, 1 WHERE NEW.path_length IS NOT NULL "
+              "ON CONFLICT(path_length) DO UPDATE SET message_count = message_count + 1; "
+              "END")
+          .arg(table),
+      QString("CREATE TRIGGER IF NOT EXISTS trg_%1_stats_delete AFTER DELETE ON %1 "
+              "BEGIN "
+              "UPDATE stats_channel_totals SET message_count = message_count - 1 "
+              "WHERE channel_key = COALESCE(OLD.channel_idx, -1); "
+              "END")
+          .arg(table),
+      QString("CREATE TRIGGER IF NOT EXISTS trg_%1_stats_channel "
+              "AFTER UPDATE OF channel_idx ON %1 "
+              "WHEN OLD.channel_idx IS NOT NEW.channel_idx "
+              "BEGIN "
+              "UPDATE stats_channel_totals SET message_count = message_count - 1 "
+              "WHERE channel_key = COALESCE(OLD.channel_idx, -1); "
+              "INSERT INTO stats_channel_totals (channel_key, message_count) "
+              "VALUES (COALESCE(NEW.channel_idx, -1), 1) "
+              "ON CONFLICT(channel_key) DO UPDATE SET message_count = message_count + 1; "
+              "END")
+          .arg(table),
+  };
+}
+
+// Inbox index, one row per channel (kind 0, peer = channel index) or direct
+// peer (kind 1, peer = key prefix). peer has no declared type so it holds
+// either form as-is.
+const char *const CONVERSATIONS_TABLE_SQL =
+    "CREATE TABLE IF NOT EXISTS conversations ("
+    "kind INTEGER NOT NULL, "
+    "peer NOT NULL, "
+    "last_message_id INTEGER NOT NULL, "
+    "last_timestamp INTEGER NOT NULL, "
+    "unread_count INTEGER NOT NULL DEFAULT 0, "
+    "last_read_message_id INTEGER NOT NULL DEFAULT 0, "
+    "PRIMARY KEY (kind, peer)) WITHOUT ROWID";
+
+// Triggers that keep conversations in step with inserts and deletes on a
+// table shaped like messages, inside the writing transaction. A message
+// sent by us marks its conversation read.
+QStringList conversationTriggerSql(const QString &table) {
+  const QString upsert =
+      "INSERT INTO conversations (kind, peer, last_message_id, last_timestamp, "
+      "unread_count, last_read_message_id) "
+      "SELECT NEW.message_type, %1, NEW.id, NEW.timestamp, NEW.is_sent_by_me = 0, "
+      "CASE WHEN NEW.is_sent_by_me THEN NEW.id ELSE 0 END WHERE 1 "
+      "ON CONFLICT(kind, peer) DO UPDATE SET "
+      "last_message_id = excluded.last_message_id, "
+      "last_timestamp = excluded.last_timestamp, "
+      "unread_count = CASE WHEN NEW.is_sent_by_me THEN 0 ELSE unread_count + 1 END, "
+      "last_read_message_id = CASE WHEN NEW.is_sent_by_me THEN NEW.id "
+      "ELSE last_read_message_id END;";
+
+  // On delete the unread count drops if the row was unread, and the newest
+  // message is looked up again (through the history index) if it was the one
+  const QString unread =
+      "UPDATE conversations SET unread_count = MAX(unread_count - 1, 0) "
+      "WHERE kind = OLD.message_type AND peer = %1 "
+      "AND OLD.id > last_read_message_id AND OLD.is_sent_by_me = 0;";
+  const QString relink =
+      "UPDATE conversations SET "
+      "last_message_id = COALESCE((SELECT id FROM %2 WHERE %3 "
+      "ORDER BY timestamp DESC, id DESC LIMIT 1), 0), "
+      "last_timestamp = COALESCE((SELECT timestamp FROM %2 WHERE %3 "
+      "ORDER BY timestamp DESC, id DESC LIMIT 1), 0) "
+      "WHERE kind = OLD.message_type AND peer = %1 AND last_message_id = OLD.id;";
+
+  const QString channelPeer = "OLD.channel_idx";
+  const QString channelMatch = "channel_idx = OLD.channel_idx";
+  const QString directPeer = "(SELECT pubkey_prefix FROM senders WHERE id = OLD.sender_id)";
+  const QString directMatch =
+      "sender_id IN (SELECT id FROM senders WHERE pubkey_prefix = "
+      "(SELECT pubkey_prefix FROM senders WHERE id = OLD.sender_id))";
+
+  return {
+      QString("CREATE TRIGGER IF NOT EXISTS trg_%1_conversation_insert AFTER INSERT ON %1 "
+              "WHEN NEW.message_type = 1 OR NEW.channel_idx IS NOT NULL BEGIN ")
+              .arg(table) +
+          upsert.arg("CASE WHEN NEW.message_type = 1 THEN (SELECT pubkey_prefix FROM "
+                     "senders WHERE id = NEW.sender_id) ELSE NEW.channel_idx END") +
+          " END",
+      QString("CREATE TRIGGER IF NOT EXISTS trg_%1_conversation_delete_channel "
+              "AFTER DELETE ON %1 "
+              "WHEN OLD.message_type = 0 AND OLD.channel_idx IS NOT NULL BEGIN ")
+              .arg(table) +
+          unread.arg(channelPeer) + relink.arg(channelPeer, table, channelMatch) + " END",
+      QString("CREATE TRIGGER IF NOT EXISTS trg_%1_conversation_delete_direct "
+              "AFTER DELETE ON %1 WHEN OLD.message_type = 1 BEGIN ")
+              .arg(table) +
+          unread.arg(directPeer) + relink.arg(directPeer, table, directMatch) + " END",
+  };
+}
+
+const char *const INDEX_STATEMENTS[] = {
+    "CREATE INDEX IF NOT EXISTS idx_contacts_name ON contacts(name)",
+    "CREATE INDEX IF NOT EXISTS idx_contacts_updated_at ON contacts(updated_at)",
+    "CREATE INDEX IF NOT EXISTS idx_message_hashes_created_at ON message_hashes(created_at)",
+    "CREATE INDEX IF NOT EXISTS idx_message_hashes_message_id ON message_hashes(message_id)",
+};
+
+// History indexes end in (timestamp, id) so ORDER BY ... LIMIT is served
+// straight from the index without a sort, and ties page deterministically.
+// For the legacy "messages" table these produce the original index names.
+QStringList messageIndexSql(const QString &table) {
+  return {
+      QString("CREATE INDEX IF NOT EXISTS idx_%1_channel "
+              "ON %1(channel_idx, timestamp DESC, id DESC)")
+          .arg(table),
+      QString("CREATE INDEX IF NOT EXISTS idx_%1_sender "
+              "ON %1(sender_id, timestamp DESC, id DESC)")
+          .arg(table),
+      QString("CREATE INDEX IF NOT EXISTS idx_%1_received_at ON %1(received_at DESC)")
+          .arg(table),
+  };
+}
+
+// Message storage is split into monthly tables (messages_YYYYMM, by
+// received_at in UTC) listed in message_partitions. Databases upgraded from
+// an unpartitioned schema keep their "messages" table as the oldest
+// partition. The timestamp bounds let history reads skip partitions. Ids
+// are assigned when a message is saved, so a late save into an old period
+// widens that partition's id range over newer ones: the id bounds only say
+// where to look first. stats_partition_totals lets a dropped partition be
+// subtracted from the channel totals without scanning it. Aged partitions
+// are rewritten with compressed text; dict_id is set once that starts and
+// compressed_at once it is done.
+const char *const PARTITION_TABLE_STATEMENTS[] = {
+    "CREATE TABLE IF NOT EXISTS message_partitions ("
+    "name TEXT PRIMARY KEY, "
+    "period_start INTEGER NOT NULL, "
+    "period_end INTEGER NOT NULL, "
+    "min_id INTEGER, "
+    "max_id INTEGER, "
+    "min_timestamp INTEGER, "
+    "max_timestamp INTEGER, "
+    "created_at INTEGER NOT NULL, "
+    "dict_id INTEGER, "
+    "compressed_at INTEGER, "
+    "raw_bytes INTEGER, "
+    "stored_bytes INTEGER)",
+    "CREATE TABLE IF NOT EXISTS stats_partition_totals ("
+    "partition_name TEXT NOT NULL, "
+    "channel_key INTEGER NOT NULL, "
+    "message_count INTEGER NOT NULL, "
+    "PRIMARY KEY (partition_name, channel_key)) WITHOUT ROWID",
+    "CREATE TABLE IF NOT EXISTS compression_dictionaries ("
+    "id INTEGER PRIMARY KEY, "
+    "codec INTEGER NOT NULL, "
+    "dictionary BLOB NOT NULL, "
+    "sample_count INTEGER NOT NULL, "
+    "created_at INTEGER NOT NULL)",
+};
+
+// Columns added to the catalog by v6 (fresh catalogs already have them)
+const char *const PARTITION_CATALOG_V6_COLUMNS[][2] = {
+    {"dict_id", "INTEGER"},
+    {"compressed_at", "INTEGER"},
+    {"raw_bytes", "INTEGER"},
+    {"stored_bytes", "INTEGER"},
+};
+
+QStringList partitionTriggerSql(const QString &table) {
+  return {
+      QString("CREATE TRIGGER IF NOT EXISTS trg_%1_partition_insert AFTER INSERT ON %1 "
+              "BEGIN "
+              "UPDATE message_partitions SET "
+              "min_id = MIN(COALESCE(min_id, NEW.id), NEW.id), "
+              "max_id = MAX(COALESCE(max_id, NEW.id), NEW.id), "
+              "min_timestamp = MIN(COALESCE(min_timestamp, NEW.timestamp), NEW.timestamp), "
+              "max_timestamp = MAX(COALESCE(max_timestamp, NEW.timestamp), NEW.timestamp) "
+              "WHERE name = '%1'; "
+              "INSERT INTO stats_partition_totals (partition_name, channel_key, message_count) "
+              "VALUES ('%1', COALESCE(NEW.channel_idx, -1), 1) "
+              "ON CONFLICT(partition_name, channel_key) DO UPDATE "
+              "SET message_count = message_count + 1; "
+              "END")
+          .arg(table),
+      QString("CREATE TRIGGER IF NOT EXISTS trg_%1_partition_delete AFTER DELETE ON %1 "
+              "BEGIN "
+              "UPDATE stats_partition_totals SET message_count = message_count - 1 "
+              "WHERE partition_name = '%1' AND channel_key = COALESCE(OLD.channel_idx, -1); "
+              "END")
+          .arg(table),
+      QString("CREATE TRIGGER IF NOT EXISTS trg_%1_partition_channel "
+              "AFTER UPDATE OF channel_idx ON %1 "
+              "WHEN OLD.channel_idx IS NOT NEW.channel_idx "
+              "BEGIN "
+              "UPDATE stats_partition_totals SET message_count = message_count - 1 "
+              "WHERE partition_name = '%1' AND channel_key = COALESCE(OLD.channel_idx, -1); "
+              "INSERT INTO stats_partition_totals (partition_name, channel_key, message_count) "
+              "VALUES ('%1', COALESCE(NEW.channel_idx, -1), 1) "
+              "ON CONFLICT(partition_name, channel_key) DO UPDATE "
+              "SET message_count = message_count + 1; "
+              "END")
+          .arg(table),
+  };
+}
+
+// Indexes and triggers carried by every partition table
+QStringList partitionObjectsSql(const QString &table) {
+  return messageIndexSql(table) + statsTriggerSql(table) + conversationTriggerSql(table) +
+         partitionTriggerSql(table);
+}
+
+// Cold partitions are rewritten into "<name>_z"; a dictionary is trained per
+// partition from up to this many of its texts
+const char *const COMPRESSED_TABLE_SUFFIX = "_z";
+const int DICTIONARY_SAMPLE_ROWS = 10000;
+const int DICTIONARY_BYTES = 16 * 1024;
+
+// Select list for history queries over "<partition> m JOIN senders s"
+const char *const MESSAGE_COLUMNS =
+    "m.message_type, m.channel_idx, s.pubkey_prefix, s.name, m.text, m.timestamp, "
+    "m.received_at, m.path_length, m.txt_type, m.snr, m.is_sent_by_me, m.text_z, m.dict_id";
+
+// A history row with the sort key and id used to merge partitions
+struct RoutedMessage {
+  qint64 key;
+  qint64 id;
+  Message message;
+};
+
+// Key of a message's sender in m_senderIds, in the frame arena: the
+// public key prefix of a direct message, NUL, the sender name
+ScratchBytes senderLookupKey(const Message &message) {
+  ScratchBytes key;
+  if (message.type == Message::CONTACT_MESSAGE) {
+    key.append(message.senderPubKeyPrefix);
+  }
+  key.append('\0');
+  key.append(message.senderName);
+  return key;
+}
+
+QByteArray senderCacheKey(const Message &message) {
+  return senderLookupKey(message).view().toByteArray();
+}
+
+} // namespace
+
 DatabaseManager::DatabaseManager(QObject *parent)
-    : QObject(parent), m_currentDbPath(""), m_currentDeviceKey() {}
+    : QObject(parent), m_currentDbPath(""), m_currentDeviceKey(),
+      m_storageProfile(StorageProfile::Balanced), m_nextMessageId(1),
+      m_compressionBacklog(false), m_retentionTimer(new QTimer(this)) {
+  m_retentionTimer->setSingleShot(true);
+  connect(m_retentionTimer, &QTimer::timeout, this,
+          &DatabaseManager::onRetentionTimer);
+  connect(&m_backup, &DatabaseBackup::progress, this, &DatabaseManager::backupProgress);
+  connect(&m_backup, &DatabaseBackup::finished, this, &DatabaseManager::backupFinished);
+  m_profiler.setPlanProvider([this](const QString &sql, const QVariantList &values) {
+    return explainQueryPlan(sql, values);
+  });
+}
 
 DatabaseManager::~DatabaseManager() { closeDatabase(); }
 
 QString DatabaseManager::getDatabasePath(const QByteArray &devicePublicKey) const {
   QString appDataPath =
-      QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+      m_databaseDirectory.isEmpty()
+          ? QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+          : m_databaseDirectory;
   QDir().mkpath(appDataPath); // Ensure directory exists
 
   QString publicKeyHex = devicePublicKey.toHex();
@@ -34,7 +456,7 @@ bool DatabaseManager::openDatabase(const QByteArray &devicePublicKey) {
 
   // Close existing connection if open
   if (m_db.isOpen()) {
-    closeDatabase();
+    closeDatabaseLocked();
   }
 
   m_currentDbPath = getDatabasePath(devicePublicKey);
@@ -51,51 +473,143 @@ bool DatabaseManager::openDatabase(const QByteArray &devicePublicKey) {
   m_db.setDatabaseName(m_currentDbPath);
 
   if (!m_db.open()) {
-    m_lastError = QString("Failed to open database: %1").arg(m_db.lastError().text());
-    qWarning() << m_lastError;
-    emit errorOccurred(m_lastError);
+    setLastError(QString("Failed to open database: %1").arg(m_db.lastError().text()));
+    qCWarning(lcStorage) << getLastError();
+    emit errorOccurred(getLastError());
     return false;
   }
 
-  // Enable Write-Ahead Logging for better performance and concurrency
+  // auto_vacuum only takes effect if set before the first table is created;
+  // existing databases are converted by enableIncrementalVacuum()
   QSqlQuery query(m_db);
+  query.exec("PRAGMA auto_vacuum=INCREMENTAL");
+
+  // Enable Write-Ahead Logging for better performance and concurrency
   query.exec("PRAGMA journal_mode=WAL");
   query.exec("PRAGMA foreign_keys=ON");
+  applyStorageProfileLocked();
 
   if (!initializeSchema()) {
-    m_lastError = "Failed to initialize database schema";
-    qWarning() << m_lastError;
-    closeDatabase();
-    emit errorOccurred(m_lastError);
+    setLastError("Failed to initialize database schema");
+    qCWarning(lcStorage) << getLastError();
+    closeDatabaseLocked();
+    emit errorOccurred(getLastError());
+    return false;
+  }
+
+  if (autoVacuumModeLocked() != AUTO_VACUUM_INCREMENTAL) {
+    qCDebug(lcStorage) << "Incremental auto-vacuum is off; pruned pages stay in the file"
+                       << "until enableIncrementalVacuum() converts it";
+  }
+
+  if (!loadPartitionsLocked() || !loadCompressionDictionariesLocked()) {
+    qCWarning(lcStorage) << getLastError();
+    closeDatabaseLocked();
+    emit errorOccurred(getLastError());
     return false;
   }
 
-  qDebug() << "Database opened:" << m_currentDbPath;
+  // History reads go through per-thread read-only connections so they run
+  // alongside ingest on this writer connection
+  m_readPool.open(m_currentDbPath, connectionName);
+
+  // From here on the checkpointer owns checkpoints, so a commit never runs
+  // one inline. Migrations above still used autocheckpoint to bound the WAL.
+  // journal_size_limit shrinks the file whenever the writer restarts it.
+  query.exec("PRAGMA wal_autocheckpoint=0");
+  query.exec(QString("PRAGMA journal_size_limit=%1")
+                 .arg(m_checkpointer.policy().walSoftLimitBytes));
+  m_checkpointer.start(m_currentDbPath, connectionName + "_checkpoint");
+
+  qCDebug(lcStorage) << "Database opened:" << m_currentDbPath;
+  m_retentionTimer->start(0);
   emit databaseOpened(m_currentDbPath);
   return true;
 }
 
 void DatabaseManager::closeDatabase() {
-  QMutexLocker locker(&m_mutex);
+  {
+    QMutexLocker locker(&m_mutex);
+    closeDatabaseLocked();
+  }
 
-  if (m_db.isOpen()) {
-    // Checkpoint WAL to ensure all data is written to main DB file
-    QSqlQuery query(m_db);
-    if (!query.exec("PRAGMA wal_checkpoint(FULL)")) {
-      qWarning() << "Failed to checkpoint WAL:" << query.lastError().text();
-    } else {
-      qDebug() << "WAL checkpoint completed";
-    }
+  // A backup reads through its own connection and needs nothing from this
+  // one, so it is waited for without the lock; writers of a reopened
+  // database do not stall behind a long VACUUM INTO
+  m_backup.wait();
+}
+
+void DatabaseManager::closeDatabaseLocked() {
+  m_retentionTimer->stop();
+  m_checkpointer.stop();
+  m_readPool.close();
 
+  if (m_db.isOpen()) {
+    // Closing the last connection checkpoints the WAL and deletes it; the
+    // background checkpoints keep what is left for that small
     QString connectionName = m_db.connectionName();
     m_db.close();
     QSqlDatabase::removeDatabase(connectionName);
-    qDebug() << "Database closed:" << m_currentDbPath;
+    qCDebug(lcStorage) << "Database closed:" << m_currentDbPath;
     emit databaseClosed();
   }
 
   m_currentDbPath.clear();
   m_currentDeviceKey.clear();
+  m_senderIds.clear();
+  m_partitions.clear();
+  m_textCodec.clear();
+  m_compressionBacklog = false;
+}
+
+void DatabaseManager::applyStorageProfileLocked() {
+  QSqlQuery query(m_db);
+  for (const QString &pragma : storageProfilePragmas(m_storageProfile, true)) {
+    if (!query.exec(pragma)) {
+      qCWarning(lcStorage) << "Failed to apply" << pragma << ":" << query.lastError().text();
+    }
+  }
+
+  m_readPool.setConnectionPragmas(storageProfilePragmas(m_storageProfile, false));
+}
+
+void DatabaseManager::setStorageProfile(StorageProfile profile) {
+  QMutexLocker locker(&m_mutex);
+  m_storageProfile = profile;
+
+  if (m_db.isOpen()) {
+    applyStorageProfileLocked();
+  } else {
+    m_readPool.setConnectionPragmas(storageProfilePragmas(profile, false));
+  }
+}
+
+StorageProfile DatabaseManager::storageProfile() const {
+  QMutexLocker locker(&m_mutex);
+  return m_storageProfile;
+}
+
+void DatabaseManager::setCheckpointPolicy(const CheckpointPolicy &policy) {
+  QMutexLocker locker(&m_mutex);
+  m_checkpointer.setPolicy(policy);
+
+  if (m_db.isOpen()) {
+    QSqlQuery query(m_db);
+    query.exec(QString("PRAGMA journal_size_limit=%1").arg(policy.walSoftLimitBytes));
+  }
+}
+
+CheckpointPolicy DatabaseManager::checkpointPolicy() const { return m_checkpointer.policy(); }
+
+WalStats DatabaseManager::walStats() const { return m_checkpointer.stats(); }
+
+bool DatabaseManager::checkpointNow(WalCheckpointer::Mode mode) {
+  if (!isOpen()) {
+    setLastError("Database not open");
+    return false;
+  }
+
+  return m_checkpointer.checkpointNow(mode);
 }
 
 bool DatabaseManager::isOpen() const {
@@ -103,6 +617,59 @@ bool DatabaseManager::isOpen() const {
   return m_db.isOpen();
 }
 
+void DatabaseManager::releaseReadConnection() { m_readPool.releaseConnection(); }
+
+bool DatabaseManager::backupTo(const QString &targetPath, bool verify) {
+  QMutexLocker locker(&m_mutex);
+
+  if (!m_db.isOpen()) {
+    setLastError("Database not open");
+    return false;
+  }
+
+  if (QFileInfo(targetPath).absoluteFilePath() ==
+      QFileInfo(m_currentDbPath).absoluteFilePath()) {
+    setLastError("Backup target is the database itself");
+    return false;
+  }
+
+  // What VACUUM INTO will write: every page in use
+  qint64 expectedBytes = 0;
+  QSqlQuery query(m_db);
+  if (query.exec("SELECT (SELECT page_count FROM pragma_page_count) - "
+                 "(SELECT freelist_count FROM pragma_freelist_count), "
+                 "(SELECT page_size FROM pragma_page_size)") &&
+      query.next()) {
+    expectedBytes = query.value(0).toLongLong() * query.value(1).toLongLong();
+  }
+
+  if (!m_backup.start(m_currentDbPath, m_db.connectionName() + "_backup", targetPath,
+                      expectedBytes, verify)) {
+    setLastError("A backup is already running");
+    return false;
+  }
+
+  qCDebug(lcStorage) << "Backup started:" << m_currentDbPath << "->" << targetPath;
+  return true;
+}
+
+bool DatabaseManager::isBackupRunning() const { return m_backup.isRunning(); }
+
+QString DatabaseManager::getLastError() const {
+  QMutexLocker locker(&m_errorMutex);
+  return m_lastError;
+}
+
+void DatabaseManager::setLastError(const QString &error) {
+  // Readers on other threads report errors too, so this has its own lock
+  QMutexLocker locker(&m_errorMutex);
+  m_lastError = error;
+}
+
+void DatabaseManager::setDatabaseDirectory(const QString &directory) {
+  m_databaseDirectory = directory;
+}
+
 bool DatabaseManager::initializeSchema() {
   // Check if schema exists
   int version = getCurrentSchemaVersion();
@@ -118,9 +685,9 @@ bool DatabaseManager::initializeSchema() {
   } else if (version < CURRENT_SCHEMA_VERSION) {
     // Schema upgrade needed
     if (!migrateSchema(version, CURRENT_SCHEMA_VERSION)) {
-      m_lastError = QString("Failed to migrate schema from v%1 to v%2")
+      setLastError(QString("Failed to migrate schema from v%1 to v%2")
                         .arg(version)
-                        .arg(CURRENT_SCHEMA_VERSION);
+                        .arg(CURRENT_SCHEMA_VERSION));
       return false;
     }
   }
@@ -133,7 +700,7 @@ bool DatabaseManager::createTables() {
 
   // Start transaction
   if (!m_db.transaction()) {
-    m_lastError = "Failed to start transaction";
+    setLastError("Failed to start transaction");
     return false;
   }
 
@@ -141,8 +708,8 @@ bool DatabaseManager::createTables() {
   if (!query.exec("CREATE TABLE IF NOT EXISTS schema_version ("
                   "version INTEGER PRIMARY KEY, "
                   "applied_at INTEGER NOT NULL)")) {
-    m_lastError = QString("Failed to create schema_version table: %1")
-                      .arg(query.lastError().text());
+    setLastError(QString("Failed to create schema_version table: %1")
+                      .arg(query.lastError().text()));
     m_db.rollback();
     return false;
   }
@@ -159,35 +726,19 @@ bool DatabaseManager::createTables() {
                   "flags INTEGER, "
                   "last_connected_at INTEGER, "
                   "created_at INTEGER NOT NULL)")) {
-    m_lastError =
-        QString("Failed to create device_info table: %1").arg(query.lastError().text());
+    setLastError(
+        QString("Failed to create device_info table: %1").arg(query.lastError().text()));
     m_db.rollback();
     return false;
   }
 
   // Contacts table
-  if (!query.exec("CREATE TABLE IF NOT EXISTS contacts ("
-                  "public_key BLOB PRIMARY KEY, "
-                  "name TEXT NOT NULL, "
-                  "type INTEGER NOT NULL, "
-                  "flags INTEGER NOT NULL, "
-                  "path_length INTEGER, "
-                  "path BLOB, "
-                  "last_advert_timestamp INTEGER, "
-                  "last_modified INTEGER, "
-                  "latitude INTEGER, "
-                  "longitude INTEGER, "
-                  "created_at INTEGER NOT NULL, "
-                  "updated_at INTEGER NOT NULL)")) {
-    m_lastError =
-        QString("Failed to create contacts table: %1").arg(query.lastError().text());
+  if (!query.exec(contactsTableSql("contacts"))) {
+    setLastError(QString("Failed to create contacts table: %1").arg(query.lastError().text()));
     m_db.rollback();
     return false;
   }
 
-  query.exec("CREATE INDEX IF NOT EXISTS idx_contacts_name ON contacts(name)");
-  query.exec("CREATE INDEX IF NOT EXISTS idx_contacts_updated_at ON contacts(updated_at)");
-
   // Channels table
   if (!query.exec("CREATE TABLE IF NOT EXISTS channels ("
                   "idx INTEGER PRIMARY KEY, "
@@ -195,61 +746,36 @@ bool DatabaseManager::createTables() {
                   "secret BLOB NOT NULL, "
                   "created_at INTEGER NOT NULL, "
                   "updated_at INTEGER NOT NULL)")) {
-    m_lastError =
-        QString("Failed to create channels table: %1").arg(query.lastError().text());
+    setLastError(QString("Failed to create channels table: %1").arg(query.lastError().text()));
     m_db.rollback();
     return false;
   }
 
-  // Messages table
-  if (!query.exec("CREATE TABLE IF NOT EXISTS messages ("
-                  "id INTEGER PRIMARY KEY AUTOINCREMENT, "
-                  "message_type INTEGER NOT NULL, "
-                  "channel_idx INTEGER, "
-                  "sender_pubkey_prefix BLOB, "
-                  "sender_name TEXT, "
-                  "text TEXT NOT NULL, "
-                  "timestamp INTEGER NOT NULL, "
-                  "received_at INTEGER NOT NULL, "
-                  "path_length INTEGER, "
-                  "txt_type INTEGER, "
-                  "snr REAL, "
-                  "is_sent_by_me INTEGER DEFAULT 0, "
-                  "FOREIGN KEY (channel_idx) REFERENCES channels(idx) ON DELETE SET NULL)")) {
-    m_lastError =
-        QString("Failed to create messages table: %1").arg(query.lastError().text());
+  // Senders referenced by messages
+  if (!query.exec(sendersTableSql())) {
+    setLastError(QString("Failed to create senders table: %1").arg(query.lastError().text()));
     m_db.rollback();
     return false;
   }
 
-  query.exec(
-      "CREATE INDEX IF NOT EXISTS idx_messages_channel ON messages(channel_idx, timestamp "
-      "DESC)");
-  query.exec(
-      "CREATE INDEX IF NOT EXISTS idx_messages_sender ON messages(sender_pubkey_prefix, "
-      "timestamp DESC)");
-  query.exec(
-      "CREATE INDEX IF NOT EXISTS idx_messages_received_at ON messages(received_at DESC)");
-  query.exec("CREATE INDEX IF NOT EXISTS idx_messages_timestamp ON messages(timestamp DESC)");
-
   // Message hashes for deduplication
-  if (!query.exec("CREATE TABLE IF NOT EXISTS message_hashes ("
-                  "hash TEXT PRIMARY KEY, "
-                  "message_id INTEGER NOT NULL, "
-                  "created_at INTEGER NOT NULL, "
-                  "FOREIGN KEY (message_id) REFERENCES messages(id) ON DELETE CASCADE)")) {
-    m_lastError =
-        QString("Failed to create message_hashes table: %1").arg(query.lastError().text());
+  if (!query.exec(messageHashesTableSql("message_hashes"))) {
+    setLastError(
+        QString("Failed to create message_hashes table: %1").arg(query.lastError().text()));
     m_db.rollback();
     return false;
   }
 
-  query.exec(
-      "CREATE INDEX IF NOT EXISTS idx_message_hashes_created_at ON message_hashes(created_at)");
+  // Messages are stored in monthly partitions, created on first write
+  if (!createIndexes() || !createStatsTables() || !createConversationsTable() ||
+      !createPartitionTables()) {
+    m_db.rollback();
+    return false;
+  }
 
   // Commit transaction
   if (!m_db.commit()) {
-    m_lastError = "Failed to commit transaction";
+    setLastError("Failed to commit transaction");
     m_db.rollback();
     return false;
   }
@@ -257,6 +783,59 @@ bool DatabaseManager::createTables() {
   return true;
 }
 
+bool DatabaseManager::createIndexes() {
+  QSqlQuery query(m_db);
+
+  for (const char *statement : INDEX_STATEMENTS) {
+    if (!query.exec(QString::fromLatin1(statement))) {
+      setLastError(QString("Failed to create index: %1").arg(query.lastError().text()));
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool DatabaseManager::createStatsTables() {
+  QSqlQuery query(m_db);
+
+  for (const char *statement : STATS_TABLE_STATEMENTS) {
+    if (!query.exec(QString::fromLatin1(statement))) {
+      setLastError(
+          QString("Failed to create statistics tables: %1").arg(query.lastError().text()));
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool DatabaseManager::createConversationsTable() {
+  QSqlQuery query(m_db);
+
+  if (!query.exec(CONVERSATIONS_TABLE_SQL)) {
+    setLastError(
+        QString("Failed to create conversations table: %1").arg(query.lastError().text()));
+    return false;
+  }
+
+  return true;
+}
+
+bool DatabaseManager::createPartitionTables() {
+  QSqlQuery query(m_db);
+
+  for (const char *statement : PARTITION_TABLE_STATEMENTS) {
+    if (!query.exec(QString::fromLatin1(statement))) {
+      setLastError(
+          QString("Failed to create partition catalog: %1").arg(query.lastError().text()));
+      return false;
+    }
+  }
+
+  return true;
+}
+
 bool DatabaseManager::insertSchemaVersion(int version) {
   QSqlQuery query(m_db);
   query.prepare("INSERT INTO schema_version (version, applied_at) VALUES (?, ?)");
@@ -264,8 +843,7 @@ bool DatabaseManager::insertSchemaVersion(int version) {
   query.addBindValue(QDateTime::currentSecsSinceEpoch());
 
   if (!query.exec()) {
-    m_lastError =
-        QString("Failed to insert schema version: %1").arg(query.lastError().text());
+    setLastError(QString("Failed to insert schema version: %1").arg(query.lastError().text()));
     return false;
   }
 
@@ -285,722 +863,2909 @@ int DatabaseManager::getCurrentSchemaVersion() {
   return 0;
 }
 
-bool DatabaseManager::migrateSchema(int fromVersion, int toVersion) {
-  // Future migrations will be implemented here
-  // For now, we only have version 1
-  qDebug() << "Migration from version" << fromVersion << "to" << toVersion
-           << "not yet implemented";
-  return false;
-}
+// Schema migrations
 
-// Device info operations
+bool DatabaseManager::migrateSchema(int fromVersion, int toVersion) {
+  // Ordered list of upgrades; each entry moves the schema from version - 1 to
+  // version and records the new version in its final transaction
+  static const Migration migrations[] = {
+      {2, "sender table, covering history indexes, WITHOUT ROWID lookups",
+       &DatabaseManager::migrateToV2},
+      {3, "trigger-maintained message statistics", &DatabaseManager::migrateToV3},
+      {4, "conversation inbox with unread counters", &DatabaseManager::migrateToV4},
+      {5, "monthly message partitions", &DatabaseManager::migrateToV5},
+      {6, "compressed cold partitions", &DatabaseManager::migrateToV6},
+  };
+
+  QElapsedTimer totalTimer;
+  totalTimer.start();
+
+  // Table rebuilds need DROP TABLE without cascading into child tables, and
+  // foreign_keys cannot be toggled inside a transaction
+  QSqlQuery query(m_db);
+  query.exec("PRAGMA foreign_keys=OFF");
 
-bool DatabaseManager::saveDeviceInfo(const DeviceInfo &deviceInfo,
-                                     const SelfInfo &selfInfo) {
-  QMutexLocker locker(&m_mutex);
+  bool ok = true;
+  for (const Migration &migration : migrations) {
+    if (migration.version <= fromVersion || migration.version > toVersion) {
+      continue;
+    }
 
-  if (!m_db.isOpen()) {
-    m_lastError = "Database not open";
-    return false;
-  }
+    qCDebug(lcStorage) << "Migrating schema to v" << migration.version << ":"
+                       << migration.description;
 
-  QSqlQuery query(m_db);
-  query.prepare("INSERT OR REPLACE INTO device_info "
-                "(id, public_key, node_name, firmware_version, firmware_name, "
-                "protocol_version, contact_type, flags, last_connected_at, created_at) "
-                "VALUES (1, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+    QElapsedTimer stepTimer;
+    stepTimer.start();
 
-  query.addBindValue(selfInfo.publicKey);
-  query.addBindValue(selfInfo.nodeName);
-  query.addBindValue(deviceInfo.firmwareVersion);
-  query.addBindValue(deviceInfo.firmwareName);
-  query.addBindValue(deviceInfo.protocolVersion);
-  query.addBindValue(selfInfo.contactType);
-  query.addBindValue(selfInfo.flags);
-  query.addBindValue(QDateTime::currentSecsSinceEpoch());
-  query.addBindValue(QDateTime::currentSecsSinceEpoch());
+    if (!(this->*migration.apply)()) {
+      qCWarning(lcStorage) << "Migration to v" << migration.version << "failed:" << getLastError();
+      ok = false;
+      break;
+    }
 
-  if (!query.exec()) {
-    m_lastError = QString("Failed to save device info: %1").arg(query.lastError().text());
-    qWarning() << m_lastError;
-    return false;
+    qCDebug(lcStorage) << "Schema v" << migration.version << "applied in" << stepTimer.elapsed()
+                       << "ms";
   }
 
-  return true;
-}
-
-bool DatabaseManager::loadDeviceInfo(DeviceInfo &deviceInfo, SelfInfo &selfInfo) {
-  QMutexLocker locker(&m_mutex);
+  query.exec("PRAGMA foreign_keys=ON");
 
-  if (!m_db.isOpen()) {
-    m_lastError = "Database not open";
-    return false;
+  if (ok) {
+    qint64 elapsedMs = totalTimer.elapsed();
+    qCDebug(lcStorage) << "Schema migrated from v" << fromVersion << "to v" << toVersion << "in"
+                       << elapsedMs << "ms";
+    emit schemaMigrated(fromVersion, toVersion, elapsedMs);
   }
 
+  return ok;
+}
+
+qint64 DatabaseManager::migrationCursor(int version, const QString &step) {
   QSqlQuery query(m_db);
-  if (!query.exec("SELECT public_key, node_name, firmware_version, firmware_name, "
-                  "protocol_version, contact_type, flags FROM device_info WHERE id = 1")) {
-    m_lastError = QString("Failed to load device info: %1").arg(query.lastError().text());
-    return false;
-  }
+  query.prepare("SELECT cursor FROM migration_progress WHERE version = ? AND step = ?");
+  query.addBindValue(version);
+  query.addBindValue(step);
 
-  if (query.next()) {
-    selfInfo.publicKey = query.value(0).toByteArray();
-    selfInfo.nodeName = query.value(1).toString();
-    deviceInfo.firmwareVersion = query.value(2).toUInt();
-    deviceInfo.firmwareName = query.value(3).toString();
-    deviceInfo.protocolVersion = query.value(4).toUInt();
-    selfInfo.contactType = query.value(5).toUInt();
-    selfInfo.flags = query.value(6).toUInt();
-    return true;
+  if (query.exec() && query.next()) {
+    return query.value(0).toLongLong();
   }
 
-  return false; // No device info found
+  return 0;
 }
 
-bool DatabaseManager::updateLastConnectedTime() {
-  QMutexLocker locker(&m_mutex);
-
-  if (!m_db.isOpen()) {
-    m_lastError = "Database not open";
+bool DatabaseManager::runResumableStep(int version, const QString &step,
+                                       const QString &sourceTable,
+                                       const std::function<bool(qint64, qint64)> &copyRange) {
+  QSqlQuery query(m_db);
+  if (!query.exec(QString("SELECT MAX(rowid) FROM %1").arg(sourceTable)) || !query.next()) {
+    setLastError(QString("Failed to size %1: %2").arg(sourceTable, query.lastError().text()));
     return false;
   }
 
-  QSqlQuery query(m_db);
-  query.prepare("UPDATE device_info SET last_connected_at = ? WHERE id = 1");
-  query.addBindValue(QDateTime::currentSecsSinceEpoch());
+  const qint64 lastRowId = query.value(0).toLongLong();
+  query.finish();
 
-  if (!query.exec()) {
-    m_lastError =
-        QString("Failed to update last connected time: %1").arg(query.lastError().text());
-    return false;
+  // Each range commits together with its cursor, so an interrupted migration
+  // resumes after the last committed batch instead of starting over
+  qint64 cursor = migrationCursor(version, step);
+  if (cursor > 0) {
+    qCDebug(lcStorage) << "Resuming migration step" << step << "at rowid" << cursor << "of"
+                       << lastRowId;
   }
 
-  return true;
-}
+  while (cursor < lastRowId) {
+    qint64 upper = qMin(cursor + MIGRATION_BATCH_SIZE, lastRowId);
 
-// Contact operations
+    if (!m_db.transaction()) {
+      setLastError("Failed to start migration transaction");
+      return false;
+    }
 
-bool DatabaseManager::saveContact(const Contact &contact) {
-  QMutexLocker locker(&m_mutex);
+    QSqlQuery progress(m_db);
+    progress.prepare("INSERT OR REPLACE INTO migration_progress (version, step, cursor) "
+                     "VALUES (?, ?, ?)");
+    progress.addBindValue(version);
+    progress.addBindValue(step);
+    progress.addBindValue(upper);
 
-  if (!m_db.isOpen()) {
-    m_lastError = "Database not open";
-    return false;
-  }
+    if (!copyRange(cursor, upper)) {
+      m_db.rollback();
+      return false;
+    }
 
-  QSqlQuery query(m_db);
-  query.prepare(
-      "INSERT OR REPLACE INTO contacts "
-      "(public_key, name, type, flags, path_length, path, last_advert_timestamp, "
-      "last_modified, latitude, longitude, created_at, updated_at) "
-      "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, "
-      "COALESCE((SELECT created_at FROM contacts WHERE public_key = ?), ?), ?)");
-
-  query.addBindValue(contact.publicKey());
-  query.addBindValue(contact.name());
-  query.addBindValue(contact.type());
-  query.addBindValue(contact.flags());
-  query.addBindValue(contact.pathLength());
-  query.addBindValue(contact.path());
-  query.addBindValue(contact.lastAdvertTimestamp());
-  query.addBindValue(contact.lastModified());
-  query.addBindValue(contact.latitude());
-  query.addBindValue(contact.longitude());
-  query.addBindValue(contact.publicKey()); // For COALESCE
-  query.addBindValue(QDateTime::currentSecsSinceEpoch()); // created_at if new
-  query.addBindValue(QDateTime::currentSecsSinceEpoch()); // updated_at
+    if (!progress.exec()) {
+      setLastError(
+          QString("Failed to record migration progress: %1").arg(progress.lastError().text()));
+      m_db.rollback();
+      return false;
+    }
 
-  if (!query.exec()) {
-    m_lastError = QString("Failed to save contact: %1").arg(query.lastError().text());
-    qWarning() << m_lastError;
-    return false;
+    if (!m_db.commit()) {
+      setLastError("Failed to commit migration batch");
+      m_db.rollback();
+      return false;
+    }
+
+    cursor = upper;
+    emit migrationProgress(version, step, cursor, lastRowId);
   }
 
   return true;
 }
 
-bool DatabaseManager::saveContacts(const QVector<Contact> &contacts) {
-  QMutexLocker locker(&m_mutex);
-
-  if (!m_db.isOpen()) {
-    m_lastError = "Database not open";
-    return false;
-  }
+bool DatabaseManager::migrateToV2() {
+  QSqlQuery query(m_db);
 
+  // Staging tables are created with IF NOT EXISTS so a resumed run keeps the
+  // batches it already copied
   if (!m_db.transaction()) {
-    m_lastError = "Failed to start transaction";
+    setLastError("Failed to start transaction");
     return false;
   }
 
-  for (const Contact &contact : contacts) {
-    QSqlQuery query(m_db);
-    query.prepare(
-        "INSERT OR REPLACE INTO contacts "
-        "(public_key, name, type, flags, path_length, path, last_advert_timestamp, "
-        "last_modified, latitude, longitude, created_at, updated_at) "
-        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, "
-        "COALESCE((SELECT created_at FROM contacts WHERE public_key = ?), ?), ?)");
-
-    query.addBindValue(contact.publicKey());
-    query.addBindValue(contact.name());
-    query.addBindValue(contact.type());
-    query.addBindValue(contact.flags());
-    query.addBindValue(contact.pathLength());
-    query.addBindValue(contact.path());
-    query.addBindValue(contact.lastAdvertTimestamp());
-    query.addBindValue(contact.lastModified());
-    query.addBindValue(contact.latitude());
-    query.addBindValue(contact.longitude());
-    query.addBindValue(contact.publicKey());
-    query.addBindValue(QDateTime::currentSecsSinceEpoch());
-    query.addBindValue(QDateTime::currentSecsSinceEpoch());
+  const QStringList stagingStatements = {
+      MIGRATION_PROGRESS_TABLE_SQL,
+      sendersTableSql(),
+      messagesTableSql("messages_v2"),
+      messageHashesTableSql("message_hashes_v2"),
+      contactsTableSql("contacts_v2"),
+  };
 
-    if (!query.exec()) {
-      m_lastError = QString("Failed to save contact batch: %1").arg(query.lastError().text());
+  for (const QString &statement : stagingStatements) {
+    if (!query.exec(statement)) {
+      setLastError(QString("Failed to create v2 tables: %1").arg(query.lastError().text()));
       m_db.rollback();
       return false;
     }
   }
 
   if (!m_db.commit()) {
-    m_lastError = "Failed to commit contacts transaction";
+    setLastError("Failed to commit v2 staging tables");
     m_db.rollback();
     return false;
   }
 
-  return true;
-}
-
-bool DatabaseManager::deleteContact(const QByteArray &publicKey) {
-  QMutexLocker locker(&m_mutex);
+  // Messages: intern sender identities, then copy rows with the sender id
+  bool copied = runResumableStep(2, "messages", "messages", [this](qint64 lo, qint64 hi) {
+    QSqlQuery senders(m_db);
+    senders.prepare("INSERT OR IGNORE INTO senders (pubkey_prefix, name) "
+                    "SELECT DISTINCT COALESCE(sender_pubkey_prefix, x''), "
+                    "COALESCE(sender_name, '') "
+                    "FROM messages WHERE id > ? AND id <= ?");
+    senders.addBindValue(lo);
+    senders.addBindValue(hi);
+
+    QSqlQuery rows(m_db);
+    rows.prepare("INSERT INTO messages_v2 "
+                 "(id, message_type, channel_idx, sender_id, text, timestamp, "
+                 "received_at, path_length, txt_type, snr, is_sent_by_me) "
+                 "SELECT m.id, m.message_type, m.channel_idx, s.id, m.text, m.timestamp, "
+                 "m.received_at, m.path_length, m.txt_type, m.snr, m.is_sent_by_me "
+                 "FROM messages m JOIN senders s "
+                 "ON s.pubkey_prefix = COALESCE(m.sender_pubkey_prefix, x'') "
+                 "AND s.name = COALESCE(m.sender_name, '') "
+                 "WHERE m.id > ? AND m.id <= ?");
+    rows.addBindValue(lo);
+    rows.addBindValue(hi);
+
+    if (!senders.exec() || !rows.exec()) {
+      setLastError(QString("Failed to copy messages: %1")
+                        .arg(senders.lastError().isValid() ? senders.lastError().text()
+                                                           : rows.lastError().text()));
+      return false;
+    }
+    return true;
+  });
 
-  if (!m_db.isOpen()) {
-    m_lastError = "Database not open";
+  if (!copied) {
+    return false;
+  }
+
+  // Dedup hashes: hex TEXT keys become 32-byte BLOB keys
+  copied = runResumableStep(2, "message_hashes", "message_hashes", [this](qint64 lo, qint64 hi) {
+    QSqlQuery select(m_db);
+    select.setForwardOnly(true);
+    select.prepare("SELECT hash, message_id, created_at FROM message_hashes "
+                   "WHERE rowid > ? AND rowid <= ?");
+    select.addBindValue(lo);
+    select.addBindValue(hi);
+
+    if (!select.exec()) {
+      setLastError(
+          QString("Failed to read message hashes: %1").arg(select.lastError().text()));
+      return false;
+    }
+
+    QSqlQuery insert(m_db);
+    insert.prepare("INSERT OR IGNORE INTO message_hashes_v2 (hash, message_id, created_at) "
+                   "VALUES (?, ?, ?)");
+
+    while (select.next()) {
+      insert.bindValue(0, QByteArray::fromHex(select.value(0).toString().toLatin1()));
+      insert.bindValue(1, select.value(1));
+      insert.bindValue(2, select.value(2));
+
+      if (!insert.exec()) {
+        setLastError(
+            QString("Failed to copy message hash: %1").arg(insert.lastError().text()));
+        return false;
+      }
+    }
+    return true;
+  });
+
+  if (!copied) {
+    return false;
+  }
+
+  // Swap the rebuilt tables in and record the new version atomically
+  if (!m_db.transaction()) {
+    setLastError("Failed to start transaction");
+    return false;
+  }
+
+  const QStringList swapStatements = {
+      "INSERT OR REPLACE INTO contacts_v2 "
+      "(public_key, name, type, flags, path_length, path, last_advert_timestamp, "
+      "last_modified, latitude, longitude, created_at, updated_at) "
+      "SELECT public_key, name, type, flags, path_length, path, last_advert_timestamp, "
+      "last_modified, latitude, longitude, created_at, updated_at FROM contacts",
+      "DROP TABLE message_hashes",
+      "DROP TABLE messages",
+      "DROP TABLE contacts",
+      "ALTER TABLE messages_v2 RENAME TO messages",
+      "ALTER TABLE message_hashes_v2 RENAME TO message_hashes",
+      "ALTER TABLE contacts_v2 RENAME TO contacts",
+      "DELETE FROM migration_progress WHERE version = 2",
+  };
+
+  for (const QString &statement : swapStatements) {
+    if (!query.exec(statement)) {
+      setLastError(QString("Failed to swap v2 tables: %1").arg(query.lastError().text()));
+      m_db.rollback();
+      return false;
+    }
+  }
+
+  for (const QString &statement : messageIndexSql("messages")) {
+    if (!query.exec(statement)) {
+      setLastError(QString("Failed to create v2 indexes: %1").arg(query.lastError().text()));
+      m_db.rollback();
+      return false;
+    }
+  }
+
+  if (!createIndexes() || !insertSchemaVersion(2)) {
+    m_db.rollback();
+    return false;
+  }
+
+  if (query.exec("PRAGMA foreign_key_check") && query.next()) {
+    qCWarning(lcStorage) << "Foreign key violations after v2 migration in table"
+                         << query.value(0).toString();
+  }
+
+  if (!m_db.commit()) {
+    setLastError("Failed to commit v2 migration");
+    m_db.rollback();
     return false;
   }
 
+  return true;
+}
+
+bool DatabaseManager::migrateToV3() {
   QSqlQuery query(m_db);
-  query.prepare("DELETE FROM contacts WHERE public_key = ?");
-  query.addBindValue(publicKey);
 
-  if (!query.exec()) {
-    m_lastError = QString("Failed to delete contact: %1").arg(query.lastError().text());
+  if (!m_db.transaction()) {
+    setLastError("Failed to start transaction");
+    return false;
+  }
+
+  QStringList statements = {MIGRATION_PROGRESS_TABLE_SQL};
+  for (const char *statement : STATS_TABLE_STATEMENTS) {
+    statements << QString::fromLatin1(statement);
+  }
+
+  for (const QString &statement : statements) {
+    if (!query.exec(statement)) {
+      setLastError(QString("Failed to create v3 tables: %1").arg(query.lastError().text()));
+      m_db.rollback();
+      return false;
+    }
+  }
+
+  if (!m_db.commit()) {
+    setLastError("Failed to commit v3 tables");
+    m_db.rollback();
+    return false;
+  }
+
+  // Backfill from existing history in rowid ranges, merging each range's
+  // partial aggregates into the tables
+  const QStringList backfillStatements = {
+      "INSERT INTO stats_channel_totals (channel_key, message_count) "
+      "SELECT COALESCE(channel_idx, -1), COUNT(*) FROM messages "
+      "WHERE id > :lo AND id <= :hi GROUP BY 1 "
+      "ON CONFLICT(channel_key) DO UPDATE "
+      "SET message_count = message_count + excluded.message_count",
+      "INSERT INTO stats_hourly (hour, channel_key, message_count) "
+      "SELECT received_at / 3600, COALESCE(channel_idx, -1), COUNT(*) FROM messages "
+      "WHERE id > :lo AND id <= :hi GROUP BY 1, 2 "
+      "ON CONFLICT(hour, channel_key) DO UPDATE "
+      "SET message_count = message_count + excluded.message_count",
+      "INSERT INTO stats_senders (sender_id, message_count, last_received_at) "
+      "SELECT sender_id, COUNT(*), MAX(received_at) FROM messages "
+      "WHERE id > :lo AND id <= :hi GROUP BY 1 "
+      "ON CONFLICT(sender_id) DO UPDATE "
+      "SET message_count = message_count + excluded.message_count, "
+      "last_received_at = MAX(last_received_at, excluded.last_received_at)",
+      "INSERT INTO stats_snr_histogram (bucket, message_count) "
+      "SELECT CAST(ROUND(snr) AS INTEGER), COUNT(*) FROM messages "
+      "WHERE id > :lo AND id <= :hi AND snr IS NOT NULL GROUP BY 1 "
+      "ON CONFLICT(bucket) DO UPDATE "
+      "SET message_count = message_count + excluded.message_count",
+      "INSERT INTO stats_path_histogram (path_length, message_count) "
+      "SELECT path_length, COUNT(*) FROM messages "
+      "WHERE id > :lo AND id <= :hi AND path_length IS NOT NULL GROUP BY 1 "
+      "ON CONFLICT(path_length) DO UPDATE "
+      "SET message_count = message_count + excluded.message_count",
+  };
+
+  bool copied = runResumableStep(3, "stats", "messages", [&](qint64 lo, qint64 hi) {
+    for (const QString &statement : backfillStatements) {
+      QSqlQuery backfill(m_db);
+      backfill.prepare(statement);
+      backfill.bindValue(":lo", lo);
+      backfill.bindValue(":hi", hi);
+
+      if (!backfill.exec()) {
+        setLastError(
+            QString("Failed to backfill statistics: %1").arg(backfill.lastError().text()));
+        return false;
+      }
+    }
+    return true;
+  });
+
+  if (!copied) {
+    return false;
+  }
+
+  // Triggers take over from here; they go in with the version bump so a
+  // resumed backfill never double counts rows
+  if (!m_db.transaction()) {
+    setLastError("Failed to start transaction");
+    return false;
+  }
+
+  for (const QString &statement : statsTriggerSql("messages")) {
+    if (!query.exec(statement)) {
+      setLastError(
+          QString("Failed to create statistics triggers: %1").arg(query.lastError().text()));
+      m_db.rollback();
+      return false;
+    }
+  }
+
+  if (!query.exec("DELETE FROM migration_progress WHERE version = 3") ||
+      !insertSchemaVersion(3)) {
+    if (query.lastError().isValid()) {
+      setLastError(
+          QString("Failed to finish v3 migration: %1").arg(query.lastError().text()));
+    }
+    m_db.rollback();
+    return false;
+  }
+
+  if (!m_db.commit()) {
+    setLastError("Failed to commit v3 migration");
+    m_db.rollback();
     return false;
   }
 
   return true;
 }
 
-QVector<Contact> DatabaseManager::loadAllContacts() {
-  QMutexLocker locker(&m_mutex);
-  QVector<Contact> contacts;
+bool DatabaseManager::migrateToV4() {
+  QSqlQuery query(m_db);
 
-  if (!m_db.isOpen()) {
-    m_lastError = "Database not open";
-    return contacts;
+  if (!m_db.transaction()) {
+    setLastError("Failed to start transaction");
+    return false;
+  }
+
+  if (!createConversationsTable()) {
+    m_db.rollback();
+    return false;
   }
 
+  for (const QString &statement : conversationTriggerSql("messages")) {
+    if (!query.exec(statement)) {
+      setLastError(QString("Failed to create conversation triggers: %1")
+                       .arg(query.lastError().text()));
+      m_db.rollback();
+      return false;
+    }
+  }
+
+  // Existing history is treated as read. The bare id/timestamp columns come
+  // from the row holding MAX(id).
+  const QStringList backfillStatements = {
+      "INSERT OR IGNORE INTO conversations "
+      "(kind, peer, last_message_id, last_timestamp, unread_count, last_read_message_id) "
+      "SELECT 0, channel_idx, MAX(id), timestamp, 0, MAX(id) FROM messages "
+      "WHERE message_type = 0 AND channel_idx IS NOT NULL GROUP BY channel_idx",
+      "INSERT OR IGNORE INTO conversations "
+      "(kind, peer, last_message_id, last_timestamp, unread_count, last_read_message_id) "
+      "SELECT 1, s.pubkey_prefix, MAX(m.id), m.timestamp, 0, MAX(m.id) "
+      "FROM messages m JOIN senders s ON s.id = m.sender_id "
+      "WHERE m.message_type = 1 GROUP BY s.pubkey_prefix",
+  };
+
+  for (const QString &statement : backfillStatements) {
+    if (!query.exec(statement)) {
+      setLastError(
+          QString("Failed to backfill conversations: %1").arg(query.lastError().text()));
+      m_db.rollback();
+      return false;
+    }
+  }
+
+  if (!insertSchemaVersion(4)) {
+    m_db.rollback();
+    return false;
+  }
+
+  if (!m_db.commit()) {
+    setLastError("Failed to commit v4 migration");
+    m_db.rollback();
+    return false;
+  }
+
+  return true;
+}
+
+bool DatabaseManager::migrateToV5() {
   QSqlQuery query(m_db);
-  if (!query.exec("SELECT public_key, name, type, flags, path_length, path, "
-                  "last_advert_timestamp, last_modified, latitude, longitude "
-                  "FROM contacts ORDER BY name")) {
-    m_lastError = QString("Failed to load contacts: %1").arg(query.lastError().text());
-    return contacts;
+
+  if (!m_db.transaction()) {
+    setLastError("Failed to start transaction");
+    return false;
   }
 
-  while (query.next()) {
-    Contact contact(query.value(0).toByteArray(), // public_key
-                    query.value(1).toString(),    // name
-                    query.value(2).toUInt());     // type
+  if (!createPartitionTables()) {
+    m_db.rollback();
+    return false;
+  }
 
-    contact.setFlags(query.value(3).toUInt());
-    contact.setPath(query.value(5).toByteArray(), query.value(4).toInt());
-    contact.setLastAdvertTimestamp(query.value(6).toUInt());
-    contact.setLastModified(query.value(7).toUInt());
-    contact.setLocation(query.value(8).toInt(), query.value(9).toInt());
+  // The existing table becomes the oldest partition. Everything in it was
+  // received before now; new messages go to monthly tables, so once its
+  // period has passed the age limit it is dropped whole.
+  qint64 now = QDateTime::currentSecsSinceEpoch();
+  QStringList statements = {
+      QString("INSERT OR IGNORE INTO message_partitions "
+              "(name, period_start, period_end, min_id, max_id, min_timestamp, "
+              "max_timestamp, created_at) "
+              "SELECT 'messages', 0, %1, MIN(id), MAX(id), MIN(timestamp), "
+              "MAX(timestamp), %1 FROM messages")
+          .arg(now),
+      "INSERT OR IGNORE INTO stats_partition_totals "
+      "(partition_name, channel_key, message_count) "
+      "SELECT 'messages', channel_key, message_count FROM stats_channel_totals",
+  };
+  statements << partitionTriggerSql("messages");
+
+  // Dedup hashes lose their foreign key to the legacy table; the table is
+  // short-lived (see hashRetentionDays), so a straight copy is cheap
+  statements << messageHashesTableSql("message_hashes_v5")
+             << "INSERT INTO message_hashes_v5 (hash, message_id, created_at) "
+                "SELECT hash, message_id, created_at FROM message_hashes"
+             << "DROP TABLE message_hashes"
+             << "ALTER TABLE message_hashes_v5 RENAME TO message_hashes";
+
+  for (const QString &statement : statements) {
+    if (!query.exec(statement)) {
+      setLastError(QString("Failed to apply v5 migration: %1").arg(query.lastError().text()));
+      m_db.rollback();
+      return false;
+    }
+  }
 
-    contacts.append(contact);
+  if (!createIndexes() || !insertSchemaVersion(5)) {
+    m_db.rollback();
+    return false;
   }
 
-  return contacts;
+  if (!m_db.commit()) {
+    setLastError("Failed to commit v5 migration");
+    m_db.rollback();
+    return false;
+  }
+
+  return true;
 }
 
-Contact DatabaseManager::loadContact(const QByteArray &publicKey) {
-  QMutexLocker locker(&m_mutex);
+bool DatabaseManager::migrateToV6() {
+  if (!m_db.transaction()) {
+    setLastError("Failed to start transaction");
+    return false;
+  }
 
-  if (!m_db.isOpen()) {
-    m_lastError = "Database not open";
-    return Contact();
+  // Only new columns and the dictionary table; existing rows stay plain
+  // until the retention timer compresses their partition
+  if (!createPartitionTables()) {
+    m_db.rollback();
+    return false;
+  }
+
+  for (const auto &column : PARTITION_CATALOG_V6_COLUMNS) {
+    if (!addColumnIfMissing("message_partitions", column[0], column[1])) {
+      m_db.rollback();
+      return false;
+    }
   }
 
+  QStringList partitions;
   QSqlQuery query(m_db);
-  query.prepare("SELECT public_key, name, type, flags, path_length, path, "
-                "last_advert_timestamp, last_modified, latitude, longitude "
-                "FROM contacts WHERE public_key = ?");
-  query.addBindValue(publicKey);
+  if (!query.exec("SELECT name FROM message_partitions")) {
+    setLastError(QString("Failed to apply v6 migration: %1").arg(query.lastError().text()));
+    m_db.rollback();
+    return false;
+  }
+  while (query.next()) {
+    partitions.append(query.value(0).toString());
+  }
 
-  if (!query.exec() || !query.next()) {
-    return Contact();
+  for (const QString &partition : std::as_const(partitions)) {
+    if (!addColumnIfMissing(partition, "text_z", "BLOB") ||
+        !addColumnIfMissing(partition, "dict_id", "INTEGER")) {
+      m_db.rollback();
+      return false;
+    }
   }
 
-  Contact contact(query.value(0).toByteArray(), query.value(1).toString(),
-                  query.value(2).toUInt());
+  if (!insertSchemaVersion(6)) {
+    m_db.rollback();
+    return false;
+  }
 
-  contact.setFlags(query.value(3).toUInt());
-  contact.setPath(query.value(5).toByteArray(), query.value(4).toInt());
-  contact.setLastAdvertTimestamp(query.value(6).toUInt());
-  contact.setLastModified(query.value(7).toUInt());
-  contact.setLocation(query.value(8).toInt(), query.value(9).toInt());
+  if (!m_db.commit()) {
+    setLastError("Failed to commit v6 migration");
+    m_db.rollback();
+    return false;
+  }
 
-  return contact;
+  return true;
 }
 
-// Channel operations
+bool DatabaseManager::addColumnIfMissing(const QString &table, const QString &column,
+                                         const QString &type) {
+  // Tables created by an earlier migration in the same upgrade already have
+  // the current columns
+  QSqlQuery query(m_db);
+  if (!query.exec(QString("PRAGMA table_info(%1)").arg(table))) {
+    setLastError(QString("Failed to inspect %1: %2").arg(table, query.lastError().text()));
+    return false;
+  }
 
-bool DatabaseManager::saveChannel(const Channel &channel) {
-  QMutexLocker locker(&m_mutex);
+  while (query.next()) {
+    if (query.value(1).toString() == column) {
+      return true;
+    }
+  }
 
-  if (!m_db.isOpen()) {
-    m_lastError = "Database not open";
+  if (!query.exec(QString("ALTER TABLE %1 ADD COLUMN %2 %3").arg(table, column, type))) {
+    setLastError(QString("Failed to add %1.%2: %3")
+                     .arg(table, column, query.lastError().text()));
     return false;
   }
 
+  return true;
+}
+
+// Message partitions
+
+QString DatabaseManager::partitionNameFor(qint64 receivedAt, qint64 *periodStart,
+                                          qint64 *periodEnd) {
+  QDate date = QDateTime::fromSecsSinceEpoch(receivedAt, QTimeZone::utc()).date();
+  QDate monthStart(date.year(), date.month(), 1);
+
+  if (periodStart) {
+    *periodStart = monthStart.startOfDay(QTimeZone::utc()).toSecsSinceEpoch();
+  }
+  if (periodEnd) {
+    *periodEnd = monthStart.addMonths(1).startOfDay(QTimeZone::utc()).toSecsSinceEpoch();
+  }
+
+  return QString("messages_%1").arg(monthStart.toString("yyyyMM"));
+}
+
+bool DatabaseManager::loadPartitionsLocked() {
+  m_partitions.clear();
+  m_nextMessageId = 1;
+
   QSqlQuery query(m_db);
-  query.prepare("INSERT OR REPLACE INTO channels "
-                "(idx, name, secret, created_at, updated_at) "
-                "VALUES (?, ?, ?, "
-                "COALESCE((SELECT created_at FROM channels WHERE idx = ?), ?), ?)");
+  if (!query.exec("SELECT name, period_start, period_end, compressed_at IS NOT NULL "
+                  "FROM message_partitions ORDER BY period_start, period_end")) {
+    setLastError(QString("Failed to load partitions: %1").arg(query.lastError().text()));
+    return false;
+  }
 
-  query.addBindValue(channel.index);
-  query.addBindValue(channel.name);
-  query.addBindValue(channel.secret);
-  query.addBindValue(channel.index); // For COALESCE
-  query.addBindValue(QDateTime::currentSecsSinceEpoch()); // created_at if new
-  query.addBindValue(QDateTime::currentSecsSinceEpoch()); // updated_at
+  while (query.next()) {
+    m_partitions.append({query.value(0).toString(), query.value(1).toLongLong(),
+                         query.value(2).toLongLong(), query.value(3).toBool()});
+  }
 
-  if (!query.exec()) {
-    m_lastError = QString("Failed to save channel: %1").arg(query.lastError().text());
-    qWarning() << m_lastError;
+  // Ids continue from the highest one in use (a rowid lookup per partition)
+  for (const MessagePartition &partition : std::as_const(m_partitions)) {
+    QSqlQuery maxQuery(m_db);
+    if (maxQuery.exec(QString("SELECT MAX(id) FROM %1").arg(partition.name)) &&
+        maxQuery.next()) {
+      m_nextMessageId = qMax(m_nextMessageId, maxQuery.value(0).toLongLong() + 1);
+    }
+  }
+
+  return true;
+}
+
+bool DatabaseManager::loadCompressionDictionariesLocked() {
+  m_textCodec.clear();
+
+  QSqlQuery query(m_db);
+  if (!query.exec("SELECT id, codec, dictionary FROM compression_dictionaries")) {
+    setLastError(
+        QString("Failed to load compression dictionaries: %1").arg(query.lastError().text()));
     return false;
   }
 
+  while (query.next()) {
+    // Dictionaries are deleted with the partition they belong to, so one
+    // that is still here means rows this build could not read back
+    const auto codec = static_cast<MessageTextCodec::Codec>(query.value(1).toInt());
+    if (codec == MessageTextCodec::ZstdDictionary && !MessageTextCodec::hasZstd()) {
+      setLastError(QString("Database holds zstd-compressed messages (dictionary %1), "
+                           "but this build lacks zstd")
+                       .arg(query.value(0).toInt()));
+      m_textCodec.clear();
+      return false;
+    }
+    m_textCodec.addDictionary(query.value(0).toInt(), codec, query.value(2).toByteArray());
+  }
+
   return true;
 }
 
-bool DatabaseManager::saveChannels(const QVector<Channel> &channels) {
+QString DatabaseManager::ensurePartitionLocked(qint64 receivedAt) {
+  qint64 periodStart = 0;
+  qint64 periodEnd = 0;
+  QString name = partitionNameFor(receivedAt, &periodStart, &periodEnd);
+
+  for (const MessagePartition &partition : std::as_const(m_partitions)) {
+    if (partition.name == name) {
+      return name;
+    }
+  }
+
+  // New period: the table, its indexes and triggers and the catalog row are
+  // created together, before the message transaction that first uses them
+  if (!m_db.transaction()) {
+    setLastError("Failed to start transaction");
+    return QString();
+  }
+
+  QStringList statements = {messagesTableSql(name, false)};
+  statements << partitionObjectsSql(name);
+
+  QSqlQuery query(m_db);
+  for (const QString &statement : statements) {
+    if (!m_profiler.exec(query, statement)) {
+      setLastError(QString("Failed to create partition %1: %2")
+                       .arg(name, query.lastError().text()));
+      m_db.rollback();
+      return QString();
+    }
+  }
+
+  query.prepare("INSERT INTO message_partitions (name, period_start, period_end, created_at) "
+                "VALUES (?, ?, ?, ?)");
+  query.addBindValue(name);
+  query.addBindValue(periodStart);
+  query.addBindValue(periodEnd);
+  query.addBindValue(QDateTime::currentSecsSinceEpoch());
+
+  if (!m_profiler.exec(query) || !m_db.commit()) {
+    setLastError(QString("Failed to register partition %1: %2")
+                     .arg(name, query.lastError().text()));
+    m_db.rollback();
+    return QString();
+  }
+
+  m_partitions.append({name, periodStart, periodEnd});
+  std::sort(m_partitions.begin(), m_partitions.end(),
+            [](const MessagePartition &a, const MessagePartition &b) {
+              return a.periodStart < b.periodStart;
+            });
+
+  qCDebug(lcStorage) << "Created message partition" << name;
+  return name;
+}
+
+qint64 DatabaseManager::dropPartitionLocked(const QString &name) {
+  QSqlQuery query(m_db);
+  query.prepare("SELECT COALESCE(SUM(message_count), 0) FROM stats_partition_totals "
+                "WHERE partition_name = ?");
+  query.addBindValue(name);
+  qint64 rows = (m_profiler.exec(query) && query.next()) ? query.value(0).toLongLong() : 0;
+  query.finish();
+
+  if (!m_db.transaction()) {
+    setLastError("Failed to start transaction");
+    return -1;
+  }
+
+  // Dropping the table skips the per-row triggers, so the aggregates that
+  // track stored rows are adjusted from the partition's own totals, and the
+  // inbox entries from the rows themselves
+  if (!detachConversationsLocked(name)) {
+    m_db.rollback();
+    return -1;
+  }
+
+  const QStringList statements = {
+      "UPDATE stats_channel_totals SET message_count = message_count - COALESCE("
+      "(SELECT t.message_count FROM stats_partition_totals t "
+      "WHERE t.partition_name = ? AND t.channel_key = stats_channel_totals.channel_key), 0)",
+      "DELETE FROM stats_partition_totals WHERE partition_name = ?",
+      "DELETE FROM compression_dictionaries WHERE id = "
+      "(SELECT dict_id FROM message_partitions WHERE name = ?)",
+      "DELETE FROM message_partitions WHERE name = ?",
+  };
+
+  for (const QString &statement : statements) {
+    QSqlQuery update(m_db);
+    update.prepare(statement);
+    for (int i = 0; i < statement.count('?'); ++i) {
+      update.addBindValue(name);
+    }
+    if (!m_profiler.exec(update)) {
+      setLastError(QString("Failed to drop partition %1: %2")
+                       .arg(name, update.lastError().text()));
+      m_db.rollback();
+      return -1;
+    }
+  }
+
+  // A partition can expire while its compressed copy is being written
+  if (!m_profiler.exec(query, QString("DROP TABLE IF EXISTS %1%2")
+                                  .arg(name, COMPRESSED_TABLE_SUFFIX)) ||
+      !m_profiler.exec(query, QString("DROP TABLE %1").arg(name)) || !m_db.commit()) {
+    setLastError(QString("Failed to drop partition %1: %2")
+                     .arg(name, query.lastError().text()));
+    m_db.rollback();
+    return -1;
+  }
+
+  for (int i = 0; i < m_partitions.size(); ++i) {
+    if (m_partitions[i].name == name) {
+      m_partitions.removeAt(i);
+      break;
+    }
+  }
+
+  qCDebug(lcStorage) << "Dropped message partition" << name << "with" << rows << "messages";
+  return rows;
+}
+
+bool DatabaseManager::detachConversationsLocked(const QString &partition) {
+  // Ids are global but partitions go by received_at, so a message saved
+  // late (a journal replay keeps its receivedAt) has a new id in an old
+  // partition. The partition's id range therefore says nothing about which
+  // messages it holds; they are looked up in the table itself.
+  //
+  // Unread messages leaving with the partition come off the counters.
+  // last_read_message_id is a threshold rather than a reference (ids are
+  // never reused), so it still separates the remaining read and unread
+  // messages and is kept.
+  const QString channelMatch = "m.channel_idx = conversations.peer";
+  const QString directMatch = "m.sender_id IN (SELECT id FROM senders "
+                              "WHERE pubkey_prefix = conversations.peer)";
+  QSqlQuery query(m_db);
+  for (const auto &kind : {qMakePair(0, channelMatch), qMakePair(1, directMatch)}) {
+    const QString sql =
+        QString("UPDATE conversations SET unread_count = MAX(unread_count - "
+                "(SELECT COUNT(*) FROM %1 m WHERE m.message_type = %2 AND %3 "
+                "AND m.id > conversations.last_read_message_id AND m.is_sent_by_me = 0), 0) "
+                "WHERE kind = %2 AND unread_count > 0")
+            .arg(partition)
+            .arg(kind.first)
+            .arg(kind.second);
+    if (!m_profiler.exec(query, sql)) {
+      setLastError(QString("Failed to update unread counts for %1: %2")
+                       .arg(partition, query.lastError().text()));
+      return false;
+    }
+  }
+
+  // Conversations whose newest message is in the partition move to their
+  // newest message in the others, found as the delete triggers find it but
+  // across partitions, or are removed if they have none left
+  QVector<QPair<int, QVariant>> orphaned;
+  if (!m_profiler.exec(query, QString("SELECT kind, peer FROM conversations WHERE EXISTS "
+                                      "(SELECT 1 FROM %1 m WHERE m.id = last_message_id)")
+                                  .arg(partition))) {
+    setLastError(QString("Failed to find conversations in %1: %2")
+                     .arg(partition, query.lastError().text()));
+    return false;
+  }
+  while (query.next()) {
+    orphaned.append({query.value(0).toInt(), query.value(1)});
+  }
+  query.finish();
+
+  for (const auto &conversation : std::as_const(orphaned)) {
+    const QString match = conversation.first == 1
+                              ? "sender_id IN (SELECT id FROM senders WHERE pubkey_prefix = ?)"
+                              : "channel_idx = ?";
+    qint64 lastId = 0;
+    qint64 lastTimestamp = 0;
+    for (const MessagePartition &other : std::as_const(m_partitions)) {
+      if (other.name == partition) {
+        continue;
+      }
+
+      QSqlQuery newest(m_db);
+      newest.prepare(QString("SELECT id, timestamp FROM %1 WHERE %2 "
+                             "ORDER BY timestamp DESC, id DESC LIMIT 1")
+                         .arg(other.name, match));
+      newest.addBindValue(conversation.second);
+      if (!m_profiler.exec(newest)) {
+        setLastError(
+            QString("Failed to relink conversation: %1").arg(newest.lastError().text()));
+        return false;
+      }
+      if (newest.next()) {
+        const qint64 id = newest.value(0).toLongLong();
+        const qint64 timestamp = newest.value(1).toLongLong();
+        if (lastId == 0 || timestamp > lastTimestamp ||
+            (timestamp == lastTimestamp && id > lastId)) {
+          lastId = id;
+          lastTimestamp = timestamp;
+        }
+      }
+    }
+
+    QSqlQuery update(m_db);
+    if (lastId == 0) {
+      update.prepare("DELETE FROM conversations WHERE kind = ? AND peer = ?");
+    } else {
+      update.prepare("UPDATE conversations SET last_message_id = ?, last_timestamp = ? "
+                     "WHERE kind = ? AND peer = ?");
+      update.addBindValue(lastId);
+      update.addBindValue(lastTimestamp);
+    }
+    update.addBindValue(conversation.first);
+    update.addBindValue(conversation.second);
+    if (!m_profiler.exec(update)) {
+      setLastError(
+          QString("Failed to relink conversation: %1").arg(update.lastError().text()));
+      return false;
+    }
+  }
+
+  return true;
+}
+
+QVector<Message> DatabaseManager::loadRouted(const QString &what, const QString &filter,
+                                             const QVariantList &bindValues,
+                                             bool byReceivedAt, int limit, int offset) {
+  MemoryScope memory(MemoryAccounting::Storage);
+  QSqlDatabase db = m_readPool.connection();
+  QVector<Message> messages;
+
+  if (!db.isOpen()) {
+    setLastError("Database not open");
+    return messages;
+  }
+
+  // One read transaction gives a consistent snapshot across the catalog and
+  // the partitions, even while the writer creates or drops one
+  db.transaction();
+
+  // Each partition's upper bound on the sort key: received_at is bounded by
+  // the period, timestamps by the tracked maximum
+  QSqlQuery catalog(db);
+  catalog.setForwardOnly(true);
+  if (!m_profiler.exec(catalog,
+                       byReceivedAt
+                           ? "SELECT name, period_end - 1 FROM message_partitions "
+                             "WHERE max_id IS NOT NULL ORDER BY period_end DESC"
+                           : "SELECT name, max_timestamp FROM message_partitions "
+                             "WHERE max_id IS NOT NULL ORDER BY max_timestamp DESC")) {
+    setLastError(QString("Failed to load %1: %2").arg(what, catalog.lastError().text()));
+    db.rollback();
+    return messages;
+  }
+
+  QVector<QPair<QString, qint64>> partitions;
+  while (catalog.next()) {
+    partitions.append({catalog.value(0).toString(), catalog.value(1).toLongLong()});
+  }
+
+  const QString orderColumn = byReceivedAt ? "received_at" : "timestamp";
+  const int needed = limit + offset;
+  QVector<RoutedMessage> merged;
+
+  auto newerFirst = [](const RoutedMessage &a, const RoutedMessage &b) {
+    return a.key != b.key ? a.key > b.key : a.id > b.id;
+  };
+
+  // Visit partitions in order of their bound and stop once none of the
+  // remaining ones can hold a row newer than the current page's last row
+  for (const auto &partition : std::as_const(partitions)) {
+    if (merged.size() >= needed && partition.second < merged[needed - 1].key) {
+      break;
+    }
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare(QString("SELECT %1, m.id, m.%2 FROM %3 m "
+                          "JOIN senders s ON s.id = m.sender_id %4 "
+                          "ORDER BY m.%2 DESC, m.id DESC LIMIT ?")
+                      .arg(QLatin1String(MESSAGE_COLUMNS), orderColumn, partition.first,
+                           filter.isEmpty() ? QString() : "WHERE " + filter));
+    for (const QVariant &value : bindValues) {
+      query.addBindValue(value);
+    }
+    query.addBindValue(needed);
+
+    if (!m_profiler.exec(query)) {
+      setLastError(QString("Failed to load %1: %2").arg(what, query.lastError().text()));
+      db.rollback();
+      return messages;
+    }
+
+    while (query.next()) {
+      bool decoded = false;
+      Message message = messageFromQuery(query, &decoded);
+      if (!decoded) {
+        setLastError(QString("Failed to load %1: undecodable text in message %2 of %3")
+                         .arg(what)
+                         .arg(query.value(13).toLongLong())
+                         .arg(partition.first));
+        db.rollback();
+        return messages;
+      }
+      merged.append({query.value(14).toLongLong(), query.value(13).toLongLong(), message});
+    }
+
+    std::sort(merged.begin(), merged.end(), newerFirst);
+    if (merged.size() > needed) {
+      merged.resize(needed);
+    }
+  }
+
+  db.commit();
+
+  for (int i = offset; i < merged.size(); ++i) {
+    messages.append(merged[i].message);
+  }
+
+  return messages;
+}
+
+bool DatabaseManager::scanMessages(qint64 fromSecs, qint64 toSecs,
+                                   const std::function<bool(const Message &)> &visitor) {
+  MemoryScope memory(MemoryAccounting::Storage);
+  QSqlDatabase db = m_readPool.connection();
+
+  if (!db.isOpen()) {
+    setLastError("Database not open");
+    return false;
+  }
+
+  if (toSecs <= 0) {
+    toSecs = std::numeric_limits<qint64>::max();
+  }
+
+  QSqlQuery catalog(db);
+  catalog.setForwardOnly(true);
+  catalog.prepare("SELECT name FROM message_partitions WHERE max_id IS NOT NULL "
+                  "AND period_end > ? AND period_start < ? ORDER BY period_start");
+  catalog.addBindValue(fromSecs);
+  catalog.addBindValue(toSecs);
+  if (!m_profiler.exec(catalog)) {
+    setLastError(QString("Failed to scan messages: %1").arg(catalog.lastError().text()));
+    return false;
+  }
+
+  QStringList partitions;
+  while (catalog.next()) {
+    partitions.append(catalog.value(0).toString());
+  }
+  catalog.finish();
+
+  // Partitions cover disjoint received_at periods, so visiting them in
+  // period order and each in received_at order keeps the whole scan ordered.
+  // Each is read in a transaction of its own, so a long scan only holds back
+  // checkpoints for one partition at a time; the snapshot is per partition.
+  for (const QString &partition : std::as_const(partitions)) {
+    db.transaction();
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare(QString("SELECT %1 FROM %2 m JOIN senders s ON s.id = m.sender_id "
+                          "WHERE m.received_at >= ? AND m.received_at < ? "
+                          "ORDER BY m.received_at, m.id")
+                      .arg(QLatin1String(MESSAGE_COLUMNS), partition));
+    query.addBindValue(fromSecs);
+    query.addBindValue(toSecs);
+
+    if (!m_profiler.exec(query)) {
+      // Expired since the catalog was read
+      QSqlQuery exists(db);
+      exists.prepare("SELECT 1 FROM message_partitions WHERE name = ?");
+      exists.addBindValue(partition);
+      if (m_profiler.exec(exists) && !exists.next()) {
+        exists.finish();
+        db.commit();
+        continue;
+      }
+
+      setLastError(QString("Failed to scan %1: %2").arg(partition, query.lastError().text()));
+      db.rollback();
+      return false;
+    }
+
+    bool more = true;
+    while (more && query.next()) {
+      bool decoded = false;
+      Message message = messageFromQuery(query, &decoded);
+      if (!decoded) {
+        setLastError(QString("Failed to scan %1: undecodable message text").arg(partition));
+        query.finish();
+        db.rollback();
+        return false;
+      }
+      more = visitor(message);
+    }
+    query.finish();
+    db.commit();
+
+    if (!more) {
+      return true;
+    }
+  }
+
+  return true;
+}
+
+QString DatabaseManager::explainQueryPlan(const QString &sql, const QVariantList &bindValues) {
+  QSqlDatabase db = m_readPool.connection();
+  if (!db.isOpen()) {
+    return QString("(database not open)");
+  }
+
+  QSqlQuery query(db);
+  query.setForwardOnly(true);
+  if (!query.prepare("EXPLAIN QUERY PLAN " + sql)) {
+    return QString("(no plan: %1)").arg(query.lastError().text());
+  }
+
+  // Our statements only use positional placeholders, never inside literals
+  const int placeholders = sql.count('?');
+  for (int i = 0; i < placeholders; ++i) {
+    query.addBindValue(i < bindValues.size() ? bindValues[i] : QVariant());
+  }
+
+  if (!query.exec()) {
+    return QString("(no plan: %1)").arg(query.lastError().text());
+  }
+
+  // Rows are (id, parent, notused, detail), parents before their children
+  QHash<int, int> depth;
+  QStringList steps;
+  while (query.next()) {
+    const int level = depth.value(query.value(1).toInt(), -1) + 1;
+    depth.insert(query.value(0).toInt(), level);
+    steps.append(QString(level * 2, ' ') + query.value(3).toString());
+  }
+  return steps.join('\n');
+}
+
+// Device info operations
+
+bool DatabaseManager::saveDeviceInfo(const DeviceInfo &deviceInfo,
+                                     const SelfInfo &selfInfo) {
+  QMutexLocker locker(&m_mutex);
+
+  if (!m_db.isOpen()) {
+    setLastError("Database not open");
+    return false;
+  }
+
+  QSqlQuery query(m_db);
+  query.prepare("INSERT OR REPLACE INTO device_info "
+                "(id, public_key, node_name, firmware_version, firmware_name, "
+                "protocol_version, contact_type, flags, last_connected_at, created_at) "
+                "VALUES (1, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+
+  query.addBindValue(selfInfo.publicKey);
+  query.addBindValue(selfInfo.nodeName);
+  query.addBindValue(deviceInfo.firmwareVersion);
+  query.addBindValue(deviceInfo.firmwareName);
+  query.addBindValue(deviceInfo.protocolVersion);
+  query.addBindValue(selfInfo.contactType);
+  query.addBindValue(selfInfo.flags);
+  query.addBindValue(QDateTime::currentSecsSinceEpoch());
+  query.addBindValue(QDateTime::currentSecsSinceEpoch());
+
+  if (!m_profiler.exec(query)) {
+    setLastError(QString("Failed to save device info: %1").arg(query.lastError().text()));
+    qCWarning(lcStorage) << getLastError();
+    return false;
+  }
+
+  return true;
+}
+
+bool DatabaseManager::loadDeviceInfo(DeviceInfo &deviceInfo, SelfInfo &selfInfo) {
+  QSqlDatabase db = m_readPool.connection();
+
+  if (!db.isOpen()) {
+    setLastError("Database not open");
+    return false;
+  }
+
+  QSqlQuery query(db);
+  if (!m_profiler.exec(query, "SELECT public_key, node_name, firmware_version, "
+                              "firmware_name, protocol_version, contact_type, flags "
+                              "FROM device_info WHERE id = 1")) {
+    setLastError(QString("Failed to load device info: %1").arg(query.lastError().text()));
+    return false;
+  }
+
+  if (query.next()) {
+    selfInfo.publicKey = query.value(0).toByteArray();
+    selfInfo.nodeName = query.value(1).toString();
+    deviceInfo.firmwareVersion = query.value(2).toUInt();
+    deviceInfo.firmwareName = query.value(3).toString();
+    deviceInfo.protocolVersion = query.value(4).toUInt();
+    selfInfo.contactType = query.value(5).toUInt();
+    selfInfo.flags = query.value(6).toUInt();
+    return true;
+  }
+
+  return false; // No device info found
+}
+
+bool DatabaseManager::updateLastConnectedTime() {
+  QMutexLocker locker(&m_mutex);
+
+  if (!m_db.isOpen()) {
+    setLastError("Database not open");
+    return false;
+  }
+
+  QSqlQuery query(m_db);
+  query.prepare("UPDATE device_info SET last_connected_at = ? WHERE id = 1");
+  query.addBindValue(QDateTime::currentSecsSinceEpoch());
+
+  if (!m_profiler.exec(query)) {
+    setLastError(
+        QString("Failed to update last connected time: %1").arg(query.lastError().text()));
+    return false;
+  }
+
+  return true;
+}
+
+// Contact operations
+
+bool DatabaseManager::saveContact(const Contact &contact) {
+  QMutexLocker locker(&m_mutex);
+
+  if (!m_db.isOpen()) {
+    setLastError("Database not open");
+    return false;
+  }
+
+  QSqlQuery query(m_db);
+  query.prepare(QLatin1String(CONTACT_UPSERT_SQL));
+  bindContact(query, contact, QDateTime::currentSecsSinceEpoch());
+
+  if (!m_profiler.exec(query)) {
+    setLastError(QString("Failed to save contact: %1").arg(query.lastError().text()));
+    qCWarning(lcStorage) << getLastError();
+    return false;
+  }
+
+  return true;
+}
+
+bool DatabaseManager::saveContacts(const QVector<Contact> &contacts) {
+  QMutexLocker locker(&m_mutex);
+
+  if (!m_db.isOpen()) {
+    setLastError("Database not open");
+    return false;
+  }
+
+  if (!m_db.transaction()) {
+    setLastError("Failed to start transaction");
+    return false;
+  }
+
+  if (upsertContactsLocked(contacts) < 0) {
+    m_db.rollback();
+    return false;
+  }
+
+  if (!m_db.commit()) {
+    setLastError("Failed to commit contacts transaction");
+    m_db.rollback();
+    return false;
+  }
+
+  return true;
+}
+
+bool DatabaseManager::syncContacts(const QVector<Contact> &contacts,
+                                   ContactSyncResult *result) {
+  TraceScope span("storage", "syncContacts");
+  MemoryScope memory(MemoryAccounting::Storage);
+  QMutexLocker locker(&m_mutex);
+
+  if (!m_db.isOpen()) {
+    setLastError("Database not open");
+    return false;
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+
+  // The device's key set lives in a per-connection temp table so deletions
+  // are reconciled with a single anti-join
+  QSqlQuery query(m_db);
+  if (!m_profiler.exec(query, "CREATE TEMP TABLE IF NOT EXISTS sync_contact_keys "
+                              "(public_key BLOB PRIMARY KEY) WITHOUT ROWID") ||
+      !m_profiler.exec(query, "DELETE FROM temp.sync_contact_keys")) {
+    setLastError(
+        QString("Failed to prepare contact sync: %1").arg(query.lastError().text()));
+    return false;
+  }
+
+  if (!m_db.transaction()) {
+    setLastError("Failed to start transaction");
+    return false;
+  }
+
+  int written = upsertContactsLocked(contacts);
+  if (written < 0) {
+    m_db.rollback();
+    return false;
+  }
+
+  QSqlQuery keyQuery(m_db);
+  keyQuery.prepare("INSERT OR IGNORE INTO temp.sync_contact_keys (public_key) VALUES (?)");
+  for (const Contact &contact : contacts) {
+    keyQuery.bindValue(0, contact.publicKey());
+    if (!m_profiler.exec(keyQuery)) {
+      setLastError(
+          QString("Failed to stage contact keys: %1").arg(keyQuery.lastError().text()));
+      m_db.rollback();
+      return false;
+    }
+  }
+
+  if (!m_profiler.exec(query, "DELETE FROM contacts WHERE public_key NOT IN "
+                              "(SELECT public_key FROM temp.sync_contact_keys)")) {
+    setLastError(
+        QString("Failed to remove stale contacts: %1").arg(query.lastError().text()));
+    m_db.rollback();
+    return false;
+  }
+  int removed = query.numRowsAffected();
+
+  if (!m_db.commit()) {
+    setLastError("Failed to commit contact sync");
+    m_db.rollback();
+    return false;
+  }
+
+  m_profiler.exec(query, "DELETE FROM temp.sync_contact_keys");
+
+  qint64 elapsedMs = timer.elapsed();
+  qCDebug(lcStorage) << "Contact sync:" << contacts.size() << "from device," << written
+                     << "written," << contacts.size() - written << "unchanged," << removed
+                     << "removed in" << elapsedMs << "ms";
+
+  if (result) {
+    result->written = written;
+    result->unchanged = contacts.size() - written;
+    result->removed = removed;
+    result->elapsedMs = elapsedMs;
+  }
+
+  return true;
+}
+
+int DatabaseManager::upsertContactsLocked(const QVector<Contact> &contacts) {
+  // One prepared statement for the whole batch; the caller owns the transaction
+  QSqlQuery query(m_db);
+  query.prepare(QLatin1String(CONTACT_UPSERT_SQL));
+
+  qint64 now = QDateTime::currentSecsSinceEpoch();
+  int written = 0;
+
+  for (const Contact &contact : contacts) {
+    bindContact(query, contact, now);
+    if (!m_profiler.exec(query)) {
+      setLastError(
+          QString("Failed to save contact batch: %1").arg(query.lastError().text()));
+      return -1;
+    }
+    written += query.numRowsAffected();
+  }
+
+  return written;
+}
+
+bool DatabaseManager::deleteContact(const QByteArray &publicKey) {
+  QMutexLocker locker(&m_mutex);
+
+  if (!m_db.isOpen()) {
+    setLastError("Database not open");
+    return false;
+  }
+
+  QSqlQuery query(m_db);
+  query.prepare("DELETE FROM contacts WHERE public_key = ?");
+  query.addBindValue(publicKey);
+
+  if (!m_profiler.exec(query)) {
+    setLastError(QString("Failed to delete contact: %1").arg(query.lastError().text()));
+    return false;
+  }
+
+  return true;
+}
+
+QVector<Contact> DatabaseManager::loadAllContacts() {
+  QSqlDatabase db = m_readPool.connection();
+  QVector<Contact> contacts;
+
+  if (!db.isOpen()) {
+    setLastError("Database not open");
+    return contacts;
+  }
+
+  QSqlQuery query(db);
+  if (!m_profiler.exec(query, "SELECT public_key, name, type, flags, path_length, path, "
+                              "last_advert_timestamp, last_modified, latitude, longitude "
+                              "FROM contacts ORDER BY name")) {
+    setLastError(QString("Failed to load contacts: %1").arg(query.lastError().text()));
+    return contacts;
+  }
+
+  while (query.next()) {
+    Contact contact(query.value(0).toByteArray(), // public_key
+                    query.value(1).toString(),    // name
+                    query.value(2).toUInt());     // type
+
+    contact.setFlags(query.value(3).toUInt());
+    contact.setPath(query.value(5).toByteArray(), query.value(4).toInt());
+    contact.setLastAdvertTimestamp(query.value(6).toUInt());
+    contact.setLastModified(query.value(7).toUInt());
+    contact.setLocation(query.value(8).toInt(), query.value(9).toInt());
+
+    contacts.append(contact);
+  }
+
+  return contacts;
+}
+
+Contact DatabaseManager::loadContact(const QByteArray &publicKey) {
+  QSqlDatabase db = m_readPool.connection();
+
+  if (!db.isOpen()) {
+    setLastError("Database not open");
+    return Contact();
+  }
+
+  QSqlQuery query(db);
+  query.prepare("SELECT public_key, name, type, flags, path_length, path, "
+                "last_advert_timestamp, last_modified, latitude, longitude "
+                "FROM contacts WHERE public_key = ?");
+  query.addBindValue(publicKey);
+
+  if (!m_profiler.exec(query) || !query.next()) {
+    return Contact();
+  }
+
+  Contact contact(query.value(0).toByteArray(), query.value(1).toString(),
+                  query.value(2).toUInt());
+
+  contact.setFlags(query.value(3).toUInt());
+  contact.setPath(query.value(5).toByteArray(), query.value(4).toInt());
+  contact.setLastAdvertTimestamp(query.value(6).toUInt());
+  contact.setLastModified(query.value(7).toUInt());
+  contact.setLocation(query.value(8).toInt(), query.value(9).toInt());
+
+  return contact;
+}
+
+// Channel operations
+
+bool DatabaseManager::saveChannel(const Channel &channel) {
+  QMutexLocker locker(&m_mutex);
+
+  if (!m_db.isOpen()) {
+    setLastError("Database not open");
+    return false;
+  }
+
+  QSqlQuery query(m_db);
+  query.prepare("INSERT OR REPLACE INTO channels "
+                "(idx, name, secret, created_at, updated_at) "
+                "VALUES (?, ?, ?, "
+                "COALESCE((SELECT created_at FROM channels WHERE idx = ?), ?), ?)");
+
+  query.addBindValue(channel.index);
+  query.addBindValue(channel.name);
+  query.addBindValue(channel.secret);
+  query.addBindValue(channel.index); // For COALESCE
+  query.addBindValue(QDateTime::currentSecsSinceEpoch()); // created_at if new
+  query.addBindValue(QDateTime::currentSecsSinceEpoch()); // updated_at
+
+  if (!m_profiler.exec(query)) {
+    setLastError(QString("Failed to save channel: %1").arg(query.lastError().text()));
+    qCWarning(lcStorage) << getLastError();
+    return false;
+  }
+
+  return true;
+}
+
+bool DatabaseManager::saveChannels(const QVector<Channel> &channels) {
+  QMutexLocker locker(&m_mutex);
+
+  if (!m_db.isOpen()) {
+    setLastError("Database not open");
+    return false;
+  }
+
+  if (!m_db.transaction()) {
+    setLastError("Failed to start transaction");
+    return false;
+  }
+
+  for (const Channel &channel : channels) {
+    QSqlQuery query(m_db);
+    query.prepare("INSERT OR REPLACE INTO channels "
+                  "(idx, name, secret, created_at, updated_at) "
+                  "VALUES (?, ?, ?, "
+                  "COALESCE((SELECT created_at FROM channels WHERE idx = ?), ?), ?)");
+
+    query.addBindValue(channel.index);
+    query.addBindValue(channel.name);
+    query.addBindValue(channel.secret);
+    query.addBindValue(channel.index);
+    query.addBindValue(QDateTime::currentSecsSinceEpoch());
+    query.addBindValue(QDateTime::currentSecsSinceEpoch());
+
+    if (!m_profiler.exec(query)) {
+      setLastError(QString("Failed to save channel batch: %1").arg(query.lastError().text()));
+      m_db.rollback();
+      return false;
+    }
+  }
+
+  if (!m_db.commit()) {
+    setLastError("Failed to commit channels transaction");
+    m_db.rollback();
+    return false;
+  }
+
+  return true;
+}
+
+bool DatabaseManager::deleteChannel(uint8_t channelIdx) {
+  QMutexLocker locker(&m_mutex);
+
+  if (!m_db.isOpen()) {
+    setLastError("Database not open");
+    return false;
+  }
+
+  if (!m_db.transaction()) {
+    setLastError("Failed to start transaction");
+    return false;
+  }
+
+  // The channel's messages are kept (channel_idx is set to NULL), but it no
+  // longer has an inbox entry
+  QSqlQuery query(m_db);
+  query.prepare("DELETE FROM conversations WHERE kind = 0 AND peer = ?");
+  query.addBindValue(channelIdx);
+
+  QSqlQuery channelQuery(m_db);
+  channelQuery.prepare("DELETE FROM channels WHERE idx = ?");
+  channelQuery.addBindValue(channelIdx);
+
+  if (!m_profiler.exec(query) || !m_profiler.exec(channelQuery)) {
+    setLastError(QString("Failed to delete channel: %1")
+                     .arg(query.lastError().isValid() ? query.lastError().text()
+                                                      : channelQuery.lastError().text()));
+    m_db.rollback();
+    return false;
+  }
+
+  if (!m_db.commit()) {
+    setLastError("Failed to commit channel deletion");
+    m_db.rollback();
+    return false;
+  }
+
+  return true;
+}
+
+QVector<Channel> DatabaseManager::loadAllChannels() {
+  QSqlDatabase db = m_readPool.connection();
+  QVector<Channel> channels;
+
+  if (!db.isOpen()) {
+    setLastError("Database not open");
+    return channels;
+  }
+
+  QSqlQuery query(db);
+  if (!m_profiler.exec(query, "SELECT idx, name, secret FROM channels ORDER BY idx")) {
+    setLastError(QString("Failed to load channels: %1").arg(query.lastError().text()));
+    return channels;
+  }
+
+  while (query.next()) {
+    Channel channel(query.value(0).toUInt(), // idx
+                    query.value(1).toString(), // name
+                    query.value(2).toByteArray()); // secret
+    channels.append(channel);
+  }
+
+  return channels;
+}
+
+Channel DatabaseManager::loadChannel(uint8_t channelIdx) {
+  QSqlDatabase db = m_readPool.connection();
+
+  if (!db.isOpen()) {
+    setLastError("Database not open");
+    return Channel();
+  }
+
+  QSqlQuery query(db);
+  query.prepare("SELECT idx, name, secret FROM channels WHERE idx = ?");
+  query.addBindValue(channelIdx);
+
+  if (!m_profiler.exec(query) || !query.next()) {
+    return Channel();
+  }
+
+  return Channel(query.value(0).toUInt(), query.value(1).toString(),
+                 query.value(2).toByteArray());
+}
+
+// Message operations
+
+QByteArray DatabaseManager::generateMessageHash(const Message &message) const {
+  // Only the digest outlives the frame
+  ScratchBytes data;
+
+  if (message.type == Message::CHANNEL_MESSAGE) {
+    data.append(message.senderName);
+  } else {
+    data.append(message.senderPubKeyPrefix);
+  }
+
+  data.append(message.text);
+  data.append(QByteArrayView(reinterpret_cast<const char *>(&message.timestamp),
+                             sizeof(message.timestamp)));
+
+  return QCryptographicHash::hash(data.rawBytes(), QCryptographicHash::Sha256);
+}
+
+qint64 DatabaseManager::resolveSenderId(const Message &message) {
+  QByteArray prefix = message.type == Message::CONTACT_MESSAGE ? message.senderPubKeyPrefix
+                                                               : QByteArray();
+
+  auto cached = m_senderIds.constFind(senderLookupKey(message).rawBytes());
+  if (cached != m_senderIds.constEnd()) {
+    return cached.value();
+  }
+
+  QSqlQuery insert(m_db);
+  insert.prepare("INSERT OR IGNORE INTO senders (pubkey_prefix, name) "
+                 "VALUES (COALESCE(?, x''), COALESCE(?, ''))");
+  insert.addBindValue(prefix);
+  insert.addBindValue(message.senderName);
+
+  QSqlQuery select(m_db);
+  select.prepare("SELECT id FROM senders "
+                 "WHERE pubkey_prefix = COALESCE(?, x'') AND name = COALESCE(?, '')");
+  select.addBindValue(prefix);
+  select.addBindValue(message.senderName);
+
+  if (!m_profiler.exec(insert) || !m_profiler.exec(select) || !select.next()) {
+    setLastError(QString("Failed to resolve sender: %1")
+                      .arg(insert.lastError().isValid() ? insert.lastError().text()
+                                                        : select.lastError().text()));
+    return -1;
+  }
+
+  // Not cached here: the row may still be rolled back with the caller's
+  // transaction, so callers cache the id once they commit
+  return select.value(0).toLongLong();
+}
+
+Message DatabaseManager::messageFromQuery(const QSqlQuery &query, bool *ok) const {
+  // Column order matches MESSAGE_COLUMNS
+  Message msg;
+  msg.type = static_cast<Message::Type>(query.value(0).toInt());
+  msg.channelIdx = query.value(1).toUInt();
+  msg.senderPubKeyPrefix = query.value(2).toByteArray();
+  msg.senderName = query.value(3).toString();
+  msg.text = storedText(query.value(4), query.value(11), query.value(12), ok);
+  msg.timestamp = query.value(5).toUInt();
+  msg.receivedAt = QDateTime::fromSecsSinceEpoch(query.value(6).toLongLong());
+  msg.pathLength = query.value(7).toUInt();
+  msg.pathLen = msg.pathLength; // Alias
+  msg.txtType = query.value(8).toUInt();
+  msg.snr = query.value(9).toFloat();
+  // is_sent_by_me is at index 10, but not stored in Message struct
+  return msg;
+}
+
+QString DatabaseManager::storedText(const QVariant &text, const QVariant &textZ,
+                                    const QVariant &dictId, bool *ok) const {
+  if (textZ.isNull()) {
+    if (ok) {
+      *ok = true;
+    }
+    return text.toString();
+  }
+
+  return m_textCodec.decompress(textZ.toByteArray(), dictId.toInt(), ok);
+}
+
+bool DatabaseManager::isMessageDuplicate(const Message &message) {
+  QMutexLocker locker(&m_mutex);
+
+  if (!m_db.isOpen()) {
+    return false;
+  }
+
+  QByteArray hash = generateMessageHash(message);
+
+  QSqlQuery query(m_db);
+  query.prepare("SELECT 1 FROM message_hashes WHERE hash = ?");
+  query.addBindValue(hash);
+
+  return m_profiler.exec(query) && query.next();
+}
+
+bool DatabaseManager::saveMessage(const Message &message, bool isSentByMe) {
+  TraceScope span("storage", "saveMessage"); // Includes waiting for the writer
+  MemoryScope memory(MemoryAccounting::Storage);
+  QMutexLocker locker(&m_mutex);
+
+  if (!m_db.isOpen()) {
+    setLastError("Database not open");
+    return false;
+  }
+
+  // Check for duplicate
+  QByteArray hash = generateMessageHash(message);
+  QSqlQuery checkQuery(m_db);
+  checkQuery.prepare("SELECT 1 FROM message_hashes WHERE hash = ?");
+  checkQuery.addBindValue(hash);
+
+  if (m_profiler.exec(checkQuery) && checkQuery.next()) {
+    // Duplicate, silently skip
+    TelemetryCounters::add(TelemetryCounters::instance().duplicatesSkipped);
+    return true;
+  }
+
+  QString partition = ensurePartitionLocked(message.receivedAt.toSecsSinceEpoch());
+  if (partition.isEmpty()) {
+    qCWarning(lcStorage) << getLastError();
+    return false;
+  }
+
+  if (!m_db.transaction()) {
+    setLastError("Failed to start transaction");
+    return false;
+  }
+
+  qint64 senderId = resolveSenderId(message);
+  if (senderId < 0 || !insertMessageLocked(message, hash, partition, senderId,
+                                           m_nextMessageId, isSentByMe)) {
+    qCWarning(lcStorage) << getLastError();
+    m_db.rollback();
+    return false;
+  }
+
+  if (!m_db.commit()) {
+    setLastError("Failed to commit message transaction");
+    m_db.rollback();
+    return false;
+  }
+
+  m_nextMessageId++;
+  if (!m_senderIds.contains(senderLookupKey(message).rawBytes())) {
+    m_senderIds.insert(senderCacheKey(message), senderId);
+  }
+  TelemetryCounters::add(TelemetryCounters::instance().messagesStored);
+
+  return true;
+}
+
+bool DatabaseManager::saveMessages(const QVector<Message> &messages, bool isSentByMe) {
+  TraceScope span("storage", "saveMessages");
+  MemoryScope memory(MemoryAccounting::Storage);
+  span.setArg("messages", messages.size());
+  QMutexLocker locker(&m_mutex);
+
+  if (!m_db.isOpen()) {
+    setLastError("Database not open");
+    return false;
+  }
+
+  // Partitions commit as they are created, so they are set up before the
+  // batch's own transaction
+  QVector<QString> partitions;
+  partitions.reserve(messages.size());
+  for (const Message &message : messages) {
+    partitions.append(ensurePartitionLocked(message.receivedAt.toSecsSinceEpoch()));
+    if (partitions.last().isEmpty()) {
+      qCWarning(lcStorage) << getLastError();
+      return false;
+    }
+  }
+
+  if (!m_db.transaction()) {
+    setLastError("Failed to start transaction");
+    return false;
+  }
+
+  QSqlQuery checkQuery(m_db);
+  checkQuery.prepare("SELECT 1 FROM message_hashes WHERE hash = ?");
+
+  qint64 nextId = m_nextMessageId;
+  QHash<QByteArray, qint64> newSenders;
+  int duplicates = 0;
+  for (int i = 0; i < messages.size(); ++i) {
+    const Message &message = messages[i];
+
+    // Also catches duplicates within the batch: their hashes are already in
+    QByteArray hash = generateMessageHash(message);
+    checkQuery.bindValue(0, hash);
+    if (m_profiler.exec(checkQuery) && checkQuery.next()) {
+      duplicates++;
+      continue;
+    }
+
+    qint64 senderId = resolveSenderId(message);
+    if (senderId < 0 ||
+        !insertMessageLocked(message, hash, partitions[i], senderId, nextId, isSentByMe)) {
+      qCWarning(lcStorage) << getLastError();
+      m_db.rollback();
+      return false;
+    }
+
+    nextId++;
+    if (!m_senderIds.contains(senderLookupKey(message).rawBytes())) {
+      newSenders.insert(senderCacheKey(message), senderId);
+    }
+  }
+
+  if (!m_db.commit()) {
+    setLastError("Failed to commit message batch");
+    m_db.rollback();
+    return false;
+  }
+
+  TelemetryCounters &counters = TelemetryCounters::instance();
+  TelemetryCounters::add(counters.messagesStored, quint64(nextId - m_nextMessageId));
+  TelemetryCounters::add(counters.duplicatesSkipped, quint64(duplicates));
+  m_nextMessageId = nextId;
+  for (auto it = newSenders.cbegin(); it != newSenders.cend(); ++it) {
+    m_senderIds.insert(it.key(), it.value());
+  }
+
+  return true;
+}
+
+bool DatabaseManager::insertMessageLocked(const Message &message, const QByteArray &hash,
+                                          const QString &partition, qint64 senderId,
+                                          qint64 messageId, bool isSentByMe) {
+  QSqlQuery query(m_db);
+  query.prepare(QString("INSERT INTO %1 "
+                        "(id, message_type, channel_idx, sender_id, text, "
+                        "timestamp, received_at, path_length, txt_type, snr, is_sent_by_me) "
+                        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)")
+                    .arg(partition));
+
+  query.addBindValue(messageId);
+  query.addBindValue(static_cast<int>(message.type));
+  query.addBindValue(message.type == Message::CHANNEL_MESSAGE
+                         ? QVariant(message.channelIdx)
+                         : QVariant());
+  query.addBindValue(senderId);
+  query.addBindValue(message.text);
+  query.addBindValue(message.timestamp);
+  query.addBindValue(message.receivedAt.toSecsSinceEpoch());
+  query.addBindValue(message.pathLength);
+  query.addBindValue(message.txtType);
+  query.addBindValue(message.snr);
+  query.addBindValue(isSentByMe ? 1 : 0);
+
+  if (!m_profiler.exec(query)) {
+    setLastError(QString("Failed to save message: %1").arg(query.lastError().text()));
+    return false;
+  }
+
+  QSqlQuery hashQuery(m_db);
+  hashQuery.prepare(
+      "INSERT INTO message_hashes (hash, message_id, created_at) VALUES (?, ?, ?)");
+  hashQuery.addBindValue(hash);
+  hashQuery.addBindValue(messageId);
+  hashQuery.addBindValue(QDateTime::currentSecsSinceEpoch());
+
+  if (!m_profiler.exec(hashQuery)) {
+    setLastError(QString("Failed to save message hash: %1").arg(hashQuery.lastError().text()));
+    return false;
+  }
+
+  return true;
+}
+
+QVector<Message> DatabaseManager::loadMessages(int limit, int offset) {
+  return loadRouted("messages", QString(), QVariantList(), true, limit, offset);
+}
+
+QVector<Message> DatabaseManager::loadChannelMessages(uint8_t channelIdx, int limit,
+                                                      int offset) {
+  return loadRouted("channel messages", "m.channel_idx = ?", {channelIdx}, false, limit,
+                    offset);
+}
+
+QVector<Message> DatabaseManager::loadDirectMessages(const QByteArray &contactPubKeyPrefix,
+                                                     int limit, int offset) {
+  return loadRouted("direct messages",
+                    "m.sender_id IN (SELECT id FROM senders WHERE pubkey_prefix = ?)",
+                    {contactPubKeyPrefix}, false, limit, offset);
+}
+
+int DatabaseManager::getMessageCount() {
+  QSqlDatabase db = m_readPool.connection();
+
+  if (!db.isOpen()) {
+    return 0;
+  }
+
+  // One row per channel plus one for direct messages
+  QSqlQuery query(db);
+  if (!m_profiler.exec(query,
+                       "SELECT COALESCE(SUM(message_count), 0) FROM stats_channel_totals")) {
+    return 0;
+  }
+
+  if (query.next()) {
+    return query.value(0).toInt();
+  }
+
+  return 0;
+}
+
+int DatabaseManager::getChannelMessageCount(uint8_t channelIdx) {
+  QSqlDatabase db = m_readPool.connection();
+
+  if (!db.isOpen()) {
+    return 0;
+  }
+
+  QSqlQuery query(db);
+  query.prepare("SELECT message_count FROM stats_channel_totals WHERE channel_key = ?");
+  query.addBindValue(channelIdx);
+
+  if (!m_profiler.exec(query) || !query.next()) {
+    return 0;
+  }
+
+  return query.value(0).toInt();
+}
+
+// Statistics
+
+QVector<ChannelCount> DatabaseManager::getChannelCounts() {
+  QSqlDatabase db = m_readPool.connection();
+  QVector<ChannelCount> counts;
+
+  if (!db.isOpen()) {
+    setLastError("Database not open");
+    return counts;
+  }
+
+  QSqlQuery query(db);
+  query.setForwardOnly(true);
+  if (!m_profiler.exec(query, "SELECT channel_key, message_count FROM stats_channel_totals "
+                              "WHERE message_count > 0 ORDER BY channel_key")) {
+    setLastError(QString("Failed to load channel counts: %1").arg(query.lastError().text()));
+    return counts;
+  }
+
+  while (query.next()) {
+    counts.append({query.value(0).toInt(), query.value(1).toLongLong()});
+  }
+
+  return counts;
+}
+
+QVector<HourlyCount> DatabaseManager::getHourlyCounts(int hours) {
+  QSqlDatabase db = m_readPool.connection();
+  QVector<HourlyCount> counts;
+
+  if (!db.isOpen()) {
+    setLastError("Database not open");
+    return counts;
+  }
+
+  // Keyed by hour first, so this is a range scan over the window only
+  QSqlQuery query(db);
+  query.setForwardOnly(true);
+  query.prepare("SELECT hour, channel_key, message_count FROM stats_hourly "
+                "WHERE hour > ? ORDER BY hour, channel_key");
+  query.addBindValue(QDateTime::currentSecsSinceEpoch() / 3600 - hours);
+
+  if (!m_profiler.exec(query)) {
+    setLastError(QString("Failed to load hourly counts: %1").arg(query.lastError().text()));
+    return counts;
+  }
+
+  while (query.next()) {
+    counts.append({query.value(1).toInt(), query.value(0).toLongLong() * 3600,
+                   query.value(2).toLongLong()});
+  }
+
+  return counts;
+}
+
+QVector<SenderCount> DatabaseManager::getTopSenders(int limit) {
+  QSqlDatabase db = m_readPool.connection();
+  QVector<SenderCount> senders;
+
+  if (!db.isOpen()) {
+    setLastError("Database not open");
+    return senders;
+  }
+
+  QSqlQuery query(db);
+  query.setForwardOnly(true);
+  query.prepare("SELECT s.pubkey_prefix, s.name, t.message_count, t.last_received_at "
+                "FROM stats_senders t JOIN senders s ON s.id = t.sender_id "
+                "ORDER BY t.message_count DESC LIMIT ?");
+  query.addBindValue(limit);
+
+  if (!m_profiler.exec(query)) {
+    setLastError(QString("Failed to load sender counts: %1").arg(query.lastError().text()));
+    return senders;
+  }
+
+  while (query.next()) {
+    senders.append({query.value(0).toByteArray(), query.value(1).toString(),
+                    query.value(2).toLongLong(), query.value(3).toLongLong()});
+  }
+
+  return senders;
+}
+
+QVector<HistogramBucket> DatabaseManager::getSnrHistogram() {
+  return loadHistogram("SELECT bucket, message_count FROM stats_snr_histogram "
+                       "ORDER BY bucket");
+}
+
+QVector<HistogramBucket> DatabaseManager::getPathLengthHistogram() {
+  return loadHistogram("SELECT path_length, message_count FROM stats_path_histogram "
+                       "ORDER BY path_length");
+}
+
+QVector<HistogramBucket> DatabaseManager::loadHistogram(const QString &sql) {
+  QSqlDatabase db = m_readPool.connection();
+  QVector<HistogramBucket> buckets;
+
+  if (!db.isOpen()) {
+    setLastError("Database not open");
+    return buckets;
+  }
+
+  QSqlQuery query(db);
+  query.setForwardOnly(true);
+  if (!m_profiler.exec(query, sql)) {
+    setLastError(QString("Failed to load histogram: %1").arg(query.lastError().text()));
+    return buckets;
+  }
+
+  while (query.next()) {
+    buckets.append({query.value(0).toInt(), query.value(1).toLongLong()});
+  }
+
+  return buckets;
+}
+
+// Conversations
+
+QVector<Conversation> DatabaseManager::listConversations() {
+  QSqlDatabase db = m_readPool.connection();
+  QVector<Conversation> conversations;
+
+  if (!db.isOpen()) {
+    setLastError("Database not open");
+    return conversations;
+  }
+
+  db.transaction();
+
+  // Id ranges say which partition most likely holds a message; a message
+  // saved late into an old partition lies outside them, so every partition
+  // is tried, likeliest first
+  QVector<std::tuple<qint64, qint64, QString>> idRanges;
+  QSqlQuery catalog(db);
+  catalog.setForwardOnly(true);
+  if (m_profiler.exec(catalog, "SELECT min_id, max_id, name FROM message_partitions "
+                               "WHERE max_id IS NOT NULL ORDER BY max_id DESC")) {
+    while (catalog.next()) {
+      idRanges.append({catalog.value(0).toLongLong(), catalog.value(1).toLongLong(),
+                       catalog.value(2).toString()});
+    }
+  }
+
+  // Reads one row per conversation plus a primary-key lookup for its preview
+  QSqlQuery query(db);
+  query.setForwardOnly(true);
+  if (!m_profiler.exec(query, "SELECT kind, peer, last_message_id, last_timestamp, "
+                              "unread_count, last_read_message_id FROM conversations "
+                              "WHERE last_message_id > 0 ORDER BY last_message_id DESC")) {
+    setLastError(QString("Failed to list conversations: %1").arg(query.lastError().text()));
+    db.rollback();
+    return conversations;
+  }
+
+  while (query.next()) {
+    Conversation conversation;
+    conversation.kind = static_cast<Message::Type>(query.value(0).toInt());
+    if (conversation.kind == Message::CHANNEL_MESSAGE) {
+      conversation.channelIdx = static_cast<uint8_t>(query.value(1).toUInt());
+    } else {
+      conversation.pubKeyPrefix = query.value(1).toByteArray();
+    }
+    conversation.lastMessageId = query.value(2).toLongLong();
+    conversation.lastTimestamp = query.value(3).toLongLong();
+    conversation.unreadCount = query.value(4).toInt();
+    conversation.lastReadMessageId = query.value(5).toLongLong();
+
+    QStringList likely;
+    QStringList others;
+    for (const auto &range : std::as_const(idRanges)) {
+      const bool inRange = conversation.lastMessageId >= std::get<0>(range) &&
+                           conversation.lastMessageId <= std::get<1>(range);
+      (inRange ? likely : others).append(std::get<2>(range));
+    }
+
+    for (const QString &partition : likely + others) {
+      QSqlQuery preview(db);
+      preview.prepare(QString("SELECT s.name, m.text, m.text_z, m.dict_id FROM %1 m "
+                              "JOIN senders s ON s.id = m.sender_id WHERE m.id = ?")
+                          .arg(partition));
+      preview.addBindValue(conversation.lastMessageId);
+      if (m_profiler.exec(preview) && preview.next()) {
+        bool decoded = false;
+        conversation.lastSenderName = preview.value(0).toString();
+        conversation.lastText =
+            storedText(preview.value(1), preview.value(2), preview.value(3), &decoded);
+        if (!decoded) {
+          setLastError(QString("Failed to list conversations: undecodable text in message %1")
+                           .arg(conversation.lastMessageId));
+          preview.finish();
+          db.rollback();
+          return QVector<Conversation>();
+        }
+        break;
+      }
+    }
+
+    conversations.append(conversation);
+  }
+
+  db.commit();
+  return conversations;
+}
+
+bool DatabaseManager::markRead(uint8_t channelIdx) {
+  return markConversationRead(Message::CHANNEL_MESSAGE, channelIdx);
+}
+
+bool DatabaseManager::markRead(const QByteArray &pubKeyPrefix) {
+  return markConversationRead(Message::CONTACT_MESSAGE, pubKeyPrefix);
+}
+
+bool DatabaseManager::markConversationRead(Message::Type kind, const QVariant &peer) {
   QMutexLocker locker(&m_mutex);
 
   if (!m_db.isOpen()) {
-    m_lastError = "Database not open";
+    setLastError("Database not open");
     return false;
   }
 
-  if (!m_db.transaction()) {
-    m_lastError = "Failed to start transaction";
+  QSqlQuery query(m_db);
+  query.prepare("UPDATE conversations SET unread_count = 0, "
+                "last_read_message_id = last_message_id "
+                "WHERE kind = ? AND peer = ?");
+  query.addBindValue(static_cast<int>(kind));
+  query.addBindValue(peer);
+
+  if (!m_profiler.exec(query)) {
+    setLastError(
+        QString("Failed to mark conversation read: %1").arg(query.lastError().text()));
     return false;
   }
 
-  for (const Channel &channel : channels) {
-    QSqlQuery query(m_db);
-    query.prepare("INSERT OR REPLACE INTO channels "
-                  "(idx, name, secret, created_at, updated_at) "
-                  "VALUES (?, ?, ?, "
-                  "COALESCE((SELECT created_at FROM channels WHERE idx = ?), ?), ?)");
+  return true;
+}
 
-    query.addBindValue(channel.index);
-    query.addBindValue(channel.name);
-    query.addBindValue(channel.secret);
-    query.addBindValue(channel.index);
-    query.addBindValue(QDateTime::currentSecsSinceEpoch());
-    query.addBindValue(QDateTime::currentSecsSinceEpoch());
+// Retention
 
-    if (!query.exec()) {
-      m_lastError = QString("Failed to save channel batch: %1").arg(query.lastError().text());
-      m_db.rollback();
-      return false;
-    }
+void DatabaseManager::setRetentionPolicy(const RetentionPolicy &policy) {
+  QMutexLocker locker(&m_mutex);
+  m_retentionPolicy = policy;
+
+  if (m_db.isOpen()) {
+    m_retentionTimer->start(0);
   }
+}
 
-  if (!m_db.commit()) {
-    m_lastError = "Failed to commit channels transaction";
-    m_db.rollback();
-    return false;
+RetentionPolicy DatabaseManager::retentionPolicy() const {
+  QMutexLocker locker(&m_mutex);
+  return m_retentionPolicy;
+}
+
+int DatabaseManager::autoVacuumModeLocked() {
+  QSqlQuery query(m_db);
+  if (!query.exec("PRAGMA auto_vacuum") || !query.next()) {
+    return -1;
   }
+  return query.value(0).toInt();
+}
 
-  return true;
+bool DatabaseManager::isIncrementalVacuumEnabled() {
+  QMutexLocker locker(&m_mutex);
+  return m_db.isOpen() && autoVacuumModeLocked() == AUTO_VACUUM_INCREMENTAL;
 }
 
-bool DatabaseManager::deleteChannel(uint8_t channelIdx) {
+bool DatabaseManager::enableIncrementalVacuum() {
   QMutexLocker locker(&m_mutex);
 
   if (!m_db.isOpen()) {
-    m_lastError = "Database not open";
+    setLastError("Database not open");
     return false;
   }
 
-  QSqlQuery query(m_db);
-  query.prepare("DELETE FROM channels WHERE idx = ?");
-  query.addBindValue(channelIdx);
+  if (autoVacuumModeLocked() == AUTO_VACUUM_INCREMENTAL) {
+    return true;
+  }
 
-  if (!query.exec()) {
-    m_lastError = QString("Failed to delete channel: %1").arg(query.lastError().text());
+  // Databases created before retention support have auto_vacuum=NONE; the
+  // mode only changes after a full VACUUM, which rewrites the whole file
+  qCDebug(lcStorage) << "Converting database to incremental auto-vacuum...";
+  QElapsedTimer timer;
+  timer.start();
+  QSqlQuery query(m_db);
+  if (!query.exec("PRAGMA auto_vacuum=INCREMENTAL") || !query.exec("VACUUM")) {
+    setLastError(
+        QString("Failed to enable incremental auto-vacuum: %1").arg(query.lastError().text()));
+    qCWarning(lcStorage) << getLastError();
     return false;
   }
 
+  qCDebug(lcStorage) << "Database converted to incremental auto-vacuum in" << timer.elapsed()
+                     << "ms";
   return true;
 }
 
-QVector<Channel> DatabaseManager::loadAllChannels() {
+void DatabaseManager::onRetentionTimer() {
+  int removed = runRetentionStep();
+
+  if (!isOpen()) {
+    return;
+  }
+
+  // A full batch means there is more backlog; come back soon but still yield
+  // to the event loop so live ingest interleaves with pruning
+  RetentionPolicy policy = retentionPolicy();
+  bool backlog = removed >= policy.batchSize;
+  {
+    QMutexLocker locker(&m_mutex);
+    backlog = backlog || m_compressionBacklog;
+  }
+  m_retentionTimer->start(backlog ? 50 : policy.intervalSecs * 1000);
+}
+
+int DatabaseManager::runRetentionStep() {
+  TraceScope span("storage", "retentionStep");
+  MemoryScope memory(MemoryAccounting::Storage);
   QMutexLocker locker(&m_mutex);
-  QVector<Channel> channels;
 
   if (!m_db.isOpen()) {
-    m_lastError = "Database not open";
-    return channels;
+    return 0;
   }
 
-  QSqlQuery query(m_db);
-  if (!query.exec("SELECT idx, name, secret FROM channels ORDER BY idx")) {
-    m_lastError = QString("Failed to load channels: %1").arg(query.lastError().text());
-    return channels;
+  const int batchSize = qMax(1, m_retentionPolicy.batchSize);
+  int removed = pruneExpiredHashes(batchSize);
+
+  // Message limits are applied one at a time so a single step never deletes
+  // more than one batch of messages
+  int removedMessages = pruneExpiredMessages(batchSize);
+  if (removedMessages == 0) {
+    removedMessages = pruneChannelOverflow(batchSize);
   }
+  if (removedMessages == 0) {
+    removedMessages = pruneForSizeBudget(batchSize);
+  }
+  removed += removedMessages;
 
-  while (query.next()) {
-    Channel channel(query.value(0).toUInt(), // idx
-                    query.value(1).toString(), // name
-                    query.value(2).toByteArray()); // secret
-    channels.append(channel);
+  // Compression rewrites rows rather than deleting them, so it only runs in
+  // steps that had nothing to prune
+  int compressed = removedMessages == 0 ? compressColdPartitions(batchSize) : 0;
+
+  if (removed > 0 || compressed > 0) {
+    // Return the pages freed by this step to the filesystem
+    QSqlQuery query(m_db);
+    m_profiler.exec(query, QString("PRAGMA incremental_vacuum(%1)").arg(batchSize));
+    while (query.next()) {
+    }
   }
 
-  return channels;
-}
+  if (removed > 0) {
+    qCDebug(lcStorage) << "Retention step removed" << removedMessages << "messages,"
+                       << (removed - removedMessages) << "hashes";
+    locker.unlock();
+    emit retentionStepCompleted(removed);
+  }
 
-Channel DatabaseManager::loadChannel(uint8_t channelIdx) {
-  QMutexLocker locker(&m_mutex);
+  return removed;
+}
 
-  if (!m_db.isOpen()) {
-    m_lastError = "Database not open";
-    return Channel();
+int DatabaseManager::pruneExpiredHashes(int batchSize) {
+  if (m_retentionPolicy.hashRetentionDays <= 0) {
+    return 0;
   }
 
-  QSqlQuery query(m_db);
-  query.prepare("SELECT idx, name, secret FROM channels WHERE idx = ?");
-  query.addBindValue(channelIdx);
+  qint64 cutoff = QDateTime::currentSecsSinceEpoch() -
+                  qint64(m_retentionPolicy.hashRetentionDays) * 86400;
 
-  if (!query.exec() || !query.next()) {
-    return Channel();
+  QSqlQuery query(m_db);
+  query.prepare("DELETE FROM message_hashes WHERE hash IN ("
+                "SELECT hash FROM message_hashes WHERE created_at < ? "
+                "ORDER BY created_at LIMIT ?)");
+  query.addBindValue(cutoff);
+  query.addBindValue(batchSize);
+
+  if (!m_profiler.exec(query)) {
+    setLastError(QString("Failed to prune message hashes: %1").arg(query.lastError().text()));
+    qCWarning(lcStorage) << getLastError();
+    return 0;
   }
 
-  return Channel(query.value(0).toUInt(), query.value(1).toString(),
-                 query.value(2).toByteArray());
+  return query.numRowsAffected();
 }
 
-// Message operations
+int DatabaseManager::pruneExpiredMessages(int batchSize) {
+  if (m_retentionPolicy.maxAgeDays <= 0) {
+    return 0;
+  }
 
-QString DatabaseManager::generateMessageHash(const Message &message) const {
-  QByteArray data;
+  qint64 cutoff = QDateTime::currentSecsSinceEpoch() -
+                  qint64(m_retentionPolicy.maxAgeDays) * 86400;
 
-  if (message.type == Message::CHANNEL_MESSAGE) {
-    data.append(message.senderName.toUtf8());
-  } else {
-    data.append(message.senderPubKeyPrefix);
+  // A partition whose whole period has expired is dropped in one step
+  for (const MessagePartition &partition : std::as_const(m_partitions)) {
+    if (partition.periodEnd <= cutoff) {
+      const QString name = partition.name; // Dropping removes it from the list
+      qint64 dropped = dropPartitionLocked(name);
+      if (dropped < 0) {
+        qCWarning(lcStorage) << getLastError();
+        return 0;
+      }
+      return static_cast<int>(qMin<qint64>(dropped, INT_MAX));
+    }
   }
 
-  data.append(message.text.toUtf8());
-  data.append(reinterpret_cast<const char *>(&message.timestamp), sizeof(message.timestamp));
+  // Otherwise only the partition straddling the cutoff has expired rows
+  int removed = 0;
+  for (const MessagePartition &partition : std::as_const(m_partitions)) {
+    if (partition.periodStart >= cutoff || removed >= batchSize) {
+      break;
+    }
+
+    QSqlQuery query(m_db);
+    query.prepare(QString("DELETE FROM %1 WHERE id IN ("
+                          "SELECT id FROM %1 WHERE received_at < ? "
+                          "ORDER BY received_at LIMIT ?)")
+                      .arg(partition.name));
+    query.addBindValue(cutoff);
+    query.addBindValue(batchSize - removed);
+
+    if (!m_profiler.exec(query)) {
+      setLastError(
+          QString("Failed to prune expired messages: %1").arg(query.lastError().text()));
+      qCWarning(lcStorage) << getLastError();
+      return removed;
+    }
+
+    removed += query.numRowsAffected();
+  }
 
-  return QString::fromLatin1(
-      QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex());
+  return removed;
 }
 
-bool DatabaseManager::isMessageDuplicate(const Message &message) {
-  QMutexLocker locker(&m_mutex);
+int DatabaseManager::pruneChannelOverflow(int batchSize) {
+  if (m_retentionPolicy.maxMessagesPerChannel <= 0) {
+    return 0;
+  }
 
-  if (!m_db.isOpen()) {
-    return false;
+  // Stored totals say which channels are over the limit without counting
+  QSqlQuery channelsQuery(m_db);
+  channelsQuery.prepare("SELECT channel_key, message_count FROM stats_channel_totals "
+                        "WHERE channel_key >= 0 AND message_count > ? ORDER BY channel_key");
+  channelsQuery.addBindValue(m_retentionPolicy.maxMessagesPerChannel);
+  if (!m_profiler.exec(channelsQuery)) {
+    return 0;
+  }
+
+  QVector<QPair<int, qint64>> overflowing;
+  while (channelsQuery.next()) {
+    overflowing.append({channelsQuery.value(0).toInt(),
+                        channelsQuery.value(1).toLongLong() -
+                            m_retentionPolicy.maxMessagesPerChannel});
+  }
+
+  // The excess is taken from the oldest partitions first, oldest timestamps
+  // first within each, walking idx_<partition>_channel
+  int removed = 0;
+  for (const auto &channel : std::as_const(overflowing)) {
+    qint64 excess = channel.second;
+
+    for (const MessagePartition &partition : std::as_const(m_partitions)) {
+      if (removed >= batchSize || excess <= 0) {
+        break;
+      }
+
+      QSqlQuery query(m_db);
+      query.prepare(QString("DELETE FROM %1 WHERE id IN ("
+                            "SELECT id FROM %1 WHERE channel_idx = ? "
+                            "ORDER BY timestamp, id LIMIT ?)")
+                        .arg(partition.name));
+      query.addBindValue(channel.first);
+      query.addBindValue(qMin<qint64>(batchSize - removed, excess));
+
+      if (!m_profiler.exec(query)) {
+        setLastError(
+            QString("Failed to prune channel messages: %1").arg(query.lastError().text()));
+        qCWarning(lcStorage) << getLastError();
+        break;
+      }
+
+      removed += query.numRowsAffected();
+      excess -= query.numRowsAffected();
+    }
+  }
+
+  return removed;
+}
+
+int DatabaseManager::pruneForSizeBudget(int batchSize) {
+  if (m_retentionPolicy.maxDatabaseBytes <= 0 ||
+      usedDatabaseBytes() <= m_retentionPolicy.maxDatabaseBytes || m_partitions.isEmpty()) {
+    return 0;
   }
 
-  QString hash = generateMessageHash(message);
+  // Rows go oldest first from the oldest partition; once it is empty (and
+  // is not the one being written) the table itself is dropped
+  const MessagePartition oldest = m_partitions.first();
 
   QSqlQuery query(m_db);
-  query.prepare("SELECT 1 FROM message_hashes WHERE hash = ?");
-  query.addBindValue(hash);
+  query.prepare(QString("DELETE FROM %1 WHERE id IN ("
+                        "SELECT id FROM %1 ORDER BY received_at LIMIT ?)")
+                    .arg(oldest.name));
+  query.addBindValue(batchSize);
+
+  if (!m_profiler.exec(query)) {
+    setLastError(QString("Failed to prune for size budget: %1").arg(query.lastError().text()));
+    qCWarning(lcStorage) << getLastError();
+    return 0;
+  }
 
-  return query.exec() && query.next();
+  // Only the rows actually deleted count; a failed drop reclaims nothing,
+  // so the step reports less than a batch and the timer backs off to its
+  // normal interval instead of retrying at once
+  int removed = query.numRowsAffected();
+  if (removed < batchSize && m_partitions.size() > 1 && dropPartitionLocked(oldest.name) < 0) {
+    qCWarning(lcStorage) << "Size budget not met:" << getLastError();
+  }
+
+  return removed;
 }
 
-bool DatabaseManager::saveMessage(const Message &message, bool isSentByMe) {
-  QMutexLocker locker(&m_mutex);
+int DatabaseManager::compressColdPartitions(int batchSize) {
+  m_compressionBacklog = false;
 
-  if (!m_db.isOpen()) {
-    m_lastError = "Database not open";
-    return false;
+  if (m_retentionPolicy.compressAfterDays <= 0) {
+    return 0;
   }
 
-  // Check for duplicate
-  QString hash = generateMessageHash(message);
-  QSqlQuery checkQuery(m_db);
-  checkQuery.prepare("SELECT 1 FROM message_hashes WHERE hash = ?");
-  checkQuery.addBindValue(hash);
+  qint64 cutoff = QDateTime::currentSecsSinceEpoch() -
+                  qint64(m_retentionPolicy.compressAfterDays) * 86400;
 
-  if (checkQuery.exec() && checkQuery.next()) {
-    // Duplicate, silently skip
-    return true;
+  // One partition at a time, oldest first; the partition being written is
+  // never old enough
+  for (const MessagePartition &partition : std::as_const(m_partitions)) {
+    if (!partition.compressed && partition.periodEnd <= cutoff) {
+      const QString name = partition.name;
+      int copied = compressPartitionLocked(name, batchSize);
+      m_compressionBacklog = copied >= 0;
+      return qMax(copied, 0);
+    }
   }
 
-  if (!m_db.transaction()) {
-    m_lastError = "Failed to start transaction";
-    return false;
-  }
+  return 0;
+}
+
+int DatabaseManager::compressPartitionLocked(const QString &name, int batchSize) {
+  // Compressing rows in place would leave the freed space scattered inside
+  // the partition's pages, which nothing writes to again. The rows are
+  // copied into a fresh table instead, which replaces the original once the
+  // copy is complete.
+  const QString target = name + COMPRESSED_TABLE_SUFFIX;
 
-  // Insert message
   QSqlQuery query(m_db);
-  query.prepare("INSERT INTO messages "
-                "(message_type, channel_idx, sender_pubkey_prefix, sender_name, text, "
-                "timestamp, received_at, path_length, txt_type, snr, is_sent_by_me) "
-                "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+  query.prepare("SELECT dict_id FROM message_partitions WHERE name = ?");
+  query.addBindValue(name);
+  if (!m_profiler.exec(query) || !query.next()) {
+    setLastError(
+        QString("Failed to read partition %1: %2").arg(name, query.lastError().text()));
+    qCWarning(lcStorage) << getLastError();
+    return -1;
+  }
+  QVariant storedDictId = query.value(0);
+  query.finish();
+
+  int dictId = storedDictId.toInt();
+  if (storedDictId.isNull()) {
+    // First batch: train the partition's dictionary from its newest texts
+    QVector<QByteArray> samples;
+    if (MessageTextCodec::hasZstd()) {
+      QSqlQuery sampleQuery(m_db);
+      sampleQuery.setForwardOnly(true);
+      sampleQuery.prepare(
+          QString("SELECT text FROM %1 WHERE text <> '' ORDER BY id DESC LIMIT ?").arg(name));
+      sampleQuery.addBindValue(DICTIONARY_SAMPLE_ROWS);
+      if (m_profiler.exec(sampleQuery)) {
+        while (sampleQuery.next()) {
+          samples.append(sampleQuery.value(0).toString().toUtf8());
+        }
+      }
+    }
 
-  query.addBindValue(static_cast<int>(message.type));
-  query.addBindValue(message.type == Message::CHANNEL_MESSAGE
-                         ? QVariant(message.channelIdx)
-                         : QVariant());
-  query.addBindValue(message.type == Message::CONTACT_MESSAGE ? message.senderPubKeyPrefix
-                                                               : QVariant());
-  query.addBindValue(message.senderName);
-  query.addBindValue(message.text);
-  query.addBindValue(message.timestamp);
-  query.addBindValue(message.receivedAt.toSecsSinceEpoch());
-  query.addBindValue(message.pathLength);
-  query.addBindValue(message.txtType);
-  query.addBindValue(message.snr);
-  query.addBindValue(isSentByMe ? 1 : 0);
+    QByteArray dictionary;
+    if (!samples.isEmpty()) {
+      dictionary = MessageTextCodec::trainDictionary(samples, DICTIONARY_BYTES);
+    }
 
-  if (!query.exec()) {
-    m_lastError = QString("Failed to save message: %1").arg(query.lastError().text());
-    qWarning() << m_lastError;
+    if (!m_db.transaction()) {
+      setLastError("Failed to start transaction");
+      return -1;
+    }
+
+    dictId = 0; // zlib unless a dictionary was trained
+    if (!dictionary.isEmpty()) {
+      query.prepare("INSERT INTO compression_dictionaries "
+                    "(codec, dictionary, sample_count, created_at) VALUES (?, ?, ?, ?)");
+      query.addBindValue(static_cast<int>(MessageTextCodec::ZstdDictionary));
+      query.addBindValue(dictionary);
+      query.addBindValue(samples.size());
+      query.addBindValue(QDateTime::currentSecsSinceEpoch());
+      if (!m_profiler.exec(query)) {
+        setLastError(
+            QString("Failed to store dictionary: %1").arg(query.lastError().text()));
+        qCWarning(lcStorage) << getLastError();
+        m_db.rollback();
+        return -1;
+      }
+      dictId = query.lastInsertId().toInt();
+    }
+
+    QSqlQuery update(m_db);
+    update.prepare("UPDATE message_partitions SET dict_id = ? WHERE name = ?");
+    update.addBindValue(dictId);
+    update.addBindValue(name);
+
+    if (!m_profiler.exec(query, QString("DROP TABLE IF EXISTS %1").arg(target)) ||
+        !m_profiler.exec(query, messagesTableSql(target, false)) ||
+        !m_profiler.exec(update) || !m_db.commit()) {
+      setLastError(QString("Failed to start compressing %1: %2")
+                       .arg(name, query.lastError().text()));
+      qCWarning(lcStorage) << getLastError();
+      m_db.rollback();
+      return -1;
+    }
+
+    if (!dictionary.isEmpty()) {
+      m_textCodec.addDictionary(dictId, MessageTextCodec::ZstdDictionary, dictionary);
+    }
+
+    qCDebug(lcStorage) << "Compressing partition" << name
+                       << (dictId ? QString("with a %1-byte dictionary from %2 messages")
+                              .arg(dictionary.size())
+                              .arg(samples.size())
+                        : QString("with zlib"));
+  }
+
+  // Rows are copied in id order, so the copy's highest id is the cursor
+  qint64 cursor = 0;
+  if (m_profiler.exec(query, QString("SELECT MAX(id) FROM %1").arg(target)) && query.next()) {
+    cursor = query.value(0).toLongLong();
+  }
+  query.finish();
+
+  if (!m_db.transaction()) {
+    setLastError("Failed to start transaction");
+    return -1;
+  }
+
+  QSqlQuery rows(m_db);
+  rows.setForwardOnly(true);
+  rows.prepare(QString("SELECT id, message_type, channel_idx, sender_id, text, timestamp, "
+                       "received_at, path_length, txt_type, snr, is_sent_by_me "
+                       "FROM %1 WHERE id > ? ORDER BY id LIMIT ?")
+                   .arg(name));
+  rows.addBindValue(cursor);
+  rows.addBindValue(batchSize);
+
+  QSqlQuery insert(m_db);
+  insert.prepare(QString("INSERT INTO %1 (id, message_type, channel_idx, sender_id, text, "
+                         "timestamp, received_at, path_length, txt_type, snr, "
+                         "is_sent_by_me, text_z, dict_id) "
+                         "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)")
+                     .arg(target));
+
+  if (!m_profiler.exec(rows)) {
+    setLastError(QString("Failed to read %1: %2").arg(name, rows.lastError().text()));
+    qCWarning(lcStorage) << getLastError();
     m_db.rollback();
-    return false;
+    return -1;
   }
 
-  // Get message ID
-  qint64 messageId = query.lastInsertId().toLongLong();
+  int copied = 0;
+  while (rows.next()) {
+    // Texts that would not shrink (very short ones, mostly) stay plain
+    QByteArray text = rows.value(4).toString().toUtf8();
+    QByteArray compressed = m_textCodec.compress(text, dictId);
+    bool useCompressed = !compressed.isEmpty() && compressed.size() < text.size();
 
-  // Insert hash
-  QSqlQuery hashQuery(m_db);
-  hashQuery.prepare(
-      "INSERT INTO message_hashes (hash, message_id, created_at) VALUES (?, ?, ?)");
-  hashQuery.addBindValue(hash);
-  hashQuery.addBindValue(messageId);
-  hashQuery.addBindValue(QDateTime::currentSecsSinceEpoch());
+    for (int i = 0; i < 4; ++i) {
+      insert.addBindValue(rows.value(i));
+    }
+    insert.addBindValue(useCompressed ? QVariant(QString("")) : rows.value(4));
+    for (int i = 5; i < 11; ++i) {
+      insert.addBindValue(rows.value(i));
+    }
+    insert.addBindValue(useCompressed ? QVariant(compressed) : QVariant());
+    insert.addBindValue(dictId);
+
+    if (!m_profiler.exec(insert)) {
+      setLastError(QString("Failed to compress %1: %2").arg(name, insert.lastError().text()));
+      qCWarning(lcStorage) << getLastError();
+      m_db.rollback();
+      return -1;
+    }
+    copied++;
+  }
+  rows.finish();
 
-  if (!hashQuery.exec()) {
-    m_lastError = QString("Failed to save message hash: %1").arg(hashQuery.lastError().text());
-    qWarning() << m_lastError;
+  bool finished = copied < batchSize;
+  if (finished && !finishCompressedPartitionLocked(name)) {
+    qCWarning(lcStorage) << getLastError();
     m_db.rollback();
-    return false;
+    return -1;
   }
 
   if (!m_db.commit()) {
-    m_lastError = "Failed to commit message transaction";
+    setLastError(QString("Failed to commit compression of %1").arg(name));
+    qCWarning(lcStorage) << getLastError();
     m_db.rollback();
-    return false;
+    return -1;
   }
 
-  return true;
+  if (finished) {
+    for (MessagePartition &partition : m_partitions) {
+      if (partition.name == name) {
+        partition.compressed = true;
+      }
+    }
+    qCDebug(lcStorage) << "Compressed message partition" << name;
+  }
+
+  return copied;
 }
 
-QVector<Message> DatabaseManager::loadMessages(int limit, int offset) {
-  QMutexLocker locker(&m_mutex);
-  QVector<Message> messages;
+bool DatabaseManager::finishCompressedPartitionLocked(const QString &name) {
+  // Runs in the caller's transaction. Rows deleted or moved off a deleted
+  // channel since they were copied are reconciled first; the copy has no
+  // triggers yet, so the aggregates (already right for the original) are
+  // untouched. The swap drops the original's indexes and triggers with it.
+  const QString target = name + COMPRESSED_TABLE_SUFFIX;
+
+  QStringList statements = {
+      QString("DELETE FROM %2 WHERE id NOT IN (SELECT id FROM %1)").arg(name, target),
+      QString("UPDATE %2 SET channel_idx = "
+              "(SELECT o.channel_idx FROM %1 o WHERE o.id = %2.id) "
+              "WHERE channel_idx IS NOT (SELECT o.channel_idx FROM %1 o WHERE o.id = %2.id)")
+          .arg(name, target),
+      QString("UPDATE message_partitions SET "
+              "raw_bytes = (SELECT COALESCE(SUM(length(CAST(text AS BLOB))), 0) FROM %1), "
+              "stored_bytes = (SELECT COALESCE(SUM(COALESCE(length(text_z), "
+              "length(CAST(text AS BLOB)))), 0) FROM %2), "
+              "compressed_at = %3 WHERE name = '%1'")
+          .arg(name, target)
+          .arg(QDateTime::currentSecsSinceEpoch()),
+      QString("DROP TABLE %1").arg(name),
+      QString("ALTER TABLE %1 RENAME TO %2").arg(target, name),
+  };
+  statements << partitionObjectsSql(name);
 
-  if (!m_db.isOpen()) {
-    m_lastError = "Database not open";
-    return messages;
+  QSqlQuery query(m_db);
+  for (const QString &statement : statements) {
+    if (!m_profiler.exec(query, statement)) {
+      setLastError(QString("Failed to replace partition %1: %2")
+                       .arg(name, query.lastError().text()));
+      return false;
+    }
   }
 
-  QSqlQuery query(m_db);
-  query.prepare("SELECT message_type, channel_idx, sender_pubkey_prefix, sender_name, text, "
-                "timestamp, received_at, path_length, txt_type, snr, is_sent_by_me "
-                "FROM messages ORDER BY received_at DESC LIMIT ? OFFSET ?");
-  query.addBindValue(limit);
-  query.addBindValue(offset);
+  return true;
+}
 
-  if (!query.exec()) {
-    m_lastError = QString("Failed to load messages: %1").arg(query.lastError().text());
-    return messages;
+CompressionStats DatabaseManager::compressionStats() {
+  QSqlDatabase db = m_readPool.connection();
+  CompressionStats stats;
+
+  if (!db.isOpen()) {
+    setLastError("Database not open");
+    return stats;
   }
 
-  while (query.next()) {
-    Message msg;
-    msg.type = static_cast<Message::Type>(query.value(0).toInt());
-    msg.channelIdx = query.value(1).toUInt();
-    msg.senderPubKeyPrefix = query.value(2).toByteArray();
-    msg.senderName = query.value(3).toString();
-    msg.text = query.value(4).toString();
-    msg.timestamp = query.value(5).toUInt();
-    msg.receivedAt = QDateTime::fromSecsSinceEpoch(query.value(6).toLongLong());
-    msg.pathLength = query.value(7).toUInt();
-    msg.pathLen = msg.pathLength; // Alias
-    msg.txtType = query.value(8).toUInt();
-    msg.snr = query.value(9).toFloat();
-    // is_sent_by_me is at index 10, but not stored in Message struct
-
-    messages.append(msg);
+  // raw_bytes and stored_bytes are only set once a partition is compressed
+  QSqlQuery query(db);
+  if (!m_profiler.exec(query, "SELECT COUNT(*), COUNT(compressed_at), "
+                              "COALESCE(SUM(raw_bytes), 0), "
+                              "COALESCE(SUM(stored_bytes), 0) FROM message_partitions") ||
+      !query.next()) {
+    setLastError(
+        QString("Failed to load compression stats: %1").arg(query.lastError().text()));
+    return stats;
   }
 
-  return messages;
+  stats.partitions = query.value(0).toInt();
+  stats.compressedPartitions = query.value(1).toInt();
+  stats.rawTextBytes = query.value(2).toLongLong();
+  stats.storedTextBytes = query.value(3).toLongLong();
+  return stats;
 }
 
-QVector<Message> DatabaseManager::loadChannelMessages(uint8_t channelIdx, int limit) {
-  QMutexLocker locker(&m_mutex);
-  QVector<Message> messages;
+CompressionMeasurement DatabaseManager::measureCompression(int sampleRows) {
+  QSqlDatabase db = m_readPool.connection();
+  CompressionMeasurement result;
 
-  if (!m_db.isOpen()) {
-    m_lastError = "Database not open";
-    return messages;
+  if (!db.isOpen()) {
+    setLastError("Database not open");
+    return result;
   }
 
-  QSqlQuery query(m_db);
-  query.prepare("SELECT message_type, channel_idx, sender_pubkey_prefix, sender_name, text, "
-                "timestamp, received_at, path_length, txt_type, snr, is_sent_by_me "
-                "FROM messages WHERE channel_idx = ? ORDER BY timestamp DESC LIMIT ?");
-  query.addBindValue(channelIdx);
-  query.addBindValue(limit);
+  // Newest history first, decoded the same way loads decode it
+  QVector<QByteArray> texts;
+  db.transaction();
 
-  if (!query.exec()) {
-    m_lastError =
-        QString("Failed to load channel messages: %1").arg(query.lastError().text());
-    return messages;
+  QStringList partitions;
+  QSqlQuery catalog(db);
+  catalog.setForwardOnly(true);
+  if (m_profiler.exec(catalog, "SELECT name FROM message_partitions WHERE max_id IS NOT NULL "
+                               "ORDER BY period_end DESC")) {
+    while (catalog.next()) {
+      partitions.append(catalog.value(0).toString());
+    }
   }
 
-  while (query.next()) {
-    Message msg;
-    msg.type = static_cast<Message::Type>(query.value(0).toInt());
-    msg.channelIdx = query.value(1).toUInt();
-    msg.senderPubKeyPrefix = query.value(2).toByteArray();
-    msg.senderName = query.value(3).toString();
-    msg.text = query.value(4).toString();
-    msg.timestamp = query.value(5).toUInt();
-    msg.receivedAt = QDateTime::fromSecsSinceEpoch(query.value(6).toLongLong());
-    msg.pathLength = query.value(7).toUInt();
-    msg.pathLen = msg.pathLength;
-    msg.txtType = query.value(8).toUInt();
-    msg.snr = query.value(9).toFloat();
-
-    messages.append(msg);
-  }
+  for (const QString &partition : std::as_const(partitions)) {
+    if (texts.size() >= sampleRows) {
+      break;
+    }
 
-  return messages;
-}
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare(QString("SELECT text, text_z, dict_id FROM %1 ORDER BY id DESC LIMIT ?")
+                      .arg(partition));
+    query.addBindValue(sampleRows - texts.size());
+    if (!m_profiler.exec(query)) {
+      continue;
+    }
 
-QVector<Message> DatabaseManager::loadDirectMessages(const QByteArray &contactPubKeyPrefix,
-                                                     int limit) {
-  QMutexLocker locker(&m_mutex);
-  QVector<Message> messages;
+    while (query.next()) {
+      bool decoded = false;
+      QByteArray text =
+          storedText(query.value(0), query.value(1), query.value(2), &decoded).toUtf8();
+      if (decoded && !text.isEmpty()) {
+        texts.append(text);
+      }
+    }
+  }
 
-  if (!m_db.isOpen()) {
-    m_lastError = "Database not open";
-    return messages;
+  db.commit();
+
+  if (texts.size() < 2) {
+    return result;
   }
 
-  QSqlQuery query(m_db);
-  query.prepare("SELECT message_type, channel_idx, sender_pubkey_prefix, sender_name, text, "
-                "timestamp, received_at, path_length, txt_type, snr, is_sent_by_me "
-                "FROM messages WHERE sender_pubkey_prefix = ? ORDER BY timestamp DESC LIMIT ?");
-  query.addBindValue(contactPubKeyPrefix);
-  query.addBindValue(limit);
+  // Train on every other message and compress the rest, so the measured
+  // texts were not seen by the dictionary
+  QVector<QByteArray> training;
+  QVector<QByteArray> measured;
+  for (int i = 0; i < texts.size(); ++i) {
+    (i % 2 ? measured : training).append(texts[i]);
+  }
 
-  if (!query.exec()) {
-    m_lastError =
-        QString("Failed to load direct messages: %1").arg(query.lastError().text());
-    return messages;
+  MessageTextCodec codec;
+  int dictId = 0;
+  QByteArray dictionary = MessageTextCodec::trainDictionary(training, DICTIONARY_BYTES);
+  if (!dictionary.isEmpty()) {
+    dictId = 1;
+    codec.addDictionary(dictId, MessageTextCodec::ZstdDictionary, dictionary);
   }
 
-  while (query.next()) {
-    Message msg;
-    msg.type = static_cast<Message::Type>(query.value(0).toInt());
-    msg.channelIdx = query.value(1).toUInt();
-    msg.senderPubKeyPrefix = query.value(2).toByteArray();
-    msg.senderName = query.value(3).toString();
-    msg.text = query.value(4).toString();
-    msg.timestamp = query.value(5).toUInt();
-    msg.receivedAt = QDateTime::fromSecsSinceEpoch(query.value(6).toLongLong());
-    msg.pathLength = query.value(7).toUInt();
-    msg.pathLen = msg.pathLength;
-    msg.txtType = query.value(8).toUInt();
-    msg.snr = query.value(9).toFloat();
-
-    messages.append(msg);
+  // Stored as partitions store them: compressed only where that is smaller
+  QVector<QPair<QByteArray, bool>> stored;
+  for (const QByteArray &text : std::as_const(measured)) {
+    QByteArray compressed = codec.compress(text, dictId);
+    bool useCompressed = !compressed.isEmpty() && compressed.size() < text.size();
+    stored.append({useCompressed ? compressed : text, useCompressed});
+    result.rawBytes += text.size();
+    result.compressedBytes += stored.last().first.size();
   }
 
-  return messages;
-}
+  const int repeats = 5;
+  qint64 checksum = 0;
+  QElapsedTimer timer;
 
-int DatabaseManager::getMessageCount() {
-  QMutexLocker locker(&m_mutex);
+  timer.start();
+  for (int r = 0; r < repeats; ++r) {
+    for (const QByteArray &text : std::as_const(measured)) {
+      checksum += QString::fromUtf8(text).size();
+    }
+  }
+  qint64 plainNs = timer.nsecsElapsed();
 
-  if (!m_db.isOpen()) {
-    return 0;
+  timer.restart();
+  for (int r = 0; r < repeats; ++r) {
+    for (const auto &row : std::as_const(stored)) {
+      checksum -= (row.second ? codec.decompress(row.first, dictId)
+                              : QString::fromUtf8(row.first))
+                      .size();
+    }
   }
+  qint64 compressedNs = timer.nsecsElapsed();
 
-  QSqlQuery query(m_db);
-  if (!query.exec("SELECT COUNT(*) FROM messages")) {
-    return 0;
+  if (checksum != 0) {
+    qCWarning(lcStorage) << "Compressed sample did not round-trip";
   }
 
-  if (query.next()) {
-    return query.value(0).toInt();
+  double decodes = double(measured.size()) * repeats;
+  result.sampledRows = texts.size();
+  result.plainDecodeNs = plainNs / decodes;
+  result.compressedDecodeNs = compressedNs / decodes;
+  result.usedDictionary = dictId != 0;
+  return result;
+}
+
+qint64 DatabaseManager::usedDatabaseBytes() {
+  // Pages on the freelist are reusable space, not data
+  QSqlQuery query(m_db);
+  if (!m_profiler.exec(query, "SELECT (SELECT page_count FROM pragma_page_count()) - "
+                              "(SELECT freelist_count FROM pragma_freelist_count()), "
+                              "(SELECT page_size FROM pragma_page_size())") ||
+      !query.next()) {
+    return 0;
   }
 
-  return 0;
+  return query.value(0).toLongLong() * query.value(1).toLongLong();
 }
 
-int DatabaseManager::getChannelMessageCount(uint8_t channelIdx) {
+qint64 DatabaseManager::memoryUsage() const {
   QMutexLocker locker(&m_mutex);
-
-  if (!m_db.isOpen()) {
-    return 0;
+  // QHash entries are estimated at their key, value and two words of overhead
+  qint64 bytes = m_senderIds.capacity() *
+                 qint64(sizeof(QByteArray) + sizeof(qint64) + 2 * sizeof(void *));
+  for (auto it = m_senderIds.cbegin(); it != m_senderIds.cend(); ++it) {
+    bytes += it.key().capacity();
   }
+  for (const MessagePartition &partition : m_partitions) {
+    bytes += sizeof(MessagePartition) + partition.name.capacity() * qint64(sizeof(QChar));
+  }
+  return bytes + m_profiler.memoryUsage();
+}
 
-  QSqlQuery query(m_db);
-  query.prepare("SELECT COUNT(*) FROM messages WHERE channel_idx = ?");
-  query.addBindValue(channelIdx);
+qint64 DatabaseManager::getDatabaseSize() {
+  QMutexLocker locker(&m_mutex);
 
-  if (!query.exec() || !query.next()) {
+  if (!m_db.isOpen()) {
     return 0;
   }
 
-  return query.value(0).toInt();
+  return usedDatabaseBytes();
 }
 
 bool DatabaseManager::clearAllData() {
   QMutexLocker locker(&m_mutex);
 
   if (!m_db.isOpen()) {
-    m_lastError = "Database not open";
+    setLastError("Database not open");
     return false;
   }
 
   QSqlQuery query(m_db);
 
   if (!m_db.transaction()) {
-    m_lastError = "Failed to start transaction";
+    setLastError("Failed to start transaction");
     return false;
   }
 
-  query.exec("DELETE FROM message_hashes");
-  query.exec("DELETE FROM messages");
-  query.exec("DELETE FROM channels");
-  query.exec("DELETE FROM contacts");
-  query.exec("DELETE FROM device_info");
+  for (const MessagePartition &partition : std::as_const(m_partitions)) {
+    m_profiler.exec(query, QString("DROP TABLE IF EXISTS %1").arg(partition.name));
+    m_profiler.exec(query, QString("DROP TABLE IF EXISTS %1%2")
+                               .arg(partition.name, COMPRESSED_TABLE_SUFFIX));
+  }
+  m_profiler.exec(query, "DELETE FROM message_partitions");
+  m_profiler.exec(query, "DELETE FROM compression_dictionaries");
+  m_profiler.exec(query, "DELETE FROM stats_partition_totals");
+  m_profiler.exec(query, "DELETE FROM message_hashes");
+  m_profiler.exec(query, "DELETE FROM senders");
+  m_profiler.exec(query, "DELETE FROM stats_channel_totals");
+  m_profiler.exec(query, "DELETE FROM stats_hourly");
+  m_profiler.exec(query, "DELETE FROM stats_senders");
+  m_profiler.exec(query, "DELETE FROM stats_snr_histogram");
+  m_profiler.exec(query, "DELETE FROM stats_path_histogram");
+  m_profiler.exec(query, "DELETE FROM conversations");
+  m_profiler.exec(query, "DELETE FROM channels");
+  m_profiler.exec(query, "DELETE FROM contacts");
+  m_profiler.exec(query, "DELETE FROM device_info");
 
   if (!m_db.commit()) {
-    m_lastError = "Failed to commit clear data transaction";
+    setLastError("Failed to commit clear data transaction");
     m_db.rollback();
     return false;
   }
 
+  m_senderIds.clear();
+  m_partitions.clear();
+  m_nextMessageId = 1;
+  m_textCodec.clear();
+
   return true;
 }
 
@@ -4,17 +4,66 @@
 #include <QString>
 #include <QSqlDatabase>
 #include <QMutex>
+#include <QTimer>
 #include <QByteArray>
 #include <QVector>
+#include <QHash>
+#include <QVariant>
+#include <functional>
 
+#include "Conversation.h"
+#include "DatabaseBackup.h"
+#include "IMessageStore.h"
+#include "MessageStats.h"
+#include "MessageTextCodec.h"
+#include "QueryProfiler.h"
+#include "ReadConnectionPool.h"
+#include "RetentionPolicy.h"
+#include "StorageProfile.h"
+#include "WalCheckpointer.h"
 #include "../models/Contact.h"
 #include "../models/Channel.h"
 #include "../models/Message.h"
 #include "../core/DeviceInfo.h"
 
+class QSqlQuery;
+
 namespace MeshCore {
 
-class DatabaseManager : public QObject {
+struct ContactSyncResult {
+  int written = 0;   // Inserted or changed rows
+  int unchanged = 0; // Already up to date
+  int removed = 0;   // No longer on the device
+  qint64 elapsedMs = 0;
+};
+
+// Stored size of partitions whose text has been compressed
+struct CompressionStats {
+  int partitions = 0;
+  int compressedPartitions = 0;
+  qint64 rawTextBytes = 0;    // UTF-8 text before compression
+  qint64 storedTextBytes = 0; // What those partitions store instead
+
+  double ratio() const {
+    return storedTextBytes > 0 ? double(rawTextBytes) / storedTextBytes : 0.0;
+  }
+};
+
+// Result of DatabaseManager::measureCompression()
+struct CompressionMeasurement {
+  int sampledRows = 0;
+  qint64 rawBytes = 0;
+  qint64 compressedBytes = 0;
+  double plainDecodeNs = 0;      // Per row, text column to QString
+  double compressedDecodeNs = 0; // Per row, including decompression
+  bool usedDictionary = false;   // false: zlib without a dictionary
+
+  double ratio() const {
+    return compressedBytes > 0 ? double(rawBytes) / compressedBytes : 0.0;
+  }
+};
+
+class DatabaseManager : public QObject, public IMessageStore {
   Q_OBJECT
 
 public:
@@ -22,10 +71,16 @@ public:
   ~DatabaseManager();
 
   // Database lifecycle
-  bool openDatabase(const QByteArray &devicePublicKey);
-  void closeDatabase();
-  bool isOpen() const;
+  bool openDatabase(const QByteArray &devicePublicKey) override;
+  void closeDatabase() override;
+  bool isOpen() const override;
   QString getDatabasePath(const QByteArray &devicePublicKey) const;
+  void setDatabaseDirectory(const QString &directory); // Empty = app data dir
+
+  // Load and count methods are safe to call from any thread; each thread
+  // reads through its own pooled read-only connection, closed when the
+  // thread finishes or, earlier, by releaseReadConnection().
+  void releaseReadConnection();
 
   // Device info operations
   bool saveDeviceInfo(const DeviceInfo &deviceInfo, const SelfInfo &selfInfo);
@@ -35,6 +90,10 @@ public:
   // Contact operations
   bool saveContact(const Contact &contact);
   bool saveContacts(const QVector<Contact> &contacts);
+  // Makes the table match the device's full list: upserts every contact and
+  // removes those no longer on the device, in one transaction
+  bool syncContacts(const QVector<Contact> &contacts,
+                    ContactSyncResult *result = nullptr);
   bool deleteContact(const QByteArray &publicKey);
   QVector<Contact> loadAllContacts();
   Contact loadContact(const QByteArray &publicKey);
@@ -47,14 +106,84 @@ public:
   Channel loadChannel(uint8_t channelIdx);
 
   // Message operations
-  bool saveMessage(const Message &message, bool isSentByMe = false);
-  QVector<Message> loadMessages(int limit = 100, int offset = 0);
-  QVector<Message> loadChannelMessages(uint8_t channelIdx, int limit = 100);
+  bool saveMessage(const Message &message, bool isSentByMe = false) override;
+  bool saveMessages(const QVector<Message> &messages, bool isSentByMe = false) override;
+  QVector<Message> loadMessages(int limit = 100, int offset = 0) override;
+  QVector<Message> loadChannelMessages(uint8_t channelIdx, int limit = 100,
+                                       int offset = 0) override;
   QVector<Message> loadDirectMessages(const QByteArray &contactPubKeyPrefix,
-                                      int limit = 100);
-  bool isMessageDuplicate(const Message &message);
-  int getMessageCount();
+                                      int limit = 100, int offset = 0) override;
+  bool isMessageDuplicate(const Message &message) override;
+  int getMessageCount() override;
   int getChannelMessageCount(uint8_t channelIdx);
+  // Streams each partition through a forward-only cursor in a read
+  // transaction of its own, so checkpoints are only held back for the
+  // partition being read
+  bool scanMessages(qint64 fromSecs, qint64 toSecs,
+                    const std::function<bool(const Message &)> &visitor) override;
+
+  // Statistics, read from trigger-maintained aggregates; cost does not grow
+  // with history size
+  QVector<ChannelCount> getChannelCounts();
+  QVector<HourlyCount> getHourlyCounts(int hours = 24);
+  QVector<SenderCount> getTopSenders(int limit = 10);
+  QVector<HistogramBucket> getSnrHistogram();
+  QVector<HistogramBucket> getPathLengthHistogram();
+
+  // Inbox: newest conversation first, maintained as messages are written
+  QVector<Conversation> listConversations();
+  bool markRead(uint8_t channelIdx);
+  bool markRead(const QByteArray &pubKeyPrefix);
+
+  // Retention
+  void setRetentionPolicy(const RetentionPolicy &policy);
+  RetentionPolicy retentionPolicy() const;
+  int runRetentionStep();
+  qint64 getDatabaseSize();
+  // Whether pruned pages are returned to the filesystem. Databases created
+  // before retention support are not converted when opened: the conversion
+  // is a full VACUUM that blocks writes for as long as it takes to rewrite
+  // the file, so enableIncrementalVacuum() only runs it when asked.
+  bool isIncrementalVacuumEnabled();
+  bool enableIncrementalVacuum();
+  // Heap held by the sender cache, partition list and statement profiler;
+  // SQLite's page cache is sized by the storage profile
+  qint64 memoryUsage() const;
+
+  // Cold storage: partitions older than RetentionPolicy::compressAfterDays
+  // are rewritten with compressed text, in batches, by the retention timer.
+  // Loads decompress transparently.
+  CompressionStats compressionStats();
+  // Compresses a sample of stored history in memory (training on half of it
+  // and measuring on the other half) and times decoding; writes nothing
+  CompressionMeasurement measureCompression(int sampleRows = 2000);
+
+  // Connection tuning; takes effect on the writer immediately and on read
+  // connections as they are opened
+  void setStorageProfile(StorageProfile profile);
+  StorageProfile storageProfile() const;
+
+  // WAL checkpoints run on a background thread and connection, never inline
+  // with a write. A blocking checkpoint waits for it to finish.
+  void setCheckpointPolicy(const CheckpointPolicy &policy);
+  CheckpointPolicy checkpointPolicy() const;
+  WalStats walStats() const;
+  bool checkpointNow(WalCheckpointer::Mode mode);
+
+  // Online backup: copies a consistent snapshot to targetPath on a
+  // background thread while ingest continues. Progress and the result are
+  // reported through backupProgress() and backupFinished(). Returns false if
+  // the database is closed or a backup is already running.
+  bool backupTo(const QString &targetPath, bool verify = true);
+  bool isBackupRunning() const;
+
+  // Statement timings and the slow-query log. Covers the statements run
+  // after the database is open, not schema creation and migrations.
+  QueryProfiler &queryProfiler() { return m_profiler; }
+  // EXPLAIN QUERY PLAN for sql, one step per line, indented by depth. Runs
+  // on the calling thread's read connection; placeholders without a value
+  // are bound to NULL.
+  QString explainQueryPlan(const QString &sql, const QVariantList &bindValues = {});
 
   // Schema management
   int getCurrentSchemaVersion();
@@ -62,21 +191,96 @@ public:
 
   // Utility
   bool clearAllData();
-  QString getLastError() const { return m_lastError; }
+  QString getLastError() const override;
 
 signals:
   void errorOccurred(const QString &error);
   void databaseOpened(const QString &path);
   void databaseClosed();
+  void retentionStepCompleted(int removedRows);
+  void migrationProgress(int toVersion, const QString &step, qint64 rowsDone,
+                         qint64 rowsTotal);
+  void schemaMigrated(int fromVersion, int toVersion, qint64 elapsedMs);
+  void backupProgress(qint64 bytesWritten, qint64 bytesExpected);
+  void backupFinished(const BackupResult &result);
+
+private slots:
+  void onRetentionTimer();
 
 private:
   // Schema initialization and migration
   bool initializeSchema();
   bool createTables();
+  bool createIndexes();
+  bool createStatsTables();
+  bool createConversationsTable();
+  bool createPartitionTables();
   bool insertSchemaVersion(int version);
 
+  struct Migration {
+    int version;
+    const char *description;
+    bool (DatabaseManager::*apply)();
+  };
+
+  bool migrateToV2();
+  bool migrateToV3();
+  bool migrateToV4();
+  bool migrateToV5();
+  bool migrateToV6();
+  bool addColumnIfMissing(const QString &table, const QString &column, const QString &type);
+  qint64 migrationCursor(int version, const QString &step);
+  bool runResumableStep(int version, const QString &step, const QString &sourceTable,
+                        const std::function<bool(qint64, qint64)> &copyRange);
+  int autoVacuumModeLocked();
+
+  // Retention helpers (caller holds m_mutex)
+  int pruneExpiredHashes(int batchSize);
+  int pruneExpiredMessages(int batchSize);
+  int pruneChannelOverflow(int batchSize);
+  int pruneForSizeBudget(int batchSize);
+  int compressColdPartitions(int batchSize);
+  int compressPartitionLocked(const QString &name, int batchSize);
+  bool finishCompressedPartitionLocked(const QString &name);
+  qint64 usedDatabaseBytes();
+
+  void closeDatabaseLocked();
+  void applyStorageProfileLocked();
+
+  // Message partitions (caller holds m_mutex)
+  struct MessagePartition {
+    QString name;
+    qint64 periodStart; // received_at range [start, end)
+    qint64 periodEnd;
+    bool compressed = false;
+  };
+
+  static QString partitionNameFor(qint64 receivedAt, qint64 *periodStart = nullptr,
+                                  qint64 *periodEnd = nullptr);
+  bool loadPartitionsLocked();
+  bool loadCompressionDictionariesLocked();
+  QString ensurePartitionLocked(qint64 receivedAt);
+  qint64 dropPartitionLocked(const QString &name);
+  bool detachConversationsLocked(const QString &partition);
+
+  // Newest-first history page merged across partitions
+  QVector<Message> loadRouted(const QString &what, const QString &filter,
+                              const QVariantList &bindValues, bool byReceivedAt, int limit,
+                              int offset);
+  int upsertContactsLocked(const QVector<Contact> &contacts);
+
   // Helper methods
-  QString generateMessageHash(const Message &message) const;
+  void setLastError(const QString &error);
+  QByteArray generateMessageHash(const Message &message) const;
+  qint64 resolveSenderId(const Message &message);
+  bool insertMessageLocked(const Message &message, const QByteArray &hash,
+                           const QString &partition, qint64 senderId, qint64 messageId,
+                           bool isSentByMe);
+  Message messageFromQuery(const QSqlQuery &query, bool *ok = nullptr) const;
+  QString storedText(const QVariant &text, const QVariant &textZ, const QVariant &dictId,
+                     bool *ok = nullptr) const;
+  QVector<HistogramBucket> loadHistogram(const QString &sql);
+  bool markConversationRead(Message::Type kind, const QVariant &peer);
   QSqlDatabase getDatabase();
   bool executeQuery(const QString &query);
 
@@ -84,10 +288,31 @@ private:
   QSqlDatabase m_db;
   QString m_currentDbPath;
   QByteArray m_currentDeviceKey;
-  mutable QMutex m_mutex;
+  mutable QMutex m_mutex; // Guards the writer connection
+  ReadConnectionPool m_readPool;
+  WalCheckpointer m_checkpointer;
+  DatabaseBackup m_backup;
+  QueryProfiler m_profiler;
+  StorageProfile m_storageProfile;
+  QString m_databaseDirectory;
+
+  mutable QMutex m_errorMutex;
   QString m_lastError;
 
-  static const int CURRENT_SCHEMA_VERSION = 1;
+  QVector<MessagePartition> m_partitions; // Oldest period first
+  qint64 m_nextMessageId;
+  MessageTextCodec m_textCodec; // Shared with reader threads
+  bool m_compressionBacklog;
+
+  QTimer *m_retentionTimer;
+  RetentionPolicy m_retentionPolicy;
+
+  // Sender key (prefix + name) -> senders.id, filled as messages are saved
+  QHash<QByteArray, qint64> m_senderIds;
+
+  static const int CURRENT_SCHEMA_VERSION = 6;
+  static const int MIGRATION_BATCH_SIZE = 5000;
+  static const int AUTO_VACUUM_INCREMENTAL = 2; // PRAGMA auto_vacuum value
 };
 
 } // namespace MeshCore
@@ -0,0 +1,680 @@
+#include "HistoryExporter.h"
+#include "IMessageStore.h"
+#include "../core/Logging.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QVector>
+#include <QtEndian>
+#include <cmath>
+#include <cstring>
+#include <memory>
+
+namespace MeshCore {
+
+namespace {
+
+const int PROGRESS_INTERVAL_ROWS = 50000;
+
+// Archive layout, all integers little-endian:
+//   "MCA1" u32 version
+//   per row group: u32 rows, u8 columns, then per column
+//                  u8 column id, u8 encoding, u32 length, data
+//   u32 0 (end of groups), u64 total rows
+const char ARCHIVE_MAGIC[4] = {'M', 'C', 'A', '1'};
+const quint32 ARCHIVE_VERSION = 1;
+
+enum Column : quint8 {
+  ColType,
+  ColChannel,
+  ColSenderKey,
+  ColSenderName,
+  ColText,
+  ColTimestamp,
+  ColReceivedAt,
+  ColPathLength,
+  ColTxtType,
+  ColSnr,
+  COLUMN_COUNT
+};
+
+enum Encoding : quint8 {
+  RunLength = 1,   // (u8 value, varint run) pairs
+  DeltaVarint = 2, // zigzag varint of the difference to the previous row
+  Dictionary = 3,  // varint entry count, entries as strings, varint index per row
+  Strings = 4,     // varint length + bytes per row
+  QuarterDb = 5,   // zigzag varint of value * 4 (how the radio reports SNR)
+  Float32 = 6,     // raw floats, when some value is not a quarter dB
+  ZLIB_FLAG = 0x80 // Column data passed through qCompress
+};
+
+void appendVarint(QByteArray &out, quint64 value) {
+  while (value >= 0x80) {
+    out.append(char((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  out.append(char(value));
+}
+
+bool readVarint(const uchar *&p, const uchar *end, quint64 &value) {
+  value = 0;
+  for (int shift = 0; shift < 64 && p < end; shift += 7) {
+    uchar byte = *p++;
+    value |= quint64(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+quint64 zigzag(qint64 value) { return (quint64(value) << 1) ^ quint64(value >> 63); }
+qint64 unzigzag(quint64 value) { return qint64(value >> 1) ^ -qint64(value & 1); }
+
+void appendString(QByteArray &out, const QByteArray &bytes) {
+  appendVarint(out, quint64(bytes.size()));
+  out.append(bytes);
+}
+
+bool readString(const uchar *&p, const uchar *end, QByteArray &bytes) {
+  quint64 length;
+  if (!readVarint(p, end, length) || length > quint64(end - p)) {
+    return false;
+  }
+  bytes = QByteArray(reinterpret_cast<const char *>(p), int(length));
+  p += length;
+  return true;
+}
+
+// One sink per output format; rows arrive oldest first
+class RowWriter {
+public:
+  explicit RowWriter(QIODevice *device) : m_device(device) {}
+  virtual ~RowWriter() = default;
+  virtual bool begin() { return true; }
+  virtual bool write(const Message &message) = 0;
+  virtual bool finish(qint64 rows) = 0;
+
+protected:
+  bool put(const QByteArray &bytes) { return m_device->write(bytes) == bytes.size(); }
+  QIODevice *m_device;
+};
+
+class JsonLinesWriter : public RowWriter {
+public:
+  using RowWriter::RowWriter;
+
+  bool write(const Message &message) override {
+    QJsonObject row;
+    if (message.type == Message::CHANNEL_MESSAGE) {
+      row["type"] = "channel";
+      row["channel"] = message.channelIdx;
+    } else {
+      row["type"] = "direct";
+      row["sender_key"] = QString(message.senderPubKeyPrefix.toHex());
+    }
+    row["sender"] = message.senderName;
+    row["text"] = message.text;
+    row["timestamp"] = qint64(message.timestamp);
+    row["received_at"] = message.receivedAt.toSecsSinceEpoch();
+    row["path_length"] = message.pathLength;
+    row["txt_type"] = message.txtType;
+    row["snr"] = double(message.snr);
+
+    return put(QJsonDocument(row).toJson(QJsonDocument::Compact) + '\n');
+  }
+
+  bool finish(qint64) override { return true; }
+};
+
+class ArchiveWriter : public RowWriter {
+public:
+  using RowWriter::RowWriter;
+
+  bool begin() override {
+    uchar version[4];
+    qToLittleEndian(ARCHIVE_VERSION, version);
+    return put(QByteArray(ARCHIVE_MAGIC, 4)) &&
+           put(QByteArray(reinterpret_cast<const char *>(version), 4));
+  }
+
+  bool write(const Message &message) override {
+    m_type.append(char(message.type));
+    m_channel.append(char(message.channelIdx));
+    m_senderKeyIndex.append(dictionaryIndex(m_senderKeys, m_senderKeyIds,
+                                            message.senderPubKeyPrefix));
+    m_senderNameIndex.append(dictionaryIndex(m_senderNames, m_senderNameIds,
+                                             message.senderName.toUtf8()));
+    appendString(m_text, message.text.toUtf8());
+    m_timestamp.append(message.timestamp);
+    m_receivedAt.append(message.receivedAt.toSecsSinceEpoch());
+    m_pathLength.append(char(message.pathLength));
+    m_txtType.append(char(message.txtType));
+    m_snr.append(message.snr);
+
+    return m_type.size() < HistoryExporter::ARCHIVE_GROUP_ROWS || flushGroup();
+  }
+
+  bool finish(qint64 rows) override {
+    if (!m_type.isEmpty() && !flushGroup()) {
+      return false;
+    }
+
+    uchar footer[12];
+    qToLittleEndian<quint32>(0, footer);
+    qToLittleEndian<quint64>(quint64(rows), footer + 4);
+    return put(QByteArray(reinterpret_cast<const char *>(footer), sizeof(footer)));
+  }
+
+private:
+  static quint32 dictionaryIndex(QVector<QByteArray> &entries, QHash<QByteArray, quint32> &ids,
+                                 const QByteArray &value) {
+    auto it = ids.constFind(value);
+    if (it != ids.constEnd()) {
+      return it.value();
+    }
+    quint32 id = quint32(entries.size());
+    entries.append(value);
+    ids.insert(value, id);
+    return id;
+  }
+
+  static QByteArray runLengths(const QByteArray &values) {
+    QByteArray out;
+    for (int i = 0; i < values.size();) {
+      int run = 1;
+      while (i + run < values.size() && values[i + run] == values[i]) {
+        ++run;
+      }
+      out.append(values[i]);
+      appendVarint(out, quint64(run));
+      i += run;
+    }
+    return out;
+  }
+
+  static QByteArray deltas(const QVector<qint64> &values) {
+    QByteArray out;
+    qint64 previous = 0;
+    for (qint64 value : values) {
+      appendVarint(out, zigzag(value - previous));
+      previous = value;
+    }
+    return out;
+  }
+
+  static QByteArray dictionary(const QVector<QByteArray> &entries,
+                               const QVector<quint32> &indexes) {
+    QByteArray out;
+    appendVarint(out, quint64(entries.size()));
+    for (const QByteArray &entry : entries) {
+      appendString(out, entry);
+    }
+    for (quint32 index : indexes) {
+      appendVarint(out, index);
+    }
+    return out;
+  }
+
+  bool putColumn(Column column, quint8 encoding, QByteArray data, bool tryZlib) {
+    if (tryZlib && data.size() > 64) {
+      QByteArray packed = qCompress(data, 6);
+      if (packed.size() < data.size()) {
+        data = packed;
+        encoding |= ZLIB_FLAG;
+      }
+    }
+
+    uchar header[6];
+    header[0] = column;
+    header[1] = encoding;
+    qToLittleEndian<quint32>(quint32(data.size()), header + 2);
+    return put(QByteArray(reinterpret_cast<const char *>(header), sizeof(header))) &&
+           put(data);
+  }
+
+  bool flushGroup() {
+    uchar header[5];
+    qToLittleEndian<quint32>(quint32(m_type.size()), header);
+    header[4] = COLUMN_COUNT;
+
+    // The radio reports SNR in quarter dB; anything else is kept as floats
+    bool quarterDb = true;
+    for (float snr : std::as_const(m_snr)) {
+      if (!std::isfinite(snr) || std::fabs(snr) > 1e6f || std::round(snr * 4) / 4 != snr) {
+        quarterDb = false;
+        break;
+      }
+    }
+    QByteArray snrData;
+    if (quarterDb) {
+      for (float snr : std::as_const(m_snr)) {
+        appendVarint(snrData, zigzag(qint64(std::lround(snr * 4))));
+      }
+    } else {
+      for (float snr : std::as_const(m_snr)) {
+        uchar bytes[4];
+        quint32 bits;
+        std::memcpy(&bits, &snr, sizeof(bits));
+        qToLittleEndian(bits, bytes);
+        snrData.append(reinterpret_cast<const char *>(bytes), 4);
+      }
+    }
+
+    bool ok = put(QByteArray(reinterpret_cast<const char *>(header), sizeof(header))) &&
+              putColumn(ColType, RunLength, runLengths(m_type), false) &&
+              putColumn(ColChannel, RunLength, runLengths(m_channel), false) &&
+              putColumn(ColSenderKey, Dictionary, dictionary(m_senderKeys, m_senderKeyIndex),
+                        true) &&
+              putColumn(ColSenderName, Dictionary,
+                        dictionary(m_senderNames, m_senderNameIndex), true) &&
+              putColumn(ColText, Strings, m_text, true) &&
+              putColumn(ColTimestamp, DeltaVarint, deltas(m_timestamp), false) &&
+              putColumn(ColReceivedAt, DeltaVarint, deltas(m_receivedAt), false) &&
+              putColumn(ColPathLength, RunLength, runLengths(m_pathLength), false) &&
+              putColumn(ColTxtType, RunLength, runLengths(m_txtType), false) &&
+              putColumn(ColSnr, quarterDb ? QuarterDb : Float32, snrData, false);
+
+    m_type.clear();
+    m_channel.clear();
+    m_senderKeys.clear();
+    m_senderKeyIds.clear();
+    m_senderKeyIndex.clear();
+    m_senderNames.clear();
+    m_senderNameIds.clear();
+    m_senderNameIndex.clear();
+    m_text.clear();
+    m_timestamp.clear();
+    m_receivedAt.clear();
+    m_pathLength.clear();
+    m_txtType.clear();
+    m_snr.clear();
+    return ok;
+  }
+
+  // Current row group, one buffer per column
+  QByteArray m_type;
+  QByteArray m_channel;
+  QVector<QByteArray> m_senderKeys;
+  QHash<QByteArray, quint32> m_senderKeyIds;
+  QVector<quint32> m_senderKeyIndex;
+  QVector<QByteArray> m_senderNames;
+  QHash<QByteArray, quint32> m_senderNameIds;
+  QVector<quint32> m_senderNameIndex;
+  QByteArray m_text;
+  QVector<qint64> m_timestamp;
+  QVector<qint64> m_receivedAt;
+  QByteArray m_pathLength;
+  QByteArray m_txtType;
+  QVector<float> m_snr;
+};
+
+// One column of a row group decoded to per-row values; which vector is
+// filled depends on the encoding
+struct DecodedColumn {
+  QVector<qint64> numbers;
+  QVector<float> floats;
+  QVector<QByteArray> strings;
+};
+
+bool decodeColumn(quint8 encoding, QByteArray data, quint32 rows, DecodedColumn &column) {
+  if (encoding & ZLIB_FLAG) {
+    data = qUncompress(data);
+    if (data.isEmpty() && rows > 0) {
+      return false;
+    }
+    encoding &= ~ZLIB_FLAG;
+  }
+
+  const uchar *p = reinterpret_cast<const uchar *>(data.constData());
+  const uchar *end = p + data.size();
+  quint64 value;
+
+  switch (encoding) {
+  case RunLength:
+    while (quint32(column.numbers.size()) < rows) {
+      if (p >= end) {
+        return false;
+      }
+      uchar runValue = *p++;
+      if (!readVarint(p, end, value) || value > rows - quint64(column.numbers.size())) {
+        return false;
+      }
+      column.numbers.insert(column.numbers.size(), int(value), runValue);
+    }
+    return true;
+
+  case DeltaVarint:
+  case QuarterDb: {
+    qint64 previous = 0;
+    for (quint32 i = 0; i < rows; ++i) {
+      if (!readVarint(p, end, value)) {
+        return false;
+      }
+      if (encoding == DeltaVarint) {
+        previous += unzigzag(value);
+        column.numbers.append(previous);
+      } else {
+        column.floats.append(float(unzigzag(value)) / 4.0f);
+      }
+    }
+    return true;
+  }
+
+  case Float32:
+    if (quint64(end - p) < quint64(rows) * 4) {
+      return false;
+    }
+    for (quint32 i = 0; i < rows; ++i, p += 4) {
+      quint32 bits = qFromLittleEndian<quint32>(p);
+      float snr;
+      std::memcpy(&snr, &bits, sizeof(snr));
+      column.floats.append(snr);
+    }
+    return true;
+
+  case Dictionary: {
+    QVector<QByteArray> entries;
+    if (!readVarint(p, end, value) || value > quint64(end - p)) {
+      return false;
+    }
+    entries.resize(int(value));
+    for (QByteArray &entry : entries) {
+      if (!readString(p, end, entry)) {
+        return false;
+      }
+    }
+    for (quint32 i = 0; i < rows; ++i) {
+      if (!readVarint(p, end, value) || value >= quint64(entries.size())) {
+        return false;
+      }
+      column.strings.append(entries[int(value)]);
+    }
+    return true;
+  }
+
+  case Strings:
+    column.strings.resize(int(rows));
+    for (QByteArray &entry : column.strings) {
+      if (!readString(p, end, entry)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  return false;
+}
+
+} // namespace
+
+HistoryExporter::HistoryExporter(IMessageStore *store, QObject *parent)
+    : QObject(parent), m_store(store), m_fromSecs(0), m_toSecs(0), m_worker(new QObject),
+      m_running(false), m_cancelled(false) {
+  m_thread.setObjectName("HistoryExporter");
+  m_worker->moveToThread(&m_thread);
+  connect(&m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+  m_thread.start(QThread::LowPriority);
+}
+
+HistoryExporter::~HistoryExporter() {
+  cancel();
+  m_thread.quit();
+  m_thread.wait();
+}
+
+void HistoryExporter::setRange(qint64 fromSecs, qint64 toSecs) {
+  m_fromSecs = fromSecs;
+  m_toSecs = toSecs;
+}
+
+bool HistoryExporter::formatFromName(const QString &name, Format *format) {
+  if (name == "jsonl" || name == "json") {
+    *format = JsonLines;
+  } else if (name == "archive" || name == "mca") {
+    *format = Archive;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool HistoryExporter::start(const QString &path, Format format) {
+  if (m_running.exchange(true)) {
+    return false;
+  }
+
+  runOnThread(
+      [this, path, format](ExportStats *stats) { return exportTo(path, format, stats); });
+  return true;
+}
+
+bool HistoryExporter::startRead(const QString &path) {
+  if (m_running.exchange(true)) {
+    return false;
+  }
+
+  runOnThread([this, path](ExportStats *stats) {
+    return readArchive(path, [](const Message &) { return true; }, stats);
+  });
+  return true;
+}
+
+void HistoryExporter::cancel() { m_cancelled = true; }
+
+void HistoryExporter::runOnThread(const std::function<bool(ExportStats *)> &job) {
+  m_cancelled = false;
+  QMetaObject::invokeMethod(m_worker, [this, job]() {
+    ExportStats stats;
+    bool ok = job(&stats);
+
+    QMetaObject::invokeMethod(
+        this,
+        [this, ok, stats]() {
+          m_running = false;
+          emit finished(ok, stats);
+        },
+        Qt::QueuedConnection);
+  });
+}
+
+bool HistoryExporter::exportTo(const QString &path, Format format, ExportStats *stats) {
+  if (!m_store || !m_store->isOpen()) {
+    setLastError("Message store not open");
+    return false;
+  }
+
+  QSaveFile file(path);
+  if (!file.open(QIODevice::WriteOnly)) {
+    setLastError(QString("Failed to open %1: %2").arg(path, file.errorString()));
+    return false;
+  }
+
+  std::unique_ptr<RowWriter> writer;
+  if (format == JsonLines) {
+    writer = std::make_unique<JsonLinesWriter>(&file);
+  } else {
+    writer = std::make_unique<ArchiveWriter>(&file);
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+  qint64 rows = 0;
+  bool writeFailed = false;
+
+  auto writeRow = [&](const Message &message) {
+    if (m_cancelled) {
+      return false;
+    }
+    if (!writer->write(message)) {
+      writeFailed = true;
+      return false;
+    }
+    if (++rows % PROGRESS_INTERVAL_ROWS == 0) {
+      emit progress(rows, timer.elapsed());
+    }
+    return true;
+  };
+
+  if (!writer->begin()) {
+    writeFailed = true;
+  } else if (!m_store->scanMessages(m_fromSecs, m_toSecs, writeRow) && !writeFailed) {
+    setLastError(m_store->getLastError());
+    file.cancelWriting();
+    return false;
+  }
+
+  if (m_cancelled) {
+    setLastError("Export cancelled");
+    file.cancelWriting();
+    return false;
+  }
+
+  if (writeFailed || !writer->finish(rows)) {
+    setLastError(QString("Failed to write %1: %2").arg(path, file.errorString()));
+    file.cancelWriting();
+    return false;
+  }
+
+  qint64 bytes = file.size();
+  if (!file.commit()) {
+    setLastError(QString("Failed to save %1: %2").arg(path, file.errorString()));
+    return false;
+  }
+
+  if (stats) {
+    stats->rows = rows;
+    stats->bytes = bytes;
+    stats->elapsedMs = timer.elapsed();
+  }
+
+  qCDebug(lcStorage) << "Exported" << rows << "messages to" << path << "in" << timer.elapsed() << "ms";
+  return true;
+}
+
+bool HistoryExporter::readArchive(const QString &path,
+                                  const std::function<bool(const Message &)> &visitor,
+                                  ExportStats *stats) {
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly)) {
+    setLastError(QString("Failed to open %1: %2").arg(path, file.errorString()));
+    return false;
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+
+  QByteArray header = file.read(8);
+  if (header.size() != 8 || std::memcmp(header.constData(), ARCHIVE_MAGIC, 4) != 0 ||
+      qFromLittleEndian<quint32>(header.constData() + 4) != ARCHIVE_VERSION) {
+    setLastError(QString("%1 is not a message archive").arg(path));
+    return false;
+  }
+
+  qint64 rows = 0;
+  bool stopped = false;
+  auto corrupt = [&]() {
+    setLastError(QString("Corrupt archive %1 at offset %2").arg(path).arg(file.pos()));
+    return false;
+  };
+
+  while (!stopped) {
+    if (m_cancelled) {
+      setLastError("Reading cancelled");
+      return false;
+    }
+
+    QByteArray groupHeader = file.read(4);
+    if (groupHeader.size() != 4) {
+      return corrupt();
+    }
+    quint32 groupRows = qFromLittleEndian<quint32>(groupHeader.constData());
+    if (groupRows == 0) {
+      break;
+    }
+
+    QByteArray countByte = file.read(1);
+    if (countByte.size() != 1) {
+      return corrupt();
+    }
+
+    QVector<DecodedColumn> columns(COLUMN_COUNT);
+    for (int i = 0; i < quint8(countByte[0]); ++i) {
+      QByteArray columnHeader = file.read(6);
+      if (columnHeader.size() != 6) {
+        return corrupt();
+      }
+      quint8 id = quint8(columnHeader[0]);
+      quint8 encoding = quint8(columnHeader[1]);
+      quint32 length = qFromLittleEndian<quint32>(columnHeader.constData() + 2);
+      if (length > file.size() - file.pos()) {
+        return corrupt();
+      }
+
+      QByteArray data = file.read(length);
+      if (id >= COLUMN_COUNT) {
+        continue; // Written by a newer version; not needed here
+      }
+      if (!decodeColumn(encoding, data, groupRows, columns[id])) {
+        return corrupt();
+      }
+    }
+
+    auto number = [&](Column column, quint32 row) {
+      return row < quint32(columns[column].numbers.size()) ? columns[column].numbers[row] : 0;
+    };
+    auto string = [&](Column column, quint32 row) {
+      return row < quint32(columns[column].strings.size()) ? columns[column].strings[row]
+                                                           : QByteArray();
+    };
+
+    for (quint32 row = 0; row < groupRows; ++row) {
+      Message msg;
+      msg.type = static_cast<Message::Type>(number(ColType, row));
+      msg.channelIdx = uint8_t(number(ColChannel, row));
+      msg.senderPubKeyPrefix = string(ColSenderKey, row);
+      msg.senderName = QString::fromUtf8(string(ColSenderName, row));
+      msg.text = QString::fromUtf8(string(ColText, row));
+      msg.timestamp = uint32_t(number(ColTimestamp, row));
+      msg.receivedAt = QDateTime::fromSecsSinceEpoch(number(ColReceivedAt, row));
+      msg.pathLength = uint8_t(number(ColPathLength, row));
+      msg.pathLen = msg.pathLength;
+      msg.txtType = uint8_t(number(ColTxtType, row));
+      msg.snr = row < quint32(columns[ColSnr].floats.size()) ? columns[ColSnr].floats[row] : 0;
+
+      rows++;
+      if (!visitor(msg)) {
+        stopped = true;
+        break;
+      }
+    }
+
+    emit progress(rows, timer.elapsed());
+  }
+
+  if (stats) {
+    stats->rows = rows;
+    stats->bytes = file.size();
+    stats->elapsedMs = timer.elapsed();
+  }
+
+  return true;
+}
+
+QString HistoryExporter::getLastError() const {
+  QMutexLocker locker(&m_errorMutex);
+  return m_lastError;
+}
+
+void HistoryExporter::setLastError(const QString &error) {
+  QMutexLocker locker(&m_errorMutex);
+  m_lastError = error;
+  qCWarning(lcStorage) << "HistoryExporter:" << error;
+}
+
+} // namespace MeshCore
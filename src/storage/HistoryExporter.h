@@ -0,0 +1,97 @@
+#pragma once
+
+#include <QByteArray>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include <atomic>
+#include <functional>
+
+#include "../models/Message.h"
+
+namespace MeshCore {
+
+class IMessageStore;
+
+struct ExportStats {
+  qint64 rows = 0;
+  qint64 bytes = 0; // Size of the written file
+  qint64 elapsedMs = 0;
+
+  double rowsPerSecond() const { return elapsedMs > 0 ? rows * 1000.0 / elapsedMs : 0.0; }
+};
+
+// Streams message history out of a message store, oldest first, without
+// holding more than one row (JSON Lines) or one row group (archive) in
+// memory. The file is written under a temporary name and only replaces
+// the target once the export has finished.
+//
+// start() and startRead() do the work on the exporter's own thread, which
+// reads through its own connection, so the caller's thread (where frames
+// are received and stored) carries on. progress() and finished() arrive on
+// the thread the exporter lives in.
+//
+// The archive is a columnar format for offline analysis: rows are stored
+// in groups of up to ARCHIVE_GROUP_ROWS, each column encoded on its own
+// (run lengths for small enums, zigzag deltas for times, per-group
+// dictionaries for senders, zlib for text). readArchive() decodes it.
+class HistoryExporter : public QObject {
+  Q_OBJECT
+
+public:
+  enum Format { JsonLines, Archive };
+
+  static const int ARCHIVE_GROUP_ROWS = 65536;
+
+  explicit HistoryExporter(IMessageStore *store, QObject *parent = nullptr);
+  // Cancels a running export and waits for its thread
+  ~HistoryExporter();
+
+  // received_at in [fromSecs, toSecs); 0 = unbounded. Used by the next
+  // export started.
+  void setRange(qint64 fromSecs, qint64 toSecs);
+
+  // Run exportTo() or decode an archive on the exporter's thread. Return
+  // false if one is already running.
+  bool start(const QString &path, Format format);
+  bool startRead(const QString &path);
+  bool isRunning() const { return m_running; }
+  // The running export stops at its next row and fails
+  void cancel();
+
+  // The same on the calling thread
+  bool exportTo(const QString &path, Format format, ExportStats *stats = nullptr);
+
+  // Decodes an archive written by exportTo(), one row group at a time
+  bool readArchive(const QString &path, const std::function<bool(const Message &)> &visitor,
+                   ExportStats *stats = nullptr);
+
+  static bool formatFromName(const QString &name, Format *format);
+
+  QString getLastError() const;
+
+signals:
+  void progress(qint64 rows, qint64 elapsedMs);
+  // For start() and startRead(); getLastError() says why if !ok
+  void finished(bool ok, const ExportStats &stats);
+
+private:
+  void setLastError(const QString &error);
+  // Export thread
+  void runOnThread(const std::function<bool(ExportStats *)> &job);
+
+  IMessageStore *m_store;
+  qint64 m_fromSecs;
+  qint64 m_toSecs;
+
+  QThread m_thread;
+  QObject *m_worker; // Lives on m_thread
+  std::atomic<bool> m_running;
+  std::atomic<bool> m_cancelled;
+
+  mutable QMutex m_errorMutex;
+  QString m_lastError;
+};
+
+} // namespace MeshCore
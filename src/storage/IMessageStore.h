@@ -0,0 +1,49 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include <cstdint>
+#include <functional>
+
+#include "../models/Message.h"
+
+namespace MeshCore {
+
+// Where MeshClient keeps message history. DatabaseManager (SQLite) is the
+// full-featured backend; MessageLogStore trades statistics, retention
+// policies and the inbox for cheaper ingest. Loads are newest first and
+// safe to call from any thread.
+class IMessageStore {
+public:
+  virtual ~IMessageStore() = default;
+
+  // One store per device, keyed by the device's public key
+  virtual bool openDatabase(const QByteArray &devicePublicKey) = 0;
+  virtual void closeDatabase() = 0;
+  virtual bool isOpen() const = 0;
+
+  // Duplicates (same sender, text and timestamp) are skipped and reported
+  // as saved
+  virtual bool saveMessage(const Message &message, bool isSentByMe = false) = 0;
+  // Several messages at once; the SQLite store commits them together or not
+  // at all
+  virtual bool saveMessages(const QVector<Message> &messages, bool isSentByMe = false) = 0;
+  virtual bool isMessageDuplicate(const Message &message) = 0;
+
+  virtual QVector<Message> loadMessages(int limit = 100, int offset = 0) = 0;
+  virtual QVector<Message> loadChannelMessages(uint8_t channelIdx, int limit = 100,
+                                               int offset = 0) = 0;
+  virtual QVector<Message> loadDirectMessages(const QByteArray &contactPubKeyPrefix,
+                                              int limit = 100, int offset = 0) = 0;
+  virtual int getMessageCount() = 0;
+
+  // Oldest first, received_at in [fromSecs, toSecs) (0 = unbounded), until
+  // the visitor returns false; memory use does not grow with history size
+  virtual bool scanMessages(qint64 fromSecs, qint64 toSecs,
+                            const std::function<bool(const Message &)> &visitor) = 0;
+
+  virtual QString getLastError() const = 0;
+};
+
+} // namespace MeshCore
@@ -0,0 +1,303 @@
+#include "IngestJournal.h"
+#include "DatabaseManager.h"
+#include "IMessageStore.h"
+#include "../core/Logging.h"
+#include "../core/MemoryAccounting.h"
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtEndian>
+
+namespace MeshCore {
+
+namespace {
+
+// Record: u32 payload length, u16 CRC-16 (qChecksum) of the payload, payload.
+// Payloads are QDataStream-encoded with a fixed stream version.
+const int RECORD_HEADER = 6;
+const int MAX_RECORD_BYTES = 64 * 1024;
+const QDataStream::Version STREAM_VERSION = QDataStream::Qt_6_0;
+
+QByteArray recordHeader(const QByteArray &payload) {
+  uchar header[RECORD_HEADER];
+  qToLittleEndian<quint32>(quint32(payload.size()), header);
+  qToLittleEndian<quint16>(qChecksum(payload), header + 4);
+  return QByteArray(reinterpret_cast<const char *>(header), RECORD_HEADER);
+}
+
+} // namespace
+
+IngestJournal::IngestJournal() : m_pending(0) {}
+
+IngestJournal::~IngestJournal() { m_file.close(); }
+
+void IngestJournal::setDirectory(const QString &directory) {
+  m_file.close();
+  m_directory = directory;
+}
+
+QString IngestJournal::getJournalPath() const {
+  QString appDataPath = m_directory.isEmpty()
+                            ? QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+                            : m_directory;
+  return QString("%1/ingest.journal").arg(appDataPath);
+}
+
+void IngestJournal::setDeviceKey(const QByteArray &devicePublicKey) {
+  m_deviceKey = devicePublicKey;
+}
+
+bool IngestJournal::ensureOpen() {
+  if (m_file.isOpen()) {
+    return true;
+  }
+
+  QString path = getJournalPath();
+  QDir().mkpath(QFileInfo(path).absolutePath());
+  m_file.setFileName(path);
+  if (!m_file.open(QIODevice::ReadWrite)) {
+    setLastError(
+        QString("Failed to open ingest journal %1: %2").arg(path, m_file.errorString()));
+    return false;
+  }
+
+  // Count what an earlier session left, dropping a torn tail so appends
+  // start on a record boundary
+  int discarded = 0;
+  m_pending = readRecords(&discarded).size();
+  if (m_pending > 0 || discarded > 0) {
+    qCDebug(lcStorage) << "Ingest journal has" << m_pending << "pending records," << discarded
+                       << "unreadable";
+  }
+  return true;
+}
+
+QVector<QByteArray> IngestJournal::readRecords(int *discarded) {
+  QVector<QByteArray> records;
+  m_file.seek(0);
+
+  qint64 goodEnd = 0;
+  while (!m_file.atEnd()) {
+    QByteArray header = m_file.read(RECORD_HEADER);
+    if (header.size() != RECORD_HEADER) {
+      break;
+    }
+
+    quint32 length = qFromLittleEndian<quint32>(header.constData());
+    quint16 checksum = qFromLittleEndian<quint16>(header.constData() + 4);
+    if (length == 0 || length > quint32(MAX_RECORD_BYTES)) {
+      break;
+    }
+
+    QByteArray payload = m_file.read(length);
+    if (payload.size() != int(length) || qChecksum(payload) != checksum) {
+      break;
+    }
+
+    records.append(payload);
+    goodEnd = m_file.pos();
+  }
+
+  if (goodEnd < m_file.size()) {
+    // Everything after the first bad record is unreachable; a crash can only
+    // tear the last one
+    *discarded = 1;
+    qCWarning(lcStorage) << "Discarding" << m_file.size() - goodEnd << "unreadable bytes at the end of"
+                         << m_file.fileName();
+    m_file.resize(goodEnd);
+  }
+
+  m_file.seek(m_file.size());
+  return records;
+}
+
+bool IngestJournal::append(const QByteArray &payload) {
+  MemoryScope memory(MemoryAccounting::Storage);
+  if (!ensureOpen()) {
+    return false;
+  }
+
+  // flush() hands the bytes to the OS, which keeps them if the client
+  // crashes; surviving power loss would need an fsync per record
+  if (m_file.write(recordHeader(payload) + payload) != RECORD_HEADER + payload.size() ||
+      !m_file.flush()) {
+    setLastError(QString("Failed to write ingest journal: %1").arg(m_file.errorString()));
+    return false;
+  }
+
+  m_pending++;
+  return true;
+}
+
+bool IngestJournal::appendMessage(const Message &message) {
+  QByteArray payload;
+  QDataStream out(&payload, QIODevice::WriteOnly);
+  out.setVersion(STREAM_VERSION);
+  out << quint8(MessageRecord) << m_deviceKey << quint8(message.type) << message.channelIdx
+      << message.senderPubKeyPrefix << message.senderName << message.text << message.timestamp
+      << message.pathLength << message.txtType << message.snr
+      << message.receivedAt.toSecsSinceEpoch();
+  return append(payload);
+}
+
+bool IngestJournal::appendContact(const Contact &contact) {
+  QByteArray payload;
+  QDataStream out(&payload, QIODevice::WriteOnly);
+  out.setVersion(STREAM_VERSION);
+  out << quint8(ContactRecord) << m_deviceKey << contact.publicKey() << contact.name()
+      << contact.type() << contact.flags() << qint8(contact.pathLength()) << contact.path()
+      << contact.lastAdvertTimestamp() << contact.lastModified() << contact.latitude()
+      << contact.longitude();
+  return append(payload);
+}
+
+bool IngestJournal::appendChannel(const Channel &channel) {
+  QByteArray payload;
+  QDataStream out(&payload, QIODevice::WriteOnly);
+  out.setVersion(STREAM_VERSION);
+  out << quint8(ChannelRecord) << m_deviceKey << channel.index << channel.name
+      << channel.secret;
+  return append(payload);
+}
+
+bool IngestJournal::replay(const QByteArray &devicePublicKey, DatabaseManager *database,
+                           IMessageStore *messageStore, JournalReplayResult *result) {
+  JournalReplayResult counts;
+  if (!QFile::exists(getJournalPath()) && !m_file.isOpen()) {
+    if (result) {
+      *result = counts;
+    }
+    return true; // Nothing was ever journaled
+  }
+
+  if (!ensureOpen()) {
+    return false;
+  }
+
+  QVector<QByteArray> records = readRecords(&counts.discarded);
+  QVector<Message> messages;
+  QVector<Contact> contacts;
+  QVector<Channel> channels;
+  QVector<QByteArray> kept;
+
+  for (const QByteArray &payload : std::as_const(records)) {
+    QDataStream in(payload);
+    in.setVersion(STREAM_VERSION);
+    quint8 kind;
+    QByteArray key;
+    in >> kind >> key;
+
+    if (!key.isEmpty() && key != devicePublicKey) {
+      kept.append(payload);
+      continue;
+    }
+
+    if (kind == MessageRecord) {
+      Message msg;
+      quint8 type;
+      qint64 receivedAt;
+      in >> type >> msg.channelIdx >> msg.senderPubKeyPrefix >> msg.senderName >> msg.text >>
+          msg.timestamp >> msg.pathLength >> msg.txtType >> msg.snr >> receivedAt;
+      msg.type = static_cast<Message::Type>(type);
+      msg.pathLen = msg.pathLength;
+      msg.receivedAt = QDateTime::fromSecsSinceEpoch(receivedAt);
+      if (in.status() == QDataStream::Ok) {
+        messages.append(msg);
+        continue;
+      }
+    } else if (kind == ContactRecord) {
+      QByteArray publicKey, path;
+      QString name;
+      quint8 type, flags;
+      qint8 pathLength;
+      quint32 lastAdvert, lastModified;
+      qint32 latitude, longitude;
+      in >> publicKey >> name >> type >> flags >> pathLength >> path >> lastAdvert >>
+          lastModified >> latitude >> longitude;
+      if (in.status() == QDataStream::Ok) {
+        Contact contact(publicKey, name, type);
+        contact.setFlags(flags);
+        contact.setPath(path, pathLength);
+        contact.setLastAdvertTimestamp(lastAdvert);
+        contact.setLastModified(lastModified);
+        contact.setLocation(latitude, longitude);
+        contacts.append(contact);
+        continue;
+      }
+    } else if (kind == ChannelRecord) {
+      uint8_t index;
+      QString name;
+      QByteArray secret;
+      in >> index >> name >> secret;
+      if (in.status() == QDataStream::Ok) {
+        channels.append(Channel(index, name, secret));
+        continue;
+      }
+    }
+
+    counts.discarded++;
+  }
+
+  // Channels first: stored messages refer to them
+  if (!channels.isEmpty() && (!database || !database->saveChannels(channels))) {
+    setLastError(QString("Failed to replay channels: %1")
+                     .arg(database ? database->getLastError() : QString("no database")));
+    return false;
+  }
+  if (!contacts.isEmpty() && (!database || !database->saveContacts(contacts))) {
+    setLastError(QString("Failed to replay contacts: %1")
+                     .arg(database ? database->getLastError() : QString("no database")));
+    return false;
+  }
+  if (!messages.isEmpty() && (!messageStore || !messageStore->saveMessages(messages))) {
+    setLastError(QString("Failed to replay messages: %1")
+                     .arg(messageStore ? messageStore->getLastError() : QString("no store")));
+    return false;
+  }
+
+  // Keep only the other devices' records. Rewritten through a temporary
+  // file, so a crash here leaves either the old journal or the new one
+  // (replaying the old one again is harmless: the stores skip duplicates).
+  // A failed rewrite leaves the old journal in place for the next replay.
+  m_file.close();
+  if (kept.isEmpty()) {
+    QFile journal(getJournalPath());
+    if (journal.exists() && !journal.remove()) {
+      setLastError(
+          QString("Failed to remove replayed journal: %1").arg(journal.errorString()));
+      return false;
+    }
+  } else {
+    QSaveFile rewrite(getJournalPath());
+    bool written = rewrite.open(QIODevice::WriteOnly);
+    for (const QByteArray &payload : std::as_const(kept)) {
+      const QByteArray record = recordHeader(payload) + payload;
+      written = written && rewrite.write(record) == record.size();
+    }
+    if (!written || !rewrite.commit()) {
+      setLastError(QString("Failed to rewrite journal: %1").arg(rewrite.errorString()));
+      rewrite.cancelWriting();
+      return false;
+    }
+  }
+  m_pending = kept.size();
+
+  counts.messages = messages.size();
+  counts.contacts = contacts.size();
+  counts.channels = channels.size();
+  counts.kept = kept.size();
+  if (result) {
+    *result = counts;
+  }
+  return true;
+}
+
+void IngestJournal::setLastError(const QString &error) {
+  m_lastError = error;
+  qCWarning(lcStorage) << "IngestJournal:" << error;
+}
+
+} // namespace MeshCore
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+#include "../models/Channel.h"
+#include "../models/Contact.h"
+#include "../models/Message.h"
+
+namespace MeshCore {
+
+class DatabaseManager;
+class IMessageStore;
+
+struct JournalReplayResult {
+  int messages = 0;
+  int contacts = 0;
+  int channels = 0;
+  int kept = 0;      // Records for other devices, left for when they connect
+  int discarded = 0; // Unreadable records (a torn tail after a crash)
+};
+
+// Append-only file holding messages, contacts and channels that arrived
+// while the database was not open: before SELF_INFO told us which device
+// this is, or after the database failed to open. Each record is written
+// through to the OS as it is appended, so a crash of the client loses
+// nothing; replay() hands the records to the stores in one batch once they
+// are available.
+//
+// Records are tagged with the device key once it is known. Untagged records
+// belong to the device whose database opens next. Main thread only.
+class IngestJournal {
+public:
+  IngestJournal();
+  ~IngestJournal();
+
+  void setDirectory(const QString &directory); // Empty = app data dir
+  QString getJournalPath() const;
+
+  // Key for records appended from now on; empty while unknown
+  void setDeviceKey(const QByteArray &devicePublicKey);
+
+  bool appendMessage(const Message &message);
+  bool appendContact(const Contact &contact);
+  bool appendChannel(const Channel &channel);
+  int pendingCount() const { return m_pending; }
+
+  // Saves this device's records (and untagged ones) and removes them from
+  // the journal. On a store error everything stays for the next attempt.
+  bool replay(const QByteArray &devicePublicKey, DatabaseManager *database,
+              IMessageStore *messageStore, JournalReplayResult *result = nullptr);
+
+  QString getLastError() const { return m_lastError; }
+
+private:
+  enum RecordKind : quint8 { MessageRecord = 1, ContactRecord = 2, ChannelRecord = 3 };
+
+  bool ensureOpen();
+  bool append(const QByteArray &payload);
+  // Reads every intact record and cuts off anything after the first bad one
+  QVector<QByteArray> readRecords(int *discarded);
+  void setLastError(const QString &error);
+
+  QString m_directory;
+  QFile m_file;
+  QByteArray m_deviceKey;
+  int m_pending;
+  QString m_lastError;
+};
+
+} // namespace MeshCore
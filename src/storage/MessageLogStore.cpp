@@ -0,0 +1,862 @@
+#include "MessageLogStore.h"
+#include "../core/FrameArena.h"
+#include "../core/Logging.h"
+#include "../core/MemoryAccounting.h"
+#include "../core/TelemetryCounters.h"
+#include "../core/Tracer.h"
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QReadLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QTimer>
+#include <QWriteLocker>
+#include <QtEndian>
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <limits>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#include <unistd.h>
+#elif defined(Q_OS_WIN)
+#include <windows.h>
+#endif
+
+namespace MeshCore {
+
+namespace {
+
+// Frame: u32 payload length, u32 CRC-32 of the payload, payload, u32 payload
+// length again (so the log can be walked backwards). A zero length marks the
+// end of the written part of a segment; segments are preallocated with zeros.
+const int FRAME_OVERHEAD = 12;
+
+// Payload: u64 sequence, i64 received_at, u32 timestamp, u8 type,
+// u8 channel, u8 path length, u8 txt type, f32 snr, u8 flags,
+// u8 prefix length, u16 name length, u16 text length, then the bytes
+const int FIXED_PAYLOAD = 34;
+const quint8 FLAG_SENT_BY_ME = 0x01;
+
+const char *const SEGMENT_SUFFIX = ".seg";
+const char *const SIDECAR_SUFFIX = ".idx";
+const quint32 SIDECAR_MAGIC = 0x4d434c49; // "MCLI"
+const quint32 SIDECAR_VERSION = 1;
+
+quint32 crc32(const uchar *data, qint64 length) {
+  static const auto table = [] {
+    std::array<quint32, 256> entries{};
+    for (quint32 i = 0; i < 256; ++i) {
+      quint32 c = i;
+      for (int k = 0; k < 8; ++k) {
+        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      }
+      entries[i] = c;
+    }
+    return entries;
+  }();
+
+  quint32 crc = 0xFFFFFFFFu;
+  for (qint64 i = 0; i < length; ++i) {
+    crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return crc ^ 0xFFFFFFFFu;
+}
+
+quint32 readU32(const uchar *p) { return qFromLittleEndian<quint32>(p); }
+
+QString segmentFileName(quint64 firstSequence) {
+  return QString("%1%2").arg(firstSequence, 16, 16, QChar('0')).arg(SEGMENT_SUFFIX);
+}
+
+QString sidecarPath(const QString &segmentPath) {
+  return segmentPath.left(segmentPath.size() - int(strlen(SEGMENT_SUFFIX))) + SIDECAR_SUFFIX;
+}
+
+} // namespace
+
+// Fields of a record read straight from the mapping, for filtering before
+// the text is decoded
+struct MessageLogStore::RecordView {
+  quint64 sequence;
+  qint64 receivedAt;
+  quint32 timestamp;
+  quint8 type;
+  quint8 channelIdx;
+  quint8 pathLength;
+  quint8 txtType;
+  float snr;
+  quint8 flags;
+  QByteArray prefix; // Raw view into the mapping
+  const uchar *name;
+  int nameLength;
+  const uchar *text;
+  int textLength;
+
+  static bool parse(const uchar *payload, quint32 length, RecordView &view) {
+    if (length < quint32(FIXED_PAYLOAD)) {
+      return false;
+    }
+
+    view.sequence = qFromLittleEndian<quint64>(payload);
+    view.receivedAt = qFromLittleEndian<qint64>(payload + 8);
+    view.timestamp = qFromLittleEndian<quint32>(payload + 16);
+    view.type = payload[20];
+    view.channelIdx = payload[21];
+    view.pathLength = payload[22];
+    view.txtType = payload[23];
+    quint32 snrBits = qFromLittleEndian<quint32>(payload + 24);
+    std::memcpy(&view.snr, &snrBits, sizeof(view.snr));
+    view.flags = payload[28];
+    int prefixLength = payload[29];
+    view.nameLength = qFromLittleEndian<quint16>(payload + 30);
+    view.textLength = qFromLittleEndian<quint16>(payload + 32);
+
+    if (quint32(FIXED_PAYLOAD + prefixLength + view.nameLength + view.textLength) != length) {
+      return false;
+    }
+
+    const uchar *bytes = payload + FIXED_PAYLOAD;
+    view.prefix = QByteArray::fromRawData(reinterpret_cast<const char *>(bytes), prefixLength);
+    view.name = bytes + prefixLength;
+    view.text = view.name + view.nameLength;
+    return true;
+  }
+
+  Message toMessage() const {
+    Message msg;
+    msg.type = static_cast<Message::Type>(type);
+    msg.channelIdx = channelIdx;
+    msg.senderPubKeyPrefix = QByteArray(prefix.constData(), prefix.size());
+    msg.senderName = QString::fromUtf8(reinterpret_cast<const char *>(name), nameLength);
+    msg.text = QString::fromUtf8(reinterpret_cast<const char *>(text), textLength);
+    msg.timestamp = timestamp;
+    msg.receivedAt = QDateTime::fromSecsSinceEpoch(receivedAt);
+    msg.pathLength = pathLength;
+    msg.pathLen = pathLength;
+    msg.txtType = txtType;
+    msg.snr = snr;
+    return msg;
+  }
+};
+
+MessageLogStore::MessageLogStore(QObject *parent)
+    : MessageLogStore(MessageLogOptions(), parent) {}
+
+MessageLogStore::MessageLogStore(const MessageLogOptions &options, QObject *parent)
+    : QObject(parent), m_options(options), m_nextSequence(1), m_recentHashPos(0),
+      m_dirtyFrom(0), m_syncTimer(new QTimer(this)) {
+  connect(m_syncTimer, &QTimer::timeout, this, [this]() { sync(); });
+}
+
+MessageLogStore::~MessageLogStore() { closeDatabase(); }
+
+void MessageLogStore::setDirectory(const QString &directory) { m_directory = directory; }
+
+QString MessageLogStore::getLogPath(const QByteArray &devicePublicKey) const {
+  QString appDataPath = m_directory.isEmpty()
+                            ? QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+                            : m_directory;
+  return QString("%1/device_%2.log").arg(appDataPath, QString(devicePublicKey.toHex()));
+}
+
+bool MessageLogStore::openDatabase(const QByteArray &devicePublicKey) {
+  QWriteLocker locker(&m_lock);
+
+  QString logPath = getLogPath(devicePublicKey);
+  if (!m_segments.empty() && m_logPath == logPath) {
+    return true;
+  }
+
+  closeLocked();
+
+  if (!QDir().mkpath(logPath)) {
+    setLastError(QString("Failed to create log directory %1").arg(logPath));
+    return false;
+  }
+  m_logPath = logPath;
+
+  QStringList files = QDir(logPath).entryList({QString("*%1").arg(SEGMENT_SUFFIX)},
+                                              QDir::Files, QDir::Name);
+
+  // Every segment but the newest was sealed; the newest takes appends, so
+  // only it can end in a torn record
+  for (int i = 0; i < files.size(); ++i) {
+    Segment segment;
+    segment.path = QDir(logPath).filePath(files[i]);
+    segment.firstSequence = files[i].left(16).toULongLong(nullptr, 16);
+    bool active = i == files.size() - 1 && !QFile::exists(sidecarPath(segment.path));
+
+    if (!openSegment(segment, active)) {
+      closeLocked();
+      return false;
+    }
+
+    if (segment.recordCount == 0 && !active) {
+      // Nothing to read, and its name could clash with the next segment's
+      segment.file->unmap(segment.data);
+      segment.file->close();
+      QFile::remove(sidecarPath(segment.path));
+      QFile::remove(segment.path);
+      continue;
+    }
+    m_segments.push_back(std::move(segment));
+  }
+
+  if (!m_segments.empty()) {
+    const Segment &last = m_segments.back();
+    m_nextSequence = last.firstSequence + last.recordCount;
+  }
+
+  if ((m_segments.empty() || m_segments.back().sealed) &&
+      !startSegmentLocked(m_nextSequence)) {
+    closeLocked();
+    return false;
+  }
+
+  // Duplicate checks cover the newest messages, as they did before the restart
+  m_recentHashes.fill(0, qMax(1, m_options.dedupWindow));
+  QVector<quint64> newestFirst;
+  visitBackwards([&](const uchar *payload, quint32 length) {
+    RecordView view;
+    if (RecordView::parse(payload, length, view)) {
+      newestFirst.append(messageHash(view.toMessage()));
+    }
+    return newestFirst.size() < m_recentHashes.size();
+  });
+  for (int i = newestFirst.size() - 1; i >= 0; --i) {
+    rememberHashLocked(newestFirst[i]);
+  }
+
+  m_dirtyFrom = m_segments.back().usedBytes;
+  if (m_options.syncIntervalMs > 0) {
+    m_syncTimer->start(m_options.syncIntervalMs);
+  }
+
+  qCDebug(lcStorage) << "Message log opened:" << logPath << "with" << m_segments.size()
+                     << "segment(s), next sequence" << m_nextSequence;
+  return true;
+}
+
+void MessageLogStore::closeDatabase() {
+  sync();
+  QWriteLocker locker(&m_lock);
+  closeLocked();
+}
+
+void MessageLogStore::closeLocked() {
+  m_syncTimer->stop();
+
+  // The active segment stays unsealed and is rescanned on the next open
+  for (Segment &segment : m_segments) {
+    if (segment.file) {
+      segment.file->unmap(segment.data);
+      segment.file->close();
+    }
+  }
+
+  m_segments.clear();
+  m_logPath.clear();
+  m_nextSequence = 1;
+  m_recentHashes.clear();
+  m_recentHashSet.clear();
+  m_recentHashPos = 0;
+  m_dirtyFrom = 0;
+}
+
+bool MessageLogStore::isOpen() const {
+  QReadLocker locker(&m_lock);
+  return !m_segments.empty();
+}
+
+bool MessageLogStore::openSegment(Segment &segment, bool active) {
+  segment.file = std::make_unique<QFile>(segment.path);
+  if (!segment.file->open(active ? QIODevice::ReadWrite : QIODevice::ReadOnly)) {
+    setLastError(
+        QString("Failed to open %1: %2").arg(segment.path, segment.file->errorString()));
+    return false;
+  }
+
+  if (active && segment.file->size() < m_options.segmentBytes) {
+    segment.file->resize(m_options.segmentBytes);
+  }
+
+  segment.mappedBytes = segment.file->size();
+  if (segment.mappedBytes == 0) {
+    segment.sealed = true;
+    return true;
+  }
+
+  segment.data = segment.file->map(0, segment.mappedBytes);
+  if (!segment.data) {
+    setLastError(
+        QString("Failed to map %1: %2").arg(segment.path, segment.file->errorString()));
+    return false;
+  }
+
+  segment.sealed = !active;
+  if (segment.sealed && loadSidecar(segment)) {
+    return true;
+  }
+
+  if (!scanSegment(segment)) {
+    return false;
+  }
+
+  if (segment.sealed) {
+    writeSidecar(segment);
+  } else if (segment.usedBytes + 8 <= segment.mappedBytes &&
+             (readU32(segment.data + segment.usedBytes) != 0 ||
+              readU32(segment.data + segment.usedBytes + 4) != 0)) {
+    // A record was being written when the process stopped. Clear what is
+    // left of it so the next append does not leave stray bytes behind.
+    qCWarning(lcStorage) << "Discarding torn record at" << segment.path << "offset"
+                         << segment.usedBytes;
+    std::memset(segment.data + segment.usedBytes, 0,
+                segment.mappedBytes - segment.usedBytes);
+  }
+
+  return true;
+}
+
+bool MessageLogStore::scanSegment(Segment &segment) {
+  qint64 pos = 0;
+  segment.recordCount = 0;
+  segment.index.clear();
+
+  while (pos + FRAME_OVERHEAD <= segment.mappedBytes) {
+    const uchar *frame = segment.data + pos;
+    quint32 length = readU32(frame);
+    if (length == 0 || pos + FRAME_OVERHEAD + length > segment.mappedBytes) {
+      break;
+    }
+
+    const uchar *payload = frame + 8;
+    RecordView view;
+    if (readU32(payload + length) != length || crc32(payload, length) != readU32(frame + 4) ||
+        !RecordView::parse(payload, length, view)) {
+      break;
+    }
+
+    if (segment.recordCount == 0) {
+      segment.firstSequence = view.sequence;
+      segment.minReceivedAt = view.receivedAt;
+      segment.maxReceivedAt = view.receivedAt;
+    }
+    segment.minReceivedAt = qMin(segment.minReceivedAt, view.receivedAt);
+    segment.maxReceivedAt = qMax(segment.maxReceivedAt, view.receivedAt);
+    if (segment.recordCount % quint64(m_options.indexInterval) == 0) {
+      segment.index.append({segment.maxReceivedAt, quint32(pos)});
+    }
+
+    segment.recordCount++;
+    pos += FRAME_OVERHEAD + length;
+  }
+
+  segment.usedBytes = pos;
+  return true;
+}
+
+bool MessageLogStore::loadSidecar(Segment &segment) {
+  QFile file(sidecarPath(segment.path));
+  if (!file.open(QIODevice::ReadOnly)) {
+    return false;
+  }
+
+  QByteArray bytes = file.readAll();
+  if (bytes.size() < 4 ||
+      crc32(reinterpret_cast<const uchar *>(bytes.constData()), bytes.size() - 4) !=
+          readU32(reinterpret_cast<const uchar *>(bytes.constData()) + bytes.size() - 4)) {
+    return false;
+  }
+
+  QDataStream in(bytes.left(bytes.size() - 4));
+  quint32 magic, version, entries;
+  in >> magic >> version;
+  if (magic != SIDECAR_MAGIC || version != SIDECAR_VERSION) {
+    return false;
+  }
+
+  in >> segment.usedBytes >> segment.firstSequence >> segment.recordCount >>
+      segment.minReceivedAt >> segment.maxReceivedAt >> entries;
+  if (segment.usedBytes != segment.mappedBytes) {
+    return false; // Not the file the sidecar was written for
+  }
+
+  segment.index.clear();
+  segment.index.reserve(entries);
+  for (quint32 i = 0; i < entries && in.status() == QDataStream::Ok; ++i) {
+    IndexEntry entry;
+    in >> entry.receivedAt >> entry.offset;
+    segment.index.append(entry);
+  }
+
+  return in.status() == QDataStream::Ok;
+}
+
+bool MessageLogStore::writeSidecar(const Segment &segment) {
+  QByteArray bytes;
+  {
+    QDataStream out(&bytes, QIODevice::WriteOnly);
+    out << SIDECAR_MAGIC << SIDECAR_VERSION << segment.usedBytes << segment.firstSequence
+        << segment.recordCount << segment.minReceivedAt << segment.maxReceivedAt
+        << quint32(segment.index.size());
+    for (const IndexEntry &entry : segment.index) {
+      out << entry.receivedAt << entry.offset;
+    }
+  }
+
+  uchar crc[4];
+  qToLittleEndian(crc32(reinterpret_cast<const uchar *>(bytes.constData()), bytes.size()),
+                  crc);
+  bytes.append(reinterpret_cast<const char *>(crc), 4);
+
+  QSaveFile file(sidecarPath(segment.path));
+  if (!file.open(QIODevice::WriteOnly) || file.write(bytes) != bytes.size() ||
+      !file.commit()) {
+    qCWarning(lcStorage) << "Failed to write log index" << file.fileName() << file.errorString();
+    return false;
+  }
+
+  return true;
+}
+
+bool MessageLogStore::sealActiveSegmentLocked() {
+  Segment &segment = m_segments.back();
+
+  // Flush, then shrink the file to its records and map it read-only. The
+  // sidecar is written last: until it exists the segment is still treated
+  // as the active one and rescanned on open.
+  segment.file->flush();
+  if (segment.data) {
+    segment.file->unmap(segment.data);
+    segment.data = nullptr;
+  }
+  segment.file->resize(segment.usedBytes);
+  segment.file->close();
+
+  // Sealed from here on even if the reopen fails: nothing more is appended
+  // to it, and readers skip a segment left without a mapping
+  segment.sealed = true;
+  segment.mappedBytes = segment.usedBytes;
+  if (!segment.file->open(QIODevice::ReadOnly)) {
+    setLastError(QString("Failed to reopen %1").arg(segment.path));
+    return false;
+  }
+
+  if (segment.mappedBytes > 0) {
+    segment.data = segment.file->map(0, segment.mappedBytes);
+    if (!segment.data) {
+      setLastError(QString("Failed to map %1").arg(segment.path));
+      return false;
+    }
+  }
+
+  return writeSidecar(segment);
+}
+
+bool MessageLogStore::startSegmentLocked(quint64 firstSequence) {
+  Segment segment;
+  segment.path = QDir(m_logPath).filePath(segmentFileName(firstSequence));
+  segment.firstSequence = firstSequence;
+
+  if (!openSegment(segment, true)) {
+    return false;
+  }
+
+  m_segments.push_back(std::move(segment));
+  m_dirtyFrom = 0;
+  return true;
+}
+
+void MessageLogStore::enforceSizeLimitLocked() {
+  if (m_options.maxLogBytes <= 0) {
+    return;
+  }
+
+  qint64 bytes = 0;
+  for (const Segment &segment : m_segments) {
+    bytes += segment.usedBytes;
+  }
+
+  // Whole segments go, oldest first; the active one always stays
+  while (m_segments.size() > 1 && bytes > m_options.maxLogBytes) {
+    Segment &oldest = m_segments.front();
+    bytes -= oldest.usedBytes;
+    oldest.file->unmap(oldest.data);
+    oldest.file->close();
+    QFile::remove(sidecarPath(oldest.path));
+    QFile::remove(oldest.path);
+    qCDebug(lcStorage) << "Removed log segment" << oldest.path << "with" << oldest.recordCount
+                       << "messages";
+    m_segments.erase(m_segments.begin());
+  }
+}
+
+bool MessageLogStore::saveMessage(const Message &message, bool isSentByMe) {
+  TraceScope span("storage", "appendMessage");
+  MemoryScope memory(MemoryAccounting::Storage);
+  QWriteLocker locker(&m_lock);
+
+  if (m_segments.empty()) {
+    setLastError("Log not open");
+    return false;
+  }
+
+  quint64 hash = messageHash(message);
+  if (m_recentHashSet.contains(hash)) {
+    TelemetryCounters::add(TelemetryCounters::instance().duplicatesSkipped);
+    return true; // Duplicate, silently skip
+  }
+
+  // Encoded in the frame arena and copied straight into the segment
+  const ScratchBytes nameBytes(message.senderName);
+  const ScratchBytes textBytes(message.text);
+  auto clip = [](QByteArrayView bytes, qsizetype max) {
+    return bytes.first(qMin(bytes.size(), max));
+  };
+  const QByteArrayView name = clip(nameBytes.view(), 0xFFFF);
+  const QByteArrayView text = clip(textBytes.view(), 0xFFFF);
+  const QByteArrayView prefix = clip(message.senderPubKeyPrefix, 0xFF);
+  const quint32 length = quint32(FIXED_PAYLOAD + prefix.size() + name.size() + text.size());
+  const qint64 frameBytes = FRAME_OVERHEAD + length;
+
+  if (frameBytes > m_options.segmentBytes) {
+    setLastError("Message too large for a log segment");
+    return false;
+  }
+
+  // The last segment is already sealed when an earlier rotation failed
+  // after sealing it; only the new segment is still missing then
+  if (m_segments.back().sealed ||
+      m_segments.back().usedBytes + frameBytes > m_segments.back().mappedBytes) {
+    if ((!m_segments.back().sealed && !sealActiveSegmentLocked()) ||
+        !startSegmentLocked(m_nextSequence)) {
+      qCWarning(lcStorage) << getLastError();
+      return false;
+    }
+    enforceSizeLimitLocked();
+  }
+
+  Segment &segment = m_segments.back();
+  if (!segment.data) {
+    setLastError(QString("Log segment %1 is not mapped").arg(segment.path));
+    return false;
+  }
+
+  qint64 receivedAt = message.receivedAt.toSecsSinceEpoch();
+  uchar *frame = segment.data + segment.usedBytes;
+  uchar *payload = frame + 8;
+
+  qToLittleEndian<quint64>(m_nextSequence, payload);
+  qToLittleEndian<qint64>(receivedAt, payload + 8);
+  qToLittleEndian<quint32>(message.timestamp, payload + 16);
+  payload[20] = quint8(message.type);
+  payload[21] = message.channelIdx;
+  payload[22] = message.pathLength;
+  payload[23] = message.txtType;
+  quint32 snrBits;
+  std::memcpy(&snrBits, &message.snr, sizeof(snrBits));
+  qToLittleEndian<quint32>(snrBits, payload + 24);
+  payload[28] = isSentByMe ? FLAG_SENT_BY_ME : 0;
+  payload[29] = quint8(prefix.size());
+  qToLittleEndian<quint16>(quint16(name.size()), payload + 30);
+  qToLittleEndian<quint16>(quint16(text.size()), payload + 32);
+
+  uchar *bytes = payload + FIXED_PAYLOAD;
+  std::memcpy(bytes, prefix.constData(), prefix.size());
+  std::memcpy(bytes + prefix.size(), name.constData(), name.size());
+  std::memcpy(bytes + prefix.size() + name.size(), text.constData(), text.size());
+
+  // The leading length goes in last: a scan treats the record as present
+  // only once it and a matching CRC and trailer are all there
+  qToLittleEndian<quint32>(length, payload + length);
+  qToLittleEndian<quint32>(crc32(payload, length), frame + 4);
+  qToLittleEndian<quint32>(length, frame);
+
+  if (segment.recordCount == 0) {
+    segment.minReceivedAt = receivedAt;
+    segment.maxReceivedAt = receivedAt;
+  }
+  segment.minReceivedAt = qMin(segment.minReceivedAt, receivedAt);
+  segment.maxReceivedAt = qMax(segment.maxReceivedAt, receivedAt);
+  if (segment.recordCount % quint64(m_options.indexInterval) == 0) {
+    segment.index.append({segment.maxReceivedAt, quint32(segment.usedBytes)});
+  }
+
+  segment.recordCount++;
+  segment.usedBytes += frameBytes;
+  m_nextSequence++;
+  rememberHashLocked(hash);
+  TelemetryCounters::add(TelemetryCounters::instance().messagesStored);
+  return true;
+}
+
+bool MessageLogStore::saveMessages(const QVector<Message> &messages, bool isSentByMe) {
+  // Appends are already cheap; there is no transaction to share
+  for (const Message &message : messages) {
+    if (!saveMessage(message, isSentByMe)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool MessageLogStore::isMessageDuplicate(const Message &message) {
+  QReadLocker locker(&m_lock);
+  return m_recentHashSet.contains(messageHash(message));
+}
+
+bool MessageLogStore::rememberHashLocked(quint64 hash) {
+  if (m_recentHashes.isEmpty()) {
+    return false;
+  }
+
+  quint64 &slot = m_recentHashes[m_recentHashPos];
+  if (slot != 0) {
+    m_recentHashSet.remove(slot);
+  }
+  slot = hash;
+  m_recentHashSet.insert(hash);
+  m_recentHashPos = (m_recentHashPos + 1) % m_recentHashes.size();
+  return true;
+}
+
+quint64 MessageLogStore::messageHash(const Message &message) {
+  // Same identity as the SQLite store's dedup hash: sender, text, timestamp
+  quint64 hash;
+  if (message.type == Message::CHANNEL_MESSAGE) {
+    hash = qHashMulti(0, ScratchBytes(message.senderName).view(), message.text,
+                      message.timestamp);
+  } else {
+    hash = qHashMulti(0, QByteArrayView(message.senderPubKeyPrefix), message.text,
+                      message.timestamp);
+  }
+  return hash != 0 ? hash : 1; // 0 marks an empty ring slot
+}
+
+void MessageLogStore::visitBackwards(
+    const std::function<bool(const uchar *, quint32)> &visitor) const {
+  for (auto segment = m_segments.rbegin(); segment != m_segments.rend(); ++segment) {
+    qint64 pos = segment->usedBytes;
+    while (pos > 0) {
+      quint32 length = readU32(segment->data + pos - 4);
+      pos -= FRAME_OVERHEAD + length;
+      if (!visitor(segment->data + pos + 8, length)) {
+        return;
+      }
+    }
+  }
+}
+
+QVector<Message> MessageLogStore::loadMatching(
+    const std::function<bool(const RecordView &)> &match, int limit, int offset) {
+  QReadLocker locker(&m_lock);
+  QVector<Message> messages;
+
+  if (m_segments.empty()) {
+    setLastError("Log not open");
+    return messages;
+  }
+
+  int skipped = 0;
+  visitBackwards([&](const uchar *payload, quint32 length) {
+    RecordView view;
+    if (!RecordView::parse(payload, length, view) || !match(view)) {
+      return true;
+    }
+    if (skipped < offset) {
+      skipped++;
+      return true;
+    }
+    messages.append(view.toMessage());
+    return messages.size() < limit;
+  });
+
+  return messages;
+}
+
+QVector<Message> MessageLogStore::loadMessages(int limit, int offset) {
+  return loadMatching([](const RecordView &) { return true; }, limit, offset);
+}
+
+QVector<Message> MessageLogStore::loadChannelMessages(uint8_t channelIdx, int limit,
+                                                      int offset) {
+  return loadMatching(
+      [channelIdx](const RecordView &view) {
+        return view.type == Message::CHANNEL_MESSAGE && view.channelIdx == channelIdx;
+      },
+      limit, offset);
+}
+
+QVector<Message> MessageLogStore::loadDirectMessages(const QByteArray &contactPubKeyPrefix,
+                                                     int limit, int offset) {
+  return loadMatching(
+      [&contactPubKeyPrefix](const RecordView &view) {
+        return view.type == Message::CONTACT_MESSAGE && view.prefix == contactPubKeyPrefix;
+      },
+      limit, offset);
+}
+
+QVector<Message> MessageLogStore::loadMessagesBetween(qint64 fromSecs, qint64 toSecs,
+                                                      int limit) {
+  QVector<Message> messages;
+  scanMessages(fromSecs, toSecs, [&](const Message &message) {
+    messages.append(message);
+    return messages.size() < limit;
+  });
+  return messages;
+}
+
+bool MessageLogStore::scanMessages(qint64 fromSecs, qint64 toSecs,
+                                   const std::function<bool(const Message &)> &visitor) {
+  if (toSecs <= 0) {
+    toSecs = std::numeric_limits<qint64>::max();
+  }
+
+  // The read lock is taken per segment, so appends get in between; segments
+  // are found again by their first sequence, as older ones may have been
+  // deleted meanwhile
+  quint64 nextSequence = 0;
+  for (bool first = true;; first = false) {
+    QReadLocker locker(&m_lock);
+
+    if (m_segments.empty()) {
+      if (first) {
+        setLastError("Log not open");
+        return false;
+      }
+      return true; // Closed during the scan
+    }
+
+    auto segment =
+        std::find_if(m_segments.cbegin(), m_segments.cend(), [&](const Segment &candidate) {
+          return candidate.firstSequence >= nextSequence;
+        });
+    if (segment == m_segments.cend()) {
+      return true;
+    }
+    nextSequence = segment->firstSequence + 1;
+
+    if (segment->recordCount == 0 || segment->maxReceivedAt < fromSecs) {
+      continue;
+    }
+    if (!segment->data) {
+      qCWarning(lcStorage) << "Skipping unmapped log segment" << segment->path;
+      continue;
+    }
+    // Receive times are not monotonic across segments (device clocks and
+    // late deliveries), so a segment past the range does not end the scan
+    if (segment->minReceivedAt >= toSecs) {
+      continue;
+    }
+
+    // Index entries hold the running maximum, so every record before the
+    // first entry reaching fromSecs is older than the range
+    auto firstEntry = std::lower_bound(
+        segment->index.cbegin(), segment->index.cend(), fromSecs,
+        [](const IndexEntry &entry, qint64 value) { return entry.receivedAt < value; });
+    qint64 pos = firstEntry == segment->index.cbegin() ? 0 : (firstEntry - 1)->offset;
+
+    while (pos < segment->usedBytes) {
+      quint32 length = readU32(segment->data + pos);
+      RecordView view;
+      if (!RecordView::parse(segment->data + pos + 8, length, view)) {
+        break;
+      }
+      pos += FRAME_OVERHEAD + length;
+      if (view.receivedAt < fromSecs || view.receivedAt >= toSecs) {
+        continue; // Out-of-order records sit between in-range ones
+      }
+      if (!visitor(view.toMessage())) {
+        return true;
+      }
+    }
+  }
+}
+
+int MessageLogStore::getMessageCount() {
+  QReadLocker locker(&m_lock);
+  quint64 count = 0;
+  for (const Segment &segment : m_segments) {
+    count += segment.recordCount;
+  }
+  return int(qMin<quint64>(count, INT_MAX));
+}
+
+bool MessageLogStore::sync() {
+  QWriteLocker locker(&m_lock);
+
+  if (m_segments.empty()) {
+    return true;
+  }
+
+  Segment &segment = m_segments.back();
+  if (segment.sealed || segment.usedBytes <= m_dirtyFrom) {
+    return true;
+  }
+
+  bool ok = true;
+#ifdef Q_OS_UNIX
+  // msync wants a page-aligned start; the mapping itself starts on a page
+  const qint64 pageSize = sysconf(_SC_PAGESIZE);
+  const qint64 start = (m_dirtyFrom / pageSize) * pageSize;
+  ok = msync(segment.data + start, size_t(segment.usedBytes - start), MS_SYNC) == 0;
+#elif defined(Q_OS_WIN)
+  ok = FlushViewOfFile(segment.data + m_dirtyFrom, SIZE_T(segment.usedBytes - m_dirtyFrom));
+#endif
+
+  if (!ok) {
+    setLastError(QString("Failed to sync %1").arg(segment.path));
+    qCWarning(lcStorage) << getLastError();
+    return false;
+  }
+
+  m_dirtyFrom = segment.usedBytes;
+  return true;
+}
+
+qint64 MessageLogStore::logBytes() const {
+  QReadLocker locker(&m_lock);
+  qint64 bytes = 0;
+  for (const Segment &segment : m_segments) {
+    bytes += segment.usedBytes;
+  }
+  return bytes;
+}
+
+qint64 MessageLogStore::memoryUsage() const {
+  QReadLocker locker(&m_lock);
+  qint64 bytes = qint64(m_segments.capacity()) * sizeof(Segment);
+  for (const Segment &segment : m_segments) {
+    bytes += segment.path.capacity() * qint64(sizeof(QChar)) +
+             segment.index.capacity() * qint64(sizeof(IndexEntry));
+  }
+  // QSet nodes are estimated at two words of overhead per entry
+  bytes += m_recentHashes.capacity() * qint64(sizeof(quint64)) +
+           m_recentHashSet.capacity() * qint64(sizeof(quint64) + 2 * sizeof(void *));
+  return bytes;
+}
+
+int MessageLogStore::segmentCount() const {
+  QReadLocker locker(&m_lock);
+  return int(m_segments.size());
+}
+
+QString MessageLogStore::getLastError() const {
+  QMutexLocker locker(&m_errorMutex);
+  return m_lastError;
+}
+
+void MessageLogStore::setLastError(const QString &error) {
+  QMutexLocker locker(&m_errorMutex);
+  m_lastError = error;
+}
+
+} // namespace MeshCore
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <QByteArray>
+#include <QMutex>
+#include <QObject>
+#include <QReadWriteLock>
+#include <QSet>
+#include <QString>
+#include <QVector>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "IMessageStore.h"
+
+class QFile;
+class QTimer;
+
+namespace MeshCore {
+
+struct MessageLogOptions {
+  qint64 segmentBytes = 8 * 1024 * 1024;
+  int indexInterval = 64;   // Records between sparse index entries
+  qint64 maxLogBytes = 0;   // Oldest segments are deleted above this; 0 = keep all
+  int syncIntervalMs = 1000; // Flush mapped pages this often; 0 = leave it to the OS
+  int dedupWindow = 65536;  // Recent messages checked for duplicates
+};
+
+// Append-only message log in memory-mapped segment files
+// (<dir>/device_<key>.log/<first sequence>.seg). Each record is framed by
+// its length on both sides plus a CRC, so the log can be read backwards for
+// recent history and a torn tail is detected and cut off on open. Sealed
+// segments get a sidecar with their sparse receive-time index so reopening
+// only scans the active one.
+//
+// Loads return messages in arrival order, newest first, and cost grows with
+// how far back the page lies; there are no per-channel indexes.
+class MessageLogStore : public QObject, public IMessageStore {
+  Q_OBJECT
+
+public:
+  explicit MessageLogStore(QObject *parent = nullptr);
+  explicit MessageLogStore(const MessageLogOptions &options, QObject *parent = nullptr);
+  ~MessageLogStore();
+
+  void setDirectory(const QString &directory); // Empty = app data dir
+  QString getLogPath(const QByteArray &devicePublicKey) const;
+
+  bool openDatabase(const QByteArray &devicePublicKey) override;
+  void closeDatabase() override;
+  bool isOpen() const override;
+
+  bool saveMessage(const Message &message, bool isSentByMe = false) override;
+  bool saveMessages(const QVector<Message> &messages, bool isSentByMe = false) override;
+  bool isMessageDuplicate(const Message &message) override;
+
+  QVector<Message> loadMessages(int limit = 100, int offset = 0) override;
+  QVector<Message> loadChannelMessages(uint8_t channelIdx, int limit = 100,
+                                       int offset = 0) override;
+  QVector<Message> loadDirectMessages(const QByteArray &contactPubKeyPrefix,
+                                      int limit = 100, int offset = 0) override;
+  int getMessageCount() override;
+  // Holds the log's read lock for one segment at a time, so appends wait
+  // for at most a segment's worth of records
+  bool scanMessages(qint64 fromSecs, qint64 toSecs,
+                    const std::function<bool(const Message &)> &visitor) override;
+
+  // Oldest first, received_at in [fromSecs, toSecs), located through the
+  // sparse index
+  QVector<Message> loadMessagesBetween(qint64 fromSecs, qint64 toSecs, int limit = 1000);
+
+  // Flushes mapped pages of the active segment to disk
+  bool sync();
+
+  qint64 logBytes() const;
+  int segmentCount() const;
+  // Heap held by the segment indexes and duplicate-check hashes; the mapped
+  // segments themselves are page cache
+  qint64 memoryUsage() const;
+
+  QString getLastError() const override;
+
+private:
+  struct IndexEntry {
+    qint64 receivedAt; // Highest received_at up to and including this record
+    quint32 offset;
+  };
+
+  struct Segment {
+    QString path;
+    std::unique_ptr<QFile> file;
+    uchar *data = nullptr;
+    qint64 mappedBytes = 0;
+    qint64 usedBytes = 0;
+    quint64 firstSequence = 0;
+    quint64 recordCount = 0;
+    qint64 minReceivedAt = 0;
+    qint64 maxReceivedAt = 0;
+    QVector<IndexEntry> index;
+    bool sealed = false;
+  };
+
+  bool openSegment(Segment &segment, bool active);
+  bool scanSegment(Segment &segment);
+  bool loadSidecar(Segment &segment);
+  bool writeSidecar(const Segment &segment);
+  bool sealActiveSegmentLocked();
+  bool startSegmentLocked(quint64 firstSequence);
+  void enforceSizeLimitLocked();
+  void closeLocked();
+
+  // Visits records newest first until the visitor returns false
+  void visitBackwards(const std::function<bool(const uchar *, quint32)> &visitor) const;
+  bool rememberHashLocked(quint64 hash);
+  static quint64 messageHash(const Message &message);
+
+  struct RecordView;
+  QVector<Message> loadMatching(const std::function<bool(const RecordView &)> &match,
+                                int limit, int offset);
+  void setLastError(const QString &error);
+
+  MessageLogOptions m_options;
+  QString m_directory;
+  QString m_logPath;
+
+  mutable QReadWriteLock m_lock; // Write lock for appends and segment changes
+  std::vector<Segment> m_segments; // Oldest first; the last one takes appends
+  quint64 m_nextSequence;
+
+  // Recent message hashes for duplicate checks
+  QVector<quint64> m_recentHashes; // Ring buffer
+  int m_recentHashPos;
+  QSet<quint64> m_recentHashSet;
+
+  qint64 m_dirtyFrom; // Active segment bytes not yet synced start here
+  QTimer *m_syncTimer;
+
+  mutable QMutex m_errorMutex;
+  QString m_lastError;
+};
+
+} // namespace MeshCore
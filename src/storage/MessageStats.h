@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QtGlobal>
+
+namespace MeshCore {
+
+// Rows returned by DatabaseManager's statistics queries. Channel keys are
+// channel indexes, with DIRECT_MESSAGES standing in for direct messages.
+
+struct ChannelCount {
+  static const int DIRECT_MESSAGES = -1;
+
+  int channelKey;
+  qint64 messageCount;
+};
+
+struct HourlyCount {
+  int channelKey;
+  qint64 hourStart; // Unix seconds, aligned to the hour
+  qint64 messageCount;
+};
+
+struct SenderCount {
+  QByteArray pubKeyPrefix; // Set for direct-message senders
+  QString name;            // Set for channel senders
+  qint64 messageCount;
+  qint64 lastReceivedAt;
+};
+
+struct HistogramBucket {
+  int value; // SNR in whole dB, or path length (0xFF = direct)
+  qint64 messageCount;
+};
+
+} // namespace MeshCore
@@ -0,0 +1,205 @@
+#include "MessageTextCodec.h"
+#include "../core/Logging.h"
+#include <QDebug>
+#include <QReadLocker>
+#include <QWriteLocker>
+
+#ifdef MESHCORE_HAVE_ZSTD
+#include <memory>
+#include <vector>
+#include <zdict.h>
+#include <zstd.h>
+#endif
+
+namespace MeshCore {
+
+namespace {
+
+// Decompression speed does not depend on the level; short texts gain little
+// beyond this one, and higher levels slow the maintenance batches down
+const int ZSTD_LEVEL = 9;
+
+} // namespace
+
+MessageTextCodec::MessageTextCodec() : m_compressContext(nullptr) {}
+
+MessageTextCodec::~MessageTextCodec() {
+  clear();
+#ifdef MESHCORE_HAVE_ZSTD
+  ZSTD_freeCCtx(static_cast<ZSTD_CCtx *>(m_compressContext));
+#endif
+}
+
+bool MessageTextCodec::hasZstd() {
+#ifdef MESHCORE_HAVE_ZSTD
+  return true;
+#else
+  return false;
+#endif
+}
+
+QByteArray MessageTextCodec::trainDictionary(const QVector<QByteArray> &samples,
+                                             int maxBytes) {
+#ifdef MESHCORE_HAVE_ZSTD
+  QByteArray buffer;
+  std::vector<size_t> sizes;
+  sizes.reserve(samples.size());
+  for (const QByteArray &sample : samples) {
+    buffer.append(sample);
+    sizes.push_back(static_cast<size_t>(sample.size()));
+  }
+
+  QByteArray dictionary(maxBytes, Qt::Uninitialized);
+  size_t size = ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(), buffer.constData(),
+                                      sizes.data(), static_cast<unsigned>(sizes.size()));
+  if (ZDICT_isError(size)) {
+    qCWarning(lcStorage) << "Dictionary training failed:" << ZDICT_getErrorName(size);
+    return QByteArray();
+  }
+
+  dictionary.truncate(static_cast<int>(size));
+  return dictionary;
+#else
+  Q_UNUSED(samples);
+  Q_UNUSED(maxBytes);
+  return QByteArray();
+#endif
+}
+
+void MessageTextCodec::addDictionary(int dictId, Codec codec, const QByteArray &dictionary) {
+  Dictionary entry{codec, nullptr, nullptr};
+
+#ifdef MESHCORE_HAVE_ZSTD
+  if (codec == ZstdDictionary) {
+    entry.compressDict =
+        ZSTD_createCDict(dictionary.constData(), dictionary.size(), ZSTD_LEVEL);
+    entry.decompressDict = ZSTD_createDDict(dictionary.constData(), dictionary.size());
+  }
+#else
+  if (codec == ZstdDictionary) {
+    qCWarning(lcStorage) << "Dictionary" << dictId << "needs zstd, which this build lacks";
+  }
+  Q_UNUSED(dictionary);
+#endif
+
+  QWriteLocker locker(&m_lock);
+  auto existing = m_dictionaries.find(dictId);
+  if (existing != m_dictionaries.end()) {
+    freeDictionary(existing.value());
+  }
+  m_dictionaries.insert(dictId, entry);
+}
+
+bool MessageTextCodec::hasDictionary(int dictId) const {
+  QReadLocker locker(&m_lock);
+  return m_dictionaries.contains(dictId);
+}
+
+void MessageTextCodec::clear() {
+  QWriteLocker locker(&m_lock);
+  for (Dictionary &dictionary : m_dictionaries) {
+    freeDictionary(dictionary);
+  }
+  m_dictionaries.clear();
+}
+
+QByteArray MessageTextCodec::compress(const QByteArray &text, int dictId) {
+  if (dictId == 0) {
+    return qCompress(text, 9);
+  }
+
+#ifdef MESHCORE_HAVE_ZSTD
+  QReadLocker locker(&m_lock);
+  auto it = m_dictionaries.constFind(dictId);
+  if (it == m_dictionaries.constEnd() || !it->compressDict) {
+    return QByteArray();
+  }
+
+  if (!m_compressContext) {
+    m_compressContext = ZSTD_createCCtx();
+  }
+
+  QByteArray out(static_cast<int>(ZSTD_compressBound(text.size())), Qt::Uninitialized);
+  size_t size = ZSTD_compress_usingCDict(static_cast<ZSTD_CCtx *>(m_compressContext),
+                                         out.data(), out.size(), text.constData(), text.size(),
+                                         static_cast<const ZSTD_CDict *>(it->compressDict));
+  if (ZSTD_isError(size)) {
+    return QByteArray();
+  }
+
+  out.truncate(static_cast<int>(size));
+  return out;
+#else
+  Q_UNUSED(text);
+  return QByteArray();
+#endif
+}
+
+QString MessageTextCodec::decompress(const QByteArray &data, int dictId, bool *ok) const {
+  if (ok) {
+    *ok = false;
+  }
+
+  if (dictId == 0) {
+    // Texts are only stored compressed when that made them smaller, so a
+    // valid stream never decodes to nothing
+    QByteArray text = qUncompress(data);
+    if (text.isEmpty()) {
+      qCWarning(lcStorage) << "Corrupt zlib message text";
+      return QString();
+    }
+    if (ok) {
+      *ok = true;
+    }
+    return QString::fromUtf8(text);
+  }
+
+#ifdef MESHCORE_HAVE_ZSTD
+  QReadLocker locker(&m_lock);
+  auto it = m_dictionaries.constFind(dictId);
+  if (it == m_dictionaries.constEnd() || !it->decompressDict) {
+    qCWarning(lcStorage) << "Missing compression dictionary" << dictId;
+    return QString();
+  }
+
+  // Decompression contexts are reused per thread; readers run concurrently
+  thread_local std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx *)> context(ZSTD_createDCtx(),
+                                                                         ZSTD_freeDCtx);
+
+  unsigned long long contentSize = ZSTD_getFrameContentSize(data.constData(), data.size());
+  if (contentSize == ZSTD_CONTENTSIZE_ERROR || contentSize == ZSTD_CONTENTSIZE_UNKNOWN) {
+    qCWarning(lcStorage) << "Corrupt zstd message text (dictionary" << dictId << ")";
+    return QString();
+  }
+
+  QByteArray out(static_cast<int>(contentSize), Qt::Uninitialized);
+  const auto *dictionary = static_cast<const ZSTD_DDict *>(it->decompressDict);
+  size_t size = ZSTD_decompress_usingDDict(context.get(), out.data(), out.size(),
+                                           data.constData(), data.size(), dictionary);
+  if (ZSTD_isError(size)) {
+    qCWarning(lcStorage) << "Failed to decompress message text:" << ZSTD_getErrorName(size);
+    return QString();
+  }
+
+  if (ok) {
+    *ok = true;
+  }
+  return QString::fromUtf8(out.constData(), static_cast<int>(size));
+#else
+  Q_UNUSED(data);
+  qCWarning(lcStorage) << "Message compressed with dictionary" << dictId
+                       << "but zstd is unavailable";
+  return QString();
+#endif
+}
+
+void MessageTextCodec::freeDictionary(Dictionary &dictionary) {
+#ifdef MESHCORE_HAVE_ZSTD
+  ZSTD_freeCDict(static_cast<ZSTD_CDict *>(dictionary.compressDict));
+  ZSTD_freeDDict(static_cast<ZSTD_DDict *>(dictionary.decompressDict));
+#endif
+  dictionary.compressDict = nullptr;
+  dictionary.decompressDict = nullptr;
+}
+
+} // namespace MeshCore
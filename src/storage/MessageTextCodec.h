@@ -0,0 +1,55 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QString>
+#include <QVector>
+
+namespace MeshCore {
+
+// Compresses message text for cold partitions. With zstd available
+// (MESHCORE_HAVE_ZSTD) texts are compressed against a dictionary trained
+// from our own traffic, which is what makes short messages shrink at all.
+// Without it, zlib (qCompress) is used with no dictionary and only pays off
+// for longer texts.
+//
+// Dictionaries are registered once and then shared; decompress() may be
+// called from any thread, compress() only from the writer thread.
+class MessageTextCodec {
+public:
+  enum Codec { Zlib = 1, ZstdDictionary = 2 };
+
+  MessageTextCodec();
+  ~MessageTextCodec();
+
+  static bool hasZstd();
+
+  // Builds a dictionary of up to maxBytes from sample texts. Empty if zstd
+  // is unavailable or there is not enough material.
+  static QByteArray trainDictionary(const QVector<QByteArray> &samples, int maxBytes);
+
+  void addDictionary(int dictId, Codec codec, const QByteArray &dictionary);
+  bool hasDictionary(int dictId) const;
+  void clear();
+
+  // dictId 0 means plain zlib. decompress() sets *ok to false when the data
+  // cannot be decoded (corrupt, unknown dictionary, or a zstd build missing)
+  QByteArray compress(const QByteArray &text, int dictId);
+  QString decompress(const QByteArray &data, int dictId, bool *ok = nullptr) const;
+
+private:
+  struct Dictionary {
+    Codec codec;
+    void *compressDict;   // ZSTD_CDict
+    void *decompressDict; // ZSTD_DDict
+  };
+
+  void freeDictionary(Dictionary &dictionary);
+
+  mutable QReadWriteLock m_lock;
+  QHash<int, Dictionary> m_dictionaries;
+  void *m_compressContext; // ZSTD_CCtx, writer thread only
+};
+
+} // namespace MeshCore
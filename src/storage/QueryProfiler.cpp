@@ -0,0 +1,189 @@
+#include "QueryProfiler.h"
+#include "../core/LatencyMetrics.h"
+#include "../core/Logging.h"
+#include <QDateTime>
+#include <QMutexLocker>
+#include <QRegularExpression>
+#include <QSqlQuery>
+#include <algorithm>
+
+namespace MeshCore {
+
+QueryProfiler::QueryProfiler()
+    : m_nextSlowQuery(0), m_slowThresholdMs(DEFAULT_SLOW_THRESHOLD_MS),
+      m_capturePlans(true) {}
+
+bool QueryProfiler::exec(QSqlQuery &query) {
+  const qint64 startNs = LatencyMetrics::now();
+  const bool ok = query.exec();
+  record(query, LatencyMetrics::now() - startNs);
+  return ok;
+}
+
+bool QueryProfiler::exec(QSqlQuery &query, const QString &sql) {
+  const qint64 startNs = LatencyMetrics::now();
+  const bool ok = query.exec(sql);
+  record(query, LatencyMetrics::now() - startNs);
+  return ok;
+}
+
+void QueryProfiler::record(const QSqlQuery &query, qint64 elapsedNs) {
+  const QString sql = query.lastQuery();
+  PlanProvider explain;
+  QString key;
+  int index;
+  {
+    QMutexLocker locker(&m_mutex);
+
+    // Normalized only the first time a given text is seen
+    auto it = m_indexBySql.constFind(sql);
+    if (it != m_indexBySql.constEnd()) {
+      index = it.value();
+    } else {
+      key = normalize(sql);
+      index = -1;
+      for (int i = 0; i < m_statements.size(); ++i) {
+        if (m_statements[i].sql == key) {
+          index = i;
+          break;
+        }
+      }
+      if (index < 0) {
+        index = m_statements.size();
+        m_statements.append(StatementStats());
+        m_statements.last().sql = key;
+      }
+      m_indexBySql.insert(sql, index);
+    }
+
+    StatementStats &stats = m_statements[index];
+    stats.exampleSql = sql;
+    stats.executions++;
+    stats.totalNs += elapsedNs;
+    stats.maxNs = qMax(stats.maxNs, elapsedNs);
+
+    if (m_slowThresholdMs <= 0 || elapsedNs < qint64(m_slowThresholdMs) * 1000000) {
+      return;
+    }
+
+    SlowQuery slow;
+    slow.sql = sql;
+    slow.boundValues = query.boundValues();
+    slow.elapsedNs = elapsedNs;
+    slow.at = QDateTime::currentMSecsSinceEpoch();
+    if (m_slowQueries.size() < MAX_SLOW_QUERIES) {
+      m_slowQueries.append(slow);
+    } else {
+      m_slowQueries[m_nextSlowQuery] = slow;
+    }
+    m_nextSlowQuery = (m_nextSlowQuery + 1) % MAX_SLOW_QUERIES;
+
+    qCDebug(lcStorage) << "Slow query:" << elapsedNs / 1000 << "us" << sql;
+    if (m_capturePlans && stats.plan.isEmpty()) {
+      explain = m_planProvider;
+      key = stats.sql;
+    }
+  }
+
+  // The provider runs SQL of its own, so not under the lock
+  if (explain) {
+    const QString plan = explain(sql, query.boundValues());
+
+    QMutexLocker locker(&m_mutex);
+    if (index < m_statements.size() && m_statements[index].sql == key) {
+      m_statements[index].plan = plan; // Unless reset() ran meanwhile
+    }
+  }
+}
+
+void QueryProfiler::setSlowThresholdMs(int ms) {
+  QMutexLocker locker(&m_mutex);
+  m_slowThresholdMs = qMax(0, ms);
+}
+
+int QueryProfiler::slowThresholdMs() const {
+  QMutexLocker locker(&m_mutex);
+  return m_slowThresholdMs;
+}
+
+void QueryProfiler::setCapturePlans(bool capture) {
+  QMutexLocker locker(&m_mutex);
+  m_capturePlans = capture;
+}
+
+bool QueryProfiler::capturePlans() const {
+  QMutexLocker locker(&m_mutex);
+  return m_capturePlans;
+}
+
+void QueryProfiler::setPlanProvider(const PlanProvider &provider) {
+  QMutexLocker locker(&m_mutex);
+  m_planProvider = provider;
+}
+
+QVector<StatementStats> QueryProfiler::statements() const {
+  QVector<StatementStats> statements;
+  {
+    QMutexLocker locker(&m_mutex);
+    statements = m_statements;
+  }
+
+  std::sort(statements.begin(), statements.end(),
+            [](const StatementStats &a, const StatementStats &b) {
+              return a.totalNs > b.totalNs;
+            });
+  return statements;
+}
+
+QVector<SlowQuery> QueryProfiler::slowQueries() const {
+  QMutexLocker locker(&m_mutex);
+  if (m_slowQueries.size() < MAX_SLOW_QUERIES) {
+    return m_slowQueries;
+  }
+
+  // Full ring: the oldest entry is the one written next
+  QVector<SlowQuery> ordered;
+  ordered.reserve(MAX_SLOW_QUERIES);
+  for (int i = 0; i < MAX_SLOW_QUERIES; ++i) {
+    ordered.append(m_slowQueries[(m_nextSlowQuery + i) % MAX_SLOW_QUERIES]);
+  }
+  return ordered;
+}
+
+void QueryProfiler::reset() {
+  QMutexLocker locker(&m_mutex);
+  m_indexBySql.clear();
+  m_statements.clear();
+  m_slowQueries.clear();
+  m_nextSlowQuery = 0;
+}
+
+qint64 QueryProfiler::memoryUsage() const {
+  QMutexLocker locker(&m_mutex);
+  auto text = [](const QString &s) { return s.capacity() * qint64(sizeof(QChar)); };
+
+  qint64 bytes = 0;
+  for (const StatementStats &stats : m_statements) {
+    bytes += sizeof(StatementStats) + text(stats.sql) + text(stats.exampleSql) +
+             text(stats.plan);
+  }
+  for (const SlowQuery &slow : m_slowQueries) {
+    bytes += sizeof(SlowQuery) + text(slow.sql) +
+             slow.boundValues.size() * qint64(sizeof(QVariant));
+  }
+  for (auto it = m_indexBySql.cbegin(); it != m_indexBySql.cend(); ++it) {
+    bytes += text(it.key()) + qint64(sizeof(QString) + sizeof(int) + 2 * sizeof(void *));
+  }
+  return bytes;
+}
+
+QString QueryProfiler::normalize(const QString &sql) {
+  static const QRegularExpression partition("\\bmessages_\\d{6}\\b");
+  static const QRegularExpression whitespace("\\s+");
+  QString key = sql;
+  key.replace(partition, "messages_<yyyymm>");
+  key.replace(whitespace, " ");
+  return key.trimmed();
+}
+
+} // namespace MeshCore
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+#include <functional>
+
+class QSqlQuery;
+
+namespace MeshCore {
+
+// Totals for one statement. Statements that differ only in the message
+// partition they touch (messages_202610, messages_202611, ...) share one
+// entry, written with messages_<yyyymm>.
+struct StatementStats {
+  QString sql;
+  QString exampleSql; // As last executed, with a real partition name
+  quint64 executions = 0;
+  qint64 totalNs = 0;
+  qint64 maxNs = 0;
+  QString plan; // EXPLAIN QUERY PLAN, captured the first time it ran slow
+
+  double meanNs() const { return executions > 0 ? double(totalNs) / executions : 0.0; }
+};
+
+struct SlowQuery {
+  QString sql; // As executed
+  QVariantList boundValues;
+  qint64 elapsedNs = 0;
+  qint64 at = 0; // Milliseconds since epoch
+};
+
+// Times SQL statements run through exec() and keeps per-statement totals
+// plus a log of the most recent executions that took longer than the slow
+// threshold. Safe to use from any thread.
+//
+// Only exec() itself is timed. For a SELECT that covers stepping to the
+// first row, which includes any full scan or temporary sort; rows fetched
+// afterwards with next() are not counted.
+class QueryProfiler {
+public:
+  // Returns the plan of sql as EXPLAIN QUERY PLAN shows it, or an error
+  using PlanProvider = std::function<QString(const QString &sql, const QVariantList &values)>;
+
+  QueryProfiler();
+
+  // Drop-in replacements for query.exec() and query.exec(sql)
+  bool exec(QSqlQuery &query);
+  bool exec(QSqlQuery &query, const QString &sql);
+
+  void record(const QSqlQuery &query, qint64 elapsedNs);
+
+  void setSlowThresholdMs(int ms); // 0 logs nothing; 50 by default
+  int slowThresholdMs() const;
+  // Capture a statement's plan the first time it runs slow. The provider is
+  // called on the thread that ran the statement.
+  void setCapturePlans(bool capture);
+  bool capturePlans() const;
+  void setPlanProvider(const PlanProvider &provider);
+
+  QVector<StatementStats> statements() const; // Most total time first
+  QVector<SlowQuery> slowQueries() const;     // Oldest first
+  void reset();
+  qint64 memoryUsage() const;
+
+  static QString normalize(const QString &sql);
+
+private:
+  mutable QMutex m_mutex;
+  QHash<QString, int> m_indexBySql; // Executed text -> m_statements index
+  QVector<StatementStats> m_statements;
+  QVector<SlowQuery> m_slowQueries; // Ring of MAX_SLOW_QUERIES
+  int m_nextSlowQuery;
+  int m_slowThresholdMs;
+  bool m_capturePlans;
+  PlanProvider m_planProvider;
+
+  static const int MAX_SLOW_QUERIES = 100;
+  static const int DEFAULT_SLOW_THRESHOLD_MS = 50;
+};
+
+} // namespace MeshCore
@@ -0,0 +1,153 @@
+#include "ReadConnectionPool.h"
+#include "../core/Logging.h"
+#include <QDebug>
+#include <QHash>
+#include <QMutexLocker>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <QThreadStorage>
+
+namespace MeshCore {
+
+namespace {
+
+struct ThreadConnection {
+  int generation = 0;
+  QString name;
+  QSqlDatabase db;
+  std::shared_ptr<std::atomic<int>> liveConnections;
+};
+
+void removeConnection(ThreadConnection &connection) {
+  connection.db.close();
+  connection.db = QSqlDatabase();
+  QSqlDatabase::removeDatabase(connection.name);
+  connection.liveConnections->fetch_sub(1, std::memory_order_relaxed);
+}
+
+// The read connections opened by one thread, by pool. QThreadStorage
+// deletes it from that thread as the thread finishes, which closes them.
+struct ThreadConnections {
+  ~ThreadConnections() {
+    for (ThreadConnection &connection : byPool) {
+      removeConnection(connection);
+    }
+  }
+
+  QHash<quint64, ThreadConnection> byPool;
+};
+
+ThreadConnections &currentThreadConnections() {
+  // Never destroyed before the threads using it, so no thread's entry leaks
+  static QThreadStorage<ThreadConnections *> *storage =
+      new QThreadStorage<ThreadConnections *>();
+  if (!storage->hasLocalData()) {
+    storage->setLocalData(new ThreadConnections());
+  }
+  return *storage->localData();
+}
+
+std::atomic<quint64> nextPoolId{1};
+
+} // namespace
+
+ReadConnectionPool::ReadConnectionPool()
+    : m_id(nextPoolId.fetch_add(1, std::memory_order_relaxed)), m_generation(0),
+      m_liveConnections(std::make_shared<std::atomic<int>>(0)) {}
+
+ReadConnectionPool::~ReadConnectionPool() { close(); }
+
+void ReadConnectionPool::open(const QString &databasePath,
+                              const QString &connectionPrefix) {
+  close();
+
+  QMutexLocker locker(&m_mutex);
+  m_databasePath = databasePath;
+  m_connectionPrefix = connectionPrefix;
+}
+
+void ReadConnectionPool::close() {
+  {
+    QMutexLocker locker(&m_mutex);
+    m_generation++;
+    m_databasePath.clear();
+  }
+
+  releaseConnection();
+}
+
+bool ReadConnectionPool::isOpen() const {
+  QMutexLocker locker(&m_mutex);
+  return !m_databasePath.isEmpty();
+}
+
+void ReadConnectionPool::setConnectionPragmas(const QStringList &pragmas) {
+  QMutexLocker locker(&m_mutex);
+  m_pragmas = pragmas;
+}
+
+QSqlDatabase ReadConnectionPool::connection() {
+  QMutexLocker locker(&m_mutex);
+
+  if (m_databasePath.isEmpty()) {
+    return QSqlDatabase();
+  }
+
+  QHash<quint64, ThreadConnection> &connections = currentThreadConnections().byPool;
+  auto existing = connections.find(m_id);
+  if (existing != connections.end()) {
+    if (existing->generation == m_generation) {
+      return existing->db;
+    }
+
+    // Opened before the pool was last closed, possibly on another file
+    removeConnection(*existing);
+    connections.erase(existing);
+  }
+
+  QString name = QString("%1_ro%2_%3_%4")
+                     .arg(m_connectionPrefix)
+                     .arg(m_id)
+                     .arg(m_generation)
+                     .arg(reinterpret_cast<quintptr>(QThread::currentThreadId()), 0, 16);
+
+  QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", name);
+  db.setDatabaseName(m_databasePath);
+  db.setConnectOptions("QSQLITE_OPEN_READONLY;QSQLITE_BUSY_TIMEOUT=5000");
+
+  if (!db.open()) {
+    qCWarning(lcStorage) << "Failed to open read connection:" << db.lastError().text();
+    db = QSqlDatabase();
+    QSqlDatabase::removeDatabase(name);
+    return QSqlDatabase();
+  }
+
+  QSqlQuery query(db);
+  query.exec("PRAGMA query_only=ON");
+  for (const QString &pragma : std::as_const(m_pragmas)) {
+    query.exec(pragma);
+  }
+
+  connections.insert(m_id, ThreadConnection{m_generation, name, db, m_liveConnections});
+  int count = m_liveConnections->fetch_add(1, std::memory_order_relaxed) + 1;
+  qCDebug(lcStorage) << "Opened read connection" << name << "(" << count << "total)";
+  return db;
+}
+
+void ReadConnectionPool::releaseConnection() {
+  QHash<quint64, ThreadConnection> &connections = currentThreadConnections().byPool;
+  auto existing = connections.find(m_id);
+  if (existing == connections.end()) {
+    return;
+  }
+
+  removeConnection(*existing);
+  connections.erase(existing);
+}
+
+int ReadConnectionPool::connectionCount() const {
+  return m_liveConnections->load(std::memory_order_relaxed);
+}
+
+} // namespace MeshCore
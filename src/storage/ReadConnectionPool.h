@@ -0,0 +1,55 @@
+#pragma once
+
+#include <QMutex>
+#include <QSqlDatabase>
+#include <QString>
+#include <QStringList>
+
+#include <atomic>
+#include <memory>
+
+namespace MeshCore {
+
+// Hands out one read-only SQLite connection per calling thread. QtSql
+// connections may only be used, closed and removed by the thread that
+// created them, so each thread gets its own and is the only one to tear it
+// down: when the thread finishes, when it releases it, or when it next asks
+// for one after the pool was closed. In WAL mode these readers never block
+// the writer.
+class ReadConnectionPool {
+public:
+  ReadConnectionPool();
+  ~ReadConnectionPool();
+
+  void open(const QString &databasePath, const QString &connectionPrefix);
+  // Invalidates every connection handed out so far. The calling thread's is
+  // closed now, other threads' the next time they use the pool or when they
+  // finish.
+  void close();
+  bool isOpen() const;
+
+  // Run on every connection opened from now on (existing ones keep theirs)
+  void setConnectionPragmas(const QStringList &pragmas);
+
+  // Connection for the calling thread, created on first use. The returned
+  // handle is invalid (not open) if the pool is closed or the open failed.
+  QSqlDatabase connection();
+
+  // Drops the calling thread's connection before the thread finishes
+  void releaseConnection();
+
+  // Connections still open, including ones from before the last close()
+  int connectionCount() const;
+
+private:
+  mutable QMutex m_mutex;
+  const quint64 m_id; // Distinguishes pools in the per-thread connection lists
+  QString m_databasePath;
+  QString m_connectionPrefix;
+  int m_generation; // Bumped by close(); older connections are stale
+  QStringList m_pragmas;
+  // Shared with the per-thread entries, which may outlive the pool
+  std::shared_ptr<std::atomic<int>> m_liveConnections;
+};
+
+} // namespace MeshCore
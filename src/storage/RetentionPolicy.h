@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QtGlobal>
+
+namespace MeshCore {
+
+// Limits applied by DatabaseManager's background pruning. A value of 0
+// disables the corresponding limit.
+struct RetentionPolicy {
+  int maxAgeDays;             // Drop messages received longer ago than this
+  int maxMessagesPerChannel;  // Keep only the newest N messages per channel
+  qint64 maxDatabaseBytes;    // Prune oldest messages while above this size
+  int hashRetentionDays;      // Dedup hashes only need a short horizon
+  int compressAfterDays;      // Compress text of partitions older than this
+  int batchSize;              // Rows deleted per step (keeps steps short)
+  int intervalSecs;           // Delay between steps when there is no backlog
+
+  RetentionPolicy()
+      : maxAgeDays(0), maxMessagesPerChannel(0), maxDatabaseBytes(0),
+        hashRetentionDays(7), compressAfterDays(0), batchSize(500), intervalSecs(60) {}
+
+  bool hasMessageLimits() const {
+    return maxAgeDays > 0 || maxMessagesPerChannel > 0 || maxDatabaseBytes > 0;
+  }
+};
+
+} // namespace MeshCore
@@ -96,6 +96,65 @@ void SettingsManager::setDateTimeFormat(const QString &format) {
   m_settings.setValue(KEY_DATETIME_FORMAT, format);
 }
 
+// Storage retention
+
+RetentionPolicy SettingsManager::getRetentionPolicy() {
+  RetentionPolicy policy;
+  policy.maxAgeDays =
+      m_settings.value(KEY_RETENTION_MAX_AGE_DAYS, policy.maxAgeDays).toInt();
+  policy.maxMessagesPerChannel =
+      m_settings.value(KEY_RETENTION_MAX_PER_CHANNEL, policy.maxMessagesPerChannel).toInt();
+  policy.maxDatabaseBytes =
+      m_settings.value(KEY_RETENTION_MAX_BYTES, policy.maxDatabaseBytes).toLongLong();
+  policy.hashRetentionDays =
+      m_settings.value(KEY_RETENTION_HASH_DAYS, policy.hashRetentionDays).toInt();
+  policy.compressAfterDays =
+      m_settings.value(KEY_COMPRESS_AFTER_DAYS, policy.compressAfterDays).toInt();
+  return policy;
+}
+
+void SettingsManager::setRetentionPolicy(const RetentionPolicy &policy) {
+  m_settings.setValue(KEY_RETENTION_MAX_AGE_DAYS, policy.maxAgeDays);
+  m_settings.setValue(KEY_RETENTION_MAX_PER_CHANNEL, policy.maxMessagesPerChannel);
+  m_settings.setValue(KEY_RETENTION_MAX_BYTES, policy.maxDatabaseBytes);
+  m_settings.setValue(KEY_RETENTION_HASH_DAYS, policy.hashRetentionDays);
+  m_settings.setValue(KEY_COMPRESS_AFTER_DAYS, policy.compressAfterDays);
+}
+
+StorageProfile SettingsManager::getStorageProfile() {
+  StorageProfile profile = StorageProfile::Balanced;
+  storageProfileFromName(m_settings.value(KEY_STORAGE_PROFILE).toString(), &profile);
+  return profile;
+}
+
+void SettingsManager::setStorageProfile(StorageProfile profile) {
+  m_settings.setValue(KEY_STORAGE_PROFILE, storageProfileName(profile));
+}
+
+QString SettingsManager::getMessageStore() {
+  return m_settings.value(KEY_MESSAGE_STORE, "sqlite").toString();
+}
+
+void SettingsManager::setMessageStore(const QString &backend) {
+  m_settings.setValue(KEY_MESSAGE_STORE, backend);
+}
+
+int SettingsManager::getSlowQueryMs() {
+  return m_settings.value(KEY_SLOW_QUERY_MS, 50).toInt();
+}
+
+void SettingsManager::setSlowQueryMs(int ms) {
+  m_settings.setValue(KEY_SLOW_QUERY_MS, ms);
+}
+
+int SettingsManager::getMetricsPort() {
+  return m_settings.value(KEY_METRICS_PORT, 0).toInt();
+}
+
+void SettingsManager::setMetricsPort(int port) {
+  m_settings.setValue(KEY_METRICS_PORT, port);
+}
+
 // Recent devices
 
 QStringList SettingsManager::getRecentDevices() {
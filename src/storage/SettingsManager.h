@@ -6,6 +6,9 @@
 #include <QStringList>
 #include <QRect>
 
+#include "RetentionPolicy.h"
+#include "StorageProfile.h"
+
 namespace MeshCore {
 
 class SettingsManager {
@@ -39,6 +42,23 @@ public:
   QString getDateTimeFormat();
   void setDateTimeFormat(const QString &format);
 
+  // Storage retention
+  RetentionPolicy getRetentionPolicy();
+  void setRetentionPolicy(const RetentionPolicy &policy);
+
+  StorageProfile getStorageProfile();
+  void setStorageProfile(StorageProfile profile);
+
+  QString getMessageStore(); // "sqlite" or "log"; read when a device connects
+  void setMessageStore(const QString &backend);
+
+  int getSlowQueryMs(); // Slow-query log threshold; 0 = off
+  void setSlowQueryMs(int ms);
+
+  // Local metrics endpoint; 0 = off
+  int getMetricsPort();
+  void setMetricsPort(int port);
+
   // Recent device list (up to 10 devices)
   QStringList getRecentDevices();
   void addRecentDevice(const QByteArray &publicKey, const QString &deviceName);
@@ -64,6 +84,16 @@ private:
   static constexpr const char *KEY_SHOW_SNR = "display/showSNR";
   static constexpr const char *KEY_DATETIME_FORMAT = "display/dateTimeFormat";
   static constexpr const char *KEY_RECENT_DEVICES = "connection/recentDevices";
+  static constexpr const char *KEY_RETENTION_MAX_AGE_DAYS = "storage/retentionMaxAgeDays";
+  static constexpr const char *KEY_RETENTION_MAX_PER_CHANNEL =
+      "storage/retentionMaxMessagesPerChannel";
+  static constexpr const char *KEY_RETENTION_MAX_BYTES = "storage/retentionMaxDatabaseBytes";
+  static constexpr const char *KEY_RETENTION_HASH_DAYS = "storage/hashRetentionDays";
+  static constexpr const char *KEY_COMPRESS_AFTER_DAYS = "storage/compressAfterDays";
+  static constexpr const char *KEY_STORAGE_PROFILE = "storage/profile";
+  static constexpr const char *KEY_MESSAGE_STORE = "storage/messageStore";
+  static constexpr const char *KEY_SLOW_QUERY_MS = "storage/slowQueryMs";
+  static constexpr const char *KEY_METRICS_PORT = "telemetry/metricsPort";
 };
 
 } // namespace MeshCore
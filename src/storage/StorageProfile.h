@@ -0,0 +1,71 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+
+namespace MeshCore {
+
+// Connection tuning presets. All of them keep WAL mode; they differ in how
+// much of the last few commits a power loss may cost and how much memory
+// the connections use.
+enum class StorageProfile {
+  Durable,    // synchronous=FULL: every commit survives power loss
+  Balanced,   // synchronous=NORMAL: recent commits may roll back, never corrupt
+  Throughput, // synchronous=OFF, large cache and mmap: for bulk imports
+};
+
+struct StorageTuning {
+  const char *synchronous; // Writer connection only
+  qint64 mmapBytes;        // Every connection
+  int cacheKiB;            // Page cache per connection
+};
+
+inline StorageTuning storageTuning(StorageProfile profile) {
+  switch (profile) {
+  case StorageProfile::Durable:
+    return {"FULL", 0, 2048};
+  case StorageProfile::Throughput:
+    return {"OFF", 256LL * 1024 * 1024, 32768};
+  case StorageProfile::Balanced:
+  default:
+    return {"NORMAL", 64LL * 1024 * 1024, 8192};
+  }
+}
+
+// PRAGMAs applied to a connection for the profile; readers skip synchronous
+inline QStringList storageProfilePragmas(StorageProfile profile, bool writer) {
+  StorageTuning tuning = storageTuning(profile);
+  QStringList pragmas = {
+      QString("PRAGMA mmap_size=%1").arg(tuning.mmapBytes),
+      QString("PRAGMA cache_size=-%1").arg(tuning.cacheKiB),
+  };
+  if (writer) {
+    pragmas << QString("PRAGMA synchronous=%1").arg(QLatin1String(tuning.synchronous));
+  }
+  return pragmas;
+}
+
+inline QString storageProfileName(StorageProfile profile) {
+  switch (profile) {
+  case StorageProfile::Durable:
+    return "durable";
+  case StorageProfile::Throughput:
+    return "throughput";
+  case StorageProfile::Balanced:
+  default:
+    return "balanced";
+  }
+}
+
+inline bool storageProfileFromName(const QString &name, StorageProfile *profile) {
+  for (StorageProfile candidate :
+       {StorageProfile::Durable, StorageProfile::Balanced, StorageProfile::Throughput}) {
+    if (storageProfileName(candidate) == name.toLower()) {
+      *profile = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace MeshCore
@@ -0,0 +1,254 @@
+#include "WalCheckpointer.h"
+#include "../core/Logging.h"
+#include "../core/MemoryAccounting.h"
+#include "../core/Tracer.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QTimer>
+
+namespace MeshCore {
+
+WalCheckpointer::WalCheckpointer(QObject *parent)
+    : QObject(parent), m_worker(new QObject), m_timer(nullptr), m_dataVersion(-1),
+      m_pending(false), m_truncated(false) {
+  m_thread.setObjectName("WalCheckpointer");
+  m_worker->moveToThread(&m_thread);
+  connect(&m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+  m_thread.start(QThread::LowPriority);
+}
+
+WalCheckpointer::~WalCheckpointer() {
+  stop();
+  m_thread.quit();
+  m_thread.wait();
+}
+
+void WalCheckpointer::start(const QString &databasePath, const QString &connectionName) {
+  stop();
+
+  QMetaObject::invokeMethod(
+      m_worker,
+      [this, databasePath, connectionName]() {
+        // Busy waits are bounded: a RESTART or TRUNCATE that cannot finish
+        // quickly gives up and is retried on a later tick
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+        db.setDatabaseName(databasePath);
+        db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=1000");
+        if (!db.open()) {
+          qCWarning(lcStorage) << "Failed to open checkpoint connection:" << db.lastError().text();
+          db = QSqlDatabase();
+          QSqlDatabase::removeDatabase(connectionName);
+          return;
+        }
+
+        m_connectionName = connectionName;
+        m_walPath = databasePath + "-wal";
+        m_dataVersion = -1;
+        m_pending = true; // Whatever the last session left behind
+        m_truncated = false;
+        m_sinceWrite.start();
+
+        m_timer = new QTimer(m_worker);
+        connect(m_timer, &QTimer::timeout, m_worker, [this]() { poll(); });
+        m_timer->start(policy().pollMs);
+      },
+      Qt::BlockingQueuedConnection);
+}
+
+void WalCheckpointer::stop() {
+  if (!m_thread.isRunning()) {
+    return;
+  }
+
+  QMetaObject::invokeMethod(
+      m_worker,
+      [this]() {
+        delete m_timer;
+        m_timer = nullptr;
+
+        if (m_connectionName.isEmpty()) {
+          return;
+        }
+
+        {
+          QSqlDatabase db = QSqlDatabase::database(m_connectionName, false);
+          db.close();
+        }
+        QSqlDatabase::removeDatabase(m_connectionName);
+        m_connectionName.clear();
+      },
+      Qt::BlockingQueuedConnection);
+
+  QMutexLocker locker(&m_mutex);
+  m_stats.walBytes = 0;
+}
+
+void WalCheckpointer::setPolicy(const CheckpointPolicy &policy) {
+  {
+    QMutexLocker locker(&m_mutex);
+    m_policy = policy;
+  }
+
+  QMetaObject::invokeMethod(m_worker, [this, policy]() {
+    if (m_timer) {
+      m_timer->start(policy.pollMs);
+    }
+  });
+}
+
+CheckpointPolicy WalCheckpointer::policy() const {
+  QMutexLocker locker(&m_mutex);
+  return m_policy;
+}
+
+WalStats WalCheckpointer::stats() const {
+  QMutexLocker locker(&m_mutex);
+  return m_stats;
+}
+
+bool WalCheckpointer::checkpointNow(Mode mode) {
+  bool ok = false;
+  QMetaObject::invokeMethod(
+      m_worker, [this, mode, &ok]() { ok = runCheckpoint(mode); },
+      Qt::BlockingQueuedConnection);
+  return ok;
+}
+
+QString WalCheckpointer::modeName(Mode mode) {
+  switch (mode) {
+  case Passive:
+    return "PASSIVE";
+  case Restart:
+    return "RESTART";
+  case Truncate:
+    return "TRUNCATE";
+  }
+  return QString();
+}
+
+void WalCheckpointer::poll() {
+  MemoryScope memory(MemoryAccounting::Storage);
+  QSqlDatabase db = QSqlDatabase::database(m_connectionName, false);
+  if (!db.isOpen()) {
+    return;
+  }
+
+  // data_version changes whenever another connection commits
+  QSqlQuery query(db);
+  if (query.exec("PRAGMA data_version") && query.next()) {
+    qint64 version = query.value(0).toLongLong();
+    if (version != m_dataVersion) {
+      if (m_dataVersion >= 0) {
+        m_pending = true;
+        m_truncated = false;
+        m_sinceWrite.restart();
+      }
+      m_dataVersion = version;
+    }
+  }
+  query.finish();
+
+  CheckpointPolicy policy = this->policy();
+  qint64 walBytes = walFileBytes();
+  qint64 idleMs = m_sinceWrite.elapsed();
+
+  {
+    QMutexLocker locker(&m_mutex);
+    m_stats.walBytes = walBytes;
+  }
+
+  if (walBytes == 0) {
+    return;
+  }
+
+  // A long pause is the time to give the disk space back; a short one (or
+  // a WAL past the soft limit) gets a PASSIVE checkpoint, which never waits
+  // on the writer or readers. Only a WAL past the hard limit holds the
+  // writer up, for at most the busy timeout.
+  if (m_pending && walBytes >= policy.walHardLimitBytes) {
+    runCheckpoint(Restart);
+  } else if (idleMs >= policy.quietMs && !m_truncated) {
+    runCheckpoint(Truncate);
+  } else if (m_pending && (idleMs >= policy.idleMs || walBytes >= policy.walSoftLimitBytes)) {
+    runCheckpoint(Passive);
+  }
+}
+
+bool WalCheckpointer::runCheckpoint(Mode mode) {
+  TraceScope span("storage", "walCheckpoint");
+  span.setArg("mode", mode);
+  QSqlDatabase db = QSqlDatabase::database(m_connectionName, false);
+  if (!db.isOpen()) {
+    return false;
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+
+  // Returns (busy, frames in the WAL, frames checkpointed)
+  QSqlQuery query(db);
+  if (!query.exec(QString("PRAGMA wal_checkpoint(%1)").arg(modeName(mode))) ||
+      !query.next()) {
+    qCWarning(lcStorage) << "WAL checkpoint failed:" << query.lastError().text();
+    return false;
+  }
+
+  bool busy = query.value(0).toInt() != 0;
+  int logFrames = query.value(1).toInt();
+  int checkpointedFrames = query.value(2).toInt();
+  query.finish();
+
+  qint64 elapsedUs = timer.nsecsElapsed() / 1000;
+  qint64 walBytes = walFileBytes();
+
+  m_pending = busy || checkpointedFrames < logFrames;
+  if (mode == Truncate && !busy) {
+    m_truncated = true;
+  }
+
+  {
+    QMutexLocker locker(&m_mutex);
+    switch (mode) {
+    case Passive:
+      m_stats.passiveCheckpoints++;
+      break;
+    case Restart:
+      m_stats.restartCheckpoints++;
+      break;
+    case Truncate:
+      m_stats.truncateCheckpoints++;
+      break;
+    }
+    if (busy) {
+      m_stats.busyCheckpoints++;
+    }
+    m_stats.walBytes = walBytes;
+    m_stats.lastCheckpointUs = elapsedUs;
+    m_stats.maxCheckpointUs = qMax(m_stats.maxCheckpointUs, elapsedUs);
+    m_stats.totalCheckpointUs += elapsedUs;
+    m_stats.lastLogFrames = logFrames;
+    m_stats.lastCheckpointedFrames = checkpointedFrames;
+    m_stats.lastCheckpointAt = QDateTime::currentSecsSinceEpoch();
+  }
+
+  if (mode != Passive || elapsedUs > 100000) {
+    qCDebug(lcStorage) << "WAL checkpoint" << modeName(mode) << "copied" << checkpointedFrames << "of"
+                       << logFrames << "frames in" << elapsedUs / 1000 << "ms"
+                       << (busy ? "(busy)" : "");
+  }
+
+  emit checkpointCompleted(mode, elapsedUs, walBytes);
+  return !busy;
+}
+
+qint64 WalCheckpointer::walFileBytes() const {
+  QFileInfo info(m_walPath);
+  return info.exists() ? info.size() : 0;
+}
+
+} // namespace MeshCore
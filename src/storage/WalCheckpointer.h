@@ -0,0 +1,91 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QThread>
+
+class QTimer;
+
+namespace MeshCore {
+
+// When the background checkpointer copies the WAL back into the database
+struct CheckpointPolicy {
+  int pollMs = 1000;
+  int idleMs = 2000;                           // PASSIVE once writes pause this long
+  int quietMs = 60000;                         // TRUNCATE once they pause this long
+  qint64 walSoftLimitBytes = 16 * 1024 * 1024; // PASSIVE even while busy above this
+  qint64 walHardLimitBytes = 64 * 1024 * 1024; // RESTART (briefly blocks writers)
+};
+
+struct WalStats {
+  qint64 walBytes = 0;
+  qint64 passiveCheckpoints = 0;
+  qint64 restartCheckpoints = 0;
+  qint64 truncateCheckpoints = 0;
+  qint64 busyCheckpoints = 0; // Stopped short by a reader or the writer
+  qint64 lastCheckpointUs = 0;
+  qint64 maxCheckpointUs = 0;
+  qint64 totalCheckpointUs = 0;
+  int lastLogFrames = 0;
+  int lastCheckpointedFrames = 0;
+  qint64 lastCheckpointAt = 0; // Seconds since epoch, 0 = never
+
+  qint64 checkpoints() const {
+    return passiveCheckpoints + restartCheckpoints + truncateCheckpoints;
+  }
+};
+
+// Runs WAL checkpoints on its own thread and connection, so the writer
+// never pays for one inline (DatabaseManager turns autocheckpoint off).
+// Activity is detected through PRAGMA data_version, without any hooks in
+// the write path.
+class WalCheckpointer : public QObject {
+  Q_OBJECT
+
+public:
+  enum Mode { Passive, Restart, Truncate };
+
+  explicit WalCheckpointer(QObject *parent = nullptr);
+  ~WalCheckpointer();
+
+  void start(const QString &databasePath, const QString &connectionName);
+  void stop();
+
+  void setPolicy(const CheckpointPolicy &policy);
+  CheckpointPolicy policy() const;
+  WalStats stats() const;
+
+  // Runs one checkpoint on the checkpoint thread and waits for it
+  bool checkpointNow(Mode mode);
+
+  static QString modeName(Mode mode);
+
+signals:
+  void checkpointCompleted(int mode, qint64 elapsedUs, qint64 walBytes);
+
+private:
+  // Checkpoint thread only
+  void poll();
+  bool runCheckpoint(Mode mode);
+  qint64 walFileBytes() const;
+
+  QThread m_thread;
+  QObject *m_worker; // Lives on m_thread; context for the work posted there
+  QTimer *m_timer;
+
+  // Checkpoint thread state
+  QString m_connectionName;
+  QString m_walPath;
+  qint64 m_dataVersion;
+  bool m_pending;   // Frames written since the last complete checkpoint
+  bool m_truncated; // WAL truncated since the last write
+  QElapsedTimer m_sinceWrite;
+
+  mutable QMutex m_mutex; // Guards m_policy and m_stats
+  CheckpointPolicy m_policy;
+  WalStats m_stats;
+};
+
+} // namespace MeshCore
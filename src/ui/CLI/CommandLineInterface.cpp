@@ -1,5 +1,14 @@
 #include "CommandLineInterface.h"
+#include "../../core/FlightRecorder.h"
+#include "../../core/Logging.h"
+#include "../../core/MemoryAccounting.h"
+#include "../../core/MetricsServer.h"
+#include "../../core/Tracer.h"
 #include "../../protocol/ProtocolConstants.h"
+#include "../../storage/DatabaseManager.h"
+#include "../../storage/HistoryExporter.h"
+#include "../../storage/MessageLogStore.h"
+#include "../../storage/SettingsManager.h"
 #include <QBluetoothLocalDevice>
 #include <QCoreApplication>
 #include <QDateTime>
@@ -10,10 +19,12 @@
 namespace MeshCore {
 
 CommandLineInterface::CommandLineInterface(MeshClient *client, QObject *parent)
-    : QObject(parent), m_client(client), m_input(stdin), m_output(stdout),
+    : QObject(parent), m_client(client), m_input(stdin),
+      m_renderer(new TerminalRenderer(this)), m_output(m_renderer->stream()),
       m_notifier(
           new QSocketNotifier(fileno(stdin), QSocketNotifier::Read, this)),
-      m_running(true) {
+      m_metricsServer(new MetricsServer(client, this)), m_running(true),
+      m_backupReportedPercent(-1), m_exporter(nullptr), m_lastHeapStatsMs(0) {
   // Connect MeshClient signals
   connect(m_client, &MeshClient::channelMessageReceived, this,
           &CommandLineInterface::onChannelMessageReceived);
@@ -38,6 +49,12 @@ CommandLineInterface::CommandLineInterface(MeshClient *client, QObject *parent)
   connect(m_client, &MeshClient::bleDiscoveryFinished, this,
           &CommandLineInterface::onBLEDiscoveryFinished);
 
+  // Backups run in the background; report as they progress
+  connect(m_client->databaseManager(), &DatabaseManager::backupProgress, this,
+          &CommandLineInterface::onBackupProgress);
+  connect(m_client->databaseManager(), &DatabaseManager::backupFinished, this,
+          &CommandLineInterface::onBackupFinished);
+
   // Connect input notifier
   connect(m_notifier, &QSocketNotifier::activated, this,
           &CommandLineInterface::processInput);
@@ -46,6 +63,17 @@ CommandLineInterface::CommandLineInterface(MeshClient *client, QObject *parent)
 void CommandLineInterface::start() {
   printWelcome();
   printHelp();
+
+  int metricsPort = SettingsManager::instance().getMetricsPort();
+  if (metricsPort > 0) {
+    if (m_metricsServer->start(static_cast<quint16>(metricsPort))) {
+      m_output << "Metrics: http://127.0.0.1:" << m_metricsServer->port() << "/metrics\n";
+    } else {
+      m_output << "Metrics endpoint not started: " << m_metricsServer->getLastError() << "\n";
+    }
+    m_output.flush();
+  }
+
   printPrompt();
 }
 
@@ -99,6 +127,36 @@ void CommandLineInterface::printHelp() {
   m_output << "  set_name <name>          - Set advertised node name\n";
   m_output << "  set_location <lat> <lon> - Set GPS location for adverts\n";
   m_output << "                             Example: set_location 51.5074 -0.1278\n";
+  m_output << "  retention [limit value]  - Show or set message retention limits\n";
+  m_output << "                             Limits: age <days>, channel <count>, size <MB>,\n";
+  m_output << "                             hashes <days> (0 disables); 'retention run' prunes now\n";
+  m_output << "  retention vacuum         - Rewrite an older database so pruning frees disk space\n";
+  m_output << "  compress [after <days>]  - Show or set cold-message compression (0 disables)\n";
+  m_output << "  compress measure [rows]  - Measure compression ratio and decode cost on history\n";
+  m_output << "  wal                      - Show WAL size and checkpoint timings\n";
+  m_output << "                             'wal checkpoint [passive|restart|truncate]' runs one;\n";
+  m_output << "                             'wal profile <durable|balanced|throughput>' tunes storage\n";
+  m_output << "  store [sqlite|log]       - Show or choose the message history backend (next connect)\n";
+  m_output << "  export <jsonl|archive> <file> [days] - Export history, oldest first (last n days)\n";
+  m_output << "  export read <file>       - Decode an archive and report its row count\n";
+  m_output << "  backup <file> [noverify] - Snapshot the database while it stays in use\n";
+  m_output << "  history <channel|pubkey> [limit] [offset] - Show stored messages, newest first\n";
+  m_output << "                             Viewing the newest page marks the conversation read\n";
+  m_output << "  inbox                    - List conversations with unread counts\n";
+  m_output << "  stats [section]          - Message statistics from the local database\n";
+  m_output << "                             Sections: channels, hours [n], senders [n], snr, paths\n";
+  m_output << "  stats latency [reset]    - Receive pipeline latency per stage (read to display)\n";
+  m_output << "  stats memory             - Memory by subsystem, with allocation rates\n";
+  m_output << "  metrics [port|off]       - Serve Prometheus metrics on 127.0.0.1 (remembered)\n";
+  m_output << "  trace [on|off|clear]     - Show or change timeline tracing of recent activity\n";
+  m_output << "  trace dump <file>        - Write the traced spans as Chrome/Perfetto JSON\n";
+  m_output << "  log [on|off] [subsystem] - Show or switch debug logging per subsystem\n";
+  m_output << "  sql [n|reset]            - Slowest statements by total time (top n)\n";
+  m_output << "  sql slow [ms|off]        - Show the slow-query log or set its threshold\n";
+  m_output << "  sql plans [on|off]       - Capture EXPLAIN QUERY PLAN for slow statements\n";
+  m_output << "  sql explain <n>          - Show the query plan of statement n from 'sql'\n";
+  m_output << "  frames [n]               - Show the last n frames to and from the device\n";
+  m_output << "  frames dump <file>       - Write the recorded frames to a file\n";
   m_output << "  help                     - Show this help\n";
   m_output << "  quit                     - Exit application\n";
   m_output << "\n";
@@ -119,10 +177,7 @@ void CommandLineInterface::printHelp() {
   m_output.flush();
 }
 
-void CommandLineInterface::printPrompt() {
-  m_output << "> ";
-  m_output.flush();
-}
+void CommandLineInterface::printPrompt() { m_renderer->requestPrompt(); }
 
 void CommandLineInterface::processInput() {
   QString line = m_input.readLine().trimmed();
@@ -143,6 +198,8 @@ void CommandLineInterface::handleCommand(const QString &line) {
 
   QString cmd = parts[0].toLower();
   QStringList args = parts.mid(1);
+  TraceScope span("cli", "command");
+  MemoryScope memory(MemoryAccounting::Ui);
 
   if (cmd == "scan") {
     cmdScan(args);
@@ -176,6 +233,34 @@ void CommandLineInterface::handleCommand(const QString &line) {
     cmdSetName(args);
   } else if (cmd == "set_location") {
     cmdSetLocation(args);
+  } else if (cmd == "retention") {
+    cmdRetention(args);
+  } else if (cmd == "compress") {
+    cmdCompress(args);
+  } else if (cmd == "wal") {
+    cmdWal(args);
+  } else if (cmd == "store") {
+    cmdStore(args);
+  } else if (cmd == "export") {
+    cmdExport(args);
+  } else if (cmd == "backup") {
+    cmdBackup(args);
+  } else if (cmd == "history") {
+    cmdHistory(args);
+  } else if (cmd == "stats") {
+    cmdStats(args);
+  } else if (cmd == "metrics") {
+    cmdMetrics(args);
+  } else if (cmd == "trace") {
+    cmdTrace(args);
+  } else if (cmd == "log") {
+    cmdLog(args);
+  } else if (cmd == "sql") {
+    cmdSql(args);
+  } else if (cmd == "frames") {
+    cmdFrames(args);
+  } else if (cmd == "inbox") {
+    cmdInbox();
   } else if (cmd == "help") {
     cmdHelp();
   } else if (cmd == "quit" || cmd == "exit") {
@@ -435,6 +520,22 @@ void CommandLineInterface::cmdStatus() {
     m_output << "  Channels: " << m_client->getChannels().size() << "\n";
   }
 
+  IMessageStore *store = m_client->messageStore();
+  if (store && store->isOpen()) {
+    m_output << "  Message store: "
+             << (store == m_client->databaseManager() ? "sqlite" : "log") << "\n";
+  }
+  if (m_client->pendingJournalRecords() > 0) {
+    m_output << "  Journaled, not yet stored: " << m_client->pendingJournalRecords() << "\n";
+  }
+
+  RecentMessageCache::Stats cacheStats = m_client->recentMessageCacheStats();
+  if (cacheStats.hits + cacheStats.misses > 0) {
+    m_output << "  History cache: " << cacheStats.hits << " hits, " << cacheStats.misses
+             << " misses (" << QString::number(cacheStats.hitRate() * 100.0, 'f', 1)
+             << "% hit rate)\n";
+  }
+
   m_output.flush();
 }
 
@@ -690,8 +791,887 @@ void CommandLineInterface::cmdSetLocation(const QStringList &args) {
   m_output.flush();
 }
 
+void CommandLineInterface::cmdRetention(const QStringList &args) {
+  DatabaseManager *db = m_client->databaseManager();
+  RetentionPolicy policy = SettingsManager::instance().getRetentionPolicy();
+
+  if (!args.isEmpty() && args[0].toLower() == "run") {
+    if (!db || !db->isOpen()) {
+      m_output << "Error: Database not open.\n";
+      m_output.flush();
+      return;
+    }
+
+    int removed = db->runRetentionStep();
+    m_output << "Retention step removed " << removed << " row(s).\n";
+    m_output.flush();
+    return;
+  }
+
+  if (!args.isEmpty() && args[0].toLower() == "vacuum") {
+    if (!db || !db->isOpen()) {
+      m_output << "Error: Database not open.\n";
+    } else if (db->isIncrementalVacuumEnabled()) {
+      m_output << "Incremental auto-vacuum is already on.\n";
+    } else {
+      // Rewrites the whole file; frames received meanwhile wait until it is done
+      m_output << "Rewriting the database for incremental auto-vacuum...\n";
+      m_renderer->flush();
+      if (db->enableIncrementalVacuum()) {
+        m_output << "Incremental auto-vacuum is on.\n";
+      } else {
+        m_output << "Error: " << db->getLastError() << "\n";
+      }
+    }
+    m_output.flush();
+    return;
+  }
+
+  if (args.size() >= 2) {
+    QString limit = args[0].toLower();
+    bool ok;
+    qint64 value = args[1].toLongLong(&ok);
+
+    if (!ok || value < 0) {
+      m_output << "Error: Invalid value: " << args[1] << "\n";
+      m_output.flush();
+      return;
+    }
+
+    if (limit == "age") {
+      policy.maxAgeDays = static_cast<int>(value);
+    } else if (limit == "channel") {
+      policy.maxMessagesPerChannel = static_cast<int>(value);
+    } else if (limit == "size") {
+      policy.maxDatabaseBytes = value * 1024 * 1024;
+    } else if (limit == "hashes") {
+      policy.hashRetentionDays = static_cast<int>(value);
+    } else {
+      m_output << "Error: Unknown limit '" << limit << "'\n";
+      m_output << "Valid limits: age, channel, size, hashes\n";
+      m_output.flush();
+      return;
+    }
+
+    SettingsManager::instance().setRetentionPolicy(policy);
+    if (db) {
+      db->setRetentionPolicy(policy);
+    }
+  } else if (!args.isEmpty()) {
+    m_output << "Usage: retention [age|channel|size|hashes <value>] | retention run|vacuum\n";
+    m_output.flush();
+    return;
+  }
+
+  auto limitString = [](qint64 value, const QString &unit) {
+    return value > 0 ? QString("%1 %2").arg(value).arg(unit) : QString("unlimited");
+  };
+
+  m_output << "Retention policy:\n";
+  m_output << "  Max age:          " << limitString(policy.maxAgeDays, "days") << "\n";
+  m_output << "  Max per channel:  "
+           << limitString(policy.maxMessagesPerChannel, "messages") << "\n";
+  m_output << "  Size budget:      "
+           << limitString(policy.maxDatabaseBytes / (1024 * 1024), "MB") << "\n";
+  m_output << "  Dedup hashes:     " << limitString(policy.hashRetentionDays, "days")
+           << "\n";
+
+  if (db && db->isOpen()) {
+    m_output << "  Database size:    "
+             << QString::number(db->getDatabaseSize() / (1024.0 * 1024.0), 'f', 1)
+             << " MB\n";
+    m_output << "  Space reclaim:    "
+             << (db->isIncrementalVacuumEnabled()
+                     ? "incremental auto-vacuum"
+                     : "off ('retention vacuum' converts the database)")
+             << "\n";
+  }
+
+  m_output.flush();
+}
+
+void CommandLineInterface::cmdCompress(const QStringList &args) {
+  DatabaseManager *db = m_client->databaseManager();
+  RetentionPolicy policy = SettingsManager::instance().getRetentionPolicy();
+  QString action = args.isEmpty() ? QString() : args[0].toLower();
+
+  if (action == "after" && args.size() >= 2) {
+    bool ok;
+    int days = args[1].toInt(&ok);
+    if (!ok || days < 0) {
+      m_output << "Error: Invalid value: " << args[1] << "\n";
+      m_output.flush();
+      return;
+    }
+
+    policy.compressAfterDays = days;
+    SettingsManager::instance().setRetentionPolicy(policy);
+    if (db) {
+      db->setRetentionPolicy(policy);
+    }
+  } else if (!action.isEmpty() && action != "measure") {
+    m_output << "Usage: compress [after <days>] | compress measure [rows]\n";
+    m_output.flush();
+    return;
+  }
+
+  if (policy.compressAfterDays > 0) {
+    m_output << "Compressing partitions older than " << policy.compressAfterDays
+             << " days\n";
+  } else {
+    m_output << "Cold-message compression is off\n";
+  }
+
+  if (!db || !db->isOpen()) {
+    m_output.flush();
+    return;
+  }
+
+  CompressionStats stats = db->compressionStats();
+  m_output << "  Partitions:       " << stats.compressedPartitions << " of " << stats.partitions
+           << " compressed\n";
+  if (stats.compressedPartitions > 0) {
+    m_output << "  Text size:        " << QString::number(stats.rawTextBytes / 1024.0, 'f', 1)
+             << " KB -> " << QString::number(stats.storedTextBytes / 1024.0, 'f', 1)
+             << " KB (" << QString::number(stats.ratio(), 'f', 2) << "x)\n";
+  }
+
+  if (action == "measure") {
+    int rows = args.size() > 1 ? args[1].toInt() : 0;
+    CompressionMeasurement measurement = db->measureCompression(rows > 0 ? rows : 2000);
+    if (measurement.sampledRows == 0) {
+      m_output << "Not enough stored messages to measure.\n";
+    } else {
+      m_output << "Sample of " << measurement.sampledRows << " recent messages ("
+               << (measurement.usedDictionary ? "zstd, trained dictionary" : "zlib") << "):\n";
+      m_output << "  Ratio:            " << QString::number(measurement.ratio(), 'f', 2)
+               << "x (" << measurement.rawBytes << " -> " << measurement.compressedBytes
+               << " bytes)\n";
+      m_output << "  Decode per row:   "
+               << QString::number(measurement.plainDecodeNs, 'f', 0) << " ns plain, "
+               << QString::number(measurement.compressedDecodeNs, 'f', 0)
+               << " ns compressed\n";
+    }
+  }
+
+  m_output.flush();
+}
+
+void CommandLineInterface::cmdWal(const QStringList &args) {
+  DatabaseManager *db = m_client->databaseManager();
+  QString action = args.isEmpty() ? QString() : args[0].toLower();
+
+  if (action == "profile" && args.size() >= 2) {
+    StorageProfile profile;
+    if (!storageProfileFromName(args[1], &profile)) {
+      m_output << "Error: Unknown profile '" << args[1] << "'\n";
+      m_output << "Valid profiles: durable, balanced, throughput\n";
+      m_output.flush();
+      return;
+    }
+
+    SettingsManager::instance().setStorageProfile(profile);
+    if (db) {
+      db->setStorageProfile(profile);
+    }
+  } else if (!action.isEmpty() && action != "checkpoint") {
+    m_output << "Usage: wal [checkpoint [passive|restart|truncate] | profile <name>]\n";
+    m_output.flush();
+    return;
+  }
+
+  StorageProfile profile = SettingsManager::instance().getStorageProfile();
+  StorageTuning tuning = storageTuning(profile);
+  m_output << "Storage profile: " << storageProfileName(profile) << " (synchronous="
+           << tuning.synchronous << ", mmap " << tuning.mmapBytes / (1024 * 1024)
+           << " MB, cache " << tuning.cacheKiB / 1024 << " MB)\n";
+
+  if (!db || !db->isOpen()) {
+    m_output.flush();
+    return;
+  }
+
+  if (action == "checkpoint") {
+    QString modeName = args.size() > 1 ? args[1].toLower() : QString("passive");
+    WalCheckpointer::Mode mode = WalCheckpointer::Passive;
+    if (modeName == "restart") {
+      mode = WalCheckpointer::Restart;
+    } else if (modeName == "truncate") {
+      mode = WalCheckpointer::Truncate;
+    } else if (modeName != "passive") {
+      m_output << "Error: Unknown checkpoint mode '" << modeName << "'\n";
+      m_output.flush();
+      return;
+    }
+
+    bool complete = db->checkpointNow(mode);
+    m_output << WalCheckpointer::modeName(mode) << " checkpoint "
+             << (complete ? "completed" : "did not complete (busy)") << "\n";
+  }
+
+  WalStats stats = db->walStats();
+  m_output << "  WAL size:         " << QString::number(stats.walBytes / 1024.0, 'f', 1)
+           << " KB\n";
+  m_output << "  Checkpoints:      " << stats.passiveCheckpoints << " passive, "
+           << stats.restartCheckpoints << " restart, " << stats.truncateCheckpoints
+           << " truncate (" << stats.busyCheckpoints << " busy)\n";
+  if (stats.checkpoints() > 0) {
+    m_output << "  Duration:         last "
+             << QString::number(stats.lastCheckpointUs / 1000.0, 'f', 1) << " ms, max "
+             << QString::number(stats.maxCheckpointUs / 1000.0, 'f', 1) << " ms, mean "
+             << QString::number(stats.totalCheckpointUs / 1000.0 / stats.checkpoints(), 'f', 1)
+             << " ms\n";
+    m_output << "  Last checkpoint:  " << stats.lastCheckpointedFrames << " of "
+             << stats.lastLogFrames << " frames, "
+             << QDateTime::fromSecsSinceEpoch(stats.lastCheckpointAt).toString("HH:mm:ss")
+             << "\n";
+  }
+
+  m_output.flush();
+}
+
+void CommandLineInterface::cmdStore(const QStringList &args) {
+  if (!args.isEmpty()) {
+    QString backend = args[0].toLower();
+    if (backend != "sqlite" && backend != "log") {
+      m_output << "Usage: store [sqlite|log]\n";
+      m_output.flush();
+      return;
+    }
+
+    SettingsManager::instance().setMessageStore(backend);
+    m_output << "Message store set to " << backend << "; takes effect on the next connect\n";
+  }
+
+  IMessageStore *store = m_client->messageStore();
+  bool usingLog = store && store != m_client->databaseManager();
+  m_output << "Message store: " << (usingLog ? "log" : "sqlite") << " (configured: "
+           << SettingsManager::instance().getMessageStore() << ")\n";
+
+  if (store && store->isOpen()) {
+    m_output << "  Messages:         " << store->getMessageCount() << "\n";
+    if (usingLog) {
+      auto *log = static_cast<MessageLogStore *>(store);
+      m_output << "  Log size:         " << QString::number(log->logBytes() / 1024.0, 'f', 1)
+               << " KB in " << log->segmentCount() << " segment(s)\n";
+    }
+  }
+
+  m_output.flush();
+}
+
+void CommandLineInterface::cmdMetrics(const QStringList &args) {
+  if (!args.isEmpty()) {
+    QString value = args[0].toLower();
+    bool ok = false;
+    int port = value == "off" ? 0 : value.toInt(&ok);
+    if (value != "off" && (!ok || port < 1 || port > 65535)) {
+      m_output << "Usage: metrics [port|off]\n";
+      m_output.flush();
+      return;
+    }
+
+    SettingsManager::instance().setMetricsPort(port);
+    if (port == 0) {
+      m_metricsServer->stop();
+    } else if (!m_metricsServer->start(static_cast<quint16>(port))) {
+      m_output << "Error: " << m_metricsServer->getLastError() << "\n";
+      m_output.flush();
+      return;
+    }
+  }
+
+  if (m_metricsServer->isListening()) {
+    m_output << "Metrics: http://127.0.0.1:" << m_metricsServer->port() << "/metrics\n";
+  } else {
+    m_output << "Metrics endpoint is off. Use 'metrics <port>' to serve it.\n";
+  }
+  m_output.flush();
+}
+
+void CommandLineInterface::cmdTrace(const QStringList &args) {
+  Tracer &tracer = Tracer::instance();
+  QString action = args.isEmpty() ? QString() : args[0].toLower();
+
+  if (action == "on" || action == "off") {
+    tracer.setEnabled(action == "on");
+  } else if (action == "clear") {
+    tracer.clear();
+  } else if (action == "dump" && args.size() > 1) {
+    int events = tracer.eventCount();
+    if (!tracer.writeChromeJson(args[1])) {
+      m_output << "Error: " << tracer.getLastError() << "\n";
+    } else {
+      m_output << "Wrote " << events << " span(s) to " << args[1]
+               << " (open in ui.perfetto.dev or chrome://tracing)\n";
+    }
+    m_output.flush();
+    return;
+  } else if (!action.isEmpty()) {
+    m_output << "Usage: trace [on|off|clear] | trace dump <file>\n";
+    m_output.flush();
+    return;
+  }
+
+  m_output << "Tracing: " << (tracer.isEnabled() ? "on" : "off") << ", "
+           << tracer.eventCount() << " of " << tracer.capacity() << " span(s) buffered\n";
+  m_output.flush();
+}
+
+void CommandLineInterface::cmdLog(const QStringList &args) {
+  // Debug output is off by default (see Logging.cpp); this switches it at
+  // run time, as QT_LOGGING_RULES does at startup (which still wins)
+  const QVector<const QLoggingCategory *> categories = {
+      &lcTransport(), &lcProtocol(), &lcStorage(), &lcCli(), &lcMetrics()};
+  QString action = args.isEmpty() ? QString() : args[0].toLower();
+  QString subsystem = args.size() > 1 ? "meshcore." + args[1].toLower() : QString();
+  auto matches = [&](const QLoggingCategory *category) {
+    return subsystem.isEmpty() || QLatin1String(category->categoryName()) == subsystem;
+  };
+
+  if ((action != "on" && action != "off" && !action.isEmpty()) ||
+      std::none_of(categories.cbegin(), categories.cend(), matches)) {
+    m_output << "Usage: log [on|off] [transport|protocol|storage|cli|metrics]\n";
+    m_output.flush();
+    return;
+  }
+
+  if (!action.isEmpty()) {
+    // Filter rules replace each other, so every category's state is restated
+    QStringList rules;
+    for (const QLoggingCategory *category : categories) {
+      bool enabled = matches(category) ? action == "on" : category->isDebugEnabled();
+      rules.append(QString("%1.debug=%2")
+                       .arg(QLatin1String(category->categoryName()),
+                            enabled ? QLatin1String("true") : QLatin1String("false")));
+    }
+    QLoggingCategory::setFilterRules(rules.join('\n'));
+  }
+
+  for (const QLoggingCategory *category : categories) {
+    m_output << "  " << category->categoryName() << ": debug "
+             << (category->isDebugEnabled() ? "on" : "off") << "\n";
+  }
+  m_output.flush();
+}
+
+void CommandLineInterface::cmdSql(const QStringList &args) {
+  DatabaseManager *db = m_client->databaseManager();
+  if (!db) {
+    m_output << "Error: Persistence is disabled\n";
+    m_output.flush();
+    return;
+  }
+
+  QueryProfiler &profiler = db->queryProfiler();
+  QString action = args.isEmpty() ? QString() : args[0].toLower();
+  auto ms = [](qint64 ns) { return QString::number(ns / 1e6, 'f', 2).rightJustified(10); };
+
+  if (action == "slow") {
+    if (args.size() > 1) {
+      bool ok = true;
+      int threshold = args[1].toLower() == "off" ? 0 : args[1].toInt(&ok);
+      if (!ok || threshold < 0) {
+        m_output << "Usage: sql slow [ms|off]\n";
+        m_output.flush();
+        return;
+      }
+      profiler.setSlowThresholdMs(threshold);
+      SettingsManager::instance().setSlowQueryMs(threshold);
+    }
+
+    const QVector<SlowQuery> slow = profiler.slowQueries();
+    m_output << "Slow-query log: "
+             << (profiler.slowThresholdMs() > 0
+                     ? QString("statements over %1 ms").arg(profiler.slowThresholdMs())
+                     : QString("off"))
+             << ", " << slow.size() << " entr" << (slow.size() == 1 ? "y" : "ies") << "\n";
+    for (int i = qMax(0, slow.size() - 20); i < slow.size(); ++i) {
+      m_output << "  " << QDateTime::fromMSecsSinceEpoch(slow[i].at).toString("HH:mm:ss")
+               << ms(slow[i].elapsedNs) << " ms  " << QueryProfiler::normalize(slow[i].sql)
+               << "\n";
+    }
+    m_output.flush();
+    return;
+  }
+
+  if (action == "plans") {
+    if (args.size() > 1) {
+      profiler.setCapturePlans(args[1].toLower() == "on");
+    }
+    m_output << "Plan capture for slow statements: "
+             << (profiler.capturePlans() ? "on" : "off") << "\n";
+    m_output.flush();
+    return;
+  }
+
+  if (action == "reset") {
+    profiler.reset();
+    m_output << "Statement timings and the slow-query log cleared.\n";
+    m_output.flush();
+    return;
+  }
+
+  const QVector<StatementStats> statements = profiler.statements();
+
+  if (action == "explain") {
+    int n = args.size() > 1 ? args[1].toInt() : 0;
+    if (n < 1 || n > statements.size()) {
+      m_output << "Usage: sql explain <n>, n from the 'sql' listing (1-" << statements.size()
+               << ")\n";
+      m_output.flush();
+      return;
+    }
+
+    const StatementStats &statement = statements[n - 1];
+    m_output << statement.sql << "\n";
+    if (!statement.plan.isEmpty()) {
+      m_output << "Plan when it ran slow:\n" << statement.plan << "\n";
+    }
+    // Placeholders are bound to NULL; the plan can differ for some values
+    m_output << "Plan now:\n" << db->explainQueryPlan(statement.exampleSql) << "\n";
+    m_output.flush();
+    return;
+  }
+
+  bool ok = true;
+  int limit = action.isEmpty() ? 10 : action.toInt(&ok);
+  if (!ok || limit <= 0) {
+    m_output << "Usage: sql [n|reset] | sql slow [ms|off] | sql plans [on|off] | "
+                "sql explain <n>\n";
+    m_output.flush();
+    return;
+  }
+
+  m_output << "Statements by total time (ms):\n";
+  m_output << "   #      calls      total       mean        max  statement\n";
+  for (int i = 0; i < qMin(limit, statements.size()); ++i) {
+    const StatementStats &statement = statements[i];
+    QString sql = statement.sql;
+    if (sql.size() > 70) {
+      sql = sql.left(67) + "...";
+    }
+    m_output << QString::number(i + 1).rightJustified(4)
+             << QString::number(statement.executions).rightJustified(11)
+             << ms(statement.totalNs) << ms(qint64(statement.meanNs())) << ms(statement.maxNs)
+             << "  " << sql
+             << (statement.plan.isEmpty() ? "" : " [plan]") << "\n";
+  }
+  if (statements.isEmpty()) {
+    m_output << "  No statements recorded yet.\n";
+  }
+  m_output.flush();
+}
+
+void CommandLineInterface::cmdFrames(const QStringList &args) {
+  FlightRecorder &recorder = FlightRecorder::instance();
+  QString action = args.isEmpty() ? QString() : args[0].toLower();
+
+  if (action == "dump" && args.size() > 1) {
+    if (!recorder.dump(args[1], "Requested from the command line")) {
+      m_output << "Error: " << recorder.getLastError() << "\n";
+    } else {
+      m_output << "Wrote " << recorder.frameCount() << " frame(s) to " << args[1] << "\n";
+    }
+    m_output.flush();
+    return;
+  }
+
+  bool ok = true;
+  int count = action.isEmpty() ? 20 : action.toInt(&ok);
+  if (!ok || count <= 0) {
+    m_output << "Usage: frames [n] | frames dump <file>\n";
+    m_output.flush();
+    return;
+  }
+
+  const QStringList lines = recorder.describe(count);
+  if (lines.isEmpty()) {
+    m_output << "No frames recorded yet.\n";
+  }
+  for (const QString &line : lines) {
+    m_output << line << "\n";
+  }
+  m_output << "(" << recorder.frameCount() << " of " << recorder.capacity()
+           << " frames kept; automatic dumps go to " << recorder.dumpDirectory() << ")\n";
+  m_output.flush();
+}
+
+void CommandLineInterface::cmdExport(const QStringList &args) {
+  QString action = args.isEmpty() ? QString() : args[0].toLower();
+  HistoryExporter::Format format = HistoryExporter::JsonLines;
+
+  if (args.size() < 2 ||
+      (action != "read" && !HistoryExporter::formatFromName(action, &format))) {
+    m_output << "Usage: export <jsonl|archive> <file> [days] | export read <file>\n";
+    m_output.flush();
+    return;
+  }
+
+  if (m_exporter) {
+    m_output << "Error: An export is already running\n";
+    m_output.flush();
+    return;
+  }
+
+  IMessageStore *store = m_client->messageStore();
+  if (action != "read" && (!store || !store->isOpen())) {
+    m_output << "Error: Message history is not open\n";
+    m_output.flush();
+    return;
+  }
+
+  // Runs on the exporter's thread; report as it progresses
+  const bool reading = action == "read";
+  m_exporter = new HistoryExporter(store, this);
+  connect(m_exporter, &HistoryExporter::progress, this, [this](qint64 rows, qint64 elapsedMs) {
+    m_output << "\n[Export] " << rows << " rows (" << elapsedMs / 1000 << " s)\n";
+    m_output.flush();
+    printPrompt();
+  });
+  connect(m_exporter, &HistoryExporter::finished, this,
+          [this, reading](bool ok, const ExportStats &stats) {
+            if (!ok) {
+              m_output << "\n[Export] Failed: " << m_exporter->getLastError() << "\n";
+            } else {
+              m_output << "\n[Export] " << (reading ? "Read " : "Exported ") << stats.rows
+                       << " messages, " << QString::number(stats.bytes / 1024.0, 'f', 1)
+                       << " KB, in " << stats.elapsedMs << " ms ("
+                       << QString::number(stats.rowsPerSecond(), 'f', 0) << " rows/s)\n";
+            }
+            m_output.flush();
+            printPrompt();
+
+            m_exporter->deleteLater();
+            m_exporter = nullptr;
+          });
+
+  if (reading) {
+    m_exporter->startRead(args[1]);
+    m_output << "Reading " << args[1] << "\n";
+  } else {
+    int days = args.size() > 2 ? args[2].toInt() : 0;
+    if (days > 0) {
+      m_exporter->setRange(QDateTime::currentDateTime().addDays(-days).toSecsSinceEpoch(), 0);
+    }
+    m_exporter->start(args[1], format);
+    m_output << "Export started: " << args[1] << "\n";
+  }
+  m_output.flush();
+}
+
+void CommandLineInterface::cmdBackup(const QStringList &args) {
+  DatabaseManager *db = m_client->databaseManager();
+
+  if (args.isEmpty() || (args.size() > 1 && args[1].toLower() != "noverify")) {
+    m_output << "Usage: backup <file> [noverify]\n";
+  } else if (!db || !db->isOpen()) {
+    m_output << "Error: Database not open\n";
+  } else if (!db->backupTo(args[0], args.size() < 2)) {
+    m_output << "Error: " << db->getLastError() << "\n";
+  } else {
+    m_backupReportedPercent = -1;
+    m_output << "Backup started: " << args[0] << "\n";
+  }
+  m_output.flush();
+}
+
 // Signal handlers
+void CommandLineInterface::cmdHistory(const QStringList &args) {
+  if (args.isEmpty()) {
+    m_output << "Usage: history <channel|pubkey> [limit] [offset]\n";
+    m_output.flush();
+    return;
+  }
+
+  int limit = args.size() > 1 ? args[1].toInt() : 20;
+  int offset = args.size() > 2 ? args[2].toInt() : 0;
+  if (limit <= 0 || offset < 0) {
+    m_output << "Error: Invalid limit or offset\n";
+    m_output.flush();
+    return;
+  }
+
+  // A short number is a channel index, anything else a public key prefix
+  bool isChannel;
+  uint channelIdx = args[0].toUInt(&isChannel);
+  isChannel = isChannel && args[0].size() <= 3 && channelIdx <= 255;
+
+  DatabaseManager *db = m_client->databaseManager();
+  QVector<Message> messages;
+  if (isChannel) {
+    messages = m_client->getChannelMessageHistory(static_cast<uint8_t>(channelIdx),
+                                                  limit, offset);
+    if (offset == 0 && db && db->isOpen()) {
+      db->markRead(static_cast<uint8_t>(channelIdx));
+    }
+  } else {
+    QByteArray prefix = QByteArray::fromHex(args[0].toLatin1()).left(6);
+    if (prefix.isEmpty()) {
+      m_output << "Error: Invalid channel index or public key\n";
+      m_output.flush();
+      return;
+    }
+    messages = m_client->getDirectMessageHistory(prefix, limit, offset);
+    if (offset == 0 && db && db->isOpen()) {
+      db->markRead(prefix);
+    }
+  }
+
+  if (messages.isEmpty()) {
+    m_output << "No messages.\n";
+  }
+
+  for (const Message &msg : messages) {
+    QString sender = msg.senderName.isEmpty() ? QString(msg.senderPubKeyPrefix.toHex())
+                                              : msg.senderName;
+    m_output << "[" << msg.receivedAt.toString("yyyy-MM-dd HH:mm:ss") << "] " << sender
+             << ": " << msg.text << "\n";
+  }
+
+  m_output.flush();
+}
+
+void CommandLineInterface::cmdInbox() {
+  DatabaseManager *db = m_client->databaseManager();
+  if (!db || !db->isOpen()) {
+    m_output << "Error: Database not open.\n";
+    m_output.flush();
+    return;
+  }
+
+  QVector<Conversation> conversations = db->listConversations();
+  if (conversations.isEmpty()) {
+    m_output << "No conversations.\n";
+  }
+
+  for (const Conversation &conversation : conversations) {
+    QString title;
+    if (conversation.kind == Message::CHANNEL_MESSAGE) {
+      title = QString("#%1").arg(conversation.channelIdx);
+      for (const Channel &ch : m_client->getChannels()) {
+        if (ch.index == conversation.channelIdx) {
+          title = QString("#%1 %2").arg(QString::number(ch.index), ch.name);
+          break;
+        }
+      }
+    } else {
+      title = QString("@%1").arg(QString(conversation.pubKeyPrefix.toHex()));
+    }
+
+    QString unread =
+        conversation.unreadCount > 0 ? QString(" (%1 unread)").arg(conversation.unreadCount)
+                                     : QString();
+    QString preview = conversation.lastText.left(50);
+    if (!conversation.lastSenderName.isEmpty()) {
+      preview = conversation.lastSenderName + ": " + preview;
+    }
+
+    m_output << (conversation.unreadCount > 0 ? "* " : "  ") << title << unread << "\n";
+    m_output << "    "
+             << QDateTime::fromSecsSinceEpoch(conversation.lastTimestamp)
+                    .toString("yyyy-MM-dd HH:mm")
+             << "  " << preview << "\n";
+  }
+
+  m_output.flush();
+}
+
+void CommandLineInterface::cmdStats(const QStringList &args) {
+  if (!args.isEmpty() && args[0].toLower() == "latency") {
+    printLatency(args.size() > 1 && args[1].toLower() == "reset");
+    return;
+  }
+  if (!args.isEmpty() && args[0].toLower() == "memory") {
+    printMemory();
+    return;
+  }
+
+  DatabaseManager *db = m_client->databaseManager();
+  if (!db || !db->isOpen()) {
+    m_output << "Error: Database not open.\n";
+    m_output.flush();
+    return;
+  }
+
+  QString section = args.isEmpty() ? QString() : args[0].toLower();
+  int count = args.size() > 1 ? args[1].toInt() : 0;
+  bool all = section.isEmpty();
+
+  if (all || section == "channels") {
+    m_output << "Stored messages: " << db->getMessageCount() << "\n";
+    for (const ChannelCount &channel : db->getChannelCounts()) {
+      m_output << "  " << channelKeyToString(channel.channelKey).leftJustified(14) << " "
+               << channel.messageCount << "\n";
+    }
+  }
+
+  if (all || section == "hours") {
+    int hours = count > 0 ? count : 24;
+    m_output << "Received in the last " << hours << " hour(s):\n";
+    for (const HourlyCount &hour : db->getHourlyCounts(hours)) {
+      m_output << "  " << QDateTime::fromSecsSinceEpoch(hour.hourStart).toString("MM-dd HH:00")
+               << "  " << channelKeyToString(hour.channelKey).leftJustified(14) << " "
+               << hour.messageCount << "\n";
+    }
+  }
+
+  if (all || section == "senders") {
+    m_output << "Top senders:\n";
+    for (const SenderCount &sender : db->getTopSenders(count > 0 ? count : 10)) {
+      QString name = sender.name.isEmpty() ? QString(sender.pubKeyPrefix.toHex()) : sender.name;
+      m_output << "  " << name.leftJustified(20) << " " << sender.messageCount << " (last "
+               << QDateTime::fromSecsSinceEpoch(sender.lastReceivedAt)
+                      .toString("yyyy-MM-dd HH:mm")
+               << ")\n";
+    }
+  }
+
+  if (all || section == "snr") {
+    m_output << "SNR distribution:\n";
+    printHistogram(db->getSnrHistogram(), "dB");
+  }
+
+  if (all || section == "paths") {
+    m_output << "Path length distribution:\n";
+    printHistogram(db->getPathLengthHistogram(), "hops");
+  }
+
+  if (!all && section != "channels" && section != "hours" && section != "senders" &&
+      section != "snr" && section != "paths") {
+    m_output << "Unknown stats section: " << section << "\n";
+  }
+
+  m_output.flush();
+}
+
+QString CommandLineInterface::channelKeyToString(int channelKey) const {
+  if (channelKey == ChannelCount::DIRECT_MESSAGES) {
+    return "direct";
+  }
+  return QString("channel %1").arg(channelKey);
+}
+
+void CommandLineInterface::printHistogram(const QVector<HistogramBucket> &buckets,
+                                          const QString &unit) {
+  qint64 peak = 0;
+  for (const HistogramBucket &bucket : buckets) {
+    peak = qMax(peak, bucket.messageCount);
+  }
+
+  for (const HistogramBucket &bucket : buckets) {
+    QString label = (unit == "hops" && bucket.value == 0xFF)
+                        ? QString("direct")
+                        : QString("%1 %2").arg(bucket.value).arg(unit);
+    int width = peak > 0 ? static_cast<int>(bucket.messageCount * 40 / peak) : 0;
+    m_output << "  " << label.rightJustified(9) << " " << QString(width, '#') << " "
+             << bucket.messageCount << "\n";
+  }
+}
+
+void CommandLineInterface::printLatency(bool reset) {
+  auto us = [](qint64 ns) { return QString::number(ns / 1000.0, 'f', 1).rightJustified(9); };
+
+  const LatencyMetrics &metrics = m_client->metrics();
+  m_output << "Receive latency (us):\n";
+  m_output << "  stage          count      p50      p90      p99    p99.9      max\n";
+  for (int i = 0; i < LatencyMetrics::StageCount; ++i) {
+    const auto stage = static_cast<LatencyMetrics::Stage>(i);
+    const LatencyHistogram &histogram = metrics.stage(stage);
+    m_output << "  " << QString(LatencyMetrics::stageName(stage)).leftJustified(9)
+             << QString::number(histogram.count()).rightJustified(10) << us(histogram.valueAt(0.5))
+             << us(histogram.valueAt(0.9)) << us(histogram.valueAt(0.99))
+             << us(histogram.valueAt(0.999)) << us(histogram.max()) << "\n";
+  }
+
+  if (reset) {
+    m_client->resetMetrics();
+    m_output << "Latency histograms reset.\n";
+  }
+  m_output.flush();
+}
+
+void CommandLineInterface::printMemory() {
+  auto size = [](double bytes) {
+    const char *units[] = {"B", "KB", "MB", "GB"};
+    int unit = 0;
+    while (qAbs(bytes) >= 1024 && unit < 3) {
+      bytes /= 1024;
+      unit++;
+    }
+    const QString text = QString::number(bytes, 'f', unit == 0 ? 0 : 1) + ' ' + units[unit];
+    return text.rightJustified(11);
+  };
+
+  const qint64 resident = MemoryAccounting::residentBytes();
+  if (resident > 0) {
+    m_output << "Resident: " << size(resident).trimmed() << "\n";
+  }
+
+  // Footprints: what the long-lived containers hold
+  QVector<qint64> footprintTotals(MemoryAccounting::SubsystemCount, 0);
+  const QVector<MemoryAccounting::Footprint> footprints =
+      MemoryAccounting::instance().footprints();
+  for (const MemoryAccounting::Footprint &footprint : footprints) {
+    footprintTotals[footprint.subsystem] += footprint.bytes;
+  }
+
+  const bool heap = MemoryAccounting::heapCountingEnabled();
+  const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+  const double seconds = m_lastHeapStatsMs > 0 ? (nowMs - m_lastHeapStatsMs) / 1000.0 : 0.0;
+  QVector<MemoryAccounting::HeapStats> heapStats;
+
+  m_output << "  subsystem      footprint" << (heap ? "  live heap   allocs/s    bytes/s" : "")
+           << "\n";
+  for (int i = 0; i < MemoryAccounting::SubsystemCount; ++i) {
+    const auto subsystem = static_cast<MemoryAccounting::Subsystem>(i);
+    const MemoryAccounting::HeapStats stats = MemoryAccounting::heapStats(subsystem);
+    heapStats.append(stats);
+
+    m_output << "  " << QString(MemoryAccounting::subsystemName(subsystem)).leftJustified(12)
+             << size(footprintTotals[i]);
+    if (heap) {
+      m_output << size(stats.liveBytes());
+      if (seconds > 0 && m_lastHeapStats.size() == heapStats.size()) {
+        const MemoryAccounting::HeapStats &last = m_lastHeapStats[i];
+        m_output << QString::number((stats.allocations - last.allocations) / seconds, 'f', 1)
+                        .rightJustified(11)
+                 << size((stats.bytesAllocated - last.bytesAllocated) / seconds);
+      }
+    }
+    m_output << "\n";
+  }
+
+  m_output << "Footprints:\n";
+  for (const MemoryAccounting::Footprint &footprint : footprints) {
+    m_output << "  " << QString("%1/%2")
+                            .arg(MemoryAccounting::subsystemName(footprint.subsystem),
+                                 footprint.name)
+                            .leftJustified(28)
+             << size(footprint.bytes) << "\n";
+  }
+
+  const FrameArena &arena = m_client->frameArena();
+  m_output << "Frame arena: " << arena.frames() << " frames, " << arena.overflows()
+           << " heap spills past its " << FrameArena::CAPACITY << " bytes\n";
+
+  if (!heap) {
+    m_output << "Heap counters are off (build with -DMESHCOREQT_MEMORY_ACCOUNTING=ON).\n";
+  } else if (seconds > 0) {
+    m_output << "Rates are over the " << QString::number(seconds, 'f', 0)
+             << " s since the previous 'stats memory'.\n";
+  }
+  m_lastHeapStats = heapStats;
+  m_lastHeapStatsMs = nowMs;
+  m_output.flush();
+}
+
 void CommandLineInterface::onChannelMessageReceived(const Message &msg) {
+  if (!m_renderer->admitMessage()) {
+    return;
+  }
+  TraceScope span("cli", "renderMessage");
+  MemoryScope memory(MemoryAccounting::Ui);
   m_output << "\n";
   m_output
       << "╔══════════════════════════════════════════════════════════════\n";
@@ -713,17 +1693,22 @@ void CommandLineInterface::onChannelMessageReceived(const Message &msg) {
 }
 
 void CommandLineInterface::onContactMessageReceived(const Message &msg) {
+  if (!m_renderer->admitMessage()) {
+    return;
+  }
+  TraceScope span("cli", "renderMessage");
+  MemoryScope memory(MemoryAccounting::Ui);
   // Try to resolve sender name from contacts
   QString senderDisplay = msg.senderPubKeyPrefix.toHex();
   QString senderName;
   QVector<Contact> contacts = m_client->getContacts();
 
-  qDebug() << "Resolving sender" << senderDisplay << "from" << contacts.size() << "contacts";
+  qCDebug(lcCli) << "Resolving sender" << senderDisplay << "from" << contacts.size() << "contacts";
 
   for (const Contact &contact : contacts) {
     if (contact.publicKey().startsWith(msg.senderPubKeyPrefix)) {
       senderName = contact.name();
-      qDebug() << "Found matching contact:" << senderName;
+      qCDebug(lcCli) << "Found matching contact:" << senderName;
 
       if (!senderName.isEmpty()) {
         senderDisplay = QString("%1 (%2)").arg(senderName, msg.senderPubKeyPrefix.toHex());
@@ -736,7 +1721,7 @@ void CommandLineInterface::onContactMessageReceived(const Message &msg) {
   }
 
   if (senderName.isEmpty()) {
-    qDebug() << "No matching contact found for" << senderDisplay;
+    qCDebug(lcCli) << "No matching contact found for" << senderDisplay;
     // Show as "Unknown Contact (prefix)"
     senderDisplay = QString("Unknown Contact (%1)").arg(senderDisplay);
   }
@@ -801,6 +1786,34 @@ void CommandLineInterface::onNoMoreMessages() {
   m_output.flush();
 }
 
+void CommandLineInterface::onBackupProgress(qint64 bytesWritten, qint64 bytesExpected) {
+  if (bytesExpected <= 0) {
+    return;
+  }
+
+  // One line per 10%
+  int percent = int(qMin<qint64>(100, bytesWritten * 100 / bytesExpected)) / 10 * 10;
+  if (percent > m_backupReportedPercent) {
+    m_backupReportedPercent = percent;
+    m_output << "\n[Backup] " << percent << "% ("
+             << QString::number(bytesWritten / (1024.0 * 1024.0), 'f', 1) << " MB)\n";
+    m_output.flush();
+    printPrompt();
+  }
+}
+
+void CommandLineInterface::onBackupFinished(const BackupResult &result) {
+  if (result.ok) {
+    m_output << "\n[Backup] Wrote " << result.path << " ("
+             << QString::number(result.bytes / (1024.0 * 1024.0), 'f', 1) << " MB) in "
+             << result.elapsedMs << " ms" << (result.verified ? ", verified" : "") << "\n";
+  } else {
+    m_output << "\n[Backup] Failed: " << result.error << "\n";
+  }
+  m_output.flush();
+  printPrompt();
+}
+
 void CommandLineInterface::printChannels() { cmdChannels(); }
 
 void CommandLineInterface::cmdScan(const QStringList &args) {
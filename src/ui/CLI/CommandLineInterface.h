@@ -4,10 +4,17 @@
 #include <QSocketNotifier>
 #include <QTextStream>
 
+#include "../../core/MemoryAccounting.h"
 #include "../../core/MeshClient.h"
+#include "../../storage/DatabaseBackup.h"
+#include "../../storage/MessageStats.h"
+#include "TerminalRenderer.h"
 
 namespace MeshCore {
 
+class HistoryExporter;
+class MetricsServer;
+
 class CommandLineInterface : public QObject {
   Q_OBJECT
 
@@ -30,6 +37,8 @@ private slots:
   void onNoMoreMessages();
   void onBLEDeviceFound(const BLEDeviceInfo &device);
   void onBLEDiscoveryFinished();
+  void onBackupProgress(qint64 bytesWritten, qint64 bytesExpected);
+  void onBackupFinished(const BackupResult &result);
 
 private:
   void printHelp();
@@ -56,17 +65,43 @@ private:
   void cmdAdvert(const QStringList &args);
   void cmdSetName(const QStringList &args);
   void cmdSetLocation(const QStringList &args);
+  void cmdRetention(const QStringList &args);
+  void cmdCompress(const QStringList &args);
+  void cmdWal(const QStringList &args);
+  void cmdStore(const QStringList &args);
+  void cmdExport(const QStringList &args);
+  void cmdBackup(const QStringList &args);
+  void cmdHistory(const QStringList &args);
+  void cmdStats(const QStringList &args);
+  void cmdMetrics(const QStringList &args);
+  void cmdTrace(const QStringList &args);
+  void cmdLog(const QStringList &args);
+  void cmdSql(const QStringList &args);
+  void cmdFrames(const QStringList &args);
+  void cmdInbox();
 
   // Helper methods for contacts command
   QString contactTypeToString(uint8_t type) const;
   QString formatPathLength(int8_t pathLen) const;
   void printContactDetails(const Contact &contact);
+  QString channelKeyToString(int channelKey) const;
+  void printHistogram(const QVector<HistogramBucket> &buckets, const QString &unit);
+  void printLatency(bool reset);
+  void printMemory();
 
   MeshClient *m_client;
   QTextStream m_input;
-  QTextStream m_output;
+  TerminalRenderer *m_renderer;
+  QTextStream &m_output; // m_renderer's stream
   QSocketNotifier *m_notifier;
+  MetricsServer *m_metricsServer;
   bool m_running;
+  int m_backupReportedPercent;
+  HistoryExporter *m_exporter; // While an export runs
+
+  // Heap counters at the previous 'stats memory', for allocation rates
+  QVector<MemoryAccounting::HeapStats> m_lastHeapStats;
+  qint64 m_lastHeapStatsMs;
 };
 
 } // namespace MeshCore
@@ -0,0 +1,106 @@
+#include "TerminalRenderer.h"
+#include <QTimer>
+#include <cstdio>
+#include <utility>
+
+namespace MeshCore {
+
+TerminalRenderer::Buffer::Buffer(TerminalRenderer *renderer) : m_renderer(renderer) {
+  open(QIODevice::WriteOnly);
+}
+
+QByteArray TerminalRenderer::Buffer::take() { return std::exchange(m_bytes, QByteArray()); }
+
+qint64 TerminalRenderer::Buffer::writeData(const char *data, qint64 size) {
+  m_bytes.append(data, size);
+  m_renderer->schedule();
+  return size;
+}
+
+TerminalRenderer::TerminalRenderer(QObject *parent)
+    : QObject(parent), m_buffer(this), m_stream(&m_buffer), m_timer(new QTimer(this)),
+      m_promptRequested(false), m_messagesThisFlush(0), m_skippedMessages(0),
+      m_worker(new QObject), m_backlogBytes(0) {
+  m_timer->setSingleShot(true);
+  connect(m_timer, &QTimer::timeout, this, &TerminalRenderer::flush);
+  m_sinceFlush.start();
+
+  m_thread.setObjectName("TerminalWriter");
+  m_worker->moveToThread(&m_thread);
+  connect(&m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+  m_thread.start();
+}
+
+TerminalRenderer::~TerminalRenderer() {
+  flush();
+
+  // Blocks until the writer has caught up, which is as long as the terminal
+  // takes; only at exit
+  QMetaObject::invokeMethod(m_worker, []() {}, Qt::BlockingQueuedConnection);
+  m_thread.quit();
+  m_thread.wait();
+}
+
+bool TerminalRenderer::admitMessage() {
+  if (behind() || m_messagesThisFlush >= MAX_MESSAGES_PER_FLUSH) {
+    m_skippedMessages++;
+    schedule();
+    return false;
+  }
+
+  m_messagesThisFlush++;
+  return true;
+}
+
+void TerminalRenderer::requestPrompt() {
+  m_promptRequested = true;
+  schedule();
+}
+
+void TerminalRenderer::schedule() {
+  // Started by the first write after a flush; later writes join it
+  if (!m_timer->isActive()) {
+    m_timer->start(qMax<qint64>(0, MIN_FLUSH_INTERVAL_MS - m_sinceFlush.elapsed()));
+  }
+}
+
+bool TerminalRenderer::behind() const {
+  return m_backlogBytes.load(std::memory_order_relaxed) > MAX_BACKLOG_BYTES;
+}
+
+void TerminalRenderer::flush() {
+  m_stream.flush();
+  QByteArray bytes = m_buffer.take();
+  m_timer->stop(); // Started again by the stream flush
+
+  if (m_skippedMessages > 0) {
+    if (behind()) {
+      m_timer->start(RETRY_MS); // Summarized once the writer catches up
+    } else {
+      bytes += QString("\n[%1 more message%2 not shown; 'history' lists them]\n")
+                   .arg(m_skippedMessages)
+                   .arg(m_skippedMessages == 1 ? "" : "s")
+                   .toUtf8();
+      m_skippedMessages = 0;
+    }
+  }
+  if (m_promptRequested) {
+    bytes += "> ";
+    m_promptRequested = false;
+  }
+
+  m_messagesThisFlush = 0;
+  m_sinceFlush.restart();
+  if (bytes.isEmpty()) {
+    return;
+  }
+
+  m_backlogBytes.fetch_add(bytes.size(), std::memory_order_relaxed);
+  QMetaObject::invokeMethod(m_worker, [this, bytes]() {
+    std::fwrite(bytes.constData(), 1, size_t(bytes.size()), stdout);
+    std::fflush(stdout);
+    m_backlogBytes.fetch_sub(bytes.size(), std::memory_order_relaxed);
+  });
+}
+
+} // namespace MeshCore
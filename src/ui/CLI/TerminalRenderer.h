@@ -0,0 +1,84 @@
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QIODevice>
+#include <QObject>
+#include <QTextStream>
+#include <QThread>
+
+#include <atomic>
+
+class QTimer;
+
+namespace MeshCore {
+
+// The CLI's stdout. Text written to stream() is collected and handed to a
+// writer thread at most once per event-loop turn, and no more often than
+// every MIN_FLUSH_INTERVAL_MS, so a slow terminal (a paused ssh session, a
+// pipe nobody reads) never blocks the main thread, where frames are
+// received and stored. The prompt is redrawn once per flush, after
+// everything else written in it.
+//
+// Received messages are shed under load: admitMessage() refuses them while
+// the writer is more than MAX_BACKLOG_BYTES behind or once
+// MAX_MESSAGES_PER_FLUSH have been shown since the last flush, and a
+// summary line with the count takes their place. Other output is never
+// dropped.
+class TerminalRenderer : public QObject {
+  Q_OBJECT
+
+public:
+  explicit TerminalRenderer(QObject *parent = nullptr);
+  // Writes what is pending and waits for the writer
+  ~TerminalRenderer();
+
+  QTextStream &stream() { return m_stream; }
+
+  // Whether to render a received message now; if not it is counted for
+  // the summary
+  bool admitMessage();
+  // Redraws the prompt at the end of the next flush
+  void requestPrompt();
+  // Hands what is pending to the writer now
+  void flush();
+
+private:
+  // Collects what m_stream writes and schedules a flush
+  class Buffer : public QIODevice {
+  public:
+    explicit Buffer(TerminalRenderer *renderer);
+    bool isSequential() const override { return true; }
+    QByteArray take();
+
+  protected:
+    qint64 readData(char *, qint64) override { return -1; }
+    qint64 writeData(const char *data, qint64 size) override;
+
+  private:
+    TerminalRenderer *m_renderer;
+    QByteArray m_bytes;
+  };
+
+  void schedule();
+  bool behind() const;
+
+  Buffer m_buffer;
+  QTextStream m_stream;
+  QTimer *m_timer;
+  QElapsedTimer m_sinceFlush;
+  bool m_promptRequested;
+  int m_messagesThisFlush;
+  quint64 m_skippedMessages; // Since the last summary
+
+  QThread m_thread;
+  QObject *m_worker;                   // Lives on m_thread; writes to stdout
+  std::atomic<qint64> m_backlogBytes; // Handed to the writer, not yet written
+
+  static const int MIN_FLUSH_INTERVAL_MS = 16;
+  static const int RETRY_MS = 100; // While messages are being skipped
+  static const int MAX_MESSAGES_PER_FLUSH = 8;
+  static const qint64 MAX_BACKLOG_BYTES = 64 * 1024;
+};
+
+} // namespace MeshCore